@@ -0,0 +1,141 @@
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "hmon/metric_registry.hpp"
+#include "hmon/plugin_abi.h"
+#include "hmon/static_plugins.hpp"
+#include "proc_fixture.hpp"
+
+namespace {
+
+using hmon::bench::FixtureSpec;
+using hmon::bench::ProcFixture;
+
+/* One static plugin driven the way the scheduler does: host buffers reused every tick. */
+class PluginRunner {
+public:
+    explicit PluginRunner(const char* name) {
+        for (const auto& sp : hmon::core::staticPlugins()) {
+            if (std::strcmp(sp.name, name) == 0) plugin_ = &sp;
+        }
+        if (plugin_ && plugin_->init(&ctx_) != 0) ctx_ = nullptr;
+    }
+    ~PluginRunner() {
+        if (ctx_) plugin_->destroy(ctx_);
+    }
+    PluginRunner(const PluginRunner&) = delete;
+    PluginRunner& operator=(const PluginRunner&) = delete;
+
+    bool ok() const { return ctx_ != nullptr; }
+
+    size_t collect() {
+        list_ = hmon_metric_list{items_.data(), 0, items_.size()};
+        arena_ = hmon_arena{arena_buf_.data(), 0, arena_buf_.size(), 0};
+        plugin_->collect(ctx_, &list_, &arena_);
+        return list_.count;
+    }
+
+    const hmon_metric_list& list() const { return list_; }
+
+private:
+    const hmon::core::StaticPlugin* plugin_ = nullptr;
+    hmon_plugin_ctx* ctx_ = nullptr;
+    std::vector<hmon_metric> items_ = std::vector<hmon_metric>(4096);
+    std::vector<char> arena_buf_ = std::vector<char>(4 << 20);
+    hmon_metric_list list_{};
+    hmon_arena arena_{};
+};
+
+void runCollector(benchmark::State& state, const char* plugin, const FixtureSpec& spec) {
+    const ProcFixture& fixture = ProcFixture::get(spec);
+    if (!fixture.ok()) {
+        state.SkipWithError("could not create the fixture tree");
+        return;
+    }
+    fixture.activate();
+    PluginRunner runner(plugin);
+    if (!runner.ok()) {
+        state.SkipWithError("plugin init failed");
+        return;
+    }
+    /* The first collect opens and caches its fds; steady state is what the scheduler pays every tick. */
+    runner.collect();
+    for (auto _ : state) benchmark::DoNotOptimize(runner.collect());
+}
+
+void BM_CpuCollect(benchmark::State& state) {
+    FixtureSpec spec;
+    spec.cores = static_cast<int>(state.range(0));
+    runCollector(state, "cpu", spec);
+}
+BENCHMARK(BM_CpuCollect)->Arg(4)->Arg(64)->Arg(256)->Unit(benchmark::kMicrosecond);
+
+void BM_ProcessCollect(benchmark::State& state) {
+    FixtureSpec spec;
+    spec.processes = static_cast<int>(state.range(0));
+    runCollector(state, "process", spec);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ProcessCollect)->Arg(1000)->Arg(10000)->Arg(50000)->Unit(benchmark::kMillisecond);
+
+void BM_PortsCollect(benchmark::State& state) {
+    FixtureSpec spec;
+    spec.processes = 1000;
+    spec.sockets = static_cast<int>(state.range(0));
+    runCollector(state, "ports", spec);
+}
+BENCHMARK(BM_PortsCollect)->Arg(100)->Arg(1000)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+void BM_SystemCollect(benchmark::State& state) {
+    runCollector(state, "system", FixtureSpec{});
+}
+BENCHMARK(BM_SystemCollect)->Unit(benchmark::kMicrosecond);
+
+/* A registry holding `n` per-process keys, published once by a single owner. */
+struct FilledRegistry {
+    explicit FilledRegistry(int n) : owner(registry.add_owner()) {
+        for (int i = 0; i < n; ++i) {
+            ids.push_back(registry.intern("proc." + std::to_string(i) + ".cpu_pct"));
+        }
+        publish();
+    }
+
+    void publish() {
+        registry.begin_publish(owner);
+        hmon_metric_value v{};
+        v.type = HMON_VAL_DOUBLE;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            v.v.f64 = static_cast<double>(i);
+            registry.set(ids[i], owner, v);
+        }
+    }
+
+    hmon::core::MetricRegistry registry;
+    hmon::core::MetricRegistry::OwnerId owner;
+    std::vector<hmon::core::MetricId> ids;
+};
+
+void BM_RegistryPrefix(benchmark::State& state) {
+    FilledRegistry filled(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        double sum = 0.0;
+        for (const auto& entry : filled.registry.prefix("proc.")) sum += entry.value.v.f64;
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_RegistryPrefix)->Arg(1000)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+void BM_RegistryPublish(benchmark::State& state) {
+    FilledRegistry filled(static_cast<int>(state.range(0)));
+    for (auto _ : state) filled.publish();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_RegistryPublish)->Arg(1000)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+}
+
+BENCHMARK_MAIN();
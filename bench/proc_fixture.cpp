@@ -0,0 +1,156 @@
+#include "proc_fixture.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+#include "hmon/fs_root.hpp"
+
+namespace fs = std::filesystem;
+
+namespace hmon::bench {
+
+namespace {
+
+void writeFile(const std::string& path, const std::string& data) {
+    std::FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return;
+    std::fwrite(data.data(), 1, data.size(), f);
+    std::fclose(f);
+}
+
+std::string format(const char* fmt, auto... args) {
+    char buf[512];
+    std::snprintf(buf, sizeof(buf), fmt, args...);
+    return buf;
+}
+
+void buildCpu(const std::string& proc, const std::string& sys, int cores) {
+    std::string stat = "cpu  " + format("%d 0 %d %d 0 0 0 0 0 0\n", cores * 1000, cores * 500, cores * 8000);
+    std::string cpuinfo;
+    const std::string cpu_dir = sys + "/devices/system/cpu";
+    for (int i = 0; i < cores; ++i) {
+        stat += format("cpu%d 1000 0 500 8000 0 0 0 0 0 0\n", i);
+        cpuinfo += format("processor\t: %d\nvendor_id\t: GenuineIntel\nmodel name\t: Synthetic CPU @ 3.00GHz\n"
+                          "cpu MHz\t\t: 3000.000\nphysical id\t: 0\ncore id\t\t: %d\ncpu cores\t: %d\n\n",
+                          i, i / 2, (cores + 1) / 2);
+
+        const std::string dir = cpu_dir + format("/cpu%d", i);
+        fs::create_directories(dir + "/cpufreq");
+        fs::create_directories(dir + "/topology");
+        writeFile(dir + "/cpufreq/scaling_cur_freq", "3000000\n");
+        writeFile(dir + "/topology/core_id", format("%d\n", i / 2));
+        writeFile(dir + "/topology/physical_package_id", "0\n");
+    }
+    stat += "intr 0\nctxt 0\nbtime 1700000000\nprocesses 1000\nprocs_running 1\nprocs_blocked 0\n";
+    writeFile(proc + "/stat", stat);
+    writeFile(proc + "/cpuinfo", cpuinfo);
+    writeFile(cpu_dir + "/online", cores > 1 ? format("0-%d\n", cores - 1) : "0\n");
+
+    fs::create_directories(sys + "/class/thermal/thermal_zone0");
+    writeFile(sys + "/class/thermal/thermal_zone0/type", "x86_pkg_temp\n");
+    writeFile(sys + "/class/thermal/thermal_zone0/temp", "45000\n");
+}
+
+void buildSystem(const std::string& proc, const std::string& sys) {
+    writeFile(proc + "/meminfo",
+              "MemTotal:       16384000 kB\nMemFree:         4096000 kB\nMemAvailable:    8192000 kB\n"
+              "Buffers:          512000 kB\nCached:          2048000 kB\nSwapTotal:       2048000 kB\n"
+              "SwapFree:        1024000 kB\n");
+    writeFile(proc + "/diskstats",
+              "   8       0 sda 1000 0 8000 100 500 0 4000 50 0 120 150 0 0 0 0 0 0\n"
+              "   8       1 sda1 900 0 7000 90 450 0 3600 45 0 110 135 0 0 0 0 0 0\n");
+    fs::create_directories(sys + "/block/sda");
+    fs::create_directories(proc + "/net");
+    writeFile(proc + "/net/dev",
+              "Inter-|   Receive                                                |  Transmit\n"
+              " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n"
+              "    lo: 1000 10 0 0 0 0 0 0 1000 10 0 0 0 0 0 0\n"
+              "  eth0: 5000000 4000 0 0 0 0 0 0 2000000 3000 0 0 0 0 0 0\n");
+    fs::create_directories(proc + "/self");
+    writeFile(proc + "/self/mounts", "/dev/sda1 / ext4 rw,relatime 0 0\nproc /proc proc rw 0 0\n");
+}
+
+void buildSockets(const std::string& proc, int sockets) {
+    const std::string header = "  sl  local_address rem_address   st tx_queue rx_queue tr tm->when retrnsmt   uid  "
+                               "timeout inode\n";
+    std::string tcp = header;
+    std::string udp = header;
+    for (int i = 0; i < sockets; ++i) {
+        const bool is_udp = i % 4 == 3;
+        const int port = 1024 + i % 64000;
+        (is_udp ? udp : tcp) += format("%4d: 00000000:%04X 00000000:0000 %s 00000000:00000000 00:00000000 00000000"
+                                       "     0        0 %d 1 0000000000000000 100 0 0 10 0\n",
+                                       i, port, is_udp ? "07" : "0A", 100000 + i);
+    }
+    writeFile(proc + "/net/tcp", tcp);
+    writeFile(proc + "/net/tcp6", header);
+    writeFile(proc + "/net/udp", udp);
+    writeFile(proc + "/net/udp6", header);
+}
+
+void buildProcesses(const std::string& proc, const FixtureSpec& spec) {
+    const int first_pid = 100;
+    for (int i = 0; i < spec.processes; ++i) {
+        const int pid = first_pid + i;
+        const std::string dir = proc + format("/%d", pid);
+        fs::create_directories(dir + "/fd");
+        writeFile(dir + "/stat",
+                  format("%d (worker-%d) S 1 %d %d 0 -1 4194560 100 0 0 0 %d %d 0 0 20 0 1 0 %d 123456789 %d "
+                         "18446744073709551615 1 1 0 0 0 0 0 0 0 17 0 0 0 0 0 0\n",
+                         pid, pid, pid, pid, pid % 997, pid % 389, pid * 10, 1000 + pid % 5000));
+        writeFile(dir + "/comm", format("worker-%d\n", pid));
+        writeFile(dir + "/cmdline", format("/usr/bin/worker%c--id%c%d", '\0', '\0', pid));
+    }
+    /* Socket inodes are handed out round-robin, a few fds per process. */
+    for (int i = 0; spec.processes > 0 && i < spec.sockets; ++i) {
+        const int pid = first_pid + i % spec.processes;
+        const std::string link = proc + format("/%d/fd/%d", pid, 3 + i / spec.processes);
+        std::error_code ec;
+        fs::create_symlink(format("socket:[%d]", 100000 + i), link, ec);
+    }
+}
+
+}
+
+ProcFixture::ProcFixture(const FixtureSpec& spec) {
+    const char* tmp = std::getenv("TMPDIR");
+    std::string templ = std::string(tmp && *tmp ? tmp : "/tmp") + "/hmon-fixture-XXXXXX";
+    if (!mkdtemp(templ.data())) return;
+    root_ = templ;
+    build(spec);
+}
+
+ProcFixture::~ProcFixture() {
+    if (root_.empty()) return;
+    std::error_code ec;
+    fs::remove_all(root_, ec);
+}
+
+void ProcFixture::build(const FixtureSpec& spec) {
+    const std::string proc = procRoot();
+    const std::string sys = sysRoot();
+    fs::create_directories(proc);
+    fs::create_directories(sys);
+    buildCpu(proc, sys, spec.cores);
+    buildSystem(proc, sys);
+    buildSockets(proc, spec.sockets);
+    buildProcesses(proc, spec);
+}
+
+void ProcFixture::activate() const {
+    hmon::core::setFsRoots(procRoot(), sysRoot());
+}
+
+const ProcFixture& ProcFixture::get(const FixtureSpec& spec) {
+    static std::map<FixtureSpec, std::unique_ptr<ProcFixture>> built;
+    auto& slot = built[spec];
+    if (!slot) slot = std::make_unique<ProcFixture>(spec);
+    return *slot;
+}
+
+} /* namespace hmon::bench */
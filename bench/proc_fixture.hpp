@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+
+namespace hmon::bench {
+
+/* Shape of a synthetic machine. */
+struct FixtureSpec {
+    int processes = 500;
+    int cores = 8;
+    int sockets = 64;       /* listening TCP/UDP sockets, spread over the processes' fd tables */
+
+    bool operator<(const FixtureSpec& o) const {
+        if (processes != o.processes) return processes < o.processes;
+        if (cores != o.cores) return cores < o.cores;
+        return sockets < o.sockets;
+    }
+};
+
+/*
+ * A throwaway procfs/sysfs tree under $TMPDIR with the files the collectors
+ * read: /proc/stat, cpuinfo, meminfo, diskstats, net/{dev,tcp,udp,...},
+ * self/mounts and stat/comm/cmdline/fd for every PID, plus the cpu, thermal
+ * and block entries of /sys.  Counters are fixed; only the layout scales.
+ * The tree is removed when the fixture is destroyed.
+ */
+class ProcFixture {
+public:
+    explicit ProcFixture(const FixtureSpec& spec);
+    ~ProcFixture();
+    ProcFixture(const ProcFixture&) = delete;
+    ProcFixture& operator=(const ProcFixture&) = delete;
+
+    bool ok() const { return !root_.empty(); }
+    std::string procRoot() const { return root_ + "/proc"; }
+    std::string sysRoot() const { return root_ + "/sys"; }
+
+    /* Point hmon::core::setFsRoots() at this tree. */
+    void activate() const;
+
+    /* Built once per spec and kept for the rest of the run. */
+    static const ProcFixture& get(const FixtureSpec& spec);
+
+private:
+    void build(const FixtureSpec& spec);
+
+    std::string root_;
+};
+
+} /* namespace hmon::bench */
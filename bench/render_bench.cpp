@@ -0,0 +1,119 @@
+/*
+ * renderSnapshot() and its helpers live in main.cpp with the TUI; pull the
+ * whole file in, its entry point renamed out of the way.
+ */
+#define main hmon_tui_main
+#include "../src/main.cpp"
+#undef main
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "proc_fixture.hpp"
+
+namespace {
+
+/* A frame as the dashboard would see it, collected by every plugin from the fixture tree. */
+struct RenderInput {
+  Snapshot snapshot;
+  std::vector<ProcessInfo> processes;
+  MetricsHistory history{512};
+  Config config;
+
+  RenderInput() {
+    hmon::bench::FixtureSpec spec;
+    spec.processes = 2000;
+    spec.cores = 32;
+    const auto& fixture = hmon::bench::ProcFixture::get(spec);
+    fixture.activate();
+
+    hmon::core::PluginManager pm;
+    pm.load_static();
+    pm.init_all();
+    pm.collect_all();
+    const SnapshotKeys keys(pm);
+    {
+      auto lock = pm.read_lock();
+      snapshot = collectSnapshot(pm, keys, config);
+      processes = visibleProcesses(collectProcesses(pm, keys, config.top_processes, config.sort_mode,
+                                                    config.lock_pid), config);
+    }
+    for (size_t i = 0; i < 256; ++i) updateHistory(&history, snapshot);
+  }
+
+  static const RenderInput& get() {
+    static const RenderInput input;
+    return input;
+  }
+};
+
+/* An off-screen terminal of the given size; output goes to /dev/null. */
+class OffscreenTerminal {
+ public:
+  OffscreenTerminal(int rows, int cols) {
+    out_ = std::fopen("/dev/null", "w");
+    in_ = std::fopen("/dev/null", "r");
+    if (!out_ || !in_) return;
+    const char* term = std::getenv("TERM");
+    screen_ = newterm(term && *term && std::strcmp(term, "dumb") != 0 ? term : "xterm-256color", out_, in_);
+    if (!screen_) return;
+    set_term(screen_);
+    resize_term(rows, cols);
+    if (has_colors()) {
+      start_color();
+      use_default_colors();
+      for (short pair = 1; pair <= 7; ++pair) init_pair(pair, pair, -1);
+    }
+  }
+
+  ~OffscreenTerminal() {
+    if (screen_) {
+      endwin();
+      delscreen(screen_);
+    }
+    if (out_) std::fclose(out_);
+    if (in_) std::fclose(in_);
+  }
+
+  OffscreenTerminal(const OffscreenTerminal&) = delete;
+  OffscreenTerminal& operator=(const OffscreenTerminal&) = delete;
+
+  bool ok() const { return screen_ != nullptr; }
+
+ private:
+  std::FILE* out_ = nullptr;
+  std::FILE* in_ = nullptr;
+  SCREEN* screen_ = nullptr;
+};
+
+/* range(0) x range(1) terminal; range(2) != 0 drops the render cache every frame (a resize or overlay close). */
+void BM_RenderSnapshot(benchmark::State& state) {
+  const RenderInput& input = RenderInput::get();
+  OffscreenTerminal terminal(static_cast<int>(state.range(1)), static_cast<int>(state.range(0)));
+  if (!terminal.ok()) {
+    state.SkipWithError("no terminfo entry for an off-screen terminal");
+    return;
+  }
+  const bool full = state.range(2) != 0;
+  RenderCache cache;
+  renderSnapshot(&cache, input.snapshot, input.history, input.processes, "bench", input.config,
+                 input.config.refresh_interval_ms);
+  for (auto _ : state) {
+    if (full) cache.invalidate();
+    renderSnapshot(&cache, input.snapshot, input.history, input.processes, "bench", input.config,
+                   input.config.refresh_interval_ms);
+  }
+}
+BENCHMARK(BM_RenderSnapshot)
+    ->ArgNames({"cols", "rows", "full"})
+    ->Args({80, 24, 0})
+    ->Args({80, 24, 1})
+    ->Args({120, 40, 0})
+    ->Args({120, 40, 1})
+    ->Args({240, 70, 0})
+    ->Args({240, 70, 1})
+    ->Unit(benchmark::kMicrosecond);
+
+}
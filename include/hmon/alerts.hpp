@@ -0,0 +1,151 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "hmon/metric_registry.hpp"
+
+namespace hmon::core {
+
+/*
+ * One rule, e.g. "cpu.temp_c > 90 for 30s" or
+ * "rate(docker.containers.mem_usage) > 100MiB/s".  The metric is a key, or
+ * a table key plus a column name, in which case every row is its own
+ * instance; a "*" segment matches any one segment.  Byte units are powers of
+ * 1000 (kB, MB) or 1024 (KiB, MiB), and are taken as KiB against a metric
+ * whose name ends in "_kb".
+ */
+struct AlertRule {
+    enum class Op { kGreater, kGreaterEqual, kLess, kLessEqual };
+
+    std::string text;                       /* the rule as written, also its name */
+    std::vector<std::string> pattern;       /* key segments */
+    bool rate = false;                      /* per second change instead of the value */
+    Op op = Op::kGreater;
+    double threshold = 0.0;
+    bool byte_unit = false;
+    std::chrono::milliseconds hold{0};      /* breached this long before firing */
+};
+
+/* nullopt with `error` set when `line` is not a rule. */
+std::optional<AlertRule> parseAlertRule(std::string_view line, std::string* error);
+
+/* A rule instance that is over its threshold now; pending until its hold has passed. */
+struct ActiveAlert {
+    const AlertRule* rule = nullptr;
+    std::string metric;
+    std::string instance;                   /* the row's name for table metrics, else empty */
+    double value = 0.0;
+    double threshold = 0.0;                 /* in the metric's own unit */
+    bool firing = false;
+    int64_t since_ms = 0;                   /* wall clock, when the breach began */
+};
+
+/*
+ * Rules compiled against metric ids.  Each newly interned key is matched
+ * against the rules once; afterwards a publish only evaluates the rules that
+ * read one of the ids it carried, and a rule whose metric its owner stopped
+ * publishing resolves.  Firing and resolving run the hook command and post
+ * to the webhook on a thread of their own, so a slow receiver never holds up
+ * a publish.
+ */
+class AlertEngine {
+public:
+    AlertEngine() = default;
+    ~AlertEngine();
+    AlertEngine(const AlertEngine&) = delete;
+    AlertEngine& operator=(const AlertEngine&) = delete;
+
+    /*
+     * Read rules plus "hook <command>" and "webhook http://host[:port]/path"
+     * lines; '#' starts a comment.  Bad lines are reported to stderr and
+     * skipped.  0 on success, -1 if the file could not be read.
+     */
+    int load(const std::string& path);
+    void add_rule(AlertRule rule);
+    void set_hook(std::string command) { hook_ = std::move(command); }
+    void set_webhook(std::string url) { webhook_ = std::move(url); }
+    /* Also report transitions to stderr, for headless runs. */
+    void set_log(bool log) { log_ = log; }
+    size_t rule_count() const { return rules_.size(); }
+
+    /*
+     * `owner` just published `ids`; caller holds the registry write lock.
+     * True when active() changed and should be republished.
+     */
+    bool on_publish(const MetricRegistry& registry, MetricRegistry::OwnerId owner, const MetricId* ids, size_t count);
+    /* Current breaches, firing first; rebuilt by on_publish(). */
+    const std::vector<ActiveAlert>& active() const { return active_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Series {
+        double prev = 0.0;                  /* last raw value, for rate() */
+        Clock::time_point prev_time{};
+        bool has_prev = false;
+        double value = 0.0;
+        bool breaching = false;
+        bool firing = false;
+        Clock::time_point breach_since{};
+        int64_t since_ms = 0;
+        uint64_t stamp = 0;
+    };
+
+    struct Target {
+        size_t rule = 0;
+        MetricId id = kInvalidMetricId;
+        std::string key;
+        std::string column;                 /* empty for a scalar */
+        std::string metric;                 /* key, or key.column */
+        double threshold = 0.0;             /* the rule's, scaled to the metric's unit */
+        MetricRegistry::OwnerId owner = 0;
+        uint64_t stamp = 0;                 /* publish that last carried the metric */
+        std::unordered_map<std::string, Series> series;    /* by instance */
+    };
+
+    struct Event {
+        std::string rule, metric, instance;
+        double value = 0.0;
+        bool firing = false;
+        int64_t time_ms = 0;
+    };
+
+    void match_new_keys(const MetricRegistry& registry);
+    void evaluate(Target* target, const hmon_metric_value& value, Clock::time_point now);
+    void update(Target* target, const std::string& instance, double raw, Clock::time_point now);
+    void resolve(Target* target, const std::string& instance, Series* series);
+    void rebuild_active();
+    void notify(Event event);
+    void action_loop();
+    void run_hook(const Event& event);
+    void post_webhook(const Event& event);
+
+    std::vector<AlertRule> rules_;
+    std::vector<Target> targets_;
+    std::vector<std::vector<uint32_t>> watch_;     /* by metric id: targets reading it */
+    size_t scanned_ = 0;                            /* registry ids already matched */
+    uint64_t epoch_ = 0;
+    bool changed_ = false;
+    std::vector<ActiveAlert> active_;
+
+    std::string hook_;
+    std::string webhook_;
+    bool log_ = false;
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<Event> queue_;
+    bool stopping_ = false;
+    std::thread actions_;
+};
+
+} /* namespace hmon::core */
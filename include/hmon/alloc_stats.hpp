@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+namespace hmon::core {
+
+/*
+ * Running totals of C++ heap allocations (operator new, in every form) made
+ * by the calling thread.  The scheduler samples them around a plugin's
+ * collect; malloc() calls from C code, such as libnvidia-ml, are not seen.
+ */
+struct AllocCounters {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+AllocCounters threadAllocations();
+
+} /* namespace hmon::core */
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "hmon/plugin_manager.hpp"
+
+namespace hmon::core {
+
+/*
+ * Prometheus text exposition of the whole registry.  Scalars become gauges
+ * named after their key ("cpu.usage_pct" -> hmon_cpu_usage_pct), strings
+ * become *_info series with the text in a label, and every numeric table
+ * column becomes one family with a sample per row, labelled by the row's
+ * key columns (see table_keys.hpp).  A table's other text columns go on one
+ * <key>_info series per row.
+ */
+void formatPrometheus(const PluginManager& pm, std::string* out);
+
+/*
+ * Minimal non-blocking HTTP/1.1 server for GET /metrics.  One thread runs
+ * the epoll loop; the exposition text is rebuilt only when the registry
+ * generation moved since the last scrape, so scrapes between plugin ticks
+ * cost a send() and nothing else.
+ */
+class MetricsExporter {
+public:
+    explicit MetricsExporter(const PluginManager& pm) : pm_(pm) {}
+    ~MetricsExporter();
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    /* Bind to an IPv4 `address` ("" for all interfaces); 0 on success, -1 after reporting to stderr. */
+    int listen(const std::string& address, uint16_t port);
+    /* Serve until `running` is cleared; checked at least every 500 ms. */
+    void run(const std::atomic<bool>& running);
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::string in;
+        std::string out;
+        size_t out_pos = 0;
+        bool close_after_write = false;
+    };
+
+    void accept_clients();
+    /* false once the connection should be dropped. */
+    bool on_readable(Connection* conn);
+    bool on_writable(Connection* conn);
+    void handle_request(Connection* conn, const std::string& head);
+    const std::string& exposition();
+    void close_connection(int fd);
+
+    const PluginManager& pm_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    std::vector<Connection> connections_;   /* indexed by fd */
+    std::string body_;
+    uint64_t body_generation_ = UINT64_MAX;
+};
+
+} /* namespace hmon::core */
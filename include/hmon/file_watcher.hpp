@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace hmon::core {
+
+/*
+ * inotify front end for plugins that read configuration files.  watch() takes
+ * a file, or a directory whose entries are of interest; paths that do not
+ * exist yet are armed once they appear, and files replaced by rename are
+ * followed.  fd() is meant to be returned as the plugin's event fd so the
+ * scheduler runs it as soon as something changed.
+ */
+class FileWatcher {
+public:
+    FileWatcher();
+    ~FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    bool ok() const { return fd_ >= 0; }
+    int fd() const { return fd_; }
+
+    /* Start watching `path`; false when it could not be watched now (it is retried as the tree changes). */
+    bool watch(const std::string& path);
+    /*
+     * Drain the queue and return every changed path, deduplicated: a watched
+     * file, a watched directory that appeared or vanished, or "dir/name" for
+     * an entry of a watched directory.  `overflow` is set when the kernel
+     * dropped events and the caller should re-read everything.
+     */
+    std::vector<std::string> changes(bool* overflow);
+
+private:
+    struct Watch {
+        std::string path;
+        bool wanted = false;    /* registered by watch(); otherwise only an ancestor of a pending path */
+    };
+
+    bool arm(const std::string& path);
+    void armPending(std::vector<std::string>* out);
+
+    int fd_ = -1;
+    std::unordered_map<int, Watch> watches_;    /* by watch descriptor */
+    std::vector<std::string> pending_;          /* registered paths without a live watch */
+};
+
+} /* namespace hmon::core */
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "hmon/plugin_manager.hpp"
+#include "hmon/recording.hpp"
+
+namespace hmon::core {
+
+/*
+ * Fleet stream: an agent connects to the viewer over TCP ("host:port") or a
+ * Unix socket ("/path.sock"), sends a hello (magic, version, host name) and
+ * then the same length-prefixed SnapshotEncoder frames an .hmr file holds.
+ * Every connection starts with a key frame, so the viewer never needs state
+ * from an earlier one.
+ */
+class FleetAgent {
+public:
+    static constexpr uint32_t kKeyFrameInterval = 60;
+
+    /* `report` sends connection changes to stderr; off under the TUI. */
+    FleetAgent(std::string target, std::string host, bool report)
+        : target_(std::move(target)), host_(std::move(host)), report_(report) {}
+    ~FleetAgent();
+    FleetAgent(const FleetAgent&) = delete;
+    FleetAgent& operator=(const FleetAgent&) = delete;
+
+    /* Connect if not connected and the reconnect backoff has passed; true once connected. */
+    bool connect();
+    /* Queue a frame of `registry`; caller holds the registry's read lock.  No-op while disconnected. */
+    void encode(const MetricRegistry& registry, int64_t time_ms);
+    /* Send the queued frame; 0 on success, -1 if the connection dropped. */
+    int flush();
+
+private:
+    void disconnect();
+
+    std::string target_;
+    std::string host_;
+    bool report_;
+    int fd_ = -1;
+    SnapshotEncoder encoder_;
+    std::string frame_;
+    std::string out_;
+    uint32_t frames_since_key_ = kKeyFrameInterval;
+    std::chrono::steady_clock::time_point retry_at_{};
+    std::chrono::milliseconds backoff_{0};
+    bool reported_down_ = false;
+};
+
+/*
+ * Viewer side of the fleet stream.  One epoll thread accepts agents and
+ * decodes their frames; each host gets a PluginManager of its own, fed
+ * through a source, so the usual read_lock()/getter path works per host.
+ */
+class FleetServer {
+public:
+    struct Host {
+        std::string name;                       /* as shown; "web#2" when agents share a name */
+        std::string agent;                      /* as sent in the hello */
+        PluginManager metrics;
+        size_t source = 0;
+        std::atomic<bool> connected{false};
+        std::atomic<int64_t> last_frame_ms{0};  /* wall clock, when the last frame arrived */
+        std::atomic<uint64_t> frames{0};
+        int fd = -1;                            /* owning connection; server thread only */
+    };
+
+    FleetServer() = default;
+    ~FleetServer();
+    FleetServer(const FleetServer&) = delete;
+    FleetServer& operator=(const FleetServer&) = delete;
+
+    /* "[addr:]port" or "/path.sock"; 0 on success, -1 after reporting to stderr. */
+    int listen(const std::string& target);
+    /* Serve until `running` is cleared; checked at least every 500 ms. */
+    void run(const std::atomic<bool>& running);
+
+    /* Hosts in order of first contact.  Hosts are never removed, so the pointers stay valid. */
+    std::vector<Host*> hosts() const;
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::string in;
+        size_t in_pos = 0;
+        Host* host = nullptr;
+        std::unique_ptr<SnapshotDecoder> decoder;
+    };
+
+    void accept_clients();
+    /* false once the connection should be dropped. */
+    bool on_readable(Connection* conn);
+    bool parse_hello(Connection* conn);
+    Host* claim_host(const std::string& name, int fd);
+    void close_connection(int fd);
+
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    std::string unix_path_;
+    std::vector<Connection> connections_;   /* indexed by fd */
+    mutable std::mutex hosts_mutex_;
+    std::vector<std::unique_ptr<Host>> hosts_;
+};
+
+} /* namespace hmon::core */
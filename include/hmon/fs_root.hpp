@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+namespace hmon::core {
+
+/*
+ * Where collectors find procfs and sysfs: "/proc" and "/sys", unless
+ * HMON_PROC_ROOT / HMON_SYS_ROOT name another tree, such as the synthetic
+ * fixture hmon_bench generates.  The environment is read on first use;
+ * setFsRoots() replaces both and must run before any plugin is initialised.
+ */
+const std::string& procRoot();
+const std::string& sysRoot();
+void setFsRoots(const std::string& proc, const std::string& sys);
+
+} /* namespace hmon::core */
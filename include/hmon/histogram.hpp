@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace hmon::core {
+
+/*
+ * Log-linear histogram in the spirit of HdrHistogram.  Values below 32 land
+ * in exact buckets; above that every power of two is split into 32 buckets,
+ * so a reported quantile is within about 3% of the true value.  Counters are
+ * relaxed atomics: one writer records while any number of readers summarise,
+ * without a lock (a reader may see a record half-applied).
+ */
+class LatencyHistogram {
+public:
+    static constexpr int kSubBits = 5;
+    static constexpr uint64_t kSubBuckets = uint64_t{1} << kSubBits;
+    static constexpr int kMaxExponent = 32;             /* values are clamped to 2^33 - 1 */
+    static constexpr size_t kBuckets = (kMaxExponent - kSubBits + 2) * kSubBuckets;
+
+    void record(uint64_t value) {
+        counts_[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+        total_.fetch_add(1, std::memory_order_relaxed);
+        uint64_t seen = max_.load(std::memory_order_relaxed);
+        while (value > seen && !max_.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+    }
+
+    uint64_t count() const { return total_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    /* Upper edge of the bucket holding quantile `q` (0..1), capped at max(); 0 when empty. */
+    uint64_t percentile(double q) const {
+        const uint64_t total = count();
+        if (total == 0) return 0;
+        const auto target = static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(total)));
+        uint64_t seen = 0;
+        for (size_t b = 0; b < kBuckets; ++b) {
+            seen += counts_[b].load(std::memory_order_relaxed);
+            if (seen >= std::max<uint64_t>(target, 1)) return std::min(bucketUpper(b), max());
+        }
+        return max();
+    }
+
+private:
+    static size_t bucketOf(uint64_t v) {
+        v = std::min(v, (uint64_t{2} << kMaxExponent) - 1);
+        if (v < kSubBuckets) return static_cast<size_t>(v);
+        const int e = 63 - __builtin_clzll(v);
+        const int shift = e - kSubBits;
+        return static_cast<size_t>((e - kSubBits + 1) * kSubBuckets + ((v >> shift) - kSubBuckets));
+    }
+
+    static uint64_t bucketUpper(size_t b) {
+        if (b < kSubBuckets) return b;
+        const int shift = static_cast<int>(b / kSubBuckets) - 1;
+        const uint64_t lower = (kSubBuckets + b % kSubBuckets) << shift;
+        return lower + (uint64_t{1} << shift) - 1;
+    }
+
+    std::array<std::atomic<uint64_t>, kBuckets> counts_{};
+    std::atomic<uint64_t> total_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+} /* namespace hmon::core */
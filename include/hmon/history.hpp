@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <vector>
+
+namespace hmon::core {
+
+/* One bucket of a rollup tier; a raw sample has min == max == avg. */
+struct HistoryPoint {
+    int64_t time_ms = 0;    /* bucket start, wall clock */
+    float   min = 0.0f;
+    float   max = 0.0f;
+    float   avg = 0.0f;
+};
+
+/* Fixed-capacity ring, indexed oldest first; push() overwrites the oldest point once full. */
+class HistoryRing {
+public:
+    explicit HistoryRing(size_t capacity = 0) { reset(capacity); }
+
+    void reset(size_t capacity);
+    void push(const HistoryPoint& point);
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return points_.size(); }
+    bool empty() const { return size_ == 0; }
+    /* Points ever pushed since reset(), so a reader can tell how many arrived since it last looked. */
+    uint64_t pushed() const { return pushed_; }
+    const HistoryPoint& operator[](size_t i) const { return points_[(head_ + i) % points_.size()]; }
+    const HistoryPoint& back() const { return (*this)[size_ - 1]; }
+
+private:
+    std::vector<HistoryPoint> points_;
+    size_t head_ = 0;       /* index of the oldest point */
+    size_t size_ = 0;
+    uint64_t pushed_ = 0;
+};
+
+/*
+ * A metric's history: every raw sample plus min/max/avg rollups at 1 s,
+ * 10 s, 1 min and 10 min.  append() is O(1) whatever the retention; each
+ * tier keeps `capacity` buckets, so the 10 min tier of a 2048-point series
+ * covers two weeks.
+ */
+class HistorySeries {
+public:
+    static constexpr size_t kTierCount = 4;
+    static constexpr std::array<int64_t, kTierCount> kTierPeriodMs{1000, 10000, 60000, 600000};
+
+    explicit HistorySeries(size_t capacity = 2048);
+
+    void append(double value, int64_t now_ms);
+
+    const HistoryRing& raw() const { return raw_; }
+    /* Closed buckets of `tier`; the bucket still filling is pending(tier). */
+    const HistoryRing& tier(size_t tier) const { return tiers_[tier]; }
+    std::optional<HistoryPoint> pending(size_t tier) const;
+    std::optional<double> last() const;
+
+    /* Finest tier whose buckets are at least span_ms / columns wide and that retains span_ms. */
+    size_t pick_tier(int64_t span_ms, size_t columns) const;
+
+    /* Binary dump of the rollup tiers, pending buckets as their running min/max/sum; raw samples are not kept. */
+    void write(std::ostream& out) const;
+    bool read(std::istream& in);
+
+private:
+    struct Accumulator {
+        int64_t  bucket = -1;
+        double   min = 0.0;
+        double   max = 0.0;
+        double   sum = 0.0;
+        uint32_t count = 0;
+
+        HistoryPoint point(int64_t period_ms) const;
+    };
+
+    HistoryRing raw_;
+    std::array<HistoryRing, kTierCount> tiers_;
+    std::array<Accumulator, kTierCount> pending_{};
+};
+
+} /* namespace hmon::core */
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "hmon/plugin_abi.h"
+
+namespace hmon::core {
+
+using MetricId = uint32_t;
+inline constexpr MetricId kInvalidMetricId = UINT32_MAX;
+
+/*
+ * Interned, typed metric store.  Every key is interned exactly once and gets a
+ * small dense id; values live in a flat array indexed by that id, so the hot
+ * path (publish + UI reads) never hashes or allocates once the key set is warm.
+ *
+ * A slot is "present" while its owner's latest publication contained it.  Each
+ * owner (plugin) has its own generation counter, so one plugin republishing
+ * does not invalidate metrics another plugin published earlier.
+ */
+class MetricRegistry {
+public:
+    using OwnerId = uint16_t;
+
+    struct Entry {
+        MetricId          id;
+        std::string_view  key;
+        hmon_metric_value value;
+    };
+
+    /*
+     * Present metrics under a prefix, in natural key order.  A view over the
+     * registry's ordered index: nothing is copied, and it stays valid until
+     * the next intern() (i.e. for as long as the caller holds the read lock).
+     */
+    class PrefixView {
+    public:
+        class iterator {
+        public:
+            iterator(const MetricRegistry* reg, const MetricId* pos, const MetricId* end)
+                : reg_(reg), pos_(pos), end_(end) { skip(); }
+            Entry operator*() const { return Entry{*pos_, reg_->key(*pos_), reg_->value(*pos_)}; }
+            iterator& operator++() { ++pos_; skip(); return *this; }
+            bool operator==(const iterator& other) const { return pos_ == other.pos_; }
+            bool operator!=(const iterator& other) const { return pos_ != other.pos_; }
+
+        private:
+            void skip() { while (pos_ != end_ && !reg_->present(*pos_)) ++pos_; }
+
+            const MetricRegistry* reg_;
+            const MetricId* pos_;
+            const MetricId* end_;
+        };
+
+        PrefixView(const MetricRegistry* reg, const MetricId* first, const MetricId* last)
+            : reg_(reg), first_(first), last_(last) {}
+        iterator begin() const { return iterator(reg_, first_, last_); }
+        iterator end() const { return iterator(reg_, last_, last_); }
+        bool empty() const { return begin() == end(); }
+
+    private:
+        const MetricRegistry* reg_;
+        const MetricId* first_;
+        const MetricId* last_;
+    };
+
+    /* Segment-wise key order where all-digit segments compare as numbers ("x.2" < "x.10")
+     * and sort before any other segment at the same position. */
+    static bool natural_less(std::string_view a, std::string_view b);
+
+    OwnerId add_owner();
+
+    MetricId intern(std::string_view key);
+    MetricId find(std::string_view key) const;
+
+    void begin_publish(OwnerId owner);
+    void set(MetricId id, OwnerId owner, const hmon_metric_value& value);
+
+    bool present(MetricId id) const;
+    /* Value with str/table pointing into registry storage; valid until the next publish. */
+    hmon_metric_value value(MetricId id) const;
+    const std::string& key(MetricId id) const { return keys_[id]; }
+    size_t size() const { return keys_.size(); }
+
+    /* `prefix` should end at a segment boundary, e.g. "proc." or "cpu.core_usage_pct.". */
+    PrefixView prefix(std::string_view prefix) const;
+
+    void clear();
+
+private:
+    struct KeyHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+
+    /* Owned copy of a table value.  Buffers keep their capacity across publishes. */
+    struct TableCopy {
+        std::vector<std::string>       names;
+        std::vector<hmon_table_column> columns;
+        std::vector<hmon_table_cell>   cells;
+        std::string                    strings;
+        hmon_table                     table{};
+    };
+
+    static void copy_table(TableCopy* dst, const hmon_table& src);
+
+    struct Slot {
+        hmon_metric_value value{};
+        std::string       str;
+        std::unique_ptr<TableCopy> table;
+        uint32_t          generation = 0;
+        OwnerId           owner = 0;
+    };
+
+    std::vector<std::string> keys_;
+    std::vector<Slot> slots_;
+    std::vector<MetricId> ordered_;     /* ids sorted by natural_less(key) */
+    std::unordered_map<std::string, MetricId, KeyHash, std::equal_to<>> index_;
+    std::vector<uint32_t> owner_generation_;
+};
+
+} /* namespace hmon::core */
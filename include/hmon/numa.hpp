@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace hmon::core {
+
+/* A NUMA node under <sysRoot>/devices/system/node and the CPUs it holds. */
+struct NumaNode {
+    int id = 0;
+    std::string cpulist;                    /* as the kernel prints it, e.g. "0-7,16-23" */
+    std::vector<int> cpus;
+};
+
+/* "0-3,8,10-11" -> {0,1,2,3,8,10,11} */
+std::vector<int> parseCpuList(const std::string& list);
+
+/* Nodes in id order; empty when the kernel has no NUMA support. */
+std::vector<NumaNode> readNumaNodes();
+
+} /* namespace hmon::core */
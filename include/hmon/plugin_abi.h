@@ -5,12 +5,19 @@
  * (libhmoncore) discovers plugins at runtime via dlopen/dlsym and calls into
  * them through opaque handles.
  *
- * All strings returned by plugins are owned by the plugin and must be copied
- * by the host if they need to outlive the next collect() call.
+ * Since ABI v2 the host owns all per-tick memory: collect() receives a list
+ * whose items[] buffer and a bump arena are both provided by the host, and the
+ * plugin writes into them without allocating.  Everything in the list only has
+ * to live until collect() returns; the host copies what it keeps.
+ *
+ * List-style data (processes, containers, ports, ...) is published as one
+ * HMON_VAL_TABLE metric per tick: a column schema plus a row-major cell
+ * buffer, instead of one "<prefix>.<row>.<field>" key per cell.
  *
  * ABI version is bumped whenever the layout of any struct or the signature of
- * any exported symbol changes.  The host refuses to load a plugin whose
- * ABI_VERSION does not match HMON_PLUGIN_ABI_VERSION.
+ * any exported symbol changes.  The host loads plugins built against
+ * HMON_PLUGIN_ABI_VERSION directly and v1 plugins through a copying shim; any
+ * other version is refused.
  */
 
 #ifndef HMON_PLUGIN_ABI_H
@@ -18,6 +25,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,12 +33,14 @@ extern "C" {
 
 /* ── ABI version ─────────────────────────────────────────────────────────── */
 
-#define HMON_PLUGIN_ABI_VERSION 1
+#define HMON_PLUGIN_ABI_VERSION 2
 
 /* ── Opaque handles ──────────────────────────────────────────────────────── */
 
 typedef struct hmon_plugin_ctx  hmon_plugin_ctx;
 typedef struct hmon_metric_list hmon_metric_list;
+typedef struct hmon_arena       hmon_arena;
+typedef struct hmon_table       hmon_table;
 
 /* ── Metric value types ──────────────────────────────────────────────────── */
 
@@ -39,6 +49,7 @@ enum hmon_value_type {
     HMON_VAL_INT64    = 1,
     HMON_VAL_DOUBLE   = 2,
     HMON_VAL_BOOL     = 3,
+    HMON_VAL_TABLE    = 4,      /* added within v2; the value union's size is unchanged */
 };
 
 /* A single metric value (discriminated union). */
@@ -49,22 +60,64 @@ struct hmon_metric_value {
         int64_t     i64;
         double      f64;
         int32_t     b;
+        const struct hmon_table* table;
     } v;
 };
 
+/* One column of a table; `type` is a scalar hmon_value_type. */
+struct hmon_table_column {
+    const char* name;
+    int32_t     type;
+};
+
+/* One cell; which member is live is given by the column's type. */
+union hmon_table_cell {
+    const char* str;
+    int64_t     i64;
+    double      f64;
+    int32_t     b;
+};
+
+/*
+ * Rows of a fixed schema.  cells[] holds row_count * column_count entries in
+ * row-major order.  A cell with no value is a NULL string, NaN double,
+ * HMON_TABLE_NULL_I64 integer or a negative bool.
+ */
+struct hmon_table {
+    const struct hmon_table_column* columns;
+    uint32_t                        column_count;
+    uint32_t                        row_count;
+    union hmon_table_cell*          cells;
+};
+
+#define HMON_TABLE_NULL_I64 INT64_MIN
+
 /* A named metric (e.g. "cpu.usage_percent", "ram.total_kb"). */
 struct hmon_metric {
     const char*              key;   /* dot-separated hierarchical name        */
     struct hmon_metric_value value;
 };
 
-/* A growable list of metrics — owned by the plugin. */
+/* A list of metrics.  In v2 items[] and capacity are provided by the host. */
 struct hmon_metric_list {
     struct hmon_metric* items;
     size_t              count;
     size_t              capacity;
 };
 
+/**
+ * Per-tick bump arena provided by the host (ABI v2).  The host resets `used`
+ * before every collect().  Requests that do not fit in the arena or the list
+ * are refused and counted in `dropped`; the host grows both buffers before
+ * the next tick, so a plugin never has to handle exhaustion beyond skipping.
+ */
+struct hmon_arena {
+    char*  base;
+    size_t used;
+    size_t capacity;
+    size_t dropped;
+};
+
 /* ── Plugin lifecycle ────────────────────────────────────────────────────── */
 
 /**
@@ -91,14 +144,33 @@ typedef int (*hmon_plugin_init_fn)(hmon_plugin_ctx** out);
 /**
  * Collect a fresh snapshot of metrics.
  * Required symbol:  int hmon_plugin_collect(hmon_plugin_ctx* ctx,
- *                                           hmon_metric_list* out_list);
+ *                                           hmon_metric_list* out_list,
+ *                                           hmon_arena* arena);
  *
- * The host provides a pre-zeroed hmon_metric_list.  The plugin allocates
- * items[] with malloc() and populates count/capacity.
- * Returns 0 on success, non-zero on failure.
+ * out_list arrives with count == 0 and a host-owned items[capacity] buffer.
+ * Keys and string values must point into the arena or static storage; use
+ * hmon_metric_append() below.  Returns 0 on success, non-zero on failure.
  */
 typedef int (*hmon_plugin_collect_fn)(hmon_plugin_ctx* ctx,
-                                      hmon_metric_list* out_list);
+                                      hmon_metric_list* out_list,
+                                      hmon_arena* arena);
+
+/**
+ * collect() result for a plugin whose subsystem is not on this host (no
+ * server running, no device).  Whatever it appended is published as usual,
+ * but the host then only re-probes it every HMON_ABSENT_RECHECK_MS until a
+ * collect() returns 0.  Not counted as a failure.  The value spells "ABST";
+ * a plugin returning some other non-zero code still fails as before.
+ */
+#define HMON_COLLECT_ABSENT 0x41425354
+#define HMON_ABSENT_RECHECK_MS 30000
+
+/**
+ * ABI v1 collect: the plugin malloc()s items[] itself and the host hands the
+ * list back through hmon_plugin_free_list().  Only used by the v1 shim.
+ */
+typedef int (*hmon_plugin_collect_v1_fn)(hmon_plugin_ctx* ctx,
+                                         hmon_metric_list* out_list);
 
 /**
  * Tear down the plugin context and free all resources.
@@ -107,14 +179,151 @@ typedef int (*hmon_plugin_collect_fn)(hmon_plugin_ctx* ctx,
 typedef void (*hmon_plugin_destroy_fn)(hmon_plugin_ctx* ctx);
 
 /**
- * Free a metric list previously returned by collect().
- * Required symbol:  void hmon_plugin_free_list(hmon_metric_list* list);
+ * Free a metric list previously returned by a v1 collect().
+ * Required for v1 plugins only:  void hmon_plugin_free_list(hmon_metric_list* list);
  */
 typedef void (*hmon_plugin_free_list_fn)(hmon_metric_list* list);
 
 typedef void (*hmon_plugin_control_fn)(const char* key, int value);
 
-typedef void (*hmon_plugin_control_fn)(const char* key, int value);
+/**
+ * A control whose value is text, such as a search string; called from the
+ * host's UI thread like hmon_plugin_control, and `value` is only valid for
+ * the duration of the call.
+ * Optional symbol:  void hmon_plugin_control_str(const char* key, const char* value);
+ */
+typedef void (*hmon_plugin_control_str_fn)(const char* key, const char* value);
+
+/**
+ * Preferred collection interval in milliseconds.  The host schedules each
+ * plugin on its own cadence; plugins without this symbol run every
+ * HMON_DEFAULT_INTERVAL_MS.
+ * Optional symbol:  int hmon_plugin_interval_ms(void);
+ */
+typedef int (*hmon_plugin_interval_fn)(void);
+
+#define HMON_DEFAULT_INTERVAL_MS 1000
+
+/**
+ * Descriptor that becomes readable when the plugin has news, such as a bus
+ * socket with queued signals.  The host polls it and runs collect() as soon
+ * as it fires instead of waiting for the next interval; collect() must drain
+ * it.  It is queried again after every collect(), so it may change or be -1.
+ * Optional symbol:  int hmon_plugin_event_fd(hmon_plugin_ctx* ctx);
+ */
+typedef int (*hmon_plugin_event_fd_fn)(hmon_plugin_ctx* ctx);
+
+/* ── Arena helpers (header-only, usable from any plugin) ─────────────────── */
+
+static inline void* hmon_arena_alloc(hmon_arena* arena, size_t size)
+{
+    size_t offset = (arena->used + 7u) & ~(size_t)7u;
+    if (offset > arena->capacity || size > arena->capacity - offset) {
+        arena->dropped += size;
+        return NULL;
+    }
+    arena->used = offset + size;
+    return arena->base + offset;
+}
+
+static inline const char* hmon_arena_strdup(hmon_arena* arena, const char* s)
+{
+    if (!s) s = "";
+    size_t len = strlen(s);
+    char* dst = (char*)hmon_arena_alloc(arena, len + 1);
+    if (!dst) return NULL;
+    memcpy(dst, s, len + 1);
+    return dst;
+}
+
+/**
+ * Append one metric, copying the key and any string value into the arena.
+ * `value` points at a const char (string), int64_t, double or int32_t (bool).
+ * Returns 0 on success, -1 when the list or arena is full.
+ */
+static inline int hmon_metric_append(hmon_metric_list* list, hmon_arena* arena,
+                                     const char* key, int type, const void* value)
+{
+    if (list->count >= list->capacity) {
+        arena->dropped += sizeof(struct hmon_metric);
+        return -1;
+    }
+    struct hmon_metric* item = &list->items[list->count];
+    item->key = hmon_arena_strdup(arena, key);
+    if (!item->key) return -1;
+    item->value.type = type;
+    switch (type) {
+    case HMON_VAL_STRING:
+        item->value.v.str = hmon_arena_strdup(arena, (const char*)value);
+        if (!item->value.v.str) return -1;
+        break;
+    case HMON_VAL_INT64:  item->value.v.i64 = *(const int64_t*)value; break;
+    case HMON_VAL_DOUBLE: item->value.v.f64 = *(const double*)value;  break;
+    case HMON_VAL_BOOL:   item->value.v.b = *(const int32_t*)value;   break;
+    default: return -1;
+    }
+    ++list->count;
+    return 0;
+}
+
+/**
+ * Append a table metric with `rows` zeroed rows and return it for filling, or
+ * NULL when the list or arena is full.  `columns` must be static storage (or
+ * arena memory); the cells, and hmon_table_set_str() copies, live in the arena.
+ */
+static inline struct hmon_table* hmon_metric_append_table(hmon_metric_list* list, hmon_arena* arena,
+                                                          const char* key,
+                                                          const struct hmon_table_column* columns,
+                                                          uint32_t column_count, uint32_t rows)
+{
+    if (list->count >= list->capacity) {
+        arena->dropped += sizeof(struct hmon_metric);
+        return NULL;
+    }
+    struct hmon_table* table = (struct hmon_table*)hmon_arena_alloc(arena, sizeof(struct hmon_table));
+    if (!table) return NULL;
+    size_t cells_size = (size_t)rows * column_count * sizeof(union hmon_table_cell);
+    table->cells = (union hmon_table_cell*)hmon_arena_alloc(arena, cells_size ? cells_size : 1);
+    if (!table->cells) return NULL;
+    if (cells_size) memset(table->cells, 0, cells_size);
+    table->columns = columns;
+    table->column_count = column_count;
+    table->row_count = rows;
+
+    struct hmon_metric* item = &list->items[list->count];
+    item->key = hmon_arena_strdup(arena, key);
+    if (!item->key) return NULL;
+    item->value.type = HMON_VAL_TABLE;
+    item->value.v.table = table;
+    ++list->count;
+    return table;
+}
+
+static inline union hmon_table_cell* hmon_table_row(struct hmon_table* table, uint32_t row)
+{
+    return table->cells + (size_t)row * table->column_count;
+}
+
+static inline const union hmon_table_cell* hmon_table_row_const(const struct hmon_table* table, uint32_t row)
+{
+    return table->cells + (size_t)row * table->column_count;
+}
+
+/* Copy `s` into the arena as the string cell (row, col); on overflow the cell stays NULL. */
+static inline void hmon_table_set_str(hmon_arena* arena, struct hmon_table* table,
+                                      uint32_t row, uint32_t col, const char* s)
+{
+    hmon_table_row(table, row)[col].str = hmon_arena_strdup(arena, s);
+}
+
+/* Index of the column called `name` with type `type`, or -1. */
+static inline int hmon_table_column_index(const struct hmon_table* table, const char* name, int type)
+{
+    for (uint32_t i = 0; i < table->column_count; ++i) {
+        if (table->columns[i].type == type && strcmp(table->columns[i].name, name) == 0) return (int)i;
+    }
+    return -1;
+}
 
 /* ── Helper macros for plugins ───────────────────────────────────────────── */
 
@@ -141,7 +350,22 @@ typedef void (*hmon_plugin_control_fn)(const char* key, int value);
 #define HMON_METRIC_CPU_TEMP_C            "cpu.temp_c"
 #define HMON_METRIC_CPU_FREQ_MHZ          "cpu.freq_mhz"
 #define HMON_METRIC_CPU_USAGE_PCT         "cpu.usage_pct"
-#define HMON_METRIC_CPU_CORE_USAGE_PCT    "cpu.core_usage_pct"  /* array index */
+/* cpu, usage_pct, user_pct, system_pct, iowait_pct, irq_pct, steal_pct */
+#define HMON_METRIC_CPU_CORES_TABLE       "cpu.per_core"
+/* node, cpus, usage_pct, iowait_pct: the cores table averaged over each NUMA
+ * node's online CPUs; absent on kernels without NUMA */
+#define HMON_METRIC_CPU_NODES_TABLE       "cpu.nodes"
+
+/* PERF: hardware counters, absent without a PMU or perf_event permission.
+ * perf.cores rows are (cpu, socket, ipc, llc_mpki, branch_mpki), perf.sockets
+ * rows (socket, ipc, llc_mpki, branch_mpki); a ratio is -1 when unknown.
+ * The pid scalars cover the PID given by the perf.lock_pid control. */
+#define HMON_METRIC_PERF_CORES_TABLE      "perf.cores"
+#define HMON_METRIC_PERF_SOCKETS_TABLE    "perf.sockets"
+#define HMON_METRIC_PERF_PID              "perf.pid"
+#define HMON_METRIC_PERF_PID_IPC          "perf.pid_ipc"
+#define HMON_METRIC_PERF_PID_LLC_MPKI     "perf.pid_llc_mpki"
+#define HMON_METRIC_PERF_PID_BRANCH_MPKI  "perf.pid_branch_mpki"
 
 /* RAM */
 #define HMON_METRIC_RAM_TOTAL_KB          "ram.total_kb"
@@ -151,30 +375,82 @@ typedef void (*hmon_plugin_control_fn)(const char* key, int value);
 #define HMON_METRIC_DISK_MOUNT            "disk.mount"
 #define HMON_METRIC_DISK_TOTAL_BYTES      "disk.total_bytes"
 #define HMON_METRIC_DISK_FREE_BYTES       "disk.free_bytes"
+#define HMON_METRIC_DISK_BUSY_PCT         "disk.busy_pct"  /* of the disk holding the root filesystem */
+/* device, busy_pct, read_iops, write_iops, read_bps, write_bps, await_ms, queue_depth */
+#define HMON_METRIC_DISK_IO_TABLE         "disk.io"
+/* mount, device, fstype, total_bytes, free_bytes; local filesystems or HMON_MOUNTS */
+#define HMON_METRIC_DISK_MOUNTS_TABLE     "disk.mounts"
+
+/* PSI: resource (cpu, memory, io), some_avg10, some_avg60, some_total_us,
+ * full_avg10, full_avg60, full_total_us, stalled, events; the full columns
+ * are null where the kernel has no "full" line. */
+#define HMON_METRIC_PSI_TABLE             "psi.resources"
+
+/* NUMA: node, cpus (cpulist), mem_total_kb, mem_free_kb, numa_hit_ps,
+ * numa_miss_ps, numa_foreign_ps, other_node_ps; the rates are pages per
+ * second from the node's numastat, null until a second sample.  Absent on
+ * kernels without NUMA. */
+#define HMON_METRIC_NUMA_NODES_TABLE      "numa.nodes"
 
 /* NETWORK */
 #define HMON_METRIC_NET_INTERFACE         "net.interface"
 #define HMON_METRIC_NET_RX_KBPS           "net.rx_kbps"
 #define HMON_METRIC_NET_TX_KBPS           "net.tx_kbps"
-
-/* GPU */
-#define HMON_METRIC_GPU_NAME              "gpu.%d.name"
-#define HMON_METRIC_GPU_SOURCE            "gpu.%d.source"
-#define HMON_METRIC_GPU_TEMP_C            "gpu.%d.temp_c"
-#define HMON_METRIC_GPU_CLOCK_MHZ         "gpu.%d.clock_mhz"
-#define HMON_METRIC_GPU_USAGE_PCT         "gpu.%d.usage_pct"
-#define HMON_METRIC_GPU_POWER_W           "gpu.%d.power_w"
-#define HMON_METRIC_GPU_VRAM_USED_MIB     "gpu.%d.vram_used_mib"
-#define HMON_METRIC_GPU_VRAM_TOTAL_MIB    "gpu.%d.vram_total_mib"
-#define HMON_METRIC_GPU_VRAM_USAGE_PCT    "gpu.%d.vram_usage_pct"
-#define HMON_METRIC_GPU_IN_USE            "gpu.%d.in_use"
-
-/* PROCESS */
-#define HMON_METRIC_PROC_PID              "proc.%d.pid"
-#define HMON_METRIC_PROC_CPU_PCT          "proc.%d.cpu_pct"
-#define HMON_METRIC_PROC_MEM_PCT          "proc.%d.mem_pct"
-#define HMON_METRIC_PROC_GPU_PCT          "proc.%d.gpu_pct"
-#define HMON_METRIC_PROC_COMMAND          "proc.%d.command"
+/* interface, rx_bps, tx_bps, rx_pps, tx_pps, rx_drops_ps, tx_drops_ps */
+#define HMON_METRIC_NET_INTERFACES_TABLE  "net.interfaces"
+
+/* GPU: name, source, temp_c, clock_mhz, usage_pct, power_w, vram_used_mib,
+ * vram_total_mib, vram_usage_pct, in_use; gpu.cores rows are (gpu, core, usage_pct). */
+#define HMON_METRIC_GPU_TABLE             "gpu.devices"
+#define HMON_METRIC_GPU_CORES_TABLE       "gpu.cores"
+
+/* PROCESS: pid, cpu_pct, mem_pct, gpu_pct, io_read_bps, io_write_bps, net_bps,
+ * io_delay_pct, numa_node, numa_local_pct, command.  On hosts with several
+ * NUMA nodes numa_node is the one holding most of the process's pages and
+ * numa_local_pct their share, re-read every 10 s at most; null elsewhere. */
+#define HMON_METRIC_PROC_TABLE            "proc.top"
+/* Only while the process.group control is set (1 cgroup, 2 container,
+ * 3 systemd unit, 4 process tree): group, procs, cpu_pct, mem_pct, gpu_pct,
+ * io_read_bps, io_write_bps, net_bps, name.  process.group_filter=<group>
+ * limits proc.top to that group's members. */
+#define HMON_METRIC_PROC_GROUPS_TABLE     "proc.groups"
+/* Only while the process.filter string control is set: processes matching
+ * it, of which proc.top lists the top rows.  The filter matches anywhere in
+ * the first 256 characters of a process's name followed by its full
+ * command line, ignoring case, or the leading digits of a PID. */
+#define HMON_METRIC_PROC_MATCHES          "proc.matches"
+
+/* DOCKER: name, image, state, cpu_pct, mem_usage, mem_limit, mem_pct,
+ * net_rx_bps, net_tx_bps, net_rx_total, net_tx_total, blk_read_bps,
+ * blk_write_bps, pids */
+#define HMON_METRIC_DOCKER_TABLE          "docker.containers"
+
+/* PORTS: port, proto, addr, pid, process */
+#define HMON_METRIC_PORTS_TABLE           "ports.listening"
+
+/* SYSTEMD: name, state, sub, desc */
+#define HMON_METRIC_SYSTEMD_TABLE         "systemd.services"
+
+/* DATABASE: type, status, active_conns, max_conns, uptime, version */
+#define HMON_METRIC_DB_TABLE              "db.instances"
+
+/* WEBSERVER: type, status, active_conns, rps, total_req */
+#define HMON_METRIC_WEB_TABLE             "web.servers"
+
+/* CRON: schedule, user, command, source */
+#define HMON_METRIC_CRON_TABLE            "cron.jobs"
+
+/* SELF (published by the host, not a plugin): plugin, collects, failures,
+ * interval_ms, wall_last_ms, wall_p50_ms, wall_p99_ms, wall_max_ms,
+ * cpu_last_ms, cpu_p99_ms, metrics, arena_bytes, alloc_bytes, allocs, stale */
+#define HMON_METRIC_SELF_PLUGINS_TABLE    "self.plugins"
+/* Estimated collector CPU at the current intervals, percent of one core */
+#define HMON_METRIC_SELF_COLLECT_CPU_PCT  "self.collect_cpu_pct"
+
+/* ALERTS (published by the host from --alerts rules): rule, metric,
+ * instance, state ("pending" or "firing"), value, threshold, since_ms */
+#define HMON_METRIC_ALERTS_TABLE          "alerts.active"
+#define HMON_METRIC_ALERTS_FIRING         "alerts.firing"
 
 #ifdef __cplusplus
 }
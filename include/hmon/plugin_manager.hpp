@@ -1,26 +1,27 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <future>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <shared_mutex>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <thread>
 #include <vector>
 
+#include "hmon/histogram.hpp"
+#include "hmon/metric_registry.hpp"
 #include "hmon/plugin_abi.h"
+#include "hmon/recording.hpp"
+#include "hmon/static_plugins.hpp"
 
 namespace hmon::core {
 
-/* Direct function pointers for statically-linked plugins. */
-struct StaticPlugin {
-    const char* name;
-    int  (*init)(hmon_plugin_ctx**);
-    int  (*collect)(hmon_plugin_ctx*, hmon_metric_list*);
-    void (*destroy)(hmon_plugin_ctx*);
-    void (*free_list)(hmon_metric_list*);
-    void (*control)(const char* key, int value);
-};
-
-std::vector<StaticPlugin>& staticPlugins();
+class AlertEngine;
 
 class PluginManager {
 public:
@@ -30,40 +31,229 @@ public:
     int load_static();
     int load(const std::string& so_path);
     int load_directory(const std::string& dir);
+    /* Initialise every loaded plugin, side by side; the number that failed. */
     int init_all();
-    int collect_all();
+
+    /*
+     * Isolation: run a loaded plugin in a helper process (this binary again,
+     * with --plugin-helper) that answers each collect with a delta frame
+     * over a pipe.  A collect that misses `deadline` (0 = the plugin's
+     * interval, at least 1 s) or a helper that dies leaves the last good
+     * values in place, marks the plugin stale and restarts the helper with
+     * backoff.  Call between load and init_all(); false for an unknown name.
+     * Isolated plugins have no event fd and run on their interval only.
+     */
+    bool isolate(const std::string& name, std::chrono::milliseconds deadline);
+    /* Helper side: load `plugin` (a static plugin's name or a .so path) and serve the host on stdin/stdout. */
+    static int run_helper(const std::string& plugin);
+    /*
+     * Synchronous collection of every plugin; only valid while the scheduler
+     * is stopped.  With a nonzero `prime`, plugins on the default interval or
+     * faster are collected twice, `prime` apart, so values computed from a
+     * delta (CPU use, network and process rates) are filled in on return.
+     */
+    int collect_all(std::chrono::milliseconds prime = std::chrono::milliseconds(0));
     void destroy_all();
 
+    /*
+     * Background collection: a fixed pool of workers runs each plugin on its
+     * own interval and publishes into the registry as soon as it finishes, so a
+     * slow plugin never delays the others.  One poll thread owns a timerfd
+     * armed for the earliest due plugin and the plugins' event fds; plugins
+     * due within a few percent of their interval ride along on the same
+     * wakeup.  Readers take read_lock() around getter calls and use
+     * generation() to notice fresh data.
+     */
+    void start(size_t workers = 4);
+    void stop();
+    void request_refresh();
+    /* Collect one plugin now, e.g. to show the effect of a control at once. */
+    void request_refresh(const std::string& plugin_name);
+
+    /*
+     * Adaptive intervals.  A plugin runs every interval << backoff: the
+     * backoff grows while its output stays the same or while collection as a
+     * whole costs more than `cpu_budget` cores (measured from the per-collect
+     * thread CPU time), and drops back to zero as soon as its output changes
+     * or the user is interacting.  While the dashboard is not visible every
+     * plugin sits at the deepest backoff.  A budget of 0 turns all of it off.
+     */
+    void set_cpu_budget(double cores);
+    void set_visible(bool visible);
+    /* A keypress: run every backed-off plugin at its own interval for a while. */
+    void note_activity();
+    /* Wake wait_for_update() callers without a new generation, e.g. to let them see a stop flag. */
+    void wake_waiters();
+    uint64_t generation() const { return generation_.load(std::memory_order_acquire); }
+    /* Block until generation() moves past `seen` or the timeout expires. */
+    bool wait_for_update(uint64_t seen, std::chrono::milliseconds timeout);
+    std::shared_lock<std::shared_mutex> read_lock() const { return std::shared_lock<std::shared_mutex>(metrics_mutex_); }
+
     std::string get_string(const std::string& key, const std::string& fallback = "") const;
     std::optional<int64_t>  get_int64(const std::string& key) const;
     std::optional<double>   get_double(const std::string& key) const;
     std::optional<bool>     get_bool(const std::string& key) const;
+    /* Registry-owned table, or nullptr; valid while the caller holds read_lock(). */
+    const hmon_table*       get_table(const std::string& key) const;
 
-    struct MetricEntry {
-        std::string key;
-        hmon_metric_value value;
-    };
-    std::vector<MetricEntry> get_by_prefix(const std::string& prefix) const;
+    /* Resolve a key to a stable id once; the id stays valid for the manager's lifetime.
+     * Takes the write lock, so never call it while holding read_lock(). */
+    MetricId resolve(std::string_view key);
+    std::string get_string(MetricId id, const std::string& fallback = "") const;
+    std::optional<int64_t>  get_int64(MetricId id) const;
+    std::optional<double>   get_double(MetricId id) const;
+    std::optional<bool>     get_bool(MetricId id) const;
+    const hmon_table*       get_table(MetricId id) const;
+    const MetricRegistry& registry() const { return registry_; }
+
+    /* Present metrics under `prefix` in natural order; caller holds read_lock(). */
+    MetricRegistry::PrefixView get_by_prefix(std::string_view prefix) const { return registry_.prefix(prefix); }
+
+    /*
+     * A publisher that is not a plugin, such as a replayed recording.  Its
+     * metrics go through the same registry path as a plugin's; the scheduler
+     * never runs it.  publish_source() takes the write lock.
+     */
+    size_t add_source(const std::string& name);
+    void publish_source(size_t source, const hmon_metric_list& list);
+
+    /*
+     * Evaluate `engine`'s rules on every publish and publish its breaches
+     * as "alerts.active" through a source of its own.  Call before start();
+     * the engine must outlive the manager's scheduler.
+     */
+    void set_alerts(AlertEngine* engine);
 
     size_t plugin_count() const { return plugins_.size(); }
     std::vector<std::string> plugin_names() const;
     void control(const std::string& plugin_name, const char* key, int value);
+    void control_str(const std::string& plugin_name, const char* key, const std::string& value);
 
 private:
+    /* Written by whichever worker runs the plugin, read lock-free by the self-metrics publisher. */
+    struct PluginStats {
+        LatencyHistogram      wall_us;
+        LatencyHistogram      cpu_us;
+        std::atomic<uint64_t> failures{0};
+        std::atomic<uint64_t> last_wall_us{0};
+        std::atomic<uint64_t> last_cpu_us{0};
+        std::atomic<uint64_t> last_metrics{0};
+        std::atomic<uint64_t> last_arena_bytes{0};
+        std::atomic<uint64_t> last_alloc_bytes{0};
+        std::atomic<uint64_t> last_allocs{0};
+        std::atomic<bool>     stale{false};     /* isolated, and the last collect missed its deadline */
+    };
+
+    /* The host's end of an isolated plugin's helper process. */
+    struct Helper {
+        int pid = -1;
+        int fd = -1;                            /* our end of the socketpair, non-blocking */
+        bool ready = false;                     /* the helper reported a successful init */
+        int failures = 0;                       /* in a row, for the restart backoff */
+        std::chrono::steady_clock::time_point retry_at{};
+        std::chrono::milliseconds deadline{0};
+        SnapshotDecoder decoder;
+        std::string reply;
+        std::vector<int> exited;                /* killed helpers not yet reaped */
+        /* Latest value per control key, replayed into every new helper; guarded by mutex. */
+        std::vector<std::pair<std::string, int>> controls;
+        std::vector<std::pair<std::string, std::string>> str_controls;
+        std::mutex mutex;                       /* fd and controls, shared with control() */
+    };
+
     struct Plugin {
         std::string  name;
         std::string  path;
         void*        dl_handle;
         hmon_plugin_ctx*               ctx;
+        int                            abi_version;
         hmon_plugin_init_fn            init;
         hmon_plugin_collect_fn         collect;
+        hmon_plugin_collect_v1_fn      collect_v1;
         hmon_plugin_destroy_fn         destroy;
         hmon_plugin_free_list_fn       free_list;
         void                           (*control_fn)(const char*, int);
+        hmon_plugin_control_str_fn     control_str_fn = nullptr;
+        hmon_plugin_event_fd_fn        event_fd_fn = nullptr;
+        MetricRegistry::OwnerId        owner;
+        /* Host-owned per-tick buffers, reset before every collect and grown on overflow. */
+        std::vector<hmon_metric>       items;
+        std::vector<char>              arena_buf;
+        hmon_metric_list               list{};
+        hmon_arena                     arena{};
+        /* Keys seen at each list position last tick, so steady-state publishes skip hashing. */
+        std::vector<std::string>       key_cache;
+        std::vector<MetricId>          id_cache;
+        /* Scheduling state, guarded by sched_mutex_. */
+        std::chrono::milliseconds      base_interval{HMON_DEFAULT_INTERVAL_MS};
+        std::chrono::milliseconds      interval{HMON_DEFAULT_INTERVAL_MS};     /* base_interval << backoff */
+        std::chrono::steady_clock::time_point next_due{};
+        int                            backoff = 0;
+        int                            unchanged = 0;       /* collects in a row with identical output */
+        double                         cpu_cost_us = 0.0;   /* moving average of CPU time per collect */
+        uint64_t                       output_hash = 0;
+        bool                           in_flight = false;
+        int                            event_fd = -1;       /* as last reported by event_fd_fn */
+        bool                           event_pending = false;
+        bool                           absent = false;      /* last collect returned HMON_COLLECT_ABSENT */
+        bool                           rerun = false;       /* refresh requested while in flight */
+        std::unique_ptr<PluginStats>   stats = std::make_unique<PluginStats>();
+        std::unique_ptr<Helper>        helper;             /* set by isolate() */
+
+        /* Initialised in process, or served by a helper. */
+        bool live() const { return ctx || helper; }
     };
 
+    /* collect_into() timed and counted into plugin.stats. */
+    int collect_one(Plugin& plugin);
+    int collect_into(Plugin& plugin);
+    int collect_isolated(Plugin& plugin);
+    bool spawn_helper(Plugin& plugin);
+    void stop_helper(Plugin& plugin, bool kill);
+    void forward_control(Helper& helper, const char* key, int value);
+    static void forward_control_locked(Helper& helper, const std::string& key, int value);
+    void forward_control_str(Helper& helper, const char* key, const std::string& value);
+    static void forward_control_str_locked(Helper& helper, const std::string& key, const std::string& value);
+    void publish(Plugin& plugin, const hmon_metric_list& list);
+    void add_self_source();
+    void publish_self(bool force);
+    void publish_alerts();
+    void bump_generation();
+    void worker_loop();
+    void event_loop();
+    void wake_event_loop();
+    void govern(Plugin& plugin, bool changed, std::chrono::steady_clock::time_point now);
+    std::chrono::milliseconds effective_interval(const Plugin& plugin) const;
+    void reset_backoff(std::chrono::steady_clock::time_point now);
+    double collect_cpu_share() const;
+
     std::vector<Plugin> plugins_;
-    std::unordered_map<std::string, hmon_metric_value> kv_map_;
+    MetricRegistry registry_;
+    mutable std::shared_mutex metrics_mutex_;
+    std::atomic<uint64_t> generation_{0};
+    std::mutex update_mutex_;
+    std::condition_variable update_cv_;
+    uint64_t waiter_wakes_ = 0;     /* guarded by update_mutex_ */
+
+    std::mutex sched_mutex_;
+    std::condition_variable sched_cv_;
+    std::vector<std::thread> workers_;
+    std::thread event_thread_;
+    int wake_fd_ = -1;
+    int timer_fd_ = -1;
+    bool stopping_ = false;
+    /* Governor inputs, guarded by sched_mutex_. */
+    double cpu_budget_ = 0.01;
+    bool visible_ = true;
+    std::chrono::steady_clock::time_point interactive_until_{};
+
+    /* "self.plugins" goes out through an ordinary source, rebuilt at most once a second. */
+    size_t self_source_ = SIZE_MAX;
+    std::mutex self_mutex_;
+    std::chrono::steady_clock::time_point self_due_{};
+
+    AlertEngine* alerts_ = nullptr;
+    size_t alerts_source_ = SIZE_MAX;
 };
 
 } /* namespace hmon::core */
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "hmon/metric_registry.hpp"
+#include "hmon/plugin_abi.h"
+
+namespace hmon::core {
+
+/* LEB128 varints, shared by .hmr files and the fleet stream. */
+void putVarint(std::string* out, uint64_t value);
+/* Bytes consumed, or 0 if [p, end) holds no complete varint yet (or a malformed one). */
+size_t readVarint(const uint8_t* p, const uint8_t* end, uint64_t* value);
+
+/* Last decoded or encoded value of one key; tables keep their cells for the next delta. */
+struct FrameValue {
+    bool     present = false;
+    int32_t  type = -1;
+    uint64_t bits = 0;                      /* i64, f64 bit pattern or bool */
+    std::string str;
+    std::vector<std::string> column_names;
+    std::vector<int32_t>     column_types;
+    uint32_t                 rows = 0;
+    std::vector<uint64_t>    cells;         /* row-major; numeric columns */
+    std::vector<std::string> cell_strs;     /* row-major; string columns */
+    std::vector<uint8_t>     cell_null;     /* row-major; string columns */
+};
+
+/*
+ * Registry snapshots as compact delta frames.  Keys are declared once and
+ * then referred to by a small id; a frame carries only the metrics that
+ * changed since the previous one: integers as zigzag varint deltas, doubles
+ * XOR-ed with their previous bits and zero bytes trimmed, and tables column
+ * by column against the previous table.  A key frame re-declares every key
+ * and value so decoding can start there.
+ */
+class SnapshotEncoder {
+public:
+    /* Append one frame of `registry`'s present metrics; caller holds the registry's read lock. */
+    void encode(const MetricRegistry& registry, int64_t time_ms, bool key_frame, std::string* out);
+
+private:
+    std::vector<uint32_t> local_of_;        /* registry id -> frame id */
+    std::vector<MetricId> metric_of_;       /* frame id -> registry id */
+    std::vector<FrameValue> values_;        /* by frame id */
+    std::string scratch_;
+    /* Spare table buffers, swapped with a value's after each delta so capacity is reused. */
+    FrameValue spare_;
+    int64_t last_time_ms_ = 0;
+};
+
+class SnapshotDecoder {
+public:
+    /* Apply one frame; false if it is malformed or a delta arrives before any key frame. */
+    bool decode(const uint8_t* data, size_t size);
+    int64_t time_ms() const { return time_ms_; }
+
+    /* The decoded state as a metric list; valid until the next decode(). */
+    hmon_metric_list list();
+
+private:
+    struct TableView {
+        std::vector<hmon_table_column> columns;
+        std::vector<hmon_table_cell>   cells;
+        hmon_table                     table{};
+    };
+
+    std::vector<std::string> keys_;
+    std::vector<FrameValue>  values_;
+    std::vector<TableView>   tables_;
+    std::vector<hmon_metric> items_;
+    FrameValue spare_;
+    int64_t time_ms_ = 0;
+    bool    started_ = false;
+};
+
+/*
+ * An .hmr file: a small header (magic, version, host name) followed by
+ * length-prefixed SnapshotEncoder frames.  Opening an existing recording
+ * appends to it, starting with a key frame.
+ */
+class RecordingWriter {
+public:
+    static constexpr uint32_t kKeyFrameInterval = 60;
+
+    ~RecordingWriter();
+    /* 0 on success, -1 after reporting to stderr. */
+    int open(const std::string& path, const std::string& host);
+    /* Append a frame; caller holds the registry's read lock. */
+    int write(const MetricRegistry& registry, int64_t time_ms);
+
+private:
+    int fd_ = -1;
+    SnapshotEncoder encoder_;
+    std::string frame_;
+    std::string record_;
+    uint32_t frames_since_key_ = kKeyFrameInterval;
+};
+
+/*
+ * Memory-mapped .hmr reader.  open() indexes every frame, so seek() only
+ * decodes forward from the nearest key frame at or before the target.
+ */
+class RecordingReader {
+public:
+    ~RecordingReader();
+    /* 0 on success, -1 after reporting to stderr. */
+    int open(const std::string& path);
+
+    const std::string& host() const { return host_; }
+    size_t frame_count() const { return frames_.size(); }
+    int64_t frame_time(size_t frame) const { return frames_[frame].time_ms; }
+    /* Last frame at or before `time_ms`, clamped to the recording. */
+    size_t frame_at(int64_t time_ms) const;
+
+    /* Make `frame` current; false if decoding failed. */
+    bool seek(size_t frame);
+    size_t position() const { return position_; }
+    hmon_metric_list list() { return decoder_.list(); }
+
+private:
+    struct Frame {
+        size_t   offset;
+        uint32_t size;
+        int64_t  time_ms;
+        bool     key;
+    };
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    std::string host_;
+    std::vector<Frame> frames_;
+    SnapshotDecoder decoder_;
+    size_t position_ = SIZE_MAX;
+};
+
+} /* namespace hmon::core */
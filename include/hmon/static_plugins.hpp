@@ -9,21 +9,33 @@ namespace hmon::core {
 struct StaticPlugin {
     const char* name;
     int  (*init)(hmon_plugin_ctx**);
-    int  (*collect)(hmon_plugin_ctx*, hmon_metric_list*);
+    int  (*collect)(hmon_plugin_ctx*, hmon_metric_list*, hmon_arena*);
     void (*destroy)(hmon_plugin_ctx*);
-    void (*free_list)(hmon_metric_list*);
     void (*control)(const char* key, int value);
+    int  interval_ms;
+    int  (*event_fd)(hmon_plugin_ctx*) = nullptr;
+    void (*control_str)(const char* key, const char* value) = nullptr;
 };
 
 std::vector<StaticPlugin>& staticPlugins();
 
 }
 
-/* Register a statically-linked plugin. Each plugin must have unique function names. */
-#define HMON_STATIC_PLUGIN(name_str, init_fn, collect_fn, destroy_fn, free_fn, ctrl_fn) \
+/* Register a statically-linked plugin. Each plugin must have unique function names.
+ * `interval` is the plugin's collection cadence in milliseconds. */
+#define HMON_STATIC_PLUGIN(name_str, init_fn, collect_fn, destroy_fn, ctrl_fn, interval) \
+    HMON_STATIC_PLUGIN_EVENTS(name_str, init_fn, collect_fn, destroy_fn, ctrl_fn, interval, nullptr)
+
+/* As above, plus an hmon_plugin_event_fd_fn that wakes the plugin between intervals. */
+#define HMON_STATIC_PLUGIN_EVENTS(name_str, init_fn, collect_fn, destroy_fn, ctrl_fn, interval, event_fd_fn) \
+    HMON_STATIC_PLUGIN_FULL(name_str, init_fn, collect_fn, destroy_fn, ctrl_fn, interval, event_fd_fn, nullptr)
+
+/* As above, plus an hmon_plugin_control_str_fn for text-valued controls. */
+#define HMON_STATIC_PLUGIN_FULL(name_str, init_fn, collect_fn, destroy_fn, ctrl_fn, interval, event_fd_fn, ctrl_str_fn) \
     namespace { struct _hmon_reg { _hmon_reg() { \
         hmon::core::StaticPlugin sp; \
         sp.name = name_str; sp.init = init_fn; sp.collect = collect_fn; \
-        sp.destroy = destroy_fn; sp.free_list = free_fn; sp.control = ctrl_fn; \
+        sp.destroy = destroy_fn; sp.control = ctrl_fn; sp.interval_ms = interval; \
+        sp.event_fd = event_fd_fn; sp.control_str = ctrl_str_fn; \
         hmon::core::staticPlugins().push_back(sp); \
     }} _hmon_reg_instance; }
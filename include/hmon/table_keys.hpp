@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "hmon/plugin_abi.h"
+
+namespace hmon::core {
+
+/*
+ * Columns that say which row a row is, rather than measuring it or its
+ * state: the first text column, and columns named pid, port, node, cpu,
+ * core, gpu, socket, group, addr, metric or instance.
+ * Rows of ranked tables move around; these follow the row.
+ */
+bool isKeyColumn(const hmon_table& table, uint32_t col);
+
+/*
+ * A short name for `row`: its text key columns, then its integer ones,
+ * joined by '#' ("bash#1234", "tcp#0.0.0.0#22#1234").  The row index only
+ * when the table has no key columns.
+ */
+std::string rowName(const hmon_table& table, uint32_t row);
+
+} /* namespace hmon::core */
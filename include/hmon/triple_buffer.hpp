@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+
+namespace hmon::core {
+
+/*
+ * Single-producer / single-consumer triple buffer.  The writer fills back()
+ * and publish()es it; the reader calls update() and then reads front().
+ * Neither side ever blocks or waits for the other: the writer always has a
+ * private slot to fill and the reader always keeps the newest complete one.
+ * Slots are reused, so containers inside T keep their capacity across frames.
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    T& back() { return slots_[back_]; }
+
+    void publish() {
+        int prev = middle_.exchange(back_ | kDirty, std::memory_order_acq_rel);
+        back_ = prev & kIndexMask;
+    }
+
+    /* Swap in the newest published slot; returns false if nothing new arrived. */
+    bool update() {
+        if ((middle_.load(std::memory_order_acquire) & kDirty) == 0) return false;
+        int prev = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = prev & kIndexMask;
+        return true;
+    }
+
+    const T& front() const { return slots_[front_]; }
+
+private:
+    static constexpr int kIndexMask = 3;
+    static constexpr int kDirty = 4;
+
+    T slots_[3]{};
+    int back_ = 0;
+    int front_ = 1;
+    std::atomic<int> middle_{2};
+};
+
+} /* namespace hmon::core */
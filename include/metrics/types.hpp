@@ -5,6 +5,13 @@
 #include <string>
 #include <vector>
 
+/* Hardware-counter ratios from the perf plugin; -1 where a counter is missing. */
+struct PerfCounters {
+  double ipc = -1.0;
+  double llc_mpki = -1.0;
+  double branch_mpki = -1.0;
+};
+
 struct CpuMetrics {
   std::string name;
   std::optional<int> total_cores;
@@ -13,6 +20,10 @@ struct CpuMetrics {
   std::optional<double> frequency_mhz;
   std::optional<double> usage_percent;
   std::vector<double> core_usage_percent;
+  std::vector<PerfCounters> core_counters;                  /* by core; empty without a PMU */
+  std::vector<std::pair<int, PerfCounters>> socket_counters;
+  int counters_pid = -1;                                    /* the locked PID, when it is counted */
+  PerfCounters pid_counters;
 };
 
 struct RamMetrics {
@@ -20,15 +31,48 @@ struct RamMetrics {
   std::optional<long long> available_kb;
 };
 
+/* A NUMA node: the cpu plugin's load over its CPUs, the system plugin's memory and numastat rates. */
+struct NumaNodeInfo {
+  int node = 0;
+  std::string cpus;
+  std::optional<double> usage_percent;
+  long long mem_total_kb = 0;
+  long long mem_free_kb = 0;
+  std::optional<double> miss_per_sec;       /* pages */
+  std::optional<double> foreign_per_sec;
+};
+
 struct SwapMetrics {
   std::optional<long long> total_kb;
   std::optional<long long> free_kb;
 };
 
+struct DiskIoMetrics {
+  std::string device;
+  double busy_percent = 0.0;
+  double read_iops = 0.0;
+  double write_iops = 0.0;
+  double read_bytes_per_sec = 0.0;
+  double write_bytes_per_sec = 0.0;
+  double await_ms = 0.0;
+  double queue_depth = 0.0;
+};
+
+struct MountMetrics {
+  std::string mount_point;
+  std::string device;
+  std::string fstype;
+  unsigned long long total_bytes = 0;
+  unsigned long long free_bytes = 0;
+};
+
 struct DiskMetrics {
   std::string mount_point = "/";
   std::optional<unsigned long long> total_bytes;
   std::optional<unsigned long long> free_bytes;
+  std::optional<double> busy_percent;
+  std::vector<MountMetrics> mounts;
+  std::vector<DiskIoMetrics> devices;
 };
 
 struct GpuMetrics {
@@ -45,10 +89,21 @@ struct GpuMetrics {
   std::vector<double> gpu_core_usage_percent;
 };
 
+struct NetInterfaceMetrics {
+  std::string name;
+  double rx_bytes_per_sec = 0.0;
+  double tx_bytes_per_sec = 0.0;
+  double rx_packets_per_sec = 0.0;
+  double tx_packets_per_sec = 0.0;
+  double rx_drops_per_sec = 0.0;
+  double tx_drops_per_sec = 0.0;
+};
+
 struct NetworkMetrics {
   std::string interface;
   std::optional<double> rx_kbps;
   std::optional<double> tx_kbps;
+  std::vector<NetInterfaceMetrics> interfaces;
 };
 
 struct ProcessInfo {
@@ -57,6 +112,13 @@ struct ProcessInfo {
   double cpu_percent = 0.0;
   double mem_percent = 0.0;
   double gpu_percent = 0.0;
+  double io_read_bps = 0.0;
+  double io_write_bps = 0.0;
+  double net_bps = 0.0;
+  double io_delay_pct = 0.0;
+  int numa_node = -1;           /* node holding most of its pages, -1 when unknown */
+  double numa_local_pct = 0.0;
+  int procs = 0;                /* members, when the row is a process group; pid is then the group id */
   std::string command;
 };
 
@@ -109,6 +171,23 @@ struct WebServerInfo {
   int64_t total_requests = 0;
 };
 
+/* One resource of the "psi.resources" table. */
+struct PressureInfo {
+  std::string resource;
+  double some_avg10 = 0.0;
+  double some_avg60 = 0.0;
+  std::optional<double> full_avg10;
+  bool stalled = false;
+};
+
+struct AlertInfo {
+  std::string rule;
+  std::string metric;
+  std::string instance;
+  double value = 0.0;
+  bool firing = false;
+};
+
 struct CronJob {
   std::string schedule;
   std::string user;
@@ -116,10 +195,29 @@ struct CronJob {
   std::string source;
 };
 
+/* One row of the host's "self.plugins" table: how collecting a plugin costs. */
+struct PluginSelfMetrics {
+  std::string name;
+  int64_t collects = 0;
+  int64_t failures = 0;
+  int64_t interval_ms = 0;
+  double wall_last_ms = 0.0;
+  double wall_p50_ms = 0.0;
+  double wall_p99_ms = 0.0;
+  double wall_max_ms = 0.0;
+  double cpu_p99_ms = 0.0;
+  int64_t metrics = 0;
+  int64_t arena_bytes = 0;
+  int64_t alloc_bytes = 0;
+  int64_t allocs = 0;
+  bool stale = false;              /* isolated plugin whose helper missed its deadline */
+};
+
 struct Snapshot {
   CpuMetrics cpu;
   RamMetrics ram;
   SwapMetrics swap;
+  std::vector<NumaNodeInfo> numa_nodes;
   DiskMetrics disk;
   NetworkMetrics network;
   std::vector<GpuMetrics> gpus;
@@ -131,4 +229,9 @@ struct Snapshot {
   std::vector<DbInfo> databases;
   std::vector<WebServerInfo> webservers;
   std::vector<CronJob> cron_jobs;
+  std::vector<PressureInfo> pressure;
+  std::vector<AlertInfo> alerts;
+  std::vector<PluginSelfMetrics> plugins;
+  double collect_cpu_pct = 0.0;
+  int64_t process_matches = -1;     /* of the process filter; -1 without one */
 };
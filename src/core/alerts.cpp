@@ -0,0 +1,596 @@
+#include "hmon/alerts.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <netdb.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "hmon/table_keys.hpp"
+
+extern char** environ;
+
+namespace hmon::core {
+
+namespace {
+
+constexpr size_t kMaxQueuedEvents = 256;
+constexpr auto kHookTimeout = std::chrono::seconds(10);
+constexpr int kWebhookTimeoutMs = 5000;
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front()))) s.remove_prefix(1);
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) s.remove_suffix(1);
+    return s;
+}
+
+bool startsWith(std::string_view s, std::string_view prefix) { return s.substr(0, prefix.size()) == prefix; }
+
+bool endsWith(std::string_view s, std::string_view suffix) {
+    return s.size() >= suffix.size() && s.substr(s.size() - suffix.size()) == suffix;
+}
+
+/* Multiplier for a threshold suffix; 0 when unknown. */
+double unitScale(std::string_view unit, bool* bytes) {
+    if (endsWith(unit, "/s")) unit.remove_suffix(2);
+    *bytes = !unit.empty() && unit.back() == 'B';
+    struct Unit { const char* name; double scale; };
+    static constexpr Unit kUnits[] = {
+        {"", 1.0}, {"%", 1.0}, {"B", 1.0},
+        {"k", 1e3}, {"K", 1e3}, {"kB", 1e3}, {"KB", 1e3}, {"M", 1e6}, {"MB", 1e6},
+        {"G", 1e9}, {"GB", 1e9}, {"T", 1e12}, {"TB", 1e12},
+        {"KiB", 1024.0}, {"MiB", 1048576.0}, {"GiB", 1073741824.0}, {"TiB", 1099511627776.0},
+    };
+    for (const auto& u : kUnits) {
+        if (unit == u.name) return u.scale;
+    }
+    return 0.0;
+}
+
+bool parseDuration(std::string_view text, std::chrono::milliseconds* out) {
+    char* end = nullptr;
+    const std::string s(text);
+    const double n = std::strtod(s.c_str(), &end);
+    if (end == s.c_str() || n < 0) return false;
+    const std::string_view unit(end);
+    double ms = 0;
+    if (unit == "ms") ms = n;
+    else if (unit.empty() || unit == "s") ms = n * 1000.0;
+    else if (unit == "m") ms = n * 60000.0;
+    else if (unit == "h") ms = n * 3600000.0;
+    else return false;
+    *out = std::chrono::milliseconds(static_cast<int64_t>(ms));
+    return true;
+}
+
+/* Whether the first `n` segments of `pattern` match the whole of `key`. */
+bool matchSegments(const std::vector<std::string>& pattern, size_t n, std::string_view key) {
+    for (size_t i = 0; i < n; ++i) {
+        const size_t dot = key.find('.');
+        const std::string_view segment = key.substr(0, dot);
+        if (segment.empty() || (pattern[i] != "*" && pattern[i] != segment)) return false;
+        if (dot == std::string_view::npos) return i + 1 == n;
+        key.remove_prefix(dot + 1);
+    }
+    return false;
+}
+
+std::optional<double> numeric(const hmon_metric_value& v) {
+    switch (v.type) {
+        case HMON_VAL_INT64: return static_cast<double>(v.v.i64);
+        case HMON_VAL_DOUBLE: return v.v.f64;
+        case HMON_VAL_BOOL: return v.v.b ? 1.0 : 0.0;
+        default: return std::nullopt;
+    }
+}
+
+int64_t wallMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string formatValue(double v) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.6g", v);
+    return buf;
+}
+
+void appendJsonString(std::string* out, const std::string& s) {
+    out->push_back('"');
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out->push_back('\\');
+            out->push_back(c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out->append(buf);
+        } else {
+            out->push_back(c);
+        }
+    }
+    out->push_back('"');
+}
+
+struct Url {
+    std::string host;
+    std::string port = "80";
+    std::string path = "/";
+};
+
+/* Plain http:// only; there is no TLS client in the tree. */
+std::optional<Url> parseUrl(std::string_view url) {
+    if (!startsWith(url, "http://")) return std::nullopt;
+    url.remove_prefix(7);
+    Url out;
+    const size_t slash = url.find('/');
+    std::string_view authority = url.substr(0, slash);
+    if (slash != std::string_view::npos) out.path = std::string(url.substr(slash));
+    const size_t colon = authority.rfind(':');
+    if (colon != std::string_view::npos && authority.find(']', colon) == std::string_view::npos) {
+        out.port = std::string(authority.substr(colon + 1));
+        authority = authority.substr(0, colon);
+    }
+    if (authority.size() > 2 && authority.front() == '[' && authority.back() == ']') {
+        authority = authority.substr(1, authority.size() - 2);
+    }
+    if (authority.empty() || out.port.empty()) return std::nullopt;
+    out.host = std::string(authority);
+    return out;
+}
+
+int connectWithTimeout(const Url& url) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (::getaddrinfo(url.host.c_str(), url.port.c_str(), &hints, &res) != 0) return -1;
+    int fd = -1;
+    for (addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            pollfd p{fd, POLLOUT, 0};
+            int err = errno == EINPROGRESS ? 0 : errno;
+            socklen_t len = sizeof(err);
+            if (err == 0 && (::poll(&p, 1, kWebhookTimeoutMs) != 1 ||
+                             ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0)) {
+                err = ETIMEDOUT;
+            }
+            if (err != 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+    }
+    ::freeaddrinfo(res);
+    return fd;
+}
+
+bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        const ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        pollfd p{fd, POLLOUT, 0};
+        if (n < 0 && errno == EAGAIN && ::poll(&p, 1, kWebhookTimeoutMs) == 1) continue;
+        return false;
+    }
+    return true;
+}
+
+}
+
+std::optional<AlertRule> parseAlertRule(std::string_view line, std::string* error) {
+    AlertRule rule;
+    rule.text = std::string(trim(line));
+    std::string_view rest = rule.text;
+
+    std::string_view key;
+    if (startsWith(rest, "rate(")) {
+        const size_t close = rest.find(')');
+        if (close == std::string_view::npos) {
+            *error = "missing ')' after rate(";
+            return std::nullopt;
+        }
+        key = trim(rest.substr(5, close - 5));
+        rest.remove_prefix(close + 1);
+        rule.rate = true;
+    } else {
+        const size_t end = rest.find_first_of(" \t<>");
+        key = rest.substr(0, end);
+        rest.remove_prefix(end == std::string_view::npos ? rest.size() : end);
+    }
+    while (!key.empty()) {
+        const size_t dot = key.find('.');
+        rule.pattern.emplace_back(key.substr(0, dot));
+        if (rule.pattern.back().empty()) break;
+        key.remove_prefix(dot == std::string_view::npos ? key.size() : dot + 1);
+    }
+    if (rule.pattern.empty() || rule.pattern.back().empty()) {
+        *error = "expected a metric key";
+        return std::nullopt;
+    }
+
+    rest = trim(rest);
+    if (startsWith(rest, ">=")) rule.op = AlertRule::Op::kGreaterEqual;
+    else if (startsWith(rest, "<=")) rule.op = AlertRule::Op::kLessEqual;
+    else if (startsWith(rest, ">")) rule.op = AlertRule::Op::kGreater;
+    else if (startsWith(rest, "<")) rule.op = AlertRule::Op::kLess;
+    else {
+        *error = "expected >, >=, < or <=";
+        return std::nullopt;
+    }
+    rest.remove_prefix(rule.op == AlertRule::Op::kGreater || rule.op == AlertRule::Op::kLess ? 1 : 2);
+    rest = trim(rest);
+
+    const size_t value_end = rest.find_first_of(" \t");
+    const std::string value(rest.substr(0, value_end));
+    rest.remove_prefix(value_end == std::string_view::npos ? rest.size() : value_end);
+    char* unit = nullptr;
+    const double number = std::strtod(value.c_str(), &unit);
+    const double scale = unit != value.c_str() ? unitScale(unit, &rule.byte_unit) : 0.0;
+    if (scale == 0.0 || !std::isfinite(number)) {
+        *error = "bad threshold \"" + value + "\"";
+        return std::nullopt;
+    }
+    rule.threshold = number * scale;
+
+    rest = trim(rest);
+    if (startsWith(rest, "for ") || startsWith(rest, "for\t")) {
+        if (!parseDuration(trim(rest.substr(4)), &rule.hold)) {
+            *error = "bad duration \"" + std::string(trim(rest.substr(4))) + "\"";
+            return std::nullopt;
+        }
+    } else if (!rest.empty()) {
+        *error = "unexpected \"" + std::string(rest) + "\"";
+        return std::nullopt;
+    }
+    return rule;
+}
+
+AlertEngine::~AlertEngine() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        stopping_ = true;
+    }
+    queue_cv_.notify_all();
+    if (actions_.joinable()) actions_.join();
+}
+
+int AlertEngine::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "[hmon] cannot read alert rules from " << path << "\n";
+        return -1;
+    }
+    std::string line;
+    int number = 0;
+    while (std::getline(in, line)) {
+        ++number;
+        const std::string_view text = trim(line);
+        if (text.empty() || text.front() == '#') continue;
+        std::string error;
+        if (startsWith(text, "hook ")) {
+            set_hook(std::string(trim(text.substr(5))));
+        } else if (startsWith(text, "webhook ")) {
+            const std::string url(trim(text.substr(8)));
+            if (parseUrl(url)) set_webhook(url);
+            else error = "webhook needs an http://host[:port]/path URL";
+        } else if (auto rule = parseAlertRule(text, &error)) {
+            add_rule(std::move(*rule));
+        }
+        if (!error.empty()) std::cerr << "[hmon] " << path << ":" << number << ": " << error << "\n";
+    }
+    return 0;
+}
+
+void AlertEngine::add_rule(AlertRule rule) {
+    rules_.push_back(std::move(rule));
+    /* Targets point at rules by index; match every key again against the new set. */
+    targets_.clear();
+    watch_.clear();
+    active_.clear();
+    scanned_ = 0;
+}
+
+void AlertEngine::match_new_keys(const MetricRegistry& registry) {
+    for (size_t id = scanned_; id < registry.size(); ++id) {
+        const std::string& key = registry.key(static_cast<MetricId>(id));
+        for (size_t r = 0; r < rules_.size(); ++r) {
+            const auto& pattern = rules_[r].pattern;
+            /* A key matching all segments is a scalar; one matching all but the last is a table and its column. */
+            std::string column;
+            if (!matchSegments(pattern, pattern.size(), key)) {
+                if (pattern.size() < 2 || !matchSegments(pattern, pattern.size() - 1, key)) continue;
+                column = pattern.back();
+            }
+            Target target;
+            target.rule = r;
+            target.id = static_cast<MetricId>(id);
+            target.key = key;
+            target.threshold = rules_[r].threshold;
+            const std::string_view name = column.empty() ? std::string_view(key).substr(key.rfind('.') + 1) : column;
+            if (rules_[r].byte_unit && endsWith(name, "_kb")) target.threshold /= 1024.0;
+            target.metric = column.empty() ? key : key + "." + column;
+            target.column = std::move(column);
+            if (watch_.size() <= id) watch_.resize(id + 1);
+            watch_[id].push_back(static_cast<uint32_t>(targets_.size()));
+            targets_.push_back(std::move(target));
+        }
+    }
+    scanned_ = registry.size();
+}
+
+bool AlertEngine::on_publish(const MetricRegistry& registry, MetricRegistry::OwnerId owner, const MetricId* ids,
+                             size_t count) {
+    if (rules_.empty()) return false;
+    ++epoch_;
+    changed_ = false;
+    if (registry.size() > scanned_) match_new_keys(registry);
+    const auto now = Clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        if (ids[i] >= watch_.size()) continue;
+        for (uint32_t t : watch_[ids[i]]) {
+            Target& target = targets_[t];
+            if (target.stamp == epoch_) continue;
+            target.owner = owner;
+            target.stamp = epoch_;
+            evaluate(&target, registry.value(ids[i]), now);
+        }
+    }
+    /* The owner published again without this metric: whatever it breached is over. */
+    for (auto& target : targets_) {
+        if (target.owner != owner || target.stamp == epoch_ || target.series.empty()) continue;
+        for (auto& [instance, series] : target.series) resolve(&target, instance, &series);
+        target.series.clear();
+    }
+    if (changed_) rebuild_active();
+    return changed_;
+}
+
+void AlertEngine::evaluate(Target* target, const hmon_metric_value& value, Clock::time_point now) {
+    if (target->column.empty()) {
+        if (auto v = numeric(value)) update(target, "", *v, now);
+        return;
+    }
+    if (value.type != HMON_VAL_TABLE || !value.v.table) return;
+    const hmon_table& table = *value.v.table;
+    int column = -1;
+    for (uint32_t c = 0; c < table.column_count; ++c) {
+        const auto& col = table.columns[c];
+        if (column < 0 && col.name && target->column == col.name && col.type != HMON_VAL_STRING) {
+            column = static_cast<int>(c);
+        }
+    }
+    if (column < 0) return;
+    /* Rows of a table without id columns can still share a name; number the repeats so each keeps its own series. */
+    std::unordered_map<std::string, int> seen;
+    for (uint32_t r = 0; r < table.row_count; ++r) {
+        const hmon_table_cell* row = table.cells + static_cast<size_t>(r) * table.column_count;
+        const hmon_table_cell& cell = row[column];
+        double v = 0.0;
+        switch (table.columns[column].type) {
+            case HMON_VAL_INT64:
+                if (cell.i64 == HMON_TABLE_NULL_I64) continue;
+                v = static_cast<double>(cell.i64);
+                break;
+            case HMON_VAL_DOUBLE:
+                if (std::isnan(cell.f64)) continue;
+                v = cell.f64;
+                break;
+            case HMON_VAL_BOOL:
+                if (cell.b < 0) continue;
+                v = cell.b ? 1.0 : 0.0;
+                break;
+            default:
+                continue;
+        }
+        std::string name = rowName(table, r);
+        if (const int repeat = seen[name]++; repeat > 0) name += "~" + std::to_string(repeat + 1);
+        update(target, name, v, now);
+    }
+    for (auto it = target->series.begin(); it != target->series.end();) {
+        if (it->second.stamp == epoch_) {
+            ++it;
+            continue;
+        }
+        resolve(target, it->first, &it->second);
+        it = target->series.erase(it);
+    }
+}
+
+void AlertEngine::update(Target* target, const std::string& instance, double raw, Clock::time_point now) {
+    const AlertRule& rule = rules_[target->rule];
+    Series& s = target->series[instance];
+    s.stamp = epoch_;
+    double v = raw;
+    if (rule.rate) {
+        const bool had_prev = s.has_prev;
+        const double dt = std::chrono::duration<double>(now - s.prev_time).count();
+        const double prev = s.prev;
+        s.prev = raw;
+        s.prev_time = now;
+        s.has_prev = true;
+        if (!had_prev || dt <= 0.0) return;
+        v = (raw - prev) / dt;
+    }
+    s.value = v;
+
+    bool breach = false;
+    switch (rule.op) {
+        case AlertRule::Op::kGreater: breach = v > target->threshold; break;
+        case AlertRule::Op::kGreaterEqual: breach = v >= target->threshold; break;
+        case AlertRule::Op::kLess: breach = v < target->threshold; break;
+        case AlertRule::Op::kLessEqual: breach = v <= target->threshold; break;
+    }
+    if (!breach) {
+        if (s.breaching) resolve(target, instance, &s);
+        return;
+    }
+    /* A breach in progress shows its current value, so it is republished every time. */
+    changed_ = true;
+    if (!s.breaching) {
+        s.breaching = true;
+        s.breach_since = now;
+        s.since_ms = wallMs();
+    }
+    if (!s.firing && now - s.breach_since >= rule.hold) {
+        s.firing = true;
+        notify(Event{rule.text, target->metric, instance, v, true, wallMs()});
+    }
+}
+
+void AlertEngine::resolve(Target* target, const std::string& instance, Series* series) {
+    if (series->firing) notify(Event{rules_[target->rule].text, target->metric, instance, series->value, false, wallMs()});
+    if (series->breaching) changed_ = true;
+    series->breaching = false;
+    series->firing = false;
+}
+
+void AlertEngine::rebuild_active() {
+    active_.clear();
+    for (const auto& target : targets_) {
+        for (const auto& [instance, s] : target.series) {
+            if (!s.breaching) continue;
+            ActiveAlert a;
+            a.rule = &rules_[target.rule];
+            a.metric = target.metric;
+            a.instance = instance;
+            a.value = s.value;
+            a.threshold = target.threshold;
+            a.firing = s.firing;
+            a.since_ms = s.since_ms;
+            active_.push_back(std::move(a));
+        }
+    }
+    std::sort(active_.begin(), active_.end(), [](const ActiveAlert& a, const ActiveAlert& b) {
+        if (a.firing != b.firing) return a.firing;
+        return a.since_ms < b.since_ms;
+    });
+}
+
+void AlertEngine::notify(Event event) {
+    if (!log_ && hook_.empty() && webhook_.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (queue_.size() >= kMaxQueuedEvents) queue_.pop_front();
+        queue_.push_back(std::move(event));
+        if (!actions_.joinable()) actions_ = std::thread([this]() { action_loop(); });
+    }
+    queue_cv_.notify_one();
+}
+
+void AlertEngine::action_loop() {
+    while (true) {
+        Event event;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+            if (stopping_) return;
+            event = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        if (log_) {
+            std::cerr << "[hmon] alert " << (event.firing ? "firing" : "resolved") << ": " << event.rule;
+            if (!event.instance.empty()) std::cerr << " [" << event.instance << "]";
+            std::cerr << " = " << formatValue(event.value) << "\n";
+        }
+        if (!hook_.empty()) run_hook(event);
+        if (!webhook_.empty()) post_webhook(event);
+    }
+}
+
+/* `sh -c hook` with the alert in HMON_ALERT_* variables; killed if it outlives kHookTimeout. */
+void AlertEngine::run_hook(const Event& event) {
+    std::vector<std::string> vars = {
+        "HMON_ALERT_RULE=" + event.rule,
+        "HMON_ALERT_METRIC=" + event.metric,
+        "HMON_ALERT_INSTANCE=" + event.instance,
+        "HMON_ALERT_VALUE=" + formatValue(event.value),
+        std::string("HMON_ALERT_STATE=") + (event.firing ? "firing" : "resolved"),
+    };
+    std::vector<char*> env;
+    for (char** e = environ; e && *e; ++e) {
+        if (!startsWith(*e, "HMON_ALERT_")) env.push_back(*e);
+    }
+    for (auto& v : vars) env.push_back(v.data());
+    env.push_back(nullptr);
+    std::string command = hook_;
+    char sh[] = "/bin/sh";
+    char dash_c[] = "-c";
+    char* argv[] = {sh, dash_c, command.data(), nullptr};
+
+    pid_t pid = -1;
+    if (::posix_spawn(&pid, sh, nullptr, nullptr, argv, env.data()) != 0) {
+        if (log_) std::cerr << "[hmon] alert hook could not be started\n";
+        return;
+    }
+    const auto deadline = std::chrono::steady_clock::now() + kHookTimeout;
+    while (::waitpid(pid, nullptr, WNOHANG) == 0) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            ::kill(pid, SIGKILL);
+            ::waitpid(pid, nullptr, 0);
+            if (log_) std::cerr << "[hmon] alert hook timed out\n";
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
+
+void AlertEngine::post_webhook(const Event& event) {
+    const auto url = parseUrl(webhook_);
+    if (!url) return;
+    char host[256] = {};
+    ::gethostname(host, sizeof(host) - 1);
+
+    std::string body = "{\"host\":";
+    appendJsonString(&body, host);
+    body += ",\"rule\":";
+    appendJsonString(&body, event.rule);
+    body += ",\"metric\":";
+    appendJsonString(&body, event.metric);
+    body += ",\"instance\":";
+    appendJsonString(&body, event.instance);
+    body += ",\"value\":" + (std::isfinite(event.value) ? formatValue(event.value) : std::string("null"));
+    body += std::string(",\"state\":\"") + (event.firing ? "firing" : "resolved") + "\"";
+    body += ",\"time_ms\":" + std::to_string(event.time_ms) + "}";
+
+    std::string request = "POST " + url->path + " HTTP/1.1\r\nHost: " + url->host + "\r\n"
+                          "Content-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) +
+                          "\r\nConnection: close\r\n\r\n" + body;
+    const int fd = connectWithTimeout(*url);
+    bool ok = fd >= 0 && sendAll(fd, request);
+    if (ok) {
+        /* Only the status line matters. */
+        char buf[64] = {};
+        size_t got = 0;
+        pollfd p{fd, POLLIN, 0};
+        while (got < 12 && ::poll(&p, 1, kWebhookTimeoutMs) == 1) {
+            const ssize_t n = ::recv(fd, buf + got, sizeof(buf) - 1 - got, 0);
+            if (n <= 0) break;
+            got += static_cast<size_t>(n);
+        }
+        ok = got >= 12 && startsWith(buf, "HTTP/1.") && buf[9] == '2';
+    }
+    if (fd >= 0) ::close(fd);
+    if (!ok && log_) std::cerr << "[hmon] alert webhook " << webhook_ << " failed\n";
+}
+
+} /* namespace hmon::core */
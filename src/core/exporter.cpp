@@ -0,0 +1,415 @@
+#include "hmon/exporter.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+#include "hmon/table_keys.hpp"
+
+namespace hmon::core {
+
+namespace {
+
+constexpr size_t kMaxRequestBytes = 8 * 1024;
+constexpr int kMaxEvents = 64;
+constexpr int kPollTimeoutMs = 500;
+constexpr const char* kTextContentType = "text/plain; version=0.0.4; charset=utf-8";
+constexpr const char* kOpenMetricsContentType = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+void appendName(std::string* out, std::string_view key) {
+    for (char c : key) {
+        const bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        out->push_back(ok ? c : '_');
+    }
+}
+
+void appendFamily(std::string* out, std::string_view key, std::string_view suffix = {}) {
+    out->append("hmon_");
+    appendName(out, key);
+    if (!suffix.empty()) {
+        out->push_back('_');
+        appendName(out, suffix);
+    }
+}
+
+void appendLabelValue(std::string* out, std::string_view value) {
+    for (char c : value) {
+        if (c == '\\') out->append("\\\\");
+        else if (c == '"') out->append("\\\"");
+        else if (c == '\n') out->append("\\n");
+        else out->push_back(c);
+    }
+}
+
+void appendInt(std::string* out, int64_t value) {
+    char buf[24];
+    const int n = std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(value));
+    out->append(buf, static_cast<size_t>(n));
+}
+
+void appendDouble(std::string* out, double value) {
+    if (std::isnan(value)) { out->append("NaN"); return; }
+    if (std::isinf(value)) { out->append(value > 0 ? "+Inf" : "-Inf"); return; }
+    char buf[32];
+    const int n = std::snprintf(buf, sizeof(buf), "%.10g", value);
+    out->append(buf, static_cast<size_t>(n));
+}
+
+void appendTypeLine(std::string* out, std::string_view key, std::string_view suffix = {}) {
+    out->append("# TYPE ");
+    appendFamily(out, key, suffix);
+    out->append(" gauge\n");
+}
+
+bool cellPresent(const hmon_table_cell& cell, int32_t type) {
+    switch (type) {
+    case HMON_VAL_STRING: return cell.str != nullptr;
+    case HMON_VAL_INT64:  return cell.i64 != HMON_TABLE_NULL_I64;
+    case HMON_VAL_DOUBLE: return !std::isnan(cell.f64);
+    case HMON_VAL_BOOL:   return cell.b >= 0;
+    default:              return false;
+    }
+}
+
+/* `{key="..",...` for the row's key columns, or `{row="i"` when the table has none; the caller closes it.
+ * False when no label was written. */
+bool appendRowLabels(std::string* out, const hmon_table& table, uint32_t row, bool keyed) {
+    const hmon_table_cell* cells = hmon_table_row_const(&table, row);
+    out->push_back('{');
+    if (!keyed) {
+        out->append("row=\"");
+        appendInt(out, row);
+        out->push_back('"');
+        return true;
+    }
+    bool first = true;
+    for (uint32_t label = 0; label < table.column_count; ++label) {
+        const hmon_table_column& key_column = table.columns[label];
+        if (!isKeyColumn(table, label) || !cellPresent(cells[label], key_column.type)) continue;
+        if (!first) out->push_back(',');
+        first = false;
+        appendName(out, key_column.name);
+        out->append("=\"");
+        if (key_column.type == HMON_VAL_STRING) appendLabelValue(out, cells[label].str);
+        else appendInt(out, cells[label].i64);
+        out->push_back('"');
+    }
+    return !first;
+}
+
+/*
+ * One family per measured column, one series per row, labelled by the row's
+ * key columns so a series stays with its process or port however the table
+ * is ranked.  Only a table with no key columns falls back to the row index.
+ * The other text columns (state, status, ...) change under a row, so they go
+ * on a separate <key>_info series rather than renaming every gauge.
+ */
+void appendTable(std::string* out, std::string_view key, const hmon_table& table) {
+    bool keyed = false;
+    bool info = false;
+    for (uint32_t col = 0; col < table.column_count; ++col) {
+        const bool is_key = isKeyColumn(table, col);
+        keyed = keyed || is_key;
+        info = info || (!is_key && table.columns[col].type == HMON_VAL_STRING);
+    }
+    for (uint32_t col = 0; col < table.column_count; ++col) {
+        const hmon_table_column& column = table.columns[col];
+        if (isKeyColumn(table, col) || column.type == HMON_VAL_STRING) continue;
+        appendTypeLine(out, key, column.name);
+        for (uint32_t row = 0; row < table.row_count; ++row) {
+            const hmon_table_cell* cells = hmon_table_row_const(&table, row);
+            if (!cellPresent(cells[col], column.type)) continue;
+            appendFamily(out, key, column.name);
+            appendRowLabels(out, table, row, keyed);
+            out->append("} ");
+            switch (column.type) {
+            case HMON_VAL_INT64:  appendInt(out, cells[col].i64); break;
+            case HMON_VAL_DOUBLE: appendDouble(out, cells[col].f64); break;
+            case HMON_VAL_BOOL:   out->push_back(cells[col].b ? '1' : '0'); break;
+            default: break;
+            }
+            out->push_back('\n');
+        }
+    }
+    if (!info) return;
+    appendTypeLine(out, key, "info");
+    for (uint32_t row = 0; row < table.row_count; ++row) {
+        const hmon_table_cell* cells = hmon_table_row_const(&table, row);
+        appendFamily(out, key, "info");
+        bool first = !appendRowLabels(out, table, row, keyed);
+        for (uint32_t col = 0; col < table.column_count; ++col) {
+            const hmon_table_column& column = table.columns[col];
+            if (column.type != HMON_VAL_STRING || isKeyColumn(table, col) || !cells[col].str) continue;
+            if (!first) out->push_back(',');
+            first = false;
+            appendName(out, column.name);
+            out->append("=\"");
+            appendLabelValue(out, cells[col].str);
+            out->push_back('"');
+        }
+        out->append("} 1\n");
+    }
+}
+
+/* Case-insensitive search for a header line's value; empty when absent. */
+std::string_view headerValue(std::string_view head, std::string_view name) {
+    size_t pos = head.find("\r\n");
+    while (pos != std::string_view::npos) {
+        pos += 2;
+        const size_t eol = head.find("\r\n", pos);
+        const std::string_view line = head.substr(pos, eol == std::string_view::npos ? std::string_view::npos : eol - pos);
+        if (line.size() > name.size() && line[name.size()] == ':' &&
+            strncasecmp(line.data(), name.data(), name.size()) == 0) {
+            std::string_view value = line.substr(name.size() + 1);
+            while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+            return value;
+        }
+        pos = eol;
+    }
+    return {};
+}
+
+bool containsNoCase(std::string_view haystack, std::string_view needle) {
+    if (needle.size() > haystack.size()) return false;
+    for (size_t i = 0; i + needle.size() <= haystack.size(); ++i) {
+        if (strncasecmp(haystack.data() + i, needle.data(), needle.size()) == 0) return true;
+    }
+    return false;
+}
+
+}
+
+void formatPrometheus(const PluginManager& pm, std::string* out) {
+    out->clear();
+    auto lock = pm.read_lock();
+    for (const auto& entry : pm.get_by_prefix("")) {
+        const hmon_metric_value& v = entry.value;
+        switch (v.type) {
+        case HMON_VAL_INT64:
+        case HMON_VAL_DOUBLE:
+        case HMON_VAL_BOOL:
+            appendTypeLine(out, entry.key);
+            appendFamily(out, entry.key);
+            out->push_back(' ');
+            if (v.type == HMON_VAL_INT64) appendInt(out, v.v.i64);
+            else if (v.type == HMON_VAL_DOUBLE) appendDouble(out, v.v.f64);
+            else out->push_back(v.v.b ? '1' : '0');
+            out->push_back('\n');
+            break;
+        case HMON_VAL_STRING:
+            appendTypeLine(out, entry.key, "info");
+            appendFamily(out, entry.key, "info");
+            out->append("{value=\"");
+            appendLabelValue(out, v.v.str ? v.v.str : "");
+            out->append("\"} 1\n");
+            break;
+        case HMON_VAL_TABLE:
+            if (v.v.table) appendTable(out, entry.key, *v.v.table);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+MetricsExporter::~MetricsExporter() {
+    for (auto& conn : connections_) {
+        if (conn.fd >= 0) ::close(conn.fd);
+    }
+    if (epoll_fd_ >= 0) ::close(epoll_fd_);
+    if (listen_fd_ >= 0) ::close(listen_fd_);
+}
+
+int MetricsExporter::listen(const std::string& address, uint16_t port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (!address.empty() && inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "[hmon] exporter: invalid listen address '" << address << "'\n";
+        return -1;
+    }
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        std::cerr << "[hmon] exporter: socket: " << std::strerror(errno) << "\n";
+        return -1;
+    }
+    const int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listen_fd_, 64) != 0) {
+        std::cerr << "[hmon] exporter: cannot listen on " << (address.empty() ? "*" : address) << ":" << port
+                  << ": " << std::strerror(errno) << "\n";
+        return -1;
+    }
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        std::cerr << "[hmon] exporter: epoll_create1: " << std::strerror(errno) << "\n";
+        return -1;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+    return 0;
+}
+
+void MetricsExporter::run(const std::atomic<bool>& running) {
+    epoll_event events[kMaxEvents];
+    while (running.load(std::memory_order_relaxed)) {
+        const int n = epoll_wait(epoll_fd_, events, kMaxEvents, kPollTimeoutMs);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "[hmon] exporter: epoll_wait: " << std::strerror(errno) << "\n";
+            return;
+        }
+        for (int i = 0; i < n; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == listen_fd_) {
+                accept_clients();
+                continue;
+            }
+            if (fd < 0 || static_cast<size_t>(fd) >= connections_.size() || connections_[fd].fd < 0) continue;
+            Connection* conn = &connections_[fd];
+            bool keep = !(events[i].events & (EPOLLERR | EPOLLHUP));
+            if (keep && (events[i].events & EPOLLIN)) keep = on_readable(conn);
+            if (keep && (events[i].events & EPOLLOUT)) keep = on_writable(conn);
+            if (!keep) close_connection(fd);
+        }
+    }
+}
+
+void MetricsExporter::accept_clients() {
+    while (true) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        if (static_cast<size_t>(fd) >= connections_.size()) connections_.resize(static_cast<size_t>(fd) + 1);
+        connections_[fd] = Connection{};
+        connections_[fd].fd = fd;
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) close_connection(fd);
+    }
+}
+
+bool MetricsExporter::on_readable(Connection* conn) {
+    char buf[4096];
+    while (true) {
+        const ssize_t n = recv(conn->fd, buf, sizeof(buf), 0);
+        if (n == 0) return false;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            return false;
+        }
+        conn->in.append(buf, static_cast<size_t>(n));
+        if (conn->in.size() > kMaxRequestBytes) return false;
+    }
+
+    /* Pipelined requests are answered in order; bodies are not expected on GET. */
+    size_t end;
+    while (!conn->close_after_write && (end = conn->in.find("\r\n\r\n")) != std::string::npos) {
+        handle_request(conn, conn->in.substr(0, end + 2));
+        conn->in.erase(0, end + 4);
+    }
+    return on_writable(conn);
+}
+
+bool MetricsExporter::on_writable(Connection* conn) {
+    while (conn->out_pos < conn->out.size()) {
+        const ssize_t n = send(conn->fd, conn->out.data() + conn->out_pos, conn->out.size() - conn->out_pos, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLOUT;
+            ev.data.fd = conn->fd;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn->fd, &ev);
+            return true;
+        }
+        conn->out_pos += static_cast<size_t>(n);
+    }
+    conn->out.clear();
+    conn->out_pos = 0;
+    if (conn->close_after_write) return false;
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = conn->fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn->fd, &ev);
+    return true;
+}
+
+void MetricsExporter::handle_request(Connection* conn, const std::string& head) {
+    const std::string_view request(head);
+    const size_t method_end = request.find(' ');
+    const size_t target_end = method_end == std::string_view::npos ? method_end : request.find(' ', method_end + 1);
+    const size_t line_end = request.find("\r\n");
+    if (target_end == std::string_view::npos || target_end > line_end) {
+        conn->out.append("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        conn->close_after_write = true;
+        return;
+    }
+    const std::string_view method = request.substr(0, method_end);
+    std::string_view target = request.substr(method_end + 1, target_end - method_end - 1);
+    target = target.substr(0, target.find('?'));
+    const std::string_view version = request.substr(target_end + 1, line_end - target_end - 1);
+
+    const std::string_view connection = headerValue(request, "Connection");
+    conn->close_after_write = version == "HTTP/1.0" ? !containsNoCase(connection, "keep-alive")
+                                                    : containsNoCase(connection, "close");
+
+    std::string_view status = "200 OK";
+    std::string_view content_type = kTextContentType;
+    std::string_view body;
+    bool openmetrics = false;
+    if (method != "GET" && method != "HEAD") {
+        status = "405 Method Not Allowed";
+        body = "Only GET is supported.\n";
+    } else if (target == "/metrics") {
+        openmetrics = containsNoCase(headerValue(request, "Accept"), "application/openmetrics-text");
+        if (openmetrics) content_type = kOpenMetricsContentType;
+        body = exposition();
+    } else if (target == "/") {
+        body = "hmon exporter: metrics at /metrics\n";
+    } else {
+        status = "404 Not Found";
+        body = "Not found.\n";
+    }
+
+    const std::string_view trailer = openmetrics ? "# EOF\n" : "";
+    std::string& out = conn->out;
+    out.append("HTTP/1.1 ").append(status).append("\r\nContent-Type: ").append(content_type);
+    out.append("\r\nContent-Length: ");
+    appendInt(&out, static_cast<int64_t>(body.size() + trailer.size()));
+    out.append(conn->close_after_write ? "\r\nConnection: close\r\n\r\n" : "\r\n\r\n");
+    if (method != "HEAD") out.append(body).append(trailer);
+}
+
+const std::string& MetricsExporter::exposition() {
+    const uint64_t generation = pm_.generation();
+    if (generation != body_generation_) {
+        formatPrometheus(pm_, &body_);
+        body_generation_ = generation;
+    }
+    return body_;
+}
+
+void MetricsExporter::close_connection(int fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections_[fd] = Connection{};
+}
+
+} /* namespace hmon::core */
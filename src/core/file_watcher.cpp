@@ -0,0 +1,134 @@
+#include "hmon/file_watcher.hpp"
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <string>
+#include <vector>
+
+namespace hmon::core {
+
+namespace {
+
+constexpr uint32_t kFileMask = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF;
+constexpr uint32_t kDirMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB |
+                              IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+constexpr uint32_t kAncestorMask = IN_CREATE | IN_MOVED_TO | IN_ONLYDIR;
+
+std::string parentOf(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos) return "";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+}
+
+FileWatcher::FileWatcher() : fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {}
+
+FileWatcher::~FileWatcher() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool FileWatcher::watch(const std::string& path) {
+    if (fd_ < 0 || path.empty()) return false;
+    return arm(path);
+}
+
+/* Watch `path` itself, or else its nearest existing ancestor until it shows up. */
+bool FileWatcher::arm(const std::string& path) {
+    struct stat st {};
+    if (stat(path.c_str(), &st) == 0) {
+        const uint32_t mask = S_ISDIR(st.st_mode) ? kDirMask : kFileMask;
+        /* IN_MASK_ADD: the inode may already be watched as an ancestor of something else. */
+        const int wd = inotify_add_watch(fd_, path.c_str(), mask | IN_MASK_ADD);
+        if (wd >= 0) {
+            Watch& w = watches_[wd];
+            w.path = path;
+            w.wanted = true;
+            return true;
+        }
+        if (errno == EACCES) return false;
+    }
+    pending_.push_back(path);
+    for (std::string dir = parentOf(path); !dir.empty(); dir = dir == "/" ? "" : parentOf(dir)) {
+        const int wd = inotify_add_watch(fd_, dir.c_str(), kAncestorMask | IN_MASK_ADD);
+        if (wd < 0) continue;
+        Watch& w = watches_[wd];
+        if (w.path.empty()) w.path = dir;
+        break;
+    }
+    return false;
+}
+
+void FileWatcher::armPending(std::vector<std::string>* out) {
+    std::vector<std::string> retry;
+    retry.swap(pending_);
+    for (const auto& path : retry) {
+        if (arm(path)) out->push_back(path);
+    }
+    if (!pending_.empty()) return;
+    /* Nothing left to wait for: drop the ancestor-only watches. */
+    for (auto it = watches_.begin(); it != watches_.end();) {
+        if (it->second.wanted) { ++it; continue; }
+        inotify_rm_watch(fd_, it->first);
+        it = watches_.erase(it);
+    }
+}
+
+std::vector<std::string> FileWatcher::changes(bool* overflow) {
+    std::vector<std::string> out;
+    if (overflow) *overflow = false;
+    if (fd_ < 0) return out;
+
+    bool structural = false;
+    alignas(inotify_event) char buf[8192];
+    while (true) {
+        const ssize_t n = ::read(fd_, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        for (ssize_t off = 0; off + static_cast<ssize_t>(sizeof(inotify_event)) <= n;) {
+            const auto* ev = reinterpret_cast<const inotify_event*>(buf + off);
+            off += static_cast<ssize_t>(sizeof(inotify_event) + ev->len);
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                if (overflow) *overflow = true;
+                continue;
+            }
+            auto it = watches_.find(ev->wd);
+            if (it == watches_.end()) continue;
+            const Watch& w = it->second;
+
+            if (ev->mask & IN_IGNORED) {
+                /* Deleted, unmounted or replaced: report it and wait for the path to come back. */
+                if (w.wanted) {
+                    out.push_back(w.path);
+                    pending_.push_back(w.path);
+                }
+                watches_.erase(it);
+                structural = true;
+                continue;
+            }
+            if (ev->mask & IN_MOVE_SELF) {
+                /* The watch would follow the inode elsewhere; drop it and re-arm the path (IN_IGNORED follows). */
+                inotify_rm_watch(fd_, ev->wd);
+                continue;
+            }
+            if (ev->len > 0) {
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO)) structural = true;
+                if (w.wanted) out.push_back(w.path + "/" + ev->name);
+            } else if (w.wanted && !(ev->mask & IN_DELETE_SELF)) {
+                out.push_back(w.path);
+            }
+        }
+    }
+    if (structural && !pending_.empty()) armPending(&out);
+
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+} /* namespace hmon::core */
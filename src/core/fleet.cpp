@@ -0,0 +1,421 @@
+#include "hmon/fleet.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace hmon::core {
+
+namespace {
+
+constexpr char kFleetMagic[4] = {'H', 'M', 'F', '1'};
+constexpr uint32_t kFleetVersion = 1;
+constexpr size_t kMaxHelloBytes = 4096;
+constexpr uint64_t kMaxFrameBytes = 64u * 1024 * 1024;
+constexpr size_t kReadBurstBytes = 1024 * 1024;
+constexpr int kMaxEvents = 64;
+constexpr int kPollTimeoutMs = 500;
+constexpr int kConnectTimeoutMs = 3000;
+constexpr auto kMinBackoff = std::chrono::seconds(1);
+constexpr auto kMaxBackoff = std::chrono::seconds(30);
+
+bool isUnixTarget(const std::string& target) {
+    return target.find('/') != std::string::npos;
+}
+
+bool unixAddress(const std::string& path, sockaddr_un* addr) {
+    if (path.size() >= sizeof(addr->sun_path)) return false;
+    *addr = sockaddr_un{};
+    addr->sun_family = AF_UNIX;
+    std::memcpy(addr->sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/* Blocking connect bounded by kConnectTimeoutMs; the socket is left blocking. */
+int connectBounded(int family, const sockaddr* addr, socklen_t len, std::string* error) {
+    const int fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        *error = std::strerror(errno);
+        return -1;
+    }
+    if (::connect(fd, addr, len) != 0) {
+        if (errno != EINPROGRESS && errno != EAGAIN) {
+            *error = std::strerror(errno);
+            ::close(fd);
+            return -1;
+        }
+        pollfd pfd{fd, POLLOUT, 0};
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+        if (poll(&pfd, 1, kConnectTimeoutMs) != 1) err = ETIMEDOUT;
+        else getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+        if (err != 0) {
+            *error = std::strerror(err);
+            ::close(fd);
+            return -1;
+        }
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    /* A viewer that stops reading must not stall collection for long. */
+    timeval send_timeout{5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+    if (family != AF_UNIX) {
+        const int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+    }
+    return fd;
+}
+
+int openConnection(const std::string& target, std::string* error) {
+    if (isUnixTarget(target)) {
+        sockaddr_un addr;
+        if (!unixAddress(target, &addr)) {
+            *error = "socket path too long";
+            return -1;
+        }
+        return connectBounded(AF_UNIX, reinterpret_cast<sockaddr*>(&addr), sizeof(addr), error);
+    }
+    const size_t colon = target.rfind(':');
+    if (colon == std::string::npos || colon == 0) {
+        *error = "expected host:port";
+        return -1;
+    }
+    std::string node = target.substr(0, colon);
+    if (node.size() > 2 && node.front() == '[' && node.back() == ']') node = node.substr(1, node.size() - 2);
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    if (const int rc = getaddrinfo(node.c_str(), target.c_str() + colon + 1, &hints, &found); rc != 0) {
+        *error = gai_strerror(rc);
+        return -1;
+    }
+    int fd = -1;
+    for (addrinfo* ai = found; ai && fd < 0; ai = ai->ai_next) {
+        fd = connectBounded(ai->ai_family, ai->ai_addr, ai->ai_addrlen, error);
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+bool sendAll(int fd, const std::string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        const ssize_t n = send(fd, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+}
+
+FleetAgent::~FleetAgent() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool FleetAgent::connect() {
+    if (fd_ >= 0) return true;
+    const auto now = std::chrono::steady_clock::now();
+    if (now < retry_at_) return false;
+
+    std::string error;
+    fd_ = openConnection(target_, &error);
+    if (fd_ < 0) {
+        backoff_ = std::clamp<std::chrono::milliseconds>(backoff_ * 2, kMinBackoff, kMaxBackoff);
+        retry_at_ = now + backoff_;
+        if (report_ && !reported_down_) {
+            std::cerr << "[hmon] push: cannot reach " << target_ << ": " << error << "; retrying\n";
+        }
+        reported_down_ = true;
+        return false;
+    }
+    if (report_) std::cerr << "[hmon] push: streaming to " << target_ << "\n";
+    backoff_ = std::chrono::milliseconds(0);
+    reported_down_ = false;
+    /* The viewer decodes each connection from scratch. */
+    encoder_ = SnapshotEncoder{};
+    frames_since_key_ = kKeyFrameInterval;
+    out_.assign(kFleetMagic, sizeof(kFleetMagic));
+    putVarint(&out_, kFleetVersion);
+    putVarint(&out_, host_.size());
+    out_.append(host_);
+    return true;
+}
+
+void FleetAgent::encode(const MetricRegistry& registry, int64_t time_ms) {
+    if (fd_ < 0) return;
+    const bool key_frame = frames_since_key_ >= kKeyFrameInterval;
+    frames_since_key_ = key_frame ? 1 : frames_since_key_ + 1;
+    frame_.clear();
+    encoder_.encode(registry, time_ms, key_frame, &frame_);
+    putVarint(&out_, frame_.size());
+    out_.append(frame_);
+}
+
+int FleetAgent::flush() {
+    if (fd_ < 0) return -1;
+    const bool sent = sendAll(fd_, out_);
+    out_.clear();
+    if (sent) return 0;
+    if (report_) std::cerr << "[hmon] push: lost " << target_ << ": " << std::strerror(errno) << "\n";
+    disconnect();
+    return -1;
+}
+
+void FleetAgent::disconnect() {
+    ::close(fd_);
+    fd_ = -1;
+    backoff_ = std::chrono::milliseconds(0);
+    retry_at_ = std::chrono::steady_clock::now() + kMinBackoff;
+}
+
+FleetServer::~FleetServer() {
+    for (auto& conn : connections_) {
+        if (conn.fd >= 0) ::close(conn.fd);
+    }
+    if (epoll_fd_ >= 0) ::close(epoll_fd_);
+    if (listen_fd_ >= 0) ::close(listen_fd_);
+    if (!unix_path_.empty()) unlink(unix_path_.c_str());
+}
+
+int FleetServer::listen(const std::string& target) {
+    if (isUnixTarget(target)) {
+        sockaddr_un addr;
+        if (!unixAddress(target, &addr)) {
+            std::cerr << "[hmon] fleet: socket path too long: " << target << "\n";
+            return -1;
+        }
+        listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        /* A socket file left by an earlier viewer would make bind() fail; never remove anything else. */
+        struct stat st{};
+        if (lstat(target.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(target.c_str());
+        if (listen_fd_ < 0 || bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listen_fd_, 64) != 0) {
+            std::cerr << "[hmon] fleet: cannot listen on " << target << ": " << std::strerror(errno) << "\n";
+            return -1;
+        }
+        unix_path_ = target;
+    } else {
+        const size_t colon = target.rfind(':');
+        const std::string address = colon == std::string::npos ? std::string() : target.substr(0, colon);
+        const std::string port = colon == std::string::npos ? target : target.substr(colon + 1);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(std::atoi(port.c_str())));
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (!address.empty() && inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+            std::cerr << "[hmon] fleet: invalid listen address '" << address << "'\n";
+            return -1;
+        }
+        listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            std::cerr << "[hmon] fleet: socket: " << std::strerror(errno) << "\n";
+            return -1;
+        }
+        const int one = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listen_fd_, 64) != 0) {
+            std::cerr << "[hmon] fleet: cannot listen on " << (address.empty() ? "*" : address) << ":" << port
+                      << ": " << std::strerror(errno) << "\n";
+            return -1;
+        }
+    }
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        std::cerr << "[hmon] fleet: epoll_create1: " << std::strerror(errno) << "\n";
+        return -1;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+    return 0;
+}
+
+void FleetServer::run(const std::atomic<bool>& running) {
+    epoll_event events[kMaxEvents];
+    while (running.load(std::memory_order_relaxed)) {
+        const int n = epoll_wait(epoll_fd_, events, kMaxEvents, kPollTimeoutMs);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        for (int i = 0; i < n; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == listen_fd_) {
+                accept_clients();
+                continue;
+            }
+            if (fd < 0 || static_cast<size_t>(fd) >= connections_.size() || connections_[fd].fd < 0) continue;
+            Connection* conn = &connections_[fd];
+            /* Read first even on HUP so a final frame sent before closing still lands. */
+            bool keep = true;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) keep = on_readable(conn);
+            if (!keep) close_connection(fd);
+        }
+    }
+}
+
+std::vector<FleetServer::Host*> FleetServer::hosts() const {
+    std::lock_guard<std::mutex> lock(hosts_mutex_);
+    std::vector<Host*> out;
+    out.reserve(hosts_.size());
+    for (const auto& host : hosts_) out.push_back(host.get());
+    return out;
+}
+
+void FleetServer::accept_clients() {
+    while (true) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        if (static_cast<size_t>(fd) >= connections_.size()) connections_.resize(static_cast<size_t>(fd) + 1);
+        connections_[fd] = Connection{};
+        connections_[fd].fd = fd;
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) close_connection(fd);
+    }
+}
+
+bool FleetServer::on_readable(Connection* conn) {
+    char buf[65536];
+    bool open = true;
+    while (true) {
+        const ssize_t n = recv(conn->fd, buf, sizeof(buf), 0);
+        if (n == 0) { open = false; break; }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            open = false;
+            break;
+        }
+        conn->in.append(buf, static_cast<size_t>(n));
+        /* Decode what we have; level-triggered epoll brings us back for the rest. */
+        if (conn->in.size() - conn->in_pos >= kReadBurstBytes) break;
+    }
+
+    if (!conn->host && !parse_hello(conn)) return false;
+    if (!conn->host) return open && conn->in.size() <= kMaxHelloBytes;
+
+    const auto* data = reinterpret_cast<const uint8_t*>(conn->in.data());
+    const uint8_t* end = data + conn->in.size();
+    bool published = false;
+    while (true) {
+        const uint8_t* p = data + conn->in_pos;
+        uint64_t frame_size = 0;
+        const size_t used = readVarint(p, end, &frame_size);
+        if (used == 0) {
+            if (end - p >= 10) return false;    /* not a varint at all */
+            break;
+        }
+        if (frame_size == 0 || frame_size > kMaxFrameBytes) return false;
+        if (frame_size > static_cast<uint64_t>(end - p - used)) break;
+        if (!conn->decoder->decode(p + used, frame_size)) {
+            std::cerr << "[hmon] fleet: bad frame from " << conn->host->name << "\n";
+            return false;
+        }
+        conn->in_pos += used + frame_size;
+        published = true;
+    }
+    /* Only the newest state matters; publish once per read burst. */
+    if (published) {
+        conn->host->metrics.publish_source(conn->host->source, conn->decoder->list());
+        conn->host->last_frame_ms = nowMs();
+        conn->host->frames.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (conn->in_pos > 0 && conn->in_pos * 2 >= conn->in.size()) {
+        conn->in.erase(0, conn->in_pos);
+        conn->in_pos = 0;
+    }
+    return open;
+}
+
+/* true if the hello is complete and valid or still incomplete; false if it is not ours. */
+bool FleetServer::parse_hello(Connection* conn) {
+    const size_t have = std::min(conn->in.size(), sizeof(kFleetMagic));
+    if (std::memcmp(conn->in.data(), kFleetMagic, have) != 0) return false;
+    if (conn->in.size() < sizeof(kFleetMagic)) return true;
+
+    const auto* data = reinterpret_cast<const uint8_t*>(conn->in.data());
+    const uint8_t* end = data + conn->in.size();
+    const uint8_t* p = data + sizeof(kFleetMagic);
+    uint64_t version = 0, name_size = 0;
+    size_t used = readVarint(p, end, &version);
+    if (used == 0) return true;
+    if (version != kFleetVersion) {
+        std::cerr << "[hmon] fleet: agent speaks stream version " << version << ", expected " << kFleetVersion << "\n";
+        return false;
+    }
+    p += used;
+    used = readVarint(p, end, &name_size);
+    if (used == 0) return true;
+    p += used;
+    if (name_size == 0 || name_size > kMaxHelloBytes) return false;
+    if (name_size > static_cast<uint64_t>(end - p)) return true;
+
+    conn->host = claim_host(std::string(reinterpret_cast<const char*>(p), name_size), conn->fd);
+    conn->decoder = std::make_unique<SnapshotDecoder>();
+    conn->in_pos = static_cast<size_t>(p + name_size - data);
+    return true;
+}
+
+FleetServer::Host* FleetServer::claim_host(const std::string& name, int fd) {
+    /* A returning agent takes its old row back; one that shares a name with a live agent gets a row of its own. */
+    std::lock_guard<std::mutex> lock(hosts_mutex_);
+    Host* host = nullptr;
+    size_t same_name = 0;
+    for (auto& h : hosts_) {
+        if (h->agent != name) continue;
+        ++same_name;
+        if (!host && h->fd < 0) host = h.get();
+    }
+    if (!host) {
+        hosts_.push_back(std::make_unique<Host>());
+        host = hosts_.back().get();
+        host->agent = name;
+        host->name = same_name ? name + "#" + std::to_string(same_name + 1) : name;
+        host->source = host->metrics.add_source(name);
+    }
+    host->fd = fd;
+    host->connected = true;
+    return host;
+}
+
+void FleetServer::close_connection(int fd) {
+    Connection& conn = connections_[fd];
+    if (conn.host && conn.host->fd == fd) {
+        conn.host->fd = -1;
+        conn.host->connected = false;
+    }
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    conn = Connection{};
+}
+
+} /* namespace hmon::core */
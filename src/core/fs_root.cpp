@@ -0,0 +1,36 @@
+#include "hmon/fs_root.hpp"
+
+#include <cstdlib>
+
+namespace hmon::core {
+
+namespace {
+
+std::string fromEnv(const char* name, const char* fallback) {
+    const char* value = std::getenv(name);
+    std::string root = value && *value ? value : fallback;
+    while (root.size() > 1 && root.back() == '/') root.pop_back();
+    return root;
+}
+
+std::string& procStorage() {
+    static std::string root = fromEnv("HMON_PROC_ROOT", "/proc");
+    return root;
+}
+
+std::string& sysStorage() {
+    static std::string root = fromEnv("HMON_SYS_ROOT", "/sys");
+    return root;
+}
+
+}
+
+const std::string& procRoot() { return procStorage(); }
+const std::string& sysRoot() { return sysStorage(); }
+
+void setFsRoots(const std::string& proc, const std::string& sys) {
+    procStorage() = proc;
+    sysStorage() = sys;
+}
+
+} /* namespace hmon::core */
@@ -0,0 +1,137 @@
+#include "hmon/history.hpp"
+
+#include <algorithm>
+#include <istream>
+#include <ostream>
+
+namespace hmon::core {
+
+namespace {
+
+constexpr uint32_t kHistoryMagic = 0x53484d48; /* "HMHS" */
+/* 2: the filling bucket is saved as its accumulator, not as a closed point. */
+constexpr uint32_t kHistoryVersion = 2;
+
+template <typename T>
+void writePod(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool readPod(std::istream& in, T* value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(value), sizeof(*value)));
+}
+
+}
+
+void HistoryRing::reset(size_t capacity) {
+    points_.assign(capacity, HistoryPoint{});
+    head_ = 0;
+    size_ = 0;
+    pushed_ = 0;
+}
+
+void HistoryRing::push(const HistoryPoint& point) {
+    if (points_.empty()) return;
+    ++pushed_;
+    if (size_ < points_.size()) {
+        points_[(head_ + size_) % points_.size()] = point;
+        ++size_;
+    } else {
+        points_[head_] = point;
+        head_ = (head_ + 1) % points_.size();
+    }
+}
+
+HistoryPoint HistorySeries::Accumulator::point(int64_t period_ms) const {
+    HistoryPoint p;
+    p.time_ms = bucket * period_ms;
+    p.min = static_cast<float>(min);
+    p.max = static_cast<float>(max);
+    p.avg = static_cast<float>(count ? sum / count : 0.0);
+    return p;
+}
+
+HistorySeries::HistorySeries(size_t capacity) : raw_(capacity) {
+    for (auto& t : tiers_) t.reset(capacity);
+}
+
+void HistorySeries::append(double value, int64_t now_ms) {
+    raw_.push(HistoryPoint{now_ms, static_cast<float>(value), static_cast<float>(value), static_cast<float>(value)});
+    for (size_t t = 0; t < kTierCount; ++t) {
+        auto& acc = pending_[t];
+        const int64_t bucket = now_ms / kTierPeriodMs[t];
+        if (acc.count > 0 && bucket != acc.bucket) {
+            tiers_[t].push(acc.point(kTierPeriodMs[t]));
+            acc.count = 0;
+        }
+        if (acc.count == 0) {
+            acc.bucket = bucket;
+            acc.min = acc.max = value;
+            acc.sum = 0.0;
+        }
+        acc.min = std::min(acc.min, value);
+        acc.max = std::max(acc.max, value);
+        acc.sum += value;
+        ++acc.count;
+    }
+}
+
+std::optional<HistoryPoint> HistorySeries::pending(size_t tier) const {
+    if (tier >= kTierCount || pending_[tier].count == 0) return std::nullopt;
+    return pending_[tier].point(kTierPeriodMs[tier]);
+}
+
+std::optional<double> HistorySeries::last() const {
+    if (raw_.empty()) return std::nullopt;
+    return raw_.back().avg;
+}
+
+size_t HistorySeries::pick_tier(int64_t span_ms, size_t columns) const {
+    const int64_t per_column = span_ms / static_cast<int64_t>(std::max<size_t>(columns, 1));
+    for (size_t t = 0; t < kTierCount; ++t) {
+        const int64_t retained = kTierPeriodMs[t] * static_cast<int64_t>(tiers_[t].capacity());
+        if (kTierPeriodMs[t] >= per_column && retained >= span_ms) return t;
+    }
+    return kTierCount - 1;
+}
+
+void HistorySeries::write(std::ostream& out) const {
+    writePod(out, kHistoryMagic);
+    writePod(out, kHistoryVersion);
+    for (size_t t = 0; t < kTierCount; ++t) {
+        writePod(out, static_cast<uint32_t>(tiers_[t].size()));
+        for (size_t i = 0; i < tiers_[t].size(); ++i) writePod(out, tiers_[t][i]);
+        const Accumulator& acc = pending_[t];
+        writePod(out, acc.bucket);
+        writePod(out, acc.min);
+        writePod(out, acc.max);
+        writePod(out, acc.sum);
+        writePod(out, acc.count);
+    }
+}
+
+bool HistorySeries::read(std::istream& in) {
+    uint32_t magic = 0, version = 0;
+    if (!readPod(in, &magic) || !readPod(in, &version)) return false;
+    if (magic != kHistoryMagic || version != kHistoryVersion) return false;
+    for (size_t t = 0; t < kTierCount; ++t) {
+        uint32_t count = 0;
+        if (!readPod(in, &count)) return false;
+        for (uint32_t i = 0; i < count; ++i) {
+            HistoryPoint p;
+            if (!readPod(in, &p)) return false;
+            tiers_[t].push(p);
+        }
+        /* Restored still open, so a restart within the same period keeps filling it rather than closing it twice. */
+        Accumulator acc;
+        if (!readPod(in, &acc.bucket) || !readPod(in, &acc.min) || !readPod(in, &acc.max) || !readPod(in, &acc.sum) ||
+            !readPod(in, &acc.count)) {
+            return false;
+        }
+        pending_[t] = acc;
+    }
+    return true;
+}
+
+} /* namespace hmon::core */
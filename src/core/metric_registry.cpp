@@ -0,0 +1,181 @@
+#include "hmon/metric_registry.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace hmon::core {
+
+namespace {
+
+bool allDigits(std::string_view s) {
+    if (s.empty()) return false;
+    for (char c : s) {
+        if (c < '0' || c > '9') return false;
+    }
+    return true;
+}
+
+/*
+ * Three-way compare of one segment.  An empty segment sorts first (so a
+ * prefix lands before its keys), then all-digit segments by value, then by
+ * length so "01" != "1", then everything else bytewise.  Keeping the digit
+ * segments apart makes this a total order: "9" < "10" < "1a".
+ */
+int compareSegment(std::string_view a, std::string_view b) {
+    if (a.empty() || b.empty()) return a.empty() == b.empty() ? 0 : (a.empty() ? -1 : 1);
+    const bool na = allDigits(a), nb = allDigits(b);
+    if (na != nb) return na ? -1 : 1;
+    if (na) {
+        auto strip = [](std::string_view s) {
+            size_t nz = s.find_first_not_of('0');
+            return nz == std::string_view::npos ? s.substr(s.size() - 1) : s.substr(nz);
+        };
+        std::string_view sa = strip(a), sb = strip(b);
+        if (sa.size() != sb.size()) return sa.size() < sb.size() ? -1 : 1;
+        int c = sa.compare(sb);
+        if (c != 0) return c;
+        if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+    }
+    return a.compare(b);
+}
+
+}
+
+bool MetricRegistry::natural_less(std::string_view a, std::string_view b) {
+    while (true) {
+        size_t da = a.find('.');
+        size_t db = b.find('.');
+        int c = compareSegment(a.substr(0, da), b.substr(0, db));
+        if (c != 0) return c < 0;
+        if (da == std::string_view::npos || db == std::string_view::npos) {
+            return da == std::string_view::npos && db != std::string_view::npos;
+        }
+        a.remove_prefix(da + 1);
+        b.remove_prefix(db + 1);
+    }
+}
+
+MetricRegistry::OwnerId MetricRegistry::add_owner() {
+    /* Generation 0 is never "current", so fresh slots start out absent. */
+    owner_generation_.push_back(1);
+    return static_cast<OwnerId>(owner_generation_.size() - 1);
+}
+
+MetricId MetricRegistry::intern(std::string_view key) {
+    auto it = index_.find(key);
+    if (it != index_.end()) return it->second;
+    auto id = static_cast<MetricId>(keys_.size());
+    keys_.emplace_back(key);
+    slots_.emplace_back();
+    index_.emplace(keys_.back(), id);
+    /* New keys are rare once warm, so keeping the order index sorted on insert is cheap. */
+    auto pos = std::upper_bound(ordered_.begin(), ordered_.end(), key,
+                                [this](std::string_view k, MetricId other) { return natural_less(k, keys_[other]); });
+    ordered_.insert(pos, id);
+    return id;
+}
+
+MetricId MetricRegistry::find(std::string_view key) const {
+    auto it = index_.find(key);
+    return it != index_.end() ? it->second : kInvalidMetricId;
+}
+
+void MetricRegistry::begin_publish(OwnerId owner) {
+    if (owner < owner_generation_.size()) ++owner_generation_[owner];
+}
+
+void MetricRegistry::set(MetricId id, OwnerId owner, const hmon_metric_value& value) {
+    if (id >= slots_.size() || owner >= owner_generation_.size()) return;
+    auto& slot = slots_[id];
+    slot.value = value;
+    if (value.type == HMON_VAL_STRING) {
+        slot.str.assign(value.v.str ? value.v.str : "");
+        slot.value.v.str = nullptr;
+    } else if (value.type == HMON_VAL_TABLE) {
+        if (!slot.table) slot.table = std::make_unique<TableCopy>();
+        if (value.v.table) copy_table(slot.table.get(), *value.v.table);
+        else copy_table(slot.table.get(), hmon_table{});
+        slot.value.v.table = nullptr;
+    }
+    slot.owner = owner;
+    slot.generation = owner_generation_[owner];
+}
+
+bool MetricRegistry::present(MetricId id) const {
+    if (id >= slots_.size()) return false;
+    const auto& slot = slots_[id];
+    return slot.generation != 0 && slot.generation == owner_generation_[slot.owner];
+}
+
+hmon_metric_value MetricRegistry::value(MetricId id) const {
+    hmon_metric_value v = slots_[id].value;
+    if (v.type == HMON_VAL_STRING) v.v.str = slots_[id].str.c_str();
+    else if (v.type == HMON_VAL_TABLE) v.v.table = &slots_[id].table->table;
+    return v;
+}
+
+void MetricRegistry::copy_table(TableCopy* dst, const hmon_table& src) {
+    /* The schema is normally identical tick to tick; only re-copy names when it changes. */
+    bool same_schema = dst->columns.size() == src.column_count;
+    for (uint32_t c = 0; same_schema && c < src.column_count; ++c) {
+        same_schema = dst->columns[c].type == src.columns[c].type && src.columns[c].name
+                   && dst->names[c] == src.columns[c].name;
+    }
+    if (!same_schema) {
+        dst->names.resize(src.column_count);
+        dst->columns.resize(src.column_count);
+        for (uint32_t c = 0; c < src.column_count; ++c) {
+            dst->names[c] = src.columns[c].name ? src.columns[c].name : "";
+            dst->columns[c].type = src.columns[c].type;
+        }
+        for (uint32_t c = 0; c < src.column_count; ++c) dst->columns[c].name = dst->names[c].c_str();
+    }
+
+    size_t n = static_cast<size_t>(src.row_count) * src.column_count;
+    dst->cells.assign(src.cells, src.cells + (src.cells ? n : 0));
+    if (!src.cells) dst->cells.resize(n);
+
+    /* String cells are packed into one buffer; offsets first, pointers once it stops growing. */
+    dst->strings.clear();
+    for (uint32_t c = 0; c < src.column_count; ++c) {
+        if (dst->columns[c].type != HMON_VAL_STRING) continue;
+        for (uint32_t r = 0; r < src.row_count; ++r) {
+            auto& cell = dst->cells[static_cast<size_t>(r) * src.column_count + c];
+            if (!cell.str) { cell.i64 = -1; continue; }
+            size_t off = dst->strings.size();
+            dst->strings.append(cell.str, std::strlen(cell.str) + 1);
+            cell.i64 = static_cast<int64_t>(off);
+        }
+    }
+    for (uint32_t c = 0; c < src.column_count; ++c) {
+        if (dst->columns[c].type != HMON_VAL_STRING) continue;
+        for (uint32_t r = 0; r < src.row_count; ++r) {
+            auto& cell = dst->cells[static_cast<size_t>(r) * src.column_count + c];
+            cell.str = cell.i64 < 0 ? nullptr : dst->strings.data() + cell.i64;
+        }
+    }
+
+    dst->table.columns = dst->columns.data();
+    dst->table.column_count = src.column_count;
+    dst->table.row_count = src.row_count;
+    dst->table.cells = dst->cells.data();
+}
+
+MetricRegistry::PrefixView MetricRegistry::prefix(std::string_view prefix) const {
+    auto first = std::lower_bound(ordered_.begin(), ordered_.end(), prefix,
+                                  [this](MetricId id, std::string_view p) { return natural_less(keys_[id], p); });
+    auto last = first;
+    while (last != ordered_.end() && keys_[*last].compare(0, prefix.size(), prefix) == 0) ++last;
+    const MetricId* base = ordered_.data();
+    return PrefixView(this, base + (first - ordered_.begin()), base + (last - ordered_.begin()));
+}
+
+void MetricRegistry::clear() {
+    keys_.clear();
+    slots_.clear();
+    ordered_.clear();
+    index_.clear();
+    owner_generation_.clear();
+}
+
+} /* namespace hmon::core */
@@ -0,0 +1,55 @@
+#include "hmon/numa.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+#include "hmon/fs_root.hpp"
+
+namespace hmon::core {
+
+std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        int lo = 0, hi = 0;
+        const std::string part = list.substr(pos, end - pos);
+        const int n = std::sscanf(part.c_str(), "%d-%d", &lo, &hi);
+        if (n == 1) hi = lo;
+        if (n >= 1 && lo >= 0 && hi >= lo) {
+            for (int c = lo; c <= hi; ++c) cpus.push_back(c);
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+std::vector<NumaNode> readNumaNodes() {
+    namespace fs = std::filesystem;
+    std::vector<NumaNode> nodes;
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator(sysRoot() + "/devices/system/node", ec)) {
+        const std::string name = e.path().filename().string();
+        if (name.size() < 5 || name.compare(0, 4, "node") != 0 ||
+            name.find_first_not_of("0123456789", 4) != std::string::npos) {
+            continue;
+        }
+        NumaNode node;
+        node.id = std::atoi(name.c_str() + 4);
+        std::ifstream in(e.path() / "cpulist");
+        std::getline(in, node.cpulist);
+        while (!node.cpulist.empty() && (node.cpulist.back() == ' ' || node.cpulist.back() == '\n')) {
+            node.cpulist.pop_back();
+        }
+        node.cpus = parseCpuList(node.cpulist);
+        nodes.push_back(std::move(node));
+    }
+    std::sort(nodes.begin(), nodes.end(), [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+    return nodes;
+}
+
+} /* namespace hmon::core */
@@ -0,0 +1,339 @@
+#include "hmon/plugin_manager.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+/*
+ * Host <-> helper protocol, over one socketpair on the helper's stdin and
+ * stdout.  The host sends 'C' (collect), 'K' <u8 length> <key> <i32>
+ * (control) or 'S' <u8 length> <key> <u16 length> <text> (string control).  The helper answers init once and every 'C' with a message:
+ * <u32 length> <i8 status> [SnapshotEncoder frame of its registry]: status
+ * is kReplyOk, kReplyAbsent (collect returned HMON_COLLECT_ABSENT) or
+ * kReplyFailed, and the frame is sent with the first two.
+ */
+
+namespace hmon::core {
+
+namespace {
+
+constexpr auto kHelperStartTimeout = std::chrono::seconds(5);
+
+constexpr int8_t kReplyOk = 0;
+constexpr int8_t kReplyAbsent = 1;
+constexpr int8_t kReplyFailed = -1;
+constexpr auto kRestartDelay = std::chrono::seconds(1);
+constexpr auto kMaxRestartDelay = std::chrono::seconds(60);
+/* How long a helper gets to exit on its own once its socket closes. */
+constexpr auto kExitGrace = std::chrono::milliseconds(200);
+constexpr uint32_t kMaxReply = 64u << 20;
+
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t n = ::write(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool readAll(int fd, void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        const ssize_t n = ::read(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool sendReply(int fd, int8_t rc, const std::string& frame) {
+    std::string out(5, '\0');
+    const auto len = static_cast<uint32_t>(frame.size() + 1);
+    std::memcpy(out.data(), &len, 4);
+    out[4] = static_cast<char>(rc);
+    out += frame;
+    return writeAll(fd, out.data(), out.size());
+}
+
+/* Read `size` bytes from a non-blocking fd by `deadline`. */
+bool readBy(int fd, char* data, size_t size, std::chrono::steady_clock::time_point deadline) {
+    while (size > 0) {
+        const ssize_t n = ::recv(fd, data, size, 0);
+        if (n > 0) {
+            data += n;
+            size -= static_cast<size_t>(n);
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EINTR)) return false;
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0) return false;
+        pollfd p{fd, POLLIN, 0};
+        if (::poll(&p, 1, static_cast<int>(left.count()) + 1) < 0 && errno != EINTR) return false;
+    }
+    return true;
+}
+
+bool readReply(int fd, std::string* out, std::chrono::steady_clock::time_point deadline) {
+    uint32_t len = 0;
+    if (!readBy(fd, reinterpret_cast<char*>(&len), 4, deadline) || len == 0 || len > kMaxReply) return false;
+    out->resize(len);
+    return readBy(fd, out->data(), len, deadline);
+}
+
+void reap(std::vector<int>* pids) {
+    pids->erase(std::remove_if(pids->begin(), pids->end(), [](int pid) { return ::waitpid(pid, nullptr, WNOHANG) != 0; }),
+                pids->end());
+}
+
+int64_t steadyMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+bool PluginManager::isolate(const std::string& name, std::chrono::milliseconds deadline) {
+    for (auto& plugin : plugins_) {
+        if (plugin.name != name || plugin.ctx || !plugin.init) continue;
+        if (!plugin.helper) plugin.helper = std::make_unique<Helper>();
+        plugin.helper->deadline = deadline;
+        /* The plugin's fds live in the helper; a parent cannot poll them. */
+        plugin.event_fd_fn = nullptr;
+        return true;
+    }
+    return false;
+}
+
+bool PluginManager::spawn_helper(Plugin& plugin) {
+    Helper& h = *plugin.helper;
+    reap(&h.exited);
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) return false;
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    std::string target = plugin.path == "<static>" ? plugin.name : plugin.path;
+    char arg0[] = "hmon";
+    char flag[] = "--plugin-helper";
+    char* argv[] = {arg0, flag, target.data(), nullptr};
+    pid_t pid = -1;
+    const int rc = ::posix_spawn(&pid, "/proc/self/exe", &actions, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(fds[1]);
+    if (rc != 0) {
+        ::close(fds[0]);
+        return false;
+    }
+    ::fcntl(fds[0], F_SETFL, ::fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    std::lock_guard<std::mutex> lock(h.mutex);
+    h.pid = pid;
+    h.fd = fds[0];
+    h.ready = false;
+    h.decoder = SnapshotDecoder();
+    for (const auto& [key, value] : h.controls) forward_control_locked(h, key, value);
+    for (const auto& [key, value] : h.str_controls) forward_control_str_locked(h, key, value);
+    return true;
+}
+
+void PluginManager::stop_helper(Plugin& plugin, bool kill) {
+    Helper& h = *plugin.helper;
+    int fd;
+    {
+        std::lock_guard<std::mutex> lock(h.mutex);
+        fd = h.fd;
+        h.fd = -1;
+    }
+    if (fd >= 0) ::close(fd);
+    if (h.pid > 0) {
+        /* EOF on its socket ends a healthy helper; a wedged one is killed, and reaped later if it is stuck in the kernel. */
+        const auto grace = std::chrono::steady_clock::now() + (kill ? std::chrono::milliseconds(0) : kExitGrace);
+        int waited = ::waitpid(h.pid, nullptr, WNOHANG);
+        while (waited == 0 && std::chrono::steady_clock::now() < grace) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            waited = ::waitpid(h.pid, nullptr, WNOHANG);
+        }
+        if (waited == 0) {
+            ::kill(h.pid, SIGKILL);
+            if (::waitpid(h.pid, nullptr, WNOHANG) == 0) h.exited.push_back(h.pid);
+        }
+    }
+    h.pid = -1;
+    h.ready = false;
+    reap(&h.exited);
+}
+
+void PluginManager::forward_control(Helper& helper, const char* key, int value) {
+    if (!key) return;
+    std::lock_guard<std::mutex> lock(helper.mutex);
+    auto it = std::find_if(helper.controls.begin(), helper.controls.end(),
+                           [&](const auto& c) { return c.first == key; });
+    if (it != helper.controls.end()) it->second = value;
+    else helper.controls.emplace_back(key, value);
+    forward_control_locked(helper, key, value);
+}
+
+/* Best effort: a helper too wedged to drain its socket gets the latest value when it is restarted. */
+void PluginManager::forward_control_locked(Helper& helper, const std::string& key, int value) {
+    if (helper.fd < 0 || key.size() > 255) return;
+    std::string msg = "K";
+    msg.push_back(static_cast<char>(key.size()));
+    msg += key;
+    const auto v = static_cast<int32_t>(value);
+    msg.append(reinterpret_cast<const char*>(&v), sizeof(v));
+    (void)::send(helper.fd, msg.data(), msg.size(), MSG_NOSIGNAL);
+}
+
+void PluginManager::forward_control_str(Helper& helper, const char* key, const std::string& value) {
+    if (!key) return;
+    std::lock_guard<std::mutex> lock(helper.mutex);
+    auto it = std::find_if(helper.str_controls.begin(), helper.str_controls.end(),
+                           [&](const auto& c) { return c.first == key; });
+    if (it != helper.str_controls.end()) it->second = value;
+    else helper.str_controls.emplace_back(key, value);
+    forward_control_str_locked(helper, key, value);
+}
+
+void PluginManager::forward_control_str_locked(Helper& helper, const std::string& key, const std::string& value) {
+    if (helper.fd < 0 || key.size() > 255 || value.size() > 65535) return;
+    std::string msg = "S";
+    msg.push_back(static_cast<char>(key.size()));
+    msg += key;
+    const auto len = static_cast<uint16_t>(value.size());
+    msg.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    msg += value;
+    (void)::send(helper.fd, msg.data(), msg.size(), MSG_NOSIGNAL);
+}
+
+int PluginManager::collect_isolated(Plugin& plugin) {
+    Helper& h = *plugin.helper;
+    PluginStats& st = *plugin.stats;
+    plugin.list = hmon_metric_list{};
+    plugin.arena = hmon_arena{};
+    const auto now = std::chrono::steady_clock::now();
+    /* Whatever was published last stays in the registry; the plugin is only flagged. */
+    auto fail = [&]() {
+        stop_helper(plugin, true);
+        ++h.failures;
+        h.retry_at = now + std::min<std::chrono::steady_clock::duration>(kMaxRestartDelay,
+                                                                         kRestartDelay * (1 << std::min(h.failures - 1, 6)));
+        st.stale.store(true, std::memory_order_relaxed);
+        return -1;
+    };
+
+    if (h.pid < 0) {
+        if (now < h.retry_at) {
+            st.stale.store(true, std::memory_order_relaxed);
+            return -1;
+        }
+        if (!spawn_helper(plugin)) return fail();
+    }
+    if (!h.ready) {
+        if (!readReply(h.fd, &h.reply, now + kHelperStartTimeout) || h.reply[0] != kReplyOk) return fail();
+        h.ready = true;
+    }
+    const auto deadline = h.deadline.count() > 0 ? h.deadline
+                                                 : std::max<std::chrono::milliseconds>(plugin.base_interval, std::chrono::seconds(1));
+    bool sent;
+    {
+        std::lock_guard<std::mutex> lock(h.mutex);
+        sent = ::send(h.fd, "C", 1, MSG_NOSIGNAL) == 1;
+    }
+    if (!sent || !readReply(h.fd, &h.reply, std::chrono::steady_clock::now() + deadline)) return fail();
+
+    h.failures = 0;
+    const auto status = static_cast<int8_t>(h.reply[0]);
+    if (status != kReplyOk && status != kReplyAbsent) return -1;
+    if (!h.decoder.decode(reinterpret_cast<const uint8_t*>(h.reply.data()) + 1, h.reply.size() - 1)) return fail();
+    plugin.list = h.decoder.list();
+    st.stale.store(false, std::memory_order_relaxed);
+    return status == kReplyAbsent ? HMON_COLLECT_ABSENT : 0;
+}
+
+int PluginManager::run_helper(const std::string& name) {
+    /* Die with the host; if it is already gone, there is no one to serve. */
+    ::prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (::getppid() == 1) return 1;
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, SIG_IGN);
+
+    PluginManager pm;
+    if (name.find('/') != std::string::npos) {
+        if (pm.load(name) != 0) return 1;
+    } else {
+        pm.load_static();
+        pm.plugins_.erase(std::remove_if(pm.plugins_.begin(), pm.plugins_.end(),
+                                         [&](const Plugin& p) { return p.name != name; }),
+                          pm.plugins_.end());
+    }
+    if (pm.plugins_.size() != 1 || !pm.plugins_[0].init) {
+        std::cerr << "[hmon] plugin helper: no plugin \"" << name << "\"\n";
+        return 1;
+    }
+    Plugin& plugin = pm.plugins_[0];
+    const int init_rc = plugin.init(&plugin.ctx);
+    if (!sendReply(STDOUT_FILENO, init_rc == 0 ? kReplyOk : kReplyFailed, {}) || init_rc != 0) return 1;
+
+    SnapshotEncoder encoder;
+    std::string frame;
+    bool key_frame = true;
+    while (true) {
+        char cmd = 0;
+        if (!readAll(STDIN_FILENO, &cmd, 1)) break;
+        if (cmd == 'K') {
+            uint8_t len = 0;
+            int32_t value = 0;
+            std::string key;
+            if (!readAll(STDIN_FILENO, &len, 1)) break;
+            key.resize(len);
+            if (!readAll(STDIN_FILENO, key.data(), len) || !readAll(STDIN_FILENO, &value, sizeof(value))) break;
+            if (plugin.control_fn) plugin.control_fn(key.c_str(), value);
+            continue;
+        }
+        if (cmd == 'S') {
+            uint8_t len = 0;
+            uint16_t value_len = 0;
+            std::string key, value;
+            if (!readAll(STDIN_FILENO, &len, 1)) break;
+            key.resize(len);
+            if (!readAll(STDIN_FILENO, key.data(), len) || !readAll(STDIN_FILENO, &value_len, sizeof(value_len))) break;
+            value.resize(value_len);
+            if (!readAll(STDIN_FILENO, value.data(), value_len)) break;
+            if (plugin.control_str_fn) plugin.control_str_fn(key.c_str(), value.c_str());
+            continue;
+        }
+        if (cmd != 'C') break;
+        const int rc = pm.collect_into(plugin);
+        const bool ok = rc == 0 || rc == HMON_COLLECT_ABSENT;
+        frame.clear();
+        if (ok) {
+            pm.publish(plugin, plugin.list);
+            encoder.encode(pm.registry_, steadyMs(), key_frame, &frame);
+            key_frame = false;
+        }
+        const int8_t status = !ok ? kReplyFailed : rc == HMON_COLLECT_ABSENT ? kReplyAbsent : kReplyOk;
+        if (!sendReply(STDOUT_FILENO, status, frame)) break;
+    }
+    return 0;
+}
+
+}
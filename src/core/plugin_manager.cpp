@@ -1,15 +1,150 @@
 #include "hmon/plugin_manager.hpp"
 
 #include <algorithm>
+#include <ctime>
 #include <dlfcn.h>
 #include <dirent.h>
 #include <cstring>
 #include <iostream>
+#include <poll.h>
 #include <string>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 #include <vector>
 
+#include "hmon/alerts.hpp"
+#include "hmon/alloc_stats.hpp"
+
 namespace hmon::core {
 
+namespace {
+
+constexpr size_t kInitialListCapacity = 256;
+constexpr size_t kInitialArenaBytes = 16 * 1024;
+constexpr auto kSelfPublishInterval = std::chrono::seconds(1);
+
+/* Governor: unchanged collects before the next backoff step, and the caps (as shifts of the base interval). */
+constexpr int kIdleCollects = 3;
+constexpr int kMaxBackoff = 3;
+constexpr int kHiddenBackoff = 6;
+constexpr double kCostSmoothing = 0.3;
+constexpr auto kInteractiveHold = std::chrono::seconds(10);
+constexpr auto kMaxCoalesce = std::chrono::milliseconds(100);
+
+const hmon_table_column kSelfColumns[] = {
+    {"plugin", HMON_VAL_STRING},
+    {"collects", HMON_VAL_INT64},
+    {"failures", HMON_VAL_INT64},
+    {"interval_ms", HMON_VAL_INT64},
+    {"wall_last_ms", HMON_VAL_DOUBLE},
+    {"wall_p50_ms", HMON_VAL_DOUBLE},
+    {"wall_p99_ms", HMON_VAL_DOUBLE},
+    {"wall_max_ms", HMON_VAL_DOUBLE},
+    {"cpu_last_ms", HMON_VAL_DOUBLE},
+    {"cpu_p99_ms", HMON_VAL_DOUBLE},
+    {"metrics", HMON_VAL_INT64},
+    {"arena_bytes", HMON_VAL_INT64},
+    {"alloc_bytes", HMON_VAL_INT64},
+    {"allocs", HMON_VAL_INT64},
+    {"stale", HMON_VAL_BOOL},
+};
+const hmon_table_column kAlertColumns[] = {
+    {"rule", HMON_VAL_STRING},
+    {"metric", HMON_VAL_STRING},
+    {"instance", HMON_VAL_STRING},
+    {"state", HMON_VAL_STRING},
+    {"value", HMON_VAL_DOUBLE},
+    {"threshold", HMON_VAL_DOUBLE},
+    {"since_ms", HMON_VAL_INT64},
+};
+enum : uint32_t {
+    kAlertRule,
+    kAlertMetric,
+    kAlertInstance,
+    kAlertState,
+    kAlertValue,
+    kAlertThreshold,
+    kAlertSince,
+    kAlertColumnCount
+};
+
+enum : uint32_t {
+    kSelfPlugin,
+    kSelfCollects,
+    kSelfFailures,
+    kSelfIntervalMs,
+    kSelfWallLast,
+    kSelfWallP50,
+    kSelfWallP99,
+    kSelfWallMax,
+    kSelfCpuLast,
+    kSelfCpuP99,
+    kSelfMetrics,
+    kSelfArenaBytes,
+    kSelfAllocBytes,
+    kSelfAllocs,
+    kSelfStale,
+    kSelfColumnCount
+};
+
+uint64_t threadCpuMicros() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000u + static_cast<uint64_t>(ts.tv_nsec) / 1000u;
+}
+
+double toMs(uint64_t us) { return static_cast<double>(us) / 1000.0; }
+
+uint64_t fnv(uint64_t h, const void* data, size_t n) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < n; ++i) h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+uint64_t fnvStr(uint64_t h, const char* s) { return s ? fnv(h, s, std::strlen(s) + 1) : fnv(h, "", 1); }
+
+/* Fingerprint of everything a collect produced, to tell an idle plugin from a busy one. */
+uint64_t listHash(const hmon_metric_list& list) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < list.count; ++i) {
+        const auto& item = list.items[i];
+        h = fnvStr(h, item.key);
+        h = fnv(h, &item.value.type, sizeof(item.value.type));
+        switch (item.value.type) {
+        case HMON_VAL_STRING: h = fnvStr(h, item.value.v.str); break;
+        case HMON_VAL_BOOL:   h = fnv(h, &item.value.v.b, sizeof(item.value.v.b)); break;
+        case HMON_VAL_TABLE: {
+            const hmon_table* t = item.value.v.table;
+            if (!t) break;
+            h = fnv(h, &t->row_count, sizeof(t->row_count));
+            for (uint32_t r = 0; r < t->row_count; ++r) {
+                const hmon_table_cell* row = t->cells + static_cast<size_t>(r) * t->column_count;
+                for (uint32_t c = 0; c < t->column_count; ++c) {
+                    if (t->columns[c].type == HMON_VAL_STRING) h = fnvStr(h, row[c].str);
+                    else if (t->columns[c].type == HMON_VAL_BOOL) h = fnv(h, &row[c].b, sizeof(row[c].b));
+                    else h = fnv(h, &row[c].i64, sizeof(row[c].i64));
+                }
+            }
+            break;
+        }
+        default: h = fnv(h, &item.value.v.i64, sizeof(item.value.v.i64)); break;
+        }
+    }
+    return h;
+}
+
+double intervalMicros(std::chrono::milliseconds interval) {
+    return static_cast<double>(std::max<int64_t>(1, interval.count())) * 1000.0;
+}
+
+/* How early a plugin may run to share a wakeup with another one. */
+std::chrono::steady_clock::duration coalesceSlack(std::chrono::milliseconds interval) {
+    return std::min<std::chrono::steady_clock::duration>(interval / 8, kMaxCoalesce);
+}
+
+}
+
 PluginManager::PluginManager() = default;
 PluginManager::~PluginManager() { destroy_all(); }
 
@@ -20,11 +155,18 @@ int PluginManager::load_static() {
         p.path = "<static>";
         p.dl_handle = nullptr;
         p.ctx = nullptr;
+        p.abi_version = HMON_PLUGIN_ABI_VERSION;
         p.init = sp.init;
         p.collect = sp.collect;
+        p.collect_v1 = nullptr;
         p.destroy = sp.destroy;
-        p.free_list = sp.free_list;
+        p.free_list = nullptr;
         p.control_fn = sp.control;
+        p.control_str_fn = sp.control_str;
+        p.event_fd_fn = sp.event_fd;
+        if (sp.interval_ms > 0) p.interval = std::chrono::milliseconds(sp.interval_ms);
+        p.base_interval = p.interval;
+        p.owner = registry_.add_owner();
         plugins_.push_back(std::move(p));
     }
     return static_cast<int>(staticPlugins().size());
@@ -35,24 +177,65 @@ int PluginManager::load(const std::string& so_path) {
     if (!handle) { std::cerr << "[hmon] dlopen(" << so_path << "): " << dlerror() << "\n"; return -1; }
     auto abi_fn = reinterpret_cast<hmon_plugin_abi_version_fn>(dlsym(handle, "hmon_plugin_abi_version"));
     if (!abi_fn) { std::cerr << "[hmon] " << so_path << ": missing hmon_plugin_abi_version\n"; dlclose(handle); return -1; }
-    if (abi_fn() != HMON_PLUGIN_ABI_VERSION) { std::cerr << "[hmon] " << so_path << ": ABI mismatch\n"; dlclose(handle); return -1; }
+    int abi = abi_fn();
+    if (abi != HMON_PLUGIN_ABI_VERSION && abi != 1) {
+        std::cerr << "[hmon] " << so_path << ": ABI mismatch (plugin v" << abi << ", host v" << HMON_PLUGIN_ABI_VERSION << ")\n";
+        dlclose(handle); return -1;
+    }
     auto name_fn = reinterpret_cast<hmon_plugin_name_fn>(dlsym(handle, "hmon_plugin_name"));
     auto init_fn = reinterpret_cast<hmon_plugin_init_fn>(dlsym(handle, "hmon_plugin_init"));
-    auto collect_fn = reinterpret_cast<hmon_plugin_collect_fn>(dlsym(handle, "hmon_plugin_collect"));
+    void* collect_sym = dlsym(handle, "hmon_plugin_collect");
     auto destroy_fn = reinterpret_cast<hmon_plugin_destroy_fn>(dlsym(handle, "hmon_plugin_destroy"));
     auto free_list_fn = reinterpret_cast<hmon_plugin_free_list_fn>(dlsym(handle, "hmon_plugin_free_list"));
     auto ctrl_fn = reinterpret_cast<hmon_plugin_control_fn>(dlsym(handle, "hmon_plugin_control"));
-    if (!name_fn || !init_fn || !collect_fn || !destroy_fn || !free_list_fn) {
+    if (!name_fn || !init_fn || !collect_sym || !destroy_fn || (abi == 1 && !free_list_fn)) {
         std::cerr << "[hmon] " << so_path << ": missing symbols\n"; dlclose(handle); return -1;
     }
     Plugin p;
     p.name = name_fn(); p.path = so_path; p.dl_handle = handle;
-    p.ctx = nullptr; p.init = init_fn; p.collect = collect_fn;
+    p.ctx = nullptr; p.abi_version = abi; p.init = init_fn;
+    p.collect = abi == 1 ? nullptr : reinterpret_cast<hmon_plugin_collect_fn>(collect_sym);
+    p.collect_v1 = abi == 1 ? reinterpret_cast<hmon_plugin_collect_v1_fn>(collect_sym) : nullptr;
     p.destroy = destroy_fn; p.free_list = free_list_fn; p.control_fn = ctrl_fn;
+    if (auto interval_fn = reinterpret_cast<hmon_plugin_interval_fn>(dlsym(handle, "hmon_plugin_interval_ms"))) {
+        int ms = interval_fn();
+        if (ms > 0) p.interval = std::chrono::milliseconds(ms);
+    }
+    p.base_interval = p.interval;
+    p.event_fd_fn = reinterpret_cast<hmon_plugin_event_fd_fn>(dlsym(handle, "hmon_plugin_event_fd"));
+    p.control_str_fn = reinterpret_cast<hmon_plugin_control_str_fn>(dlsym(handle, "hmon_plugin_control_str"));
+    p.owner = registry_.add_owner();
     plugins_.push_back(std::move(p));
     return 0;
 }
 
+size_t PluginManager::add_source(const std::string& name) {
+    Plugin p;
+    p.name = name;
+    p.path = "<source>";
+    p.dl_handle = nullptr;
+    p.ctx = nullptr;
+    p.abi_version = HMON_PLUGIN_ABI_VERSION;
+    p.init = nullptr;
+    p.collect = nullptr;
+    p.collect_v1 = nullptr;
+    p.destroy = nullptr;
+    p.free_list = nullptr;
+    p.control_fn = nullptr;
+    p.owner = registry_.add_owner();
+    plugins_.push_back(std::move(p));
+    return plugins_.size() - 1;
+}
+
+void PluginManager::publish_source(size_t source, const hmon_metric_list& list) {
+    if (source >= plugins_.size()) return;
+    {
+        std::unique_lock<std::shared_mutex> lock(metrics_mutex_);
+        publish(plugins_[source], list);
+    }
+    bump_generation();
+}
+
 int PluginManager::load_directory(const std::string& dir) {
     DIR* dp = opendir(dir.c_str());
     if (!dp) return 0;
@@ -70,104 +253,614 @@ int PluginManager::load_directory(const std::string& dir) {
 }
 
 int PluginManager::init_all() {
-    int failures = 0;
+    /* Plugins probe devices and daemons in init; none of them should wait for another's probe. */
+    std::vector<std::pair<Plugin*, std::future<int>>> inits;
     for (auto& plugin : plugins_) {
-        if (plugin.ctx) continue;
-        int rc = plugin.init(&plugin.ctx);
-        if (rc != 0) { std::cerr << "[hmon] plugin \"" << plugin.name << "\" init failed\n"; ++failures; }
+        if (plugin.helper) {
+            if (plugin.helper->pid < 0) spawn_helper(plugin);
+            continue;
+        }
+        if (plugin.ctx || !plugin.init) continue;
+        inits.emplace_back(&plugin, std::async(std::launch::async, [&plugin] { return plugin.init(&plugin.ctx); }));
+    }
+    int failures = 0;
+    for (auto& [plugin, rc] : inits) {
+        if (rc.get() == 0) continue;
+        std::cerr << "[hmon] plugin \"" << plugin->name << "\" init failed\n";
+        ++failures;
     }
     return failures;
 }
 
-int PluginManager::collect_all() {
-    kv_map_.clear();
-
+int PluginManager::collect_all(std::chrono::milliseconds prime) {
+    add_self_source();
     struct CollectResult {
-        std::vector<std::pair<std::string, hmon_metric_value>> metrics;
-        std::string plugin_name;
         bool success = false;
     };
 
     std::vector<std::future<CollectResult>> futures;
     futures.reserve(plugins_.size());
 
+    const auto start = std::chrono::steady_clock::now();
     for (auto& plugin : plugins_) {
-        futures.push_back(std::async(std::launch::async, [&plugin]() -> CollectResult {
+        futures.push_back(std::async(std::launch::async, [this, &plugin, prime, start]() -> CollectResult {
             CollectResult res;
-            res.plugin_name = plugin.name;
-            if (!plugin.ctx) return res;
-            hmon_metric_list list{};
-            int rc = plugin.collect(plugin.ctx, &list);
-            if (rc != 0) return res;
-            res.metrics.reserve(list.count);
-            for (size_t i = 0; i < list.count; ++i) {
-                res.metrics.emplace_back(list.items[i].key, list.items[i].value);
+            if (!plugin.live()) return res;
+            int rc = collect_one(plugin);
+            /* Slower plugins show levels rather than rates, and are not worth a second pass. */
+            if (prime.count() > 0 && plugin.base_interval <= std::chrono::milliseconds(HMON_DEFAULT_INTERVAL_MS)) {
+                std::this_thread::sleep_until(start + prime);
+                rc = collect_one(plugin);
             }
-            res.success = true;
+            plugin.absent = rc == HMON_COLLECT_ABSENT;
+            res.success = rc == 0 || plugin.absent;
             return res;
         }));
     }
 
-    for (auto& fut : futures) {
-        auto res = fut.get();
-        if (res.success) {
-            for (auto& [k, v] : res.metrics) {
-                kv_map_.emplace(std::move(k), v);
-            }
-        }
+    for (size_t i = 0; i < futures.size(); ++i) {
+        auto res = futures[i].get();
+        if (!res.success) continue;
+        std::unique_lock<std::shared_mutex> lock(metrics_mutex_);
+        publish(plugins_[i], plugins_[i].list);
     }
+    {
+        std::unique_lock<std::shared_mutex> lock(metrics_mutex_);
+        publish_self(true);
+    }
+    bump_generation();
     return 0;
 }
 
+void PluginManager::bump_generation() {
+    {
+        std::lock_guard<std::mutex> lock(update_mutex_);
+        generation_.fetch_add(1, std::memory_order_release);
+    }
+    update_cv_.notify_all();
+}
+
+bool PluginManager::wait_for_update(uint64_t seen, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(update_mutex_);
+    const uint64_t wakes = waiter_wakes_;
+    update_cv_.wait_for(lock, timeout, [&] { return generation() != seen || waiter_wakes_ != wakes; });
+    return generation() != seen;
+}
+
+void PluginManager::wake_waiters() {
+    {
+        std::lock_guard<std::mutex> lock(update_mutex_);
+        ++waiter_wakes_;
+    }
+    update_cv_.notify_all();
+}
+
+void PluginManager::start(size_t workers) {
+    if (!workers_.empty() || plugins_.empty()) return;
+    add_self_source();
+    {
+        std::lock_guard<std::mutex> lock(sched_mutex_);
+        stopping_ = false;
+        auto now = std::chrono::steady_clock::now();
+        for (auto& plugin : plugins_) {
+            plugin.next_due = now + effective_interval(plugin);
+            if (plugin.ctx && plugin.event_fd_fn) plugin.event_fd = plugin.event_fd_fn(plugin.ctx);
+        }
+    }
+    wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (wake_fd_ < 0 || timer_fd_ < 0) {
+        /* Without the poll thread workers fall back to timed waits and event fds go unwatched. */
+        std::cerr << "[hmon] eventfd/timerfd: " << std::strerror(errno) << "\n";
+        if (wake_fd_ >= 0) { ::close(wake_fd_); wake_fd_ = -1; }
+        if (timer_fd_ >= 0) { ::close(timer_fd_); timer_fd_ = -1; }
+    }
+    workers = std::max<size_t>(1, std::min(workers, plugins_.size()));
+    for (size_t i = 0; i < workers; ++i) workers_.emplace_back([this] { worker_loop(); });
+    if (timer_fd_ >= 0) event_thread_ = std::thread([this] { event_loop(); });
+}
+
+void PluginManager::stop() {
+    {
+        std::lock_guard<std::mutex> lock(sched_mutex_);
+        stopping_ = true;
+    }
+    sched_cv_.notify_all();
+    for (auto& t : workers_) t.join();
+    workers_.clear();
+    if (event_thread_.joinable()) {
+        wake_event_loop();
+        event_thread_.join();
+    }
+    if (wake_fd_ >= 0) { ::close(wake_fd_); wake_fd_ = -1; }
+    if (timer_fd_ >= 0) { ::close(timer_fd_); timer_fd_ = -1; }
+}
+
+void PluginManager::wake_event_loop() {
+    if (wake_fd_ < 0) return;
+    uint64_t one = 1;
+    (void)!::write(wake_fd_, &one, sizeof(one));
+}
+
+/*
+ * The only timed wakeup in the scheduler: timer_fd_ is armed for the earliest
+ * next_due of an idle plugin, and the event fds of idle plugins are polled
+ * alongside it.  A plugin that fired is left out of the poll set until a
+ * worker has collected it (which drains the fd), so a level-triggered
+ * descriptor never spins; workers poke wake_fd_ whenever they move a
+ * next_due so the timer is re-armed.
+ */
+void PluginManager::event_loop() {
+    std::vector<pollfd> fds;
+    std::vector<Plugin*> owners;
+    std::unique_lock<std::mutex> lock(sched_mutex_);
+    while (!stopping_) {
+        fds.assign({pollfd{wake_fd_, POLLIN, 0}, pollfd{timer_fd_, POLLIN, 0}});
+        owners.assign(2, nullptr);
+        auto earliest = std::chrono::steady_clock::time_point::max();
+        for (auto& plugin : plugins_) {
+            if (!plugin.live() || plugin.in_flight) continue;
+            earliest = std::min(earliest, plugin.next_due);
+            if (plugin.event_fd < 0 || plugin.event_pending) continue;
+            fds.push_back(pollfd{plugin.event_fd, POLLIN, 0});
+            owners.push_back(&plugin);
+        }
+        itimerspec spec{};
+        if (earliest != std::chrono::steady_clock::time_point::max()) {
+            /* steady_clock is CLOCK_MONOTONIC; an all-zero it_value would disarm, so a past deadline becomes 1ns. */
+            const auto ns = std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                     earliest.time_since_epoch()).count());
+            spec.it_value.tv_sec = static_cast<time_t>(ns / 1000000000);
+            spec.it_value.tv_nsec = static_cast<long>(ns % 1000000000);
+        }
+        timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+        lock.unlock();
+        int n = ::poll(fds.data(), fds.size(), -1);
+        uint64_t drained;
+        if (fds[0].revents & POLLIN) (void)!::read(wake_fd_, &drained, sizeof(drained));
+        const bool timer = (fds[1].revents & POLLIN) && ::read(timer_fd_, &drained, sizeof(drained)) > 0;
+        lock.lock();
+        if (n <= 0) continue;
+
+        bool woke = timer;
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 2; i < fds.size(); ++i) {
+            if (!fds[i].revents) continue;
+            owners[i]->event_pending = true;
+            owners[i]->next_due = now;
+            woke = true;
+        }
+        if (woke) sched_cv_.notify_all();
+    }
+}
+
+void PluginManager::request_refresh() {
+    {
+        std::lock_guard<std::mutex> lock(sched_mutex_);
+        auto now = std::chrono::steady_clock::now();
+        for (auto& plugin : plugins_) plugin.next_due = now;
+    }
+    sched_cv_.notify_all();
+    wake_event_loop();
+}
+
+void PluginManager::request_refresh(const std::string& plugin_name) {
+    {
+        std::lock_guard<std::mutex> lock(sched_mutex_);
+        for (auto& plugin : plugins_) {
+            if (plugin.name != plugin_name) continue;
+            /* A collect already running may have read the old state; it is followed by another. */
+            if (plugin.in_flight) plugin.rerun = true;
+            else plugin.next_due = std::chrono::steady_clock::now();
+        }
+    }
+    sched_cv_.notify_all();
+    wake_event_loop();
+}
+
+void PluginManager::set_cpu_budget(double cores) {
+    std::lock_guard<std::mutex> lock(sched_mutex_);
+    cpu_budget_ = std::max(0.0, cores);
+    if (cpu_budget_ > 0.0) return;
+    for (auto& plugin : plugins_) {
+        plugin.backoff = 0;
+        plugin.interval = plugin.base_interval;
+    }
+}
+
+void PluginManager::set_visible(bool visible) {
+    {
+        std::lock_guard<std::mutex> lock(sched_mutex_);
+        if (visible_ == visible) return;
+        visible_ = visible;
+        /* Going hidden takes effect at each plugin's next collect; coming back has to be immediate. */
+        if (visible) reset_backoff(std::chrono::steady_clock::now());
+    }
+    sched_cv_.notify_all();
+    wake_event_loop();
+}
+
+void PluginManager::note_activity() {
+    {
+        std::lock_guard<std::mutex> lock(sched_mutex_);
+        auto now = std::chrono::steady_clock::now();
+        interactive_until_ = now + kInteractiveHold;
+        reset_backoff(now);
+    }
+    sched_cv_.notify_all();
+    wake_event_loop();
+}
+
+/* Caller holds sched_mutex_.  Backed-off plugins return to their own interval and run now. */
+void PluginManager::reset_backoff(std::chrono::steady_clock::time_point now) {
+    for (auto& plugin : plugins_) {
+        if (plugin.backoff == 0) continue;
+        plugin.backoff = 0;
+        plugin.unchanged = 0;
+        plugin.interval = plugin.base_interval;
+        if (!plugin.in_flight && !plugin.absent) plugin.next_due = std::min(plugin.next_due, now);
+    }
+}
+
+/* Caller holds sched_mutex_.  An absent plugin is only re-probed now and then. */
+std::chrono::milliseconds PluginManager::effective_interval(const Plugin& plugin) const {
+    if (!plugin.absent) return plugin.interval;
+    return std::max(plugin.interval, std::chrono::milliseconds(HMON_ABSENT_RECHECK_MS));
+}
+
+/* Caller holds sched_mutex_.  Estimated cores spent collecting at the current intervals. */
+double PluginManager::collect_cpu_share() const {
+    double share = 0.0;
+    for (const auto& plugin : plugins_) {
+        if (plugin.live()) share += plugin.cpu_cost_us / intervalMicros(plugin.interval);
+    }
+    return share;
+}
+
+/*
+ * Caller holds sched_mutex_; runs after each successful collect, before the
+ * plugin's next_due moves.  Picks the smallest backoff the plugin's output
+ * and the CPU budget allow: none while it changes or a key was pressed
+ * recently, one more step after every kIdleCollects identical collects, and
+ * as many as it takes to bring a plugin over its fair share back under budget.
+ */
+void PluginManager::govern(Plugin& plugin, bool changed, std::chrono::steady_clock::time_point now) {
+    const double cpu = static_cast<double>(plugin.stats->last_cpu_us.load(std::memory_order_relaxed));
+    plugin.cpu_cost_us = plugin.cpu_cost_us == 0.0 ? cpu
+                                                   : plugin.cpu_cost_us + kCostSmoothing * (cpu - plugin.cpu_cost_us);
+    plugin.unchanged = changed ? 0 : plugin.unchanged + 1;
+    if (cpu_budget_ <= 0.0) return;
+
+    int want = plugin.backoff;
+    if (!visible_) {
+        want = kHiddenBackoff;
+    } else if (changed || now < interactive_until_) {
+        want = 0;
+    } else if (plugin.unchanged >= kIdleCollects) {
+        want = std::min(plugin.backoff + 1, kMaxBackoff);
+        plugin.unchanged = 0;
+    } else {
+        want = std::min(want, kMaxBackoff);
+    }
+
+    if (visible_ && now >= interactive_until_) {
+        size_t active = 0;
+        for (const auto& p : plugins_) active += p.live() ? 1 : 0;
+        const double others = collect_cpu_share() - plugin.cpu_cost_us / intervalMicros(plugin.interval);
+        const double fair = cpu_budget_ / static_cast<double>(std::max<size_t>(1, active));
+        auto share = [&](int b) { return plugin.cpu_cost_us / intervalMicros(plugin.base_interval * (1 << b)); };
+        while (want < kMaxBackoff && others + share(want) > cpu_budget_ && share(want) > fair) ++want;
+    }
+
+    plugin.backoff = want;
+    plugin.interval = plugin.base_interval * (1 << want);
+}
+
+void PluginManager::worker_loop() {
+    std::unique_lock<std::mutex> lock(sched_mutex_);
+    while (!stopping_) {
+        Plugin* next = nullptr;
+        for (auto& plugin : plugins_) {
+            if (!plugin.live() || plugin.in_flight) continue;
+            if (!next || plugin.next_due < next->next_due) next = &plugin;
+        }
+        if (!next) { sched_cv_.wait(lock); continue; }
+        if (next->next_due > std::chrono::steady_clock::now() + coalesceSlack(next->interval)) {
+            /* The poll thread's timerfd wakes us; only without one do workers keep their own clock. */
+            if (timer_fd_ >= 0) sched_cv_.wait(lock);
+            else sched_cv_.wait_until(lock, next->next_due);
+            continue;
+        }
+
+        next->in_flight = true;
+        lock.unlock();
+        const int rc = collect_one(*next);
+        const bool ok = rc == 0 || rc == HMON_COLLECT_ABSENT;
+        bool changed = false;
+        if (ok) {
+            const uint64_t hash = listHash(next->list);
+            changed = hash != next->output_hash;
+            next->output_hash = hash;
+            std::unique_lock<std::shared_mutex> write(metrics_mutex_);
+            publish(*next, next->list);
+            publish_self(false);
+            bump_generation();
+        }
+        int event_fd = next->event_fd_fn ? next->event_fd_fn(next->ctx) : -1;
+        lock.lock();
+        if (next->event_fd_fn) {
+            next->event_fd = event_fd;
+            next->event_pending = false;
+        }
+
+        /* Keep a steady cadence; if we fell behind, skip the missed slots rather than bursting. */
+        auto now = std::chrono::steady_clock::now();
+        if (ok) govern(*next, changed, now);
+        next->absent = rc == HMON_COLLECT_ABSENT;
+        const auto interval = effective_interval(*next);
+        next->next_due += interval;
+        if (next->next_due < now) next->next_due = now + interval;
+        if (next->rerun) next->next_due = now;
+        next->rerun = false;
+        next->in_flight = false;
+        wake_event_loop();
+        sched_cv_.notify_all();
+    }
+}
+
+int PluginManager::collect_one(Plugin& plugin) {
+    const auto wall_start = std::chrono::steady_clock::now();
+    const uint64_t cpu_start = threadCpuMicros();
+    const AllocCounters allocs_start = threadAllocations();
+    const int rc = collect_into(plugin);
+    const AllocCounters allocs = threadAllocations();
+    const uint64_t cpu_us = threadCpuMicros() - cpu_start;
+    const auto wall_us = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - wall_start).count());
+
+    PluginStats& st = *plugin.stats;
+    st.wall_us.record(wall_us);
+    st.cpu_us.record(cpu_us);
+    st.last_wall_us.store(wall_us, std::memory_order_relaxed);
+    st.last_cpu_us.store(cpu_us, std::memory_order_relaxed);
+    st.last_metrics.store(plugin.list.count, std::memory_order_relaxed);
+    st.last_arena_bytes.store(plugin.arena.used + plugin.arena.dropped, std::memory_order_relaxed);
+    st.last_alloc_bytes.store(allocs.bytes - allocs_start.bytes, std::memory_order_relaxed);
+    st.last_allocs.store(allocs.count - allocs_start.count, std::memory_order_relaxed);
+    if (rc != 0 && rc != HMON_COLLECT_ABSENT) st.failures.fetch_add(1, std::memory_order_relaxed);
+    return rc;
+}
+
+int PluginManager::collect_into(Plugin& plugin) {
+    if (plugin.helper) return collect_isolated(plugin);
+    if (plugin.items.empty()) {
+        plugin.items.resize(kInitialListCapacity);
+        plugin.arena_buf.resize(kInitialArenaBytes);
+    } else if (plugin.arena.dropped > 0) {
+        /* Last tick overflowed and published whatever fitted; grow before reuse. */
+        if (plugin.list.count >= plugin.items.size()) plugin.items.resize(plugin.items.size() * 2);
+        plugin.arena_buf.resize(std::max(plugin.arena_buf.size() * 2, plugin.arena.used + plugin.arena.dropped));
+    }
+    plugin.list = hmon_metric_list{plugin.items.data(), 0, plugin.items.size()};
+    plugin.arena = hmon_arena{plugin.arena_buf.data(), 0, plugin.arena_buf.size(), 0};
+
+    int rc;
+    if (plugin.collect) {
+        rc = plugin.collect(plugin.ctx, &plugin.list, &plugin.arena);
+    } else {
+        /* v1 shim: copy the plugin-allocated list into host buffers, then give it back. */
+        hmon_metric_list v1{};
+        rc = plugin.collect_v1(plugin.ctx, &v1);
+        for (size_t i = 0; rc == 0 && i < v1.count; ++i) {
+            const auto& item = v1.items[i];
+            const void* value = item.value.type == HMON_VAL_STRING ? static_cast<const void*>(item.value.v.str)
+                                                                   : static_cast<const void*>(&item.value.v);
+            hmon_metric_append(&plugin.list, &plugin.arena, item.key, item.value.type, value);
+        }
+        if (plugin.free_list) plugin.free_list(&v1);
+    }
+    return rc;
+}
+
+void PluginManager::add_self_source() {
+    if (self_source_ == SIZE_MAX) self_source_ = add_source("self");
+}
+
+/*
+ * Rebuild "self.plugins" from every plugin's stats and publish it, at most
+ * once per kSelfPublishInterval unless `force`.  Callers hold the metrics
+ * write lock and bump the generation afterwards.
+ */
+void PluginManager::publish_self(bool force) {
+    if (self_source_ >= plugins_.size()) return;
+    std::unique_lock<std::mutex> guard(self_mutex_, std::try_to_lock);
+    if (!guard) return;
+    auto now = std::chrono::steady_clock::now();
+    if (!force && now < self_due_) return;
+    self_due_ = now + kSelfPublishInterval;
+
+    Plugin& self = plugins_[self_source_];
+    uint32_t rows = 0;
+    size_t names = 0;
+    for (const auto& plugin : plugins_) {
+        if (!plugin.live()) continue;
+        ++rows;
+        names += plugin.name.size() + 1;
+    }
+    const size_t need = sizeof(hmon_table) + rows * kSelfColumnCount * sizeof(hmon_table_cell) + names + rows * 8 + 128;
+    if (self.items.size() < 2) self.items.resize(2);
+    if (self.arena_buf.size() < need) self.arena_buf.resize(need);
+    self.list = hmon_metric_list{self.items.data(), 0, self.items.size()};
+    self.arena = hmon_arena{self.arena_buf.data(), 0, self.arena_buf.size(), 0};
+
+    auto* table = hmon_metric_append_table(&self.list, &self.arena, HMON_METRIC_SELF_PLUGINS_TABLE, kSelfColumns,
+                                           kSelfColumnCount, rows);
+    if (!table) return;
+    {
+        std::lock_guard<std::mutex> sched(sched_mutex_);
+        uint32_t r = 0;
+        for (const auto& plugin : plugins_) {
+            if (!plugin.live() || r >= rows) continue;
+            const PluginStats& st = *plugin.stats;
+            auto* row = hmon_table_row(table, r);
+            hmon_table_set_str(&self.arena, table, r, kSelfPlugin, plugin.name.c_str());
+            row[kSelfCollects].i64 = static_cast<int64_t>(st.wall_us.count());
+            row[kSelfFailures].i64 = static_cast<int64_t>(st.failures.load(std::memory_order_relaxed));
+            row[kSelfIntervalMs].i64 = effective_interval(plugin).count();
+            row[kSelfWallLast].f64 = toMs(st.last_wall_us.load(std::memory_order_relaxed));
+            row[kSelfWallP50].f64 = toMs(st.wall_us.percentile(0.50));
+            row[kSelfWallP99].f64 = toMs(st.wall_us.percentile(0.99));
+            row[kSelfWallMax].f64 = toMs(st.wall_us.max());
+            row[kSelfCpuLast].f64 = toMs(st.last_cpu_us.load(std::memory_order_relaxed));
+            row[kSelfCpuP99].f64 = toMs(st.cpu_us.percentile(0.99));
+            row[kSelfMetrics].i64 = static_cast<int64_t>(st.last_metrics.load(std::memory_order_relaxed));
+            row[kSelfArenaBytes].i64 = static_cast<int64_t>(st.last_arena_bytes.load(std::memory_order_relaxed));
+            row[kSelfAllocBytes].i64 = static_cast<int64_t>(st.last_alloc_bytes.load(std::memory_order_relaxed));
+            row[kSelfAllocs].i64 = static_cast<int64_t>(st.last_allocs.load(std::memory_order_relaxed));
+            row[kSelfStale].b = st.stale.load(std::memory_order_relaxed) ? 1 : 0;
+            ++r;
+        }
+        const double cpu_pct = collect_cpu_share() * 100.0;
+        hmon_metric_append(&self.list, &self.arena, HMON_METRIC_SELF_COLLECT_CPU_PCT, HMON_VAL_DOUBLE, &cpu_pct);
+    }
+    publish(self, self.list);
+}
+
+void PluginManager::set_alerts(AlertEngine* engine) {
+    alerts_ = engine;
+    if (!alerts_ || alerts_->rule_count() == 0) {
+        alerts_ = nullptr;
+        return;
+    }
+    if (alerts_source_ == SIZE_MAX) alerts_source_ = add_source("alerts");
+    std::unique_lock<std::shared_mutex> lock(metrics_mutex_);
+    publish_alerts();
+}
+
+/* Rebuild "alerts.active" from the engine; callers hold the metrics write lock. */
+void PluginManager::publish_alerts() {
+    Plugin& source = plugins_[alerts_source_];
+    const auto& active = alerts_->active();
+    size_t strings = 0;
+    int64_t firing = 0;
+    for (const auto& a : active) {
+        strings += a.rule->text.size() + a.metric.size() + a.instance.size() + 16;
+        firing += a.firing ? 1 : 0;
+    }
+    const auto rows = static_cast<uint32_t>(active.size());
+    const size_t need = sizeof(hmon_table) + rows * kAlertColumnCount * sizeof(hmon_table_cell) + strings + 128;
+    if (source.items.size() < 2) source.items.resize(2);
+    if (source.arena_buf.size() < need) source.arena_buf.resize(need);
+    source.list = hmon_metric_list{source.items.data(), 0, source.items.size()};
+    source.arena = hmon_arena{source.arena_buf.data(), 0, source.arena_buf.size(), 0};
+
+    auto* table = hmon_metric_append_table(&source.list, &source.arena, HMON_METRIC_ALERTS_TABLE, kAlertColumns,
+                                           kAlertColumnCount, rows);
+    if (!table) return;
+    for (uint32_t r = 0; r < rows; ++r) {
+        const auto& a = active[r];
+        auto* row = hmon_table_row(table, r);
+        hmon_table_set_str(&source.arena, table, r, kAlertRule, a.rule->text.c_str());
+        hmon_table_set_str(&source.arena, table, r, kAlertMetric, a.metric.c_str());
+        hmon_table_set_str(&source.arena, table, r, kAlertInstance, a.instance.c_str());
+        hmon_table_set_str(&source.arena, table, r, kAlertState, a.firing ? "firing" : "pending");
+        row[kAlertValue].f64 = a.value;
+        row[kAlertThreshold].f64 = a.threshold;
+        row[kAlertSince].i64 = a.since_ms;
+    }
+    hmon_metric_append(&source.list, &source.arena, HMON_METRIC_ALERTS_FIRING, HMON_VAL_INT64, &firing);
+    publish(source, source.list);
+}
+
+void PluginManager::publish(Plugin& plugin, const hmon_metric_list& list) {
+    registry_.begin_publish(plugin.owner);
+    if (plugin.key_cache.size() < list.count) {
+        plugin.key_cache.resize(list.count);
+        plugin.id_cache.resize(list.count, kInvalidMetricId);
+    }
+    for (size_t i = 0; i < list.count; ++i) {
+        const auto& item = list.items[i];
+        if (!item.key) continue;
+        /* Plugins emit keys in a stable order, so the id at this position is almost always reusable. */
+        if (plugin.id_cache[i] == kInvalidMetricId || plugin.key_cache[i] != item.key) {
+            plugin.key_cache[i] = item.key;
+            plugin.id_cache[i] = registry_.intern(item.key);
+        }
+        registry_.set(plugin.id_cache[i], plugin.owner, item.value);
+    }
+    if (alerts_ && &plugin != &plugins_[alerts_source_] &&
+        alerts_->on_publish(registry_, plugin.owner, plugin.id_cache.data(), list.count)) {
+        publish_alerts();
+    }
+}
+
 void PluginManager::destroy_all() {
+    stop();
     for (auto& plugin : plugins_) {
+        if (plugin.helper) stop_helper(plugin, false);
         if (plugin.ctx) { plugin.destroy(plugin.ctx); plugin.ctx = nullptr; }
         if (plugin.dl_handle) { dlclose(plugin.dl_handle); plugin.dl_handle = nullptr; }
     }
     plugins_.clear();
-    kv_map_.clear();
+    registry_.clear();
+}
+
+MetricId PluginManager::resolve(std::string_view key) {
+    std::unique_lock<std::shared_mutex> lock(metrics_mutex_);
+    return registry_.intern(key);
 }
 
 std::string PluginManager::get_string(const std::string& key, const std::string& fallback) const {
-    auto it = kv_map_.find(key);
-    if (it != kv_map_.end() && it->second.type == HMON_VAL_STRING)
-        return it->second.v.str ? it->second.v.str : fallback;
-    return fallback;
+    return get_string(registry_.find(key), fallback);
 }
 
 std::optional<int64_t> PluginManager::get_int64(const std::string& key) const {
-    auto it = kv_map_.find(key);
-    if (it != kv_map_.end() && it->second.type == HMON_VAL_INT64) return it->second.v.i64;
-    return std::nullopt;
+    return get_int64(registry_.find(key));
 }
 
 std::optional<double> PluginManager::get_double(const std::string& key) const {
-    auto it = kv_map_.find(key);
-    if (it != kv_map_.end() && it->second.type == HMON_VAL_DOUBLE) return it->second.v.f64;
-    return std::nullopt;
+    return get_double(registry_.find(key));
 }
 
 std::optional<bool> PluginManager::get_bool(const std::string& key) const {
-    auto it = kv_map_.find(key);
-    if (it != kv_map_.end() && it->second.type == HMON_VAL_BOOL) return it->second.v.b != 0;
+    return get_bool(registry_.find(key));
+}
+
+const hmon_table* PluginManager::get_table(const std::string& key) const {
+    return get_table(registry_.find(key));
+}
+
+std::string PluginManager::get_string(MetricId id, const std::string& fallback) const {
+    if (!registry_.present(id)) return fallback;
+    auto v = registry_.value(id);
+    return v.type == HMON_VAL_STRING ? std::string(v.v.str) : fallback;
+}
+
+std::optional<int64_t> PluginManager::get_int64(MetricId id) const {
+    if (!registry_.present(id)) return std::nullopt;
+    auto v = registry_.value(id);
+    if (v.type == HMON_VAL_INT64) return v.v.i64;
     return std::nullopt;
 }
 
-std::vector<PluginManager::MetricEntry> PluginManager::get_by_prefix(const std::string& prefix) const {
-    std::vector<MetricEntry> result;
-    std::vector<std::pair<std::string, hmon_metric_value>> sorted;
-    for (const auto& [k, v] : kv_map_) {
-        if (k.rfind(prefix, 0) == 0) {
-            sorted.emplace_back(k, v);
-        }
-    }
-    std::sort(sorted.begin(), sorted.end(),
-              [](const auto& a, const auto& b) { return a.first < b.first; });
-    result.reserve(sorted.size());
-    for (const auto& [k, v] : sorted) {
-        result.push_back({k, v});
-    }
-    return result;
+std::optional<double> PluginManager::get_double(MetricId id) const {
+    if (!registry_.present(id)) return std::nullopt;
+    auto v = registry_.value(id);
+    if (v.type == HMON_VAL_DOUBLE) return v.v.f64;
+    return std::nullopt;
+}
+
+std::optional<bool> PluginManager::get_bool(MetricId id) const {
+    if (!registry_.present(id)) return std::nullopt;
+    auto v = registry_.value(id);
+    if (v.type == HMON_VAL_BOOL) return v.v.b != 0;
+    return std::nullopt;
+}
+
+const hmon_table* PluginManager::get_table(MetricId id) const {
+    if (!registry_.present(id)) return nullptr;
+    auto v = registry_.value(id);
+    return v.type == HMON_VAL_TABLE ? v.v.table : nullptr;
 }
 
 std::vector<std::string> PluginManager::plugin_names() const {
@@ -178,8 +871,21 @@ std::vector<std::string> PluginManager::plugin_names() const {
 }
 
 void PluginManager::control(const std::string& plugin_name, const char* key, int value) {
-    for (auto& plugin : plugins_)
-        if (plugin.name == plugin_name && plugin.control_fn) { plugin.control_fn(key, value); return; }
+    for (auto& plugin : plugins_) {
+        if (plugin.name != plugin_name) continue;
+        if (plugin.helper) forward_control(*plugin.helper, key, value);
+        else if (plugin.control_fn) plugin.control_fn(key, value);
+        return;
+    }
+}
+
+void PluginManager::control_str(const std::string& plugin_name, const char* key, const std::string& value) {
+    for (auto& plugin : plugins_) {
+        if (plugin.name != plugin_name) continue;
+        if (plugin.helper) forward_control_str(*plugin.helper, key, value);
+        else if (plugin.control_str_fn) plugin.control_str_fn(key, value.c_str());
+        return;
+    }
 }
 
 }
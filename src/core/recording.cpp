@@ -0,0 +1,595 @@
+#include "hmon/recording.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace hmon::core {
+
+namespace {
+
+constexpr char kRecordingMagic[4] = {'H', 'M', 'R', '1'};
+constexpr uint32_t kRecordingVersion = 1;
+constexpr uint32_t kNoFrameId = UINT32_MAX;
+constexpr uint32_t kMaxFrameBytes = 64u * 1024 * 1024;
+
+void putZigzag(std::string* out, int64_t value) {
+    putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void putString(std::string* out, std::string_view s) {
+    putVarint(out, s.size());
+    out->append(s);
+}
+
+/* XOR with the previous bits; one byte gives how many leading and trailing zero bytes were dropped. */
+void putXor(std::string* out, uint64_t prev, uint64_t cur) {
+    const uint64_t x = prev ^ cur;
+    if (x == 0) {
+        out->push_back(0);
+        return;
+    }
+    const int lead = __builtin_clzll(x) / 8;
+    const int trail = __builtin_ctzll(x) / 8;
+    out->push_back(static_cast<char>(1 + lead * 8 + trail));
+    for (int i = trail; i < 8 - lead; ++i) out->push_back(static_cast<char>(x >> (i * 8)));
+}
+
+uint64_t doubleBits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double bitsDouble(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+struct Cursor {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok = true;
+
+    uint8_t byte() {
+        if (p >= end) { ok = false; return 0; }
+        return *p++;
+    }
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const uint8_t b = byte();
+            value |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) return value;
+        }
+        ok = false;
+        return 0;
+    }
+    int64_t zigzag() {
+        const uint64_t v = varint();
+        return static_cast<int64_t>((v >> 1) ^ (~(v & 1) + 1));
+    }
+    bool string(std::string* out) {
+        const uint64_t n = varint();
+        if (!ok || n > static_cast<uint64_t>(end - p)) { ok = false; return false; }
+        out->assign(reinterpret_cast<const char*>(p), n);
+        p += n;
+        return true;
+    }
+    uint64_t xorWith(uint64_t prev) {
+        const uint8_t head = byte();
+        if (head == 0) return prev;
+        const int lead = (head - 1) / 8, trail = (head - 1) % 8;
+        if (lead + trail > 7) { ok = false; return prev; }
+        uint64_t x = 0;
+        for (int i = trail; i < 8 - lead; ++i) x |= static_cast<uint64_t>(byte()) << (i * 8);
+        return prev ^ x;
+    }
+};
+
+bool knownType(int32_t type) {
+    return type == HMON_VAL_INT64 || type == HMON_VAL_DOUBLE || type == HMON_VAL_BOOL || type == HMON_VAL_STRING;
+}
+
+uint64_t cellBits(const hmon_table_cell& cell, int32_t type) {
+    switch (type) {
+    case HMON_VAL_INT64:  return static_cast<uint64_t>(cell.i64);
+    case HMON_VAL_DOUBLE: return doubleBits(cell.f64);
+    case HMON_VAL_BOOL:   return static_cast<uint64_t>(static_cast<int64_t>(cell.b));
+    default:              return 0;
+    }
+}
+
+/* Returns whether anything differs from `st`; `st` becomes the new table either way. */
+bool encodeTable(std::string* out, FrameValue* st, FrameValue* spare, const hmon_table& table, bool fresh) {
+    const uint32_t ncols = table.column_count, rows = table.row_count;
+    bool schema = fresh || st->column_names.size() != ncols;
+    for (uint32_t c = 0; !schema && c < ncols; ++c) {
+        const char* name = table.columns[c].name ? table.columns[c].name : "";
+        schema = st->column_types[c] != table.columns[c].type || st->column_names[c] != name;
+    }
+    out->push_back(schema ? 1 : 0);
+    if (schema) {
+        putVarint(out, ncols);
+        st->column_names.resize(ncols);
+        st->column_types.resize(ncols);
+        for (uint32_t c = 0; c < ncols; ++c) {
+            st->column_names[c] = table.columns[c].name ? table.columns[c].name : "";
+            st->column_types[c] = table.columns[c].type;
+            putString(out, st->column_names[c]);
+            out->push_back(static_cast<char>(table.columns[c].type));
+        }
+    }
+    putVarint(out, rows);
+
+    bool changed = schema || rows != st->rows;
+    const size_t count = static_cast<size_t>(rows) * ncols;
+    spare->cells.assign(count, 0);
+    spare->cell_strs.resize(count);
+    spare->cell_null.assign(count, 0);
+    for (uint32_t c = 0; c < ncols; ++c) {
+        const int32_t type = table.columns[c].type;
+        if (!knownType(type)) continue;
+        for (uint32_t r = 0; r < rows; ++r) {
+            const size_t idx = static_cast<size_t>(r) * ncols + c;
+            const bool has_prev = !schema && r < st->rows;
+            const hmon_table_cell& cell = table.cells[idx];
+            if (type == HMON_VAL_STRING) {
+                const bool null = cell.str == nullptr;
+                spare->cell_null[idx] = null;
+                if (!null) spare->cell_strs[idx].assign(cell.str);
+                if (has_prev && st->cell_null[idx] == null && (null || st->cell_strs[idx] == cell.str)) {
+                    putVarint(out, 0);
+                } else if (null) {
+                    putVarint(out, 1);
+                    changed = true;
+                } else {
+                    putVarint(out, spare->cell_strs[idx].size() + 2);
+                    out->append(spare->cell_strs[idx]);
+                    changed = true;
+                }
+                continue;
+            }
+            const uint64_t cur = cellBits(cell, type);
+            const uint64_t prev = has_prev ? st->cells[idx] : 0;
+            spare->cells[idx] = cur;
+            changed |= cur != prev;
+            if (type == HMON_VAL_DOUBLE) putXor(out, prev, cur);
+            else putZigzag(out, static_cast<int64_t>(cur - prev));
+        }
+    }
+    st->rows = rows;
+    std::swap(st->cells, spare->cells);
+    std::swap(st->cell_strs, spare->cell_strs);
+    std::swap(st->cell_null, spare->cell_null);
+    return changed;
+}
+
+bool decodeTable(Cursor* in, FrameValue* st, FrameValue* spare, bool fresh) {
+    const bool schema = in->byte() != 0;
+    if (schema) {
+        const uint64_t ncols = in->varint();
+        if (!in->ok || ncols > static_cast<uint64_t>(in->end - in->p)) return false;
+        st->column_names.resize(ncols);
+        st->column_types.resize(ncols);
+        for (uint64_t c = 0; c < ncols; ++c) {
+            in->string(&st->column_names[c]);
+            st->column_types[c] = in->byte();
+        }
+    } else if (fresh) {
+        return false;
+    }
+    const uint64_t rows = in->varint();
+    const size_t ncols = st->column_names.size();
+    if (!in->ok || (ncols > 0 && rows > static_cast<uint64_t>(in->end - in->p) / ncols + 1)) return false;
+
+    const size_t count = static_cast<size_t>(rows) * ncols;
+    spare->cells.assign(count, 0);
+    spare->cell_strs.resize(count);
+    spare->cell_null.assign(count, 0);
+    for (size_t c = 0; c < ncols && in->ok; ++c) {
+        const int32_t type = st->column_types[c];
+        if (!knownType(type)) continue;
+        for (size_t r = 0; r < rows && in->ok; ++r) {
+            const size_t idx = r * ncols + c;
+            const bool has_prev = !schema && r < st->rows;
+            if (type == HMON_VAL_STRING) {
+                const uint64_t tag = in->varint();
+                if (tag == 0) {
+                    if (!has_prev) return false;
+                    spare->cell_null[idx] = st->cell_null[idx];
+                    spare->cell_strs[idx].swap(st->cell_strs[idx]);
+                } else if (tag == 1) {
+                    spare->cell_null[idx] = 1;
+                } else {
+                    const uint64_t n = tag - 2;
+                    if (n > static_cast<uint64_t>(in->end - in->p)) return false;
+                    spare->cell_strs[idx].assign(reinterpret_cast<const char*>(in->p), n);
+                    in->p += n;
+                }
+                continue;
+            }
+            const uint64_t prev = has_prev ? st->cells[idx] : 0;
+            spare->cells[idx] = type == HMON_VAL_DOUBLE ? in->xorWith(prev)
+                                                        : prev + static_cast<uint64_t>(in->zigzag());
+        }
+    }
+    st->rows = static_cast<uint32_t>(rows);
+    std::swap(st->cells, spare->cells);
+    std::swap(st->cell_strs, spare->cell_strs);
+    std::swap(st->cell_null, spare->cell_null);
+    return in->ok;
+}
+
+/*
+ * Walk the header and every complete frame record; `on_frame` gets each
+ * frame's offset, size, time and kind.  Returns the offset just past the
+ * last complete record, or 0 if the header is not ours.
+ */
+template <typename OnFrame>
+size_t scanRecording(const uint8_t* data, size_t size, std::string* host, OnFrame&& on_frame) {
+    if (size < sizeof(kRecordingMagic) || std::memcmp(data, kRecordingMagic, sizeof(kRecordingMagic)) != 0) return 0;
+    Cursor in{data + sizeof(kRecordingMagic), data + size};
+    const uint64_t version = in.varint();
+    in.string(host);
+    if (!in.ok || version != kRecordingVersion) return 0;
+
+    size_t end = static_cast<size_t>(in.p - data);
+    bool started = false;
+    int64_t time_ms = 0;
+    while (in.p < in.end) {
+        const uint64_t frame_size = in.varint();
+        if (!in.ok || frame_size == 0 || frame_size > kMaxFrameBytes || frame_size > static_cast<uint64_t>(in.end - in.p)) break;
+        Cursor head{in.p, in.p + frame_size};
+        const uint8_t kind = head.byte();
+        const int64_t delta = head.zigzag();
+        if (!head.ok || (kind != 'K' && kind != 'D')) break;
+        time_ms = kind == 'K' ? delta : time_ms + delta;
+        started |= kind == 'K';
+        if (started) on_frame(static_cast<size_t>(in.p - data), static_cast<uint32_t>(frame_size), time_ms, kind == 'K');
+        in.p += frame_size;
+        end = static_cast<size_t>(in.p - data);
+    }
+    return end;
+}
+
+bool writeAll(int fd, const std::string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        const ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+}
+
+void putVarint(std::string* out, uint64_t value) {
+    while (value >= 0x80) {
+        out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+size_t readVarint(const uint8_t* p, const uint8_t* end, uint64_t* value) {
+    Cursor in{p, end};
+    *value = in.varint();
+    return in.ok ? static_cast<size_t>(in.p - p) : 0;
+}
+
+void SnapshotEncoder::encode(const MetricRegistry& registry, int64_t time_ms, bool key_frame, std::string* out) {
+    if (key_frame) {
+        local_of_.clear();
+        metric_of_.clear();
+        values_.clear();
+        last_time_ms_ = 0;
+    }
+    out->push_back(key_frame ? 'K' : 'D');
+    putZigzag(out, time_ms - last_time_ms_);
+    last_time_ms_ = time_ms;
+
+    /* New keys get the next frame ids, in registry id order. */
+    if (local_of_.size() < registry.size()) local_of_.resize(registry.size(), kNoFrameId);
+    const size_t first_new = metric_of_.size();
+    for (MetricId id = 0; id < registry.size(); ++id) {
+        if (local_of_[id] != kNoFrameId || !registry.present(id)) continue;
+        local_of_[id] = static_cast<uint32_t>(metric_of_.size());
+        metric_of_.push_back(id);
+        values_.emplace_back();
+    }
+    putVarint(out, metric_of_.size() - first_new);
+    for (size_t i = first_new; i < metric_of_.size(); ++i) putString(out, registry.key(metric_of_[i]));
+
+    scratch_.clear();
+    size_t removed = 0;
+    for (size_t l = 0; l < values_.size(); ++l) {
+        if (!values_[l].present || registry.present(metric_of_[l])) continue;
+        values_[l].present = false;
+        putVarint(&scratch_, l);
+        ++removed;
+    }
+    putVarint(out, removed);
+    out->append(scratch_);
+
+    scratch_.clear();
+    size_t changed_count = 0;
+    for (size_t l = 0; l < values_.size(); ++l) {
+        const MetricId id = metric_of_[l];
+        if (!registry.present(id)) continue;
+        const hmon_metric_value v = registry.value(id);
+        if (!knownType(v.type) && !(v.type == HMON_VAL_TABLE && v.v.table)) continue;
+
+        FrameValue& st = values_[l];
+        const bool fresh = !st.present || st.type != v.type;
+        const size_t mark = scratch_.size();
+        putVarint(&scratch_, l);
+        scratch_.push_back(static_cast<char>(v.type));
+        bool changed = fresh;
+        switch (v.type) {
+        case HMON_VAL_INT64: {
+            const uint64_t cur = static_cast<uint64_t>(v.v.i64), prev = fresh ? 0 : st.bits;
+            changed |= cur != prev;
+            putZigzag(&scratch_, static_cast<int64_t>(cur - prev));
+            st.bits = cur;
+            break;
+        }
+        case HMON_VAL_DOUBLE: {
+            const uint64_t cur = doubleBits(v.v.f64), prev = fresh ? 0 : st.bits;
+            changed |= cur != prev;
+            putXor(&scratch_, prev, cur);
+            st.bits = cur;
+            break;
+        }
+        case HMON_VAL_BOOL: {
+            const uint64_t cur = v.v.b ? 1 : 0;
+            changed |= cur != st.bits;
+            scratch_.push_back(static_cast<char>(cur));
+            st.bits = cur;
+            break;
+        }
+        case HMON_VAL_STRING: {
+            const char* s = v.v.str ? v.v.str : "";
+            changed |= st.str != s;
+            putString(&scratch_, s);
+            if (changed) st.str = s;
+            break;
+        }
+        default:
+            changed |= encodeTable(&scratch_, &st, &spare_, *v.v.table, fresh);
+            break;
+        }
+        st.present = true;
+        st.type = v.type;
+        if (changed) ++changed_count;
+        else scratch_.resize(mark);
+    }
+    putVarint(out, changed_count);
+    out->append(scratch_);
+}
+
+bool SnapshotDecoder::decode(const uint8_t* data, size_t size) {
+    Cursor in{data, data + size};
+    const uint8_t kind = in.byte();
+    if (kind == 'K') {
+        keys_.clear();
+        values_.clear();
+        time_ms_ = 0;
+        started_ = true;
+    } else if (kind != 'D' || !started_) {
+        return false;
+    }
+    time_ms_ += in.zigzag();
+
+    const uint64_t new_keys = in.varint();
+    for (uint64_t i = 0; i < new_keys && in.ok; ++i) {
+        keys_.emplace_back();
+        in.string(&keys_.back());
+        values_.emplace_back();
+    }
+
+    const uint64_t removed = in.varint();
+    for (uint64_t i = 0; i < removed && in.ok; ++i) {
+        const uint64_t id = in.varint();
+        if (id >= values_.size()) return false;
+        values_[id].present = false;
+    }
+
+    const uint64_t changed = in.varint();
+    for (uint64_t i = 0; i < changed && in.ok; ++i) {
+        const uint64_t id = in.varint();
+        const int32_t type = in.byte();
+        if (!in.ok || id >= values_.size()) return false;
+        FrameValue& st = values_[id];
+        const bool fresh = !st.present || st.type != type;
+        switch (type) {
+        case HMON_VAL_INT64:  st.bits = (fresh ? 0 : st.bits) + static_cast<uint64_t>(in.zigzag()); break;
+        case HMON_VAL_DOUBLE: st.bits = in.xorWith(fresh ? 0 : st.bits); break;
+        case HMON_VAL_BOOL:   st.bits = in.byte(); break;
+        case HMON_VAL_STRING: in.string(&st.str); break;
+        case HMON_VAL_TABLE:
+            if (!decodeTable(&in, &st, &spare_, fresh)) return false;
+            break;
+        default:
+            return false;
+        }
+        st.present = true;
+        st.type = type;
+    }
+    return in.ok && in.p == in.end;
+}
+
+hmon_metric_list SnapshotDecoder::list() {
+    items_.clear();
+    tables_.resize(values_.size());
+    for (size_t id = 0; id < values_.size(); ++id) {
+        const FrameValue& st = values_[id];
+        if (!st.present) continue;
+        hmon_metric m{};
+        m.key = keys_[id].c_str();
+        m.value.type = st.type;
+        switch (st.type) {
+        case HMON_VAL_INT64:  m.value.v.i64 = static_cast<int64_t>(st.bits); break;
+        case HMON_VAL_DOUBLE: m.value.v.f64 = bitsDouble(st.bits); break;
+        case HMON_VAL_BOOL:   m.value.v.b = static_cast<int32_t>(st.bits); break;
+        case HMON_VAL_STRING: m.value.v.str = st.str.c_str(); break;
+        case HMON_VAL_TABLE: {
+            TableView& view = tables_[id];
+            const size_t ncols = st.column_names.size();
+            view.columns.resize(ncols);
+            for (size_t c = 0; c < ncols; ++c) view.columns[c] = {st.column_names[c].c_str(), st.column_types[c]};
+            view.cells.resize(static_cast<size_t>(st.rows) * ncols);
+            for (size_t idx = 0; idx < view.cells.size(); ++idx) {
+                hmon_table_cell& cell = view.cells[idx];
+                switch (st.column_types[idx % ncols]) {
+                case HMON_VAL_STRING: cell.str = st.cell_null[idx] ? nullptr : st.cell_strs[idx].c_str(); break;
+                case HMON_VAL_DOUBLE: cell.f64 = bitsDouble(st.cells[idx]); break;
+                case HMON_VAL_BOOL:   cell.b = static_cast<int32_t>(static_cast<int64_t>(st.cells[idx])); break;
+                default:              cell.i64 = static_cast<int64_t>(st.cells[idx]); break;
+                }
+            }
+            view.table = hmon_table{view.columns.data(), static_cast<uint32_t>(ncols), st.rows, view.cells.data()};
+            m.value.v.table = &view.table;
+            break;
+        }
+        default:
+            continue;
+        }
+        items_.push_back(m);
+    }
+    return hmon_metric_list{items_.data(), items_.size(), items_.size()};
+}
+
+RecordingWriter::~RecordingWriter() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+int RecordingWriter::open(const std::string& path, const std::string& host) {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        std::cerr << "[hmon] record: cannot open " << path << ": " << std::strerror(errno) << "\n";
+        return -1;
+    }
+    struct stat st{};
+    fstat(fd_, &st);
+    if (st.st_size == 0) {
+        std::string header(kRecordingMagic, sizeof(kRecordingMagic));
+        putVarint(&header, kRecordingVersion);
+        putString(&header, host);
+        if (!writeAll(fd_, header)) {
+            std::cerr << "[hmon] record: write " << path << ": " << std::strerror(errno) << "\n";
+            return -1;
+        }
+        return 0;
+    }
+    /* Appending: drop a torn record left by a crash so the new frames stay reachable. */
+    std::string existing(static_cast<size_t>(st.st_size), '\0');
+    const bool read_ok = pread(fd_, existing.data(), existing.size(), 0) == static_cast<ssize_t>(existing.size());
+    std::string old_host;
+    const size_t end = read_ok ? scanRecording(reinterpret_cast<const uint8_t*>(existing.data()), existing.size(),
+                                               &old_host, [](size_t, uint32_t, int64_t, bool) {})
+                               : 0;
+    if (end == 0) {
+        std::cerr << "[hmon] record: " << path << " exists and is not an hmon recording\n";
+        return -1;
+    }
+    if (end < existing.size() && ftruncate(fd_, static_cast<off_t>(end)) != 0) {
+        std::cerr << "[hmon] record: truncate " << path << ": " << std::strerror(errno) << "\n";
+        return -1;
+    }
+    return 0;
+}
+
+int RecordingWriter::write(const MetricRegistry& registry, int64_t time_ms) {
+    if (fd_ < 0) return -1;
+    const bool key_frame = frames_since_key_ >= kKeyFrameInterval;
+    frames_since_key_ = key_frame ? 1 : frames_since_key_ + 1;
+    frame_.clear();
+    encoder_.encode(registry, time_ms, key_frame, &frame_);
+    record_.clear();
+    putVarint(&record_, frame_.size());
+    record_.append(frame_);
+    if (!writeAll(fd_, record_)) {
+        /* A short write leaves a truncated tail the reader ignores; start clean next time. */
+        frames_since_key_ = kKeyFrameInterval;
+        return -1;
+    }
+    return 0;
+}
+
+RecordingReader::~RecordingReader() {
+    if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+int RecordingReader::open(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "[hmon] replay: cannot open " << path << ": " << std::strerror(errno) << "\n";
+        return -1;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size <= static_cast<off_t>(sizeof(kRecordingMagic))) {
+        std::cerr << "[hmon] replay: " << path << " is empty\n";
+        ::close(fd);
+        return -1;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        std::cerr << "[hmon] replay: mmap " << path << ": " << std::strerror(errno) << "\n";
+        size_ = 0;
+        return -1;
+    }
+    data_ = static_cast<const uint8_t*>(map);
+
+    const size_t end = scanRecording(data_, size_, &host_, [this](size_t offset, uint32_t size, int64_t time_ms, bool key) {
+        frames_.push_back(Frame{offset, size, time_ms, key});
+    });
+    if (end == 0) {
+        std::cerr << "[hmon] replay: " << path << " is not a version " << kRecordingVersion << " hmon recording\n";
+        return -1;
+    }
+    if (frames_.empty()) {
+        std::cerr << "[hmon] replay: " << path << " has no frames\n";
+        return -1;
+    }
+    return 0;
+}
+
+size_t RecordingReader::frame_at(int64_t time_ms) const {
+    auto it = std::upper_bound(frames_.begin(), frames_.end(), time_ms,
+                               [](int64_t t, const Frame& f) { return t < f.time_ms; });
+    return it == frames_.begin() ? 0 : static_cast<size_t>(it - frames_.begin()) - 1;
+}
+
+bool RecordingReader::seek(size_t frame) {
+    if (frame >= frames_.size()) return false;
+    if (frame == position_) return true;
+    size_t start = frame;
+    while (start > 0 && !frames_[start].key) --start;
+    /* Moving forward past no key frame: continue from where we are. */
+    if (position_ != SIZE_MAX && position_ < frame && position_ >= start) start = position_ + 1;
+    for (size_t i = start; i <= frame; ++i) {
+        if (!decoder_.decode(data_ + frames_[i].offset, frames_[i].size)) {
+            position_ = SIZE_MAX;
+            return false;
+        }
+    }
+    position_ = frame;
+    return true;
+}
+
+} /* namespace hmon::core */
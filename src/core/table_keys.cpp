@@ -0,0 +1,47 @@
+#include "hmon/table_keys.hpp"
+
+#include <cstring>
+
+namespace hmon::core {
+
+bool isKeyColumn(const hmon_table& table, uint32_t col) {
+    const hmon_table_column& column = table.columns[col];
+    if (column.type == HMON_VAL_STRING) {
+        uint32_t first = 0;
+        while (first < table.column_count && table.columns[first].type != HMON_VAL_STRING) ++first;
+        if (first == col) return true;
+    } else if (column.type != HMON_VAL_INT64) {
+        return false;
+    }
+    if (!column.name) return false;
+    for (const char* id : {"pid", "port", "node", "cpu", "core", "gpu", "socket", "group", "addr", "metric",
+                           "instance"}) {
+        if (std::strcmp(column.name, id) == 0) return true;
+    }
+    return false;
+}
+
+std::string rowName(const hmon_table& table, uint32_t row) {
+    const hmon_table_cell* cells = hmon_table_row_const(&table, row);
+    std::string name;
+    bool keyed = false;
+    auto append = [&](const std::string& part) {
+        if (part.empty()) return;
+        if (!name.empty()) name.push_back('#');
+        name += part;
+    };
+    /* Text first, so a process reads as "bash#1234" whichever column comes first. */
+    for (uint32_t c = 0; c < table.column_count; ++c) {
+        if (table.columns[c].type != HMON_VAL_STRING || !isKeyColumn(table, c)) continue;
+        keyed = true;
+        if (cells[c].str) append(cells[c].str);
+    }
+    for (uint32_t c = 0; c < table.column_count; ++c) {
+        if (table.columns[c].type != HMON_VAL_INT64 || !isKeyColumn(table, c)) continue;
+        keyed = true;
+        if (cells[c].i64 != HMON_TABLE_NULL_I64) append(std::to_string(cells[c].i64));
+    }
+    return keyed ? name : std::to_string(row);
+}
+
+} /* namespace hmon::core */
@@ -1,23 +1,30 @@
 #include <ncurses.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <clocale>
+#include <csignal>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <cwchar>
+#include <filesystem>
 #include <fstream>
 #include <future>
 #include <iomanip>
 #include <iostream>
 #include <numeric>
 #include <limits>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -43,8 +50,14 @@
 #include <sys/socket.h>
 #endif
 
+#include "hmon/alerts.hpp"
+#include "hmon/exporter.hpp"
+#include "hmon/fleet.hpp"
+#include "hmon/history.hpp"
 #include "hmon/plugin_abi.h"
 #include "hmon/plugin_manager.hpp"
+#include "hmon/recording.hpp"
+#include "hmon/triple_buffer.hpp"
 #include "hmon/embed_plugins.hpp"
 #include "metrics/types.hpp"
 #include "metrics/version.hpp"
@@ -111,27 +124,50 @@ std::optional<double> getSwapUsagePercent() {
   return 100.0 * static_cast<double>(used) / static_cast<double>(total);
 }
 
-enum class SortMode { kCpu, kMem, kGpu, kPid };
+/* Values match the process plugin's process.sort and process.group controls. */
+enum class SortMode { kCpu, kMem, kGpu, kPid, kIo, kNet };
+enum class GroupMode { kNone, kCgroup, kContainer, kUnit, kTree };
 enum class ZenFocus { kNone, kPorts, kServices, kDocker };
 
 struct Config {
   int refresh_interval_ms = 1000;
   size_t top_processes = 8;
   size_t history_points = 2048;
+  size_t history_zoom = 0;
   bool show_gpu = true;
   bool show_history = true;
   bool zen_mode = false;
   int lock_pid = -1;
   int selected_pid = -1;
   SortMode sort_mode = SortMode::kCpu;
+  GroupMode group_mode = GroupMode::kNone;
+  int drill_group = -1;                 /* group id whose members are listed instead of the groups */
+  std::string drill_group_name;
+  std::string process_filter;           /* '/' search over every process, not only the top rows */
+  bool filter_editing = false;
   bool show_colors = true;
   bool show_help = false;
   bool show_version = false;
   bool show_selection_highlight = false;
+  bool show_plugin_timings = false;
+  double cpu_budget_pct = 1.0;
   int zen_docker_scroll = 0;
   int zen_ports_scroll = 0;
   int zen_services_scroll = 0;
   ZenFocus zen_focus = ZenFocus::kNone;
+  bool docker_cgroup_backend = false;
+  bool headless = false;
+  std::string listen_address;
+  uint16_t listen_port = 9464;
+  bool listen_set = false;
+  std::string record_path;
+  std::string replay_path;
+  std::string alerts_path;
+  bool alerts_set = false;
+  /* Plugins run in helper processes, with their collect deadline in ms (0 = default). */
+  std::vector<std::pair<std::string, int>> isolate;
+  std::string push_target;
+  std::string fleet_target;
   std::optional<std::string> cli_error;
 };
 
@@ -143,13 +179,43 @@ struct Rect {
 };
 
 struct MetricsHistory {
-  std::vector<double> cpu_usage;
-  std::vector<double> cpu_temp;
-  std::vector<double> ram_usage;
-  std::vector<double> gpu_usage;
-  std::vector<double> gpu_vram_usage;
-  std::vector<double> disk_usage;
+  explicit MetricsHistory(size_t capacity)
+      : cpu_usage(capacity), cpu_temp(capacity), ram_usage(capacity),
+        gpu_usage(capacity), gpu_vram_usage(capacity), disk_usage(capacity) {}
+
+  hmon::core::HistorySeries cpu_usage;
+  hmon::core::HistorySeries cpu_temp;
+  hmon::core::HistorySeries ram_usage;
+  hmon::core::HistorySeries gpu_usage;
+  hmon::core::HistorySeries gpu_vram_usage;
+  hmon::core::HistorySeries disk_usage;
+
+  /* Fixed order, also the on-disk order of the history file. */
+  std::array<hmon::core::HistorySeries*, 6> all() {
+    return {&cpu_usage, &cpu_temp, &ram_usage, &gpu_usage, &gpu_vram_usage, &disk_usage};
+  }
+};
+
+/* Time spans the history graph cycles through; 0 is the live view of raw samples. */
+struct HistoryZoom {
+  const char* label;
+  int64_t span_ms;
+};
+
+constexpr HistoryZoom kHistoryZooms[] = {
+    {"live", 0},
+    {"10m", 10LL * 60 * 1000},
+    {"1h", 60LL * 60 * 1000},
+    {"6h", 6LL * 60 * 60 * 1000},
+    {"24h", 24LL * 60 * 60 * 1000},
+    {"7d", 7LL * 24 * 60 * 60 * 1000},
 };
+constexpr size_t kHistoryZoomCount = sizeof(kHistoryZooms) / sizeof(kHistoryZooms[0]);
+
+int64_t wallClockMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch()).count();
+}
 
 struct BrailleCanvas {
   int width = 0;
@@ -157,12 +223,39 @@ struct BrailleCanvas {
   std::vector<uint16_t> cells;
 };
 
+/*
+ * One series' canvas, kept across frames.  In the live view a new raw sample
+ * shifts the canvas left a column and only the newest segments are
+ * rasterised; a zoomed view re-plots only when its data or column grid
+ * moved.  A change of size, scale or zoom always re-plots from scratch.
+ */
+struct HistoryCanvas {
+  BrailleCanvas canvas;
+  int64_t span_ms = -1;
+  double min_value = 0.0;
+  double max_value = 0.0;
+  uint64_t pushed = 0;      /* live view: raw().pushed() when last plotted */
+  uint64_t plot_key = 0;    /* zoomed view: hash of what the last plot used */
+};
+
+struct HistoryGraphs {
+  HistoryCanvas cpu, cpu_temp, ram, gpu, disk;
+};
+
 constexpr uint16_t kDirUp = 0x01;
 constexpr uint16_t kDirDown = 0x02;
 constexpr uint16_t kDirLeft = 0x04;
 constexpr uint16_t kDirRight = 0x08;
 constexpr uint16_t kDirPoint = 0x10;
 
+/* Terminal focus reports, mapped to key codes past ncurses' own. */
+constexpr int kKeyFocusIn = KEY_MAX + 1;
+constexpr int kKeyFocusOut = KEY_MAX + 2;
+/* getch() timeout while the terminal is unfocused; the frame keeps whatever arrives. */
+constexpr int kUnfocusedTimeoutMs = 30000;
+/* Gap between the two startup samples, so the first frame already shows rates. */
+constexpr auto kPrimeSample = std::chrono::milliseconds(100);
+
 void printHelp(const char* program_name) {
   std::cout << "hmon " << version::kCurrent << "\n\n";
   std::cout << "Usage: " << program_name << " [OPTIONS]\n\n";
@@ -175,11 +268,26 @@ void printHelp(const char* program_name) {
   std::cout << "  --no-history            Disable history\n";
   std::cout << "  --zen                   Zen mode\n";
   std::cout << "  --pid <id>              Focus on a specific PID\n";
-  std::cout << "  --no-color              Disable colors\n\n";
+  std::cout << "  --no-color              Disable colors\n";
+  std::cout << "  --docker-backend <b>    Container stats from 'api' (default) or 'cgroup'\n";
+  std::cout << "  --cpu-budget <pct>      Collector CPU budget, % of a core (0 = fixed intervals, default: 1)\n";
+  std::cout << "  --headless              No TUI; serve Prometheus metrics over HTTP\n";
+  std::cout << "  --listen [addr:]port    Exporter address (default: 9464 on all interfaces)\n";
+  std::cout << "  --record <file.hmr>     Append every refresh's metrics to a recording\n";
+  std::cout << "  --replay <file.hmr>     Play a recording back instead of live metrics\n";
+  std::cout << "  --alerts <file>         Alert rules (default: ~/.config/hmon/alerts.conf if present)\n";
+  std::cout << "  --isolate <p[=ms],...>  Run plugins in helper processes with a collect deadline\n";
+  std::cout << "  --push <host:port>      Stream metrics to a fleet viewer (TCP, or a socket path)\n";
+  std::cout << "  --fleet <[addr:]port>   Fleet viewer for --push agents (TCP, or a socket path)\n\n";
   std::cout << "Controls:\n";
   std::cout << "  q       Quit    ?       Help    z       Zen mode\n";
   std::cout << "  s       Sort    l       Lock    u       Unlock\n";
-  std::cout << "  r       Refresh +/-     Speed\n";
+  std::cout << "  g       Group   Enter   Open group  Esc  Back to groups\n";
+  std::cout << "  r       Refresh +/-     Speed   h       History span\n";
+  std::cout << "Replay:\n";
+  std::cout << "  Space   Pause   </>     Seek 1m f       Playback speed\n";
+  std::cout << "Fleet:\n";
+  std::cout << "  j/k     Select  Enter   Drill in b       Back to fleet\n";
 }
 
 void printVersion() {
@@ -280,10 +388,138 @@ Config parseArgs(int argc, char* argv[]) {
       continue;
     }
 
+    if (arg == "--docker-backend") {
+      if (i + 1 >= argc) {
+        config.cli_error = "--docker-backend requires 'api' or 'cgroup'.";
+        return config;
+      }
+      const std::string backend = argv[++i];
+      if (backend != "api" && backend != "cgroup") {
+        config.cli_error = "Invalid docker backend. Use 'api' or 'cgroup'.";
+        return config;
+      }
+      config.docker_cgroup_backend = backend == "cgroup";
+      continue;
+    }
+
+    if (arg == "--cpu-budget") {
+      if (i + 1 >= argc) {
+        config.cli_error = "--cpu-budget requires a percentage between 0 and 100.";
+        return config;
+      }
+      double pct = -1.0;
+      try {
+        size_t used = 0;
+        pct = std::stod(argv[++i], &used);
+        if (argv[i][used] != '\0') pct = -1.0;
+      } catch (...) {
+      }
+      if (!(pct >= 0.0 && pct <= 100.0)) {
+        config.cli_error = "--cpu-budget requires a percentage between 0 and 100.";
+        return config;
+      }
+      config.cpu_budget_pct = pct;
+      continue;
+    }
+
+    if (arg == "--headless") {
+      config.headless = true;
+      continue;
+    }
+
+    if (arg == "--listen") {
+      if (i + 1 >= argc) {
+        config.cli_error = "--listen requires [address:]port.";
+        return config;
+      }
+      const std::string value = argv[++i];
+      const size_t colon = value.rfind(':');
+      int port = 0;
+      if (!parseIntArg(value.substr(colon == std::string::npos ? 0 : colon + 1).c_str(), 1, 65535, &port)) {
+        config.cli_error = "Invalid listen port. Use a value between 1 and 65535.";
+        return config;
+      }
+      config.listen_address = colon == std::string::npos ? std::string() : value.substr(0, colon);
+      config.listen_port = static_cast<uint16_t>(port);
+      config.listen_set = true;
+      continue;
+    }
+
+    if (arg == "--record" || arg == "--replay") {
+      if (i + 1 >= argc) {
+        config.cli_error = arg + " requires a file path.";
+        return config;
+      }
+      (arg == "--record" ? config.record_path : config.replay_path) = argv[++i];
+      continue;
+    }
+
+    if (arg == "--alerts") {
+      if (i + 1 >= argc) {
+        config.cli_error = "--alerts requires a file path.";
+        return config;
+      }
+      config.alerts_path = argv[++i];
+      config.alerts_set = true;
+      continue;
+    }
+
+    if (arg == "--isolate") {
+      if (i + 1 >= argc) {
+        config.cli_error = "--isolate requires a comma-separated plugin list.";
+        return config;
+      }
+      std::stringstream list(argv[++i]);
+      std::string item;
+      while (std::getline(list, item, ',')) {
+        if (item.empty()) continue;
+        const size_t eq = item.find('=');
+        int deadline_ms = 0;
+        if (eq != std::string::npos &&
+            !parseIntArg(item.c_str() + eq + 1, 100, 600000, &deadline_ms)) {
+          config.cli_error = "--isolate deadlines are milliseconds between 100 and 600000.";
+          return config;
+        }
+        config.isolate.emplace_back(item.substr(0, eq), deadline_ms);
+      }
+      continue;
+    }
+
+    if (arg == "--push" || arg == "--fleet") {
+      if (i + 1 >= argc) {
+        config.cli_error = arg + (arg == "--push" ? " requires host:port or a socket path." :
+                                                    " requires [address:]port or a socket path.");
+        return config;
+      }
+      const std::string value = argv[++i];
+      /* Anything with a slash is a Unix socket path. */
+      if (value.find('/') == std::string::npos) {
+        const size_t colon = value.rfind(':');
+        int port = 0;
+        if ((arg == "--push" && (colon == std::string::npos || colon == 0)) ||
+            !parseIntArg(value.substr(colon == std::string::npos ? 0 : colon + 1).c_str(), 1, 65535, &port)) {
+          config.cli_error = "Invalid " + arg + " target '" + value + "'.";
+          return config;
+        }
+      }
+      (arg == "--push" ? config.push_target : config.fleet_target) = value;
+      continue;
+    }
+
     config.cli_error = "Unknown option: " + arg;
     return config;
   }
 
+  if (!config.replay_path.empty() && (config.headless || !config.record_path.empty() || !config.push_target.empty())) {
+    config.cli_error = "--replay cannot be combined with --headless, --record or --push.";
+  }
+  if (!config.fleet_target.empty() && (config.headless || !config.record_path.empty() ||
+                                       !config.replay_path.empty() || !config.push_target.empty())) {
+    config.cli_error = "--fleet cannot be combined with --headless, --record, --replay or --push.";
+  }
+  if (!config.isolate.empty() && (!config.replay_path.empty() || !config.fleet_target.empty())) {
+    config.cli_error = "--isolate only applies to live plugins, not --replay or --fleet.";
+  }
   return config;
 }
 
@@ -339,6 +575,44 @@ std::string formatGpuVramUsage(const std::optional<double>& used, const std::opt
   return formatMibOrGib(used) + " / " + formatMibOrGib(total);
 }
 
+/* The 's' key's cycle: CPU, MEM, GPU, I/O, NET, PID. */
+SortMode nextSortMode(SortMode mode) {
+  switch (mode) {
+    case SortMode::kCpu: return SortMode::kMem;
+    case SortMode::kMem: return SortMode::kGpu;
+    case SortMode::kGpu: return SortMode::kIo;
+    case SortMode::kIo: return SortMode::kNet;
+    case SortMode::kNet: return SortMode::kPid;
+    case SortMode::kPid: break;
+  }
+  return SortMode::kCpu;
+}
+
+GroupMode nextGroupMode(GroupMode mode) {
+  switch (mode) {
+    case GroupMode::kNone: return GroupMode::kCgroup;
+    case GroupMode::kCgroup: return GroupMode::kContainer;
+    case GroupMode::kContainer: return GroupMode::kUnit;
+    case GroupMode::kUnit: return GroupMode::kTree;
+    case GroupMode::kTree: break;
+  }
+  return GroupMode::kNone;
+}
+
+const char* groupModeLabel(GroupMode mode) {
+  switch (mode) {
+    case GroupMode::kCgroup: return "CGROUP";
+    case GroupMode::kContainer: return "CONTAINER";
+    case GroupMode::kUnit: return "UNIT";
+    case GroupMode::kTree: return "TREE";
+    case GroupMode::kNone: break;
+  }
+  return "";
+}
+
+/* Groups are listed while grouping is on and none is open. */
+bool showGroups(const Config& config) { return config.group_mode != GroupMode::kNone && config.drill_group <= 0; }
+
 bool processListContainsPid(const std::vector<ProcessInfo>& processes, int pid) {
   if (pid <= 0) {
     return false;
@@ -544,24 +818,151 @@ void drawBar(WINDOW* win, int row, const std::string& label, double percent, int
   wattroff(win, A_BOLD);
 }
 
-WINDOW* createPanel(const Rect& rect, const std::string& title) {
-  if (rect.h < 4 || rect.w < 20) {
-    return nullptr;
-  }
-  WINDOW* panel = newwin(rect.h, rect.w, rect.y, rect.x);
-  
+/* A firing alert turns the frame red and names its rule in the title. */
+void drawPanelFrame(WINDOW* panel, const std::string& title, const AlertInfo* alert = nullptr) {
+  const int frame_pair = alert ? 3 : 4;
   if (has_colors()) {
-    wattron(panel, COLOR_PAIR(4));
+    wattron(panel, COLOR_PAIR(frame_pair));
     wattron(panel, A_BOLD);
   }
   box(panel, ACS_VLINE, ACS_HLINE);
   if (has_colors()) {
-    wattroff(panel, COLOR_PAIR(4));
+    wattroff(panel, COLOR_PAIR(frame_pair));
     wattroff(panel, A_BOLD);
   }
   
   mvwprintw(panel, 0, 2, " %s ", title.c_str());
-  return panel;
+  if (alert) {
+    std::string text = " ! " + alert->rule + (alert->instance.empty() ? "" : " [" + alert->instance + "]") + " ";
+    const int col = 4 + static_cast<int>(title.size());
+    wattron(panel, A_BOLD);
+    if (has_colors()) wattron(panel, COLOR_PAIR(3));
+    mvwaddnstr(panel, 0, col, text.c_str(), std::max(0, getmaxx(panel) - col - 2));
+    if (has_colors()) wattroff(panel, COLOR_PAIR(3));
+    wattroff(panel, A_BOLD);
+  }
+}
+
+/* FNV-1a over a panel's inputs, with doubles quantised to what the panel displays. */
+class RenderHash {
+ public:
+  RenderHash& add(int64_t v) {
+    for (int i = 0; i < 8; ++i) mix(static_cast<uint8_t>(static_cast<uint64_t>(v) >> (i * 8)));
+    return *this;
+  }
+  RenderHash& add(double v, double step = 0.1) { return add(static_cast<int64_t>(std::llround(v / step))); }
+  RenderHash& add(const std::string& s) {
+    for (char c : s) mix(static_cast<uint8_t>(c));
+    return add(static_cast<int64_t>(s.size()));
+  }
+  template <typename T>
+  RenderHash& add(const std::optional<T>& v) {
+    add(static_cast<int64_t>(v.has_value()));
+    if (v) add(static_cast<std::conditional_t<std::is_floating_point_v<T>, double, int64_t>>(*v));
+    return *this;
+  }
+  RenderHash& add(const Rect& r) { return add(int64_t{r.y}).add(int64_t{r.x}).add(int64_t{r.h}).add(int64_t{r.w}); }
+  uint64_t value() const { return hash_; }
+
+ private:
+  void mix(uint8_t byte) {
+    hash_ ^= byte;
+    hash_ *= 1099511628211ULL;
+  }
+
+  uint64_t hash_ = 1469598103934665603ULL;
+};
+
+/*
+ * Dashboard windows kept across frames.  A panel is redrawn only when the hash
+ * of its inputs changes, so an idle panel costs neither formatting nor terminal
+ * output.  Any change of layout, or anything drawn over the panels (help
+ * overlay, zen mode, resize), drops the cache and repaints the whole screen.
+ */
+struct PanelCache {
+  WINDOW* win = nullptr;
+  uint64_t input_hash = 0;
+};
+
+struct RenderCache {
+  PanelCache cpu, ram, gpu, net, disk, history;
+  /* Survives invalidate(): the canvases re-plot themselves when the graph size changes. */
+  HistoryGraphs history_graphs;
+  uint64_t layout_hash = 0;
+  bool valid = false;
+
+  std::array<PanelCache*, 6> panels() { return {&cpu, &ram, &gpu, &net, &disk, &history}; }
+
+  void invalidate() {
+    for (auto* panel : panels()) {
+      if (panel->win) delwin(panel->win);
+      *panel = PanelCache{};
+    }
+    valid = false;
+  }
+
+  ~RenderCache() { invalidate(); }
+};
+
+/* Return `cache`'s window for `rect`, or nullptr if the rect is too small for a panel. */
+WINDOW* acquirePanel(PanelCache* cache, const Rect& rect) {
+  if (rect.h < 4 || rect.w < 20) {
+    return nullptr;
+  }
+  if (!cache->win) cache->win = newwin(rect.h, rect.w, rect.y, rect.x);
+  return cache->win;
+}
+
+/* Redraw the panel if its inputs changed since the last frame. */
+/* Body of a panel whose plugins have not reported yet. */
+void drawPanelPlaceholder(WINDOW* panel) {
+  int h = 0, w = 0;
+  getmaxyx(panel, h, w);
+  if (h < 3 || w < 6) return;
+  if (has_colors()) wattron(panel, COLOR_PAIR(7));
+  mvwaddnstr(panel, 1, 2, "Collecting...", w - 4);
+  if (has_colors()) wattroff(panel, COLOR_PAIR(7));
+}
+
+template <typename Render>
+void updatePanel(PanelCache* cache, WINDOW* panel, const std::string& title, const AlertInfo* alert,
+                 uint64_t input_hash, Render&& render) {
+  if (alert) input_hash = RenderHash().add(static_cast<int64_t>(input_hash)).add(alert->rule).add(alert->instance).value();
+  if (!panel || cache->input_hash == input_hash) return;
+  cache->input_hash = input_hash;
+  werase(panel);
+  drawPanelFrame(panel, title, alert);
+  render(panel);
+  wnoutrefresh(panel);
+}
+
+enum class AlertPanel { kNone, kCpu, kRam, kGpu, kNet, kDisk, kProcesses };
+
+/* The panel showing an alert's metric; PSI rows belong to the resource's panel. */
+AlertPanel alertPanel(const AlertInfo& alert) {
+  auto under = [&](const char* prefix) { return alert.metric.rfind(prefix, 0) == 0; };
+  if (under("psi.")) {
+    if (alert.instance == "cpu") return AlertPanel::kCpu;
+    if (alert.instance == "memory") return AlertPanel::kRam;
+    if (alert.instance == "io") return AlertPanel::kDisk;
+    return AlertPanel::kNone;
+  }
+  if (under("cpu.") || under("perf.")) return AlertPanel::kCpu;
+  if (under("ram.") || under("swap.") || under("numa.")) return AlertPanel::kRam;
+  if (under("gpu.")) return AlertPanel::kGpu;
+  if (under("net.")) return AlertPanel::kNet;
+  if (under("disk.")) return AlertPanel::kDisk;
+  if (under("proc.") || under("docker.")) return AlertPanel::kProcesses;
+  return AlertPanel::kNone;
+}
+
+/* First firing alert for `panel`; alerts are listed firing first. */
+const AlertInfo* firingAlert(const Snapshot& snapshot, AlertPanel panel) {
+  for (const auto& a : snapshot.alerts) {
+    if (!a.firing) break;
+    if (alertPanel(a) == panel) return &a;
+  }
+  return nullptr;
 }
 
 BrailleCanvas createBrailleCanvas(int width, int height) {
@@ -631,37 +1032,154 @@ void rasterizeBrailleLine(BrailleCanvas* canvas, int x0, int y0, int x1, int y1)
   }
 }
 
-void plotBrailleSeries(BrailleCanvas* canvas, const std::vector<double>& values,
-                       double min_value, double max_value) {
-  if (!canvas || canvas->width <= 0 || canvas->height <= 0 || values.empty()) return;
+int canvasRowFor(const BrailleCanvas& canvas, double value, double min_value, double max_value) {
+  const int graph_h = canvas.height;
+  const double clamped = std::max(min_value, std::min(max_value, value));
+  const double normalized = (clamped - min_value) / (max_value - min_value);
+  const int y_from_bottom = static_cast<int>(std::lround(normalized * static_cast<double>(graph_h - 1)));
+  return std::max(0, std::min(graph_h - 1, (graph_h - 1) - y_from_bottom));
+}
+
+/* Zoomed views end on a column boundary so buckets stay in their column between frames. */
+int64_t alignedViewEnd(int64_t now_ms, int64_t span_ms, int graph_w) {
+  const int64_t column_ms = std::max<int64_t>(1, span_ms / std::max(1, graph_w - 1));
+  return now_ms / column_ms * column_ms;
+}
+
+/*
+ * Plot a series across the canvas.  The live view (span_ms == 0) spreads the
+ * newest raw samples over the width as before; a zoomed view takes the rollup
+ * tier that matches the width and places its buckets by time over the last
+ * span_ms, leaving gaps where hmon was not running.
+ */
+void plotBrailleSeries(BrailleCanvas* canvas, const hmon::core::HistorySeries& series, int64_t span_ms,
+                       int64_t now_ms, double min_value, double max_value) {
+  if (!canvas || canvas->width <= 0 || canvas->height <= 0) return;
   if (max_value <= min_value) return;
 
-  const int graph_w = canvas->width, graph_h = canvas->height;
-  const size_t sample_count = std::min(values.size(), static_cast<size_t>(graph_w));
-  const size_t start_index = values.size() - sample_count;
-  if (sample_count == 0) return;
+  const int graph_w = canvas->width;
+
+  auto valueToPixelY = [&](double value) { return canvasRowFor(*canvas, value, min_value, max_value); };
 
-  auto valueToPixelY = [&](double value) {
-    const double clamped = std::max(min_value, std::min(max_value, value));
-    const double normalized = (clamped - min_value) / (max_value - min_value);
-    const int y_from_bottom = static_cast<int>(std::lround(normalized * static_cast<double>(graph_h - 1)));
-    return std::max(0, std::min(graph_h - 1, (graph_h - 1) - y_from_bottom));
+  struct PlotPoint {
+    int x;
+    double value;
+    bool joined;    /* connect to the previous point */
   };
+  std::vector<PlotPoint> points;
+
+  if (span_ms <= 0) {
+    const auto& raw = series.raw();
+    const size_t sample_count = std::min(raw.size(), static_cast<size_t>(graph_w));
+    const size_t start_index = raw.size() - sample_count;
+    for (size_t i = 0; i < sample_count; ++i) {
+      const int x = sample_count <= 1 ? 0 : static_cast<int>((i * static_cast<size_t>(graph_w - 1)) / (sample_count - 1));
+      points.push_back({x, raw[start_index + i].avg, true});
+    }
+  } else {
+    const size_t tier = series.pick_tier(span_ms, static_cast<size_t>(graph_w));
+    const int64_t period_ms = hmon::core::HistorySeries::kTierPeriodMs[tier];
+    now_ms = alignedViewEnd(now_ms, span_ms, graph_w);
+    const int64_t window_start = now_ms - span_ms;
+    std::vector<double> sums(static_cast<size_t>(graph_w), 0.0);
+    std::vector<int> counts(static_cast<size_t>(graph_w), 0);
+    std::vector<int64_t> times(static_cast<size_t>(graph_w), 0);
+    auto add = [&](const hmon::core::HistoryPoint& p) {
+      if (p.time_ms + period_ms < window_start || p.time_ms > now_ms) return;
+      const int64_t offset = std::max<int64_t>(0, p.time_ms - window_start);
+      const auto x = static_cast<size_t>(std::min<int64_t>(graph_w - 1, offset * (graph_w - 1) / span_ms));
+      sums[x] += p.avg;
+      ++counts[x];
+      times[x] = std::max(times[x], p.time_ms);
+    };
+    const auto& ring = series.tier(tier);
+    for (size_t i = ring.size(); i-- > 0;) {
+      if (ring[i].time_ms + period_ms < window_start) break;
+      add(ring[i]);
+    }
+    if (auto open = series.pending(tier)) add(*open);
+
+    int64_t prev_time = 0;
+    for (int x = 0; x < graph_w; ++x) {
+      const auto idx = static_cast<size_t>(x);
+      if (counts[idx] == 0) continue;
+      const bool joined = !points.empty() && times[idx] - prev_time <= 2 * period_ms;
+      points.push_back({x, sums[idx] / counts[idx], joined});
+      prev_time = times[idx];
+    }
+  }
+
+  for (size_t i = 0; i < points.size(); ++i) {
+    const int y = valueToPixelY(points[i].value);
+    if (i > 0 && points[i].joined) {
+      rasterizeBrailleLine(canvas, points[i - 1].x, valueToPixelY(points[i - 1].value), points[i].x, y);
+    } else {
+      canvas->cells[static_cast<size_t>(y * canvas->width + points[i].x)] |= kDirPoint;
+    }
+  }
+}
 
-  auto sampleToPixelX = [&](size_t sample_index) {
-    if (sample_count <= 1) return 0;
-    return static_cast<int>((sample_index * static_cast<size_t>(graph_w - 1)) / (sample_count - 1));
+/*
+ * Bring `graph` up to date with `series`.  Once the live view is full every
+ * sample owns one column, and a segment only touches the columns of its two
+ * endpoints, so shifting by the new sample count and rasterising the new
+ * segments gives exactly what a full re-plot would.  Column 0 is redone
+ * because the segment that led into it has scrolled off.
+ */
+void updateHistoryCanvas(HistoryCanvas* graph, const hmon::core::HistorySeries& series, int width, int height,
+                         int64_t span_ms, int64_t now_ms, double min_value, double max_value) {
+  BrailleCanvas& canvas = graph->canvas;
+  const bool same_view = canvas.width == width && canvas.height == height && graph->span_ms == span_ms &&
+                         graph->min_value == min_value && graph->max_value == max_value;
+  const auto& raw = series.raw();
+
+  auto replot = [&]() {
+    canvas = createBrailleCanvas(width, height);
+    plotBrailleSeries(&canvas, series, span_ms, now_ms, min_value, max_value);
+    graph->span_ms = span_ms;
+    graph->min_value = min_value;
+    graph->max_value = max_value;
+    graph->pushed = raw.pushed();
   };
 
-  if (sample_count == 1) {
-    canvas->cells[static_cast<size_t>(valueToPixelY(values[start_index]) * canvas->width)] |= kDirPoint;
+  if (span_ms > 0) {
+    const size_t tier = series.pick_tier(span_ms, static_cast<size_t>(std::max(width, 1)));
+    RenderHash key;
+    key.add(static_cast<int64_t>(tier)).add(alignedViewEnd(now_ms, span_ms, width))
+        .add(static_cast<int64_t>(series.tier(tier).pushed()));
+    if (auto open = series.pending(tier)) key.add(open->time_ms).add(static_cast<double>(open->avg), 1e-3);
+    if (!same_view || key.value() != graph->plot_key) {
+      replot();
+      graph->plot_key = key.value();
+    }
+    return;
+  }
+
+  const uint64_t fresh = raw.pushed() - graph->pushed;
+  if (same_view && fresh == 0) return;
+  const size_t shift = static_cast<size_t>(fresh);
+  const auto w = static_cast<size_t>(width);
+  /* The canvas was full before and still is: every plotted sample sits at x == its index. */
+  const bool scrollable = same_view && w >= 2 && raw.size() >= w && raw.size() - shift >= w && shift < w;
+  if (!scrollable) {
+    replot();
     return;
   }
 
-  for (size_t i = 0; i + 1 < sample_count; ++i) {
-    rasterizeBrailleLine(canvas, sampleToPixelX(i), valueToPixelY(values[start_index + i]),
-                         sampleToPixelX(i + 1), valueToPixelY(values[start_index + i + 1]));
+  for (int y = 0; y < height; ++y) {
+    auto row = canvas.cells.begin() + static_cast<std::ptrdiff_t>(static_cast<size_t>(y) * w);
+    std::move(row + static_cast<std::ptrdiff_t>(shift), row + static_cast<std::ptrdiff_t>(w), row);
+    std::fill(row + static_cast<std::ptrdiff_t>(w - shift), row + static_cast<std::ptrdiff_t>(w), uint16_t{0});
+    canvas.cells[static_cast<size_t>(y) * w] = 0;
+  }
+
+  const size_t start = raw.size() - w;
+  auto rowOf = [&](size_t x) { return canvasRowFor(canvas, raw[start + x].avg, min_value, max_value); };
+  rasterizeBrailleLine(&canvas, 0, rowOf(0), 1, rowOf(1));
+  for (size_t x = std::max<size_t>(1, w - shift); x < w; ++x) {
+    rasterizeBrailleLine(&canvas, static_cast<int>(x - 1), rowOf(x - 1), static_cast<int>(x), rowOf(x));
   }
+  graph->pushed = raw.pushed();
 }
 
 void drawBrailleLayer(WINDOW* win, const BrailleCanvas& canvas, int top, int left, int color_pair) {
@@ -703,77 +1221,24 @@ void drawBrailleLayer(WINDOW* win, const BrailleCanvas& canvas, int top, int lef
   }
 }
 
-std::optional<double> computeRootDiskBusyPercent() {
-#ifdef __APPLE__
-  static std::optional<unsigned long long> previous_read_ops;
-  static std::optional<unsigned long long> previous_write_ops;
-  static std::chrono::steady_clock::time_point previous_time;
-
-  std::string output;
-  FILE* pipe = popen("iostat -d disk0 1 1 2>/dev/null | tail -1", "r");
-  if (pipe) {
-    char buf[256];
-    while (fgets(buf, sizeof(buf), pipe)) output += buf;
-    pclose(pipe);
-  }
-  if (output.empty()) {
-    return std::nullopt;
-  }
-
-  std::istringstream iss(output);
-  std::string device;
-  unsigned long long read_ops = 0, write_ops = 0;
-  
-  iss >> device;
-  if (device.empty()) return std::nullopt;
-  
-  std::vector<unsigned long long> values;
-  unsigned long long val;
-  while (iss >> val) {
-    values.push_back(val);
-  }
-  
-  if (values.size() < 2) return std::nullopt;
-  
-  read_ops = values[0];
-  write_ops = values[1];
-  
-  const auto now = std::chrono::steady_clock::now();
-  
-  if (!previous_read_ops || !previous_write_ops) {
-    previous_read_ops = read_ops;
-    previous_write_ops = write_ops;
-    previous_time = now;
-    return std::nullopt;
-  }
-  
-  const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - previous_time);
-  const unsigned long long total_ops = (read_ops - *previous_read_ops) + (write_ops - *previous_write_ops);
-  
-  previous_read_ops = read_ops;
-  previous_write_ops = write_ops;
-  previous_time = now;
-  
-  if (elapsed.count() <= 0) return std::nullopt;
-  
-  const double ops_per_sec = static_cast<double>(total_ops) / (static_cast<double>(elapsed.count()) / 1000.0);
-  const double busy_pct = std::min(100.0, ops_per_sec / 100.0 * 100.0);
-  
-  return std::max(0.0, std::min(100.0, busy_pct));
-#else
-  return std::nullopt;
-#endif
-}
-
 int estimateCpuRows(const Snapshot& snapshot) {
   int rows = 5;
   if (snapshot.cpu.usage_percent) ++rows;
   if (snapshot.cpu.temperature_c) ++rows;
+  if (!snapshot.cpu.core_counters.empty()) rows += 1 + static_cast<int>(snapshot.cpu.socket_counters.size());
+  if (snapshot.cpu.counters_pid > 0) ++rows;
   return rows;
 }
 
-int estimateRamRows() { return 4; }
-int estimateNetworkRows() { return 4; }
+constexpr size_t kMaxNetPanelInterfaces = 8;
+
+int estimateRamRows(const Snapshot& snapshot) { return snapshot.pressure.empty() ? 4 : 5; }
+
+int estimateNetworkRows(const Snapshot& snapshot) {
+  const size_t interfaces = snapshot.network.interfaces.size();
+  if (interfaces <= 1) return 4;
+  return 2 + static_cast<int>(std::min(interfaces, kMaxNetPanelInterfaces));
+}
 
 int estimateGpuRows(const Snapshot& snapshot) {
   if (snapshot.gpus.empty()) return 3;
@@ -783,7 +1248,15 @@ int estimateGpuRows(const Snapshot& snapshot) {
   return 7;
 }
 
-int estimateDiskRows() { return 4; }
+constexpr size_t kMaxDiskPanelMounts = 8;
+constexpr size_t kMaxDiskPanelDevices = 6;
+
+int estimateDiskRows(const Snapshot& snapshot) {
+  const size_t mounts = snapshot.disk.mounts.size();
+  const size_t devices = std::min(snapshot.disk.devices.size(), kMaxDiskPanelDevices);
+  const int space_rows = mounts <= 1 ? 3 : static_cast<int>(std::min(mounts, kMaxDiskPanelMounts));
+  return 1 + space_rows + (devices == 0 ? 0 : 1 + static_cast<int>(devices));
+}
 int estimateHistoryRows() { return 12; }
 
 void splitColumnHeights(int total_h, int top_pref_h, int bottom_pref_h, int gap, int* top_h, int* bottom_h) {
@@ -800,6 +1273,41 @@ void splitColumnHeights(int total_h, int top_pref_h, int bottom_pref_h, int gap,
   *bottom_h = available - proposed_top;
 }
 
+/* "IPC 1.42  LLC 3.1/ki  BR 0.8/ki", leaving out whatever the PMU could not count. */
+std::string formatPerfCounters(const PerfCounters& counters) {
+  char buf[96];
+  int n = std::snprintf(buf, sizeof(buf), counters.ipc >= 0.0 ? "IPC %.2f" : "IPC -", counters.ipc);
+  if (counters.llc_mpki >= 0.0 && n < static_cast<int>(sizeof(buf))) {
+    n += std::snprintf(buf + n, sizeof(buf) - static_cast<size_t>(n), "  LLC %.1f/ki", counters.llc_mpki);
+  }
+  if (counters.branch_mpki >= 0.0 && n < static_cast<int>(sizeof(buf))) {
+    std::snprintf(buf + n, sizeof(buf) - static_cast<size_t>(n), "  BR %.1f/ki", counters.branch_mpki);
+  }
+  return buf;
+}
+
+/* One cell per core, coloured by IPC: green from 1.5, yellow from 0.8, red below; blank where nothing ran. */
+void drawIpcHeatmap(WINDOW* panel, int row, const std::vector<PerfCounters>& cores) {
+  const int max_x = getmaxx(panel);
+  const std::string label = "IPC  ";
+  mvwaddnstr(panel, row, 2, label.c_str(), max_x - 4);
+  const int start = 2 + static_cast<int>(label.size());
+  const int width = std::min(static_cast<int>(cores.size()), max_x - 2 - start);
+  wattron(panel, A_BOLD);
+  for (int i = 0; i < width; ++i) {
+    const double ipc = cores[static_cast<size_t>(i)].ipc;
+    if (ipc < 0.0) {
+      mvwaddch(panel, row, start + i, ' ');
+      continue;
+    }
+    const int color = ipc >= 1.5 ? 1 : (ipc >= 0.8 ? 2 : 3);
+    if (has_colors()) wattron(panel, COLOR_PAIR(color));
+    mvwaddch(panel, row, start + i, ACS_CKBOARD);
+    if (has_colors()) wattroff(panel, COLOR_PAIR(color));
+  }
+  wattroff(panel, A_BOLD);
+}
+
 void renderCpuPanel(WINDOW* panel, const Snapshot& snapshot) {
   if (!panel) return;
   
@@ -825,6 +1333,49 @@ void renderCpuPanel(WINDOW* panel, const Snapshot& snapshot) {
   if (snapshot.cpu.temperature_c && row < max_y - 1) {
     drawBar(panel, row++, "Temp ", *snapshot.cpu.temperature_c, 1);
   }
+  if (!snapshot.cpu.core_counters.empty() && row < max_y - 1) {
+    drawIpcHeatmap(panel, row++, snapshot.cpu.core_counters);
+  }
+  for (const auto& [socket, counters] : snapshot.cpu.socket_counters) {
+    if (row >= max_y - 1) break;
+    addWindowLine(panel, row++, "Socket " + std::to_string(socket) + ": " + formatPerfCounters(counters));
+  }
+  if (snapshot.cpu.counters_pid > 0 && row < max_y - 1) {
+    addWindowLine(panel, row++, "PID " + std::to_string(snapshot.cpu.counters_pid) + ": " +
+                                    formatPerfCounters(snapshot.cpu.pid_counters));
+  }
+}
+
+/* "512B", "1.5K", "12.0M": a byte count or rate in at most six columns. */
+std::string formatCompactBytes(double bytes) {
+  const char* units[] = {"B", "K", "M", "G", "T"};
+  int level = 0;
+  while (bytes >= 1024.0 && level < 4) {
+    bytes /= 1024.0;
+    ++level;
+  }
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), level == 0 ? "%.0f%s" : "%.1f%s", bytes, units[level]);
+  return buf;
+}
+
+/* The path's tail when it is wider than `width`, e.g. "...v1/python". */
+std::string compactPath(const std::string& path, size_t width) {
+  if (path.size() <= width) return path;
+  if (width <= 3) return path.substr(path.size() - width);
+  return "..." + path.substr(path.size() - (width - 3));
+}
+
+/* Active interface first, then the busiest. */
+std::vector<const NetInterfaceMetrics*> orderInterfaces(const NetworkMetrics& net) {
+  std::vector<const NetInterfaceMetrics*> ordered;
+  for (const auto& n : net.interfaces) ordered.push_back(&n);
+  std::stable_sort(ordered.begin(), ordered.end(), [&](const NetInterfaceMetrics* a, const NetInterfaceMetrics* b) {
+    const bool a_active = a->name == net.interface, b_active = b->name == net.interface;
+    if (a_active != b_active) return a_active;
+    return a->rx_bytes_per_sec + a->tx_bytes_per_sec > b->rx_bytes_per_sec + b->tx_bytes_per_sec;
+  });
+  return ordered;
 }
 
 void renderNetworkPanel(WINDOW* panel, const Snapshot& snapshot) {
@@ -833,6 +1384,29 @@ void renderNetworkPanel(WINDOW* panel, const Snapshot& snapshot) {
   int row = 1;
 
   const auto& net = snapshot.network;
+  if (net.interfaces.size() > 1) {
+    const int max_y = getmaxy(panel);
+    wattron(panel, A_BOLD);
+    addWindowLine(panel, row++, "Interface       RX/s    TX/s  Drop/s");
+    wattroff(panel, A_BOLD);
+    size_t shown = 0;
+    for (const auto* n : orderInterfaces(net)) {
+      if (row >= max_y - 1 || shown++ == kMaxNetPanelInterfaces) break;
+      char line[64];
+      std::snprintf(line, sizeof(line), "%-12.12s %7s %7s %7.0f", n->name.c_str(), "", "",
+                    n->rx_drops_per_sec + n->tx_drops_per_sec);
+      if (n->name == net.interface) wattron(panel, A_BOLD);
+      addWindowLine(panel, row, line);
+      if (n->name == net.interface) wattroff(panel, A_BOLD);
+      char rate[16];
+      std::snprintf(rate, sizeof(rate), "%7s", formatCompactBytes(n->rx_bytes_per_sec).c_str());
+      addColoredText(panel, row, 15, rate, 1);
+      std::snprintf(rate, sizeof(rate), "%7s", formatCompactBytes(n->tx_bytes_per_sec).c_str());
+      addColoredText(panel, row++, 23, rate, 3);
+    }
+    return;
+  }
+
   if (net.interface.empty()) {
     addWindowLine(panel, row++, "N/A");
     return;
@@ -886,6 +1460,22 @@ void renderRamPanel(WINDOW* panel, const Snapshot& snapshot) {
   if (row < max_y - 1) {
     drawBar(panel, row++, "Usage", used_pct);
   }
+  if (!snapshot.pressure.empty() && row < max_y - 1) {
+    /* "some" over the last 10 s; a resource over its trigger threshold is marked and coloured. */
+    const int max_x = getmaxx(panel);
+    int col = 2;
+    mvwaddnstr(panel, row, col, "Pressure:", max_x - 2 - col);
+    col += 9;
+    for (const auto& p : snapshot.pressure) {
+      char cell[32];
+      std::snprintf(cell, sizeof(cell), " %s %.1f%%%s", p.resource == "memory" ? "mem" : p.resource.c_str(),
+                    p.some_avg10, p.stalled ? "!" : "");
+      if (col >= max_x - 2) break;
+      addColoredText(panel, row, col, cell, p.stalled ? 3 : colorPairForPercent(p.some_avg10));
+      col += static_cast<int>(std::strlen(cell));
+    }
+    ++row;
+  }
 }
 
 void renderGpuPanel(WINDOW* panel, const Snapshot& snapshot) {
@@ -959,28 +1549,62 @@ void renderDiskPanel(WINDOW* panel, const Snapshot& snapshot) {
   int row = 1;
   const int max_y = getmaxy(panel);
   
-  addWindowLine(panel, row++, "Mount: " + snapshot.disk.mount_point);
+  if (snapshot.disk.mounts.size() > 1) {
+    size_t shown = 0;
+    for (const auto& m : snapshot.disk.mounts) {
+      if (row >= max_y - 1 || shown++ == kMaxDiskPanelMounts) break;
+      const auto free = std::min(m.free_bytes, m.total_bytes);
+      const double used_pct = m.total_bytes > 0 ?
+          100.0 * static_cast<double>(m.total_bytes - free) / static_cast<double>(m.total_bytes) : 0.0;
+      addWindowLine(panel, row, compactPath(m.mount_point, 12));
+      drawMiniBar(panel, row, 15, used_pct, 10);
+      char detail[48];
+      std::snprintf(detail, sizeof(detail), "%3.0f%% %s/%s", used_pct,
+                    formatCompactBytes(static_cast<double>(m.total_bytes - free)).c_str(),
+                    formatCompactBytes(static_cast<double>(m.total_bytes)).c_str());
+      addColoredText(panel, row++, 26, detail, 7);
+    }
+  } else {
+    addWindowLine(panel, row++, "Mount: " + snapshot.disk.mount_point);
 
-  if (!snapshot.disk.total_bytes || !snapshot.disk.free_bytes || *snapshot.disk.total_bytes == 0) {
-    addWindowLine(panel, row++, "Disk data unavailable");
-    return;
-  }
+    if (!snapshot.disk.total_bytes || !snapshot.disk.free_bytes || *snapshot.disk.total_bytes == 0) {
+      addWindowLine(panel, row++, "Disk data unavailable");
+    } else {
+      const auto total = *snapshot.disk.total_bytes;
+      const auto free = std::min(*snapshot.disk.free_bytes, total);
+      const auto used = total - free;
 
-  const auto total = *snapshot.disk.total_bytes;
-  const auto free = std::min(*snapshot.disk.free_bytes, total);
-  const auto used = total - free;
+      const double used_pct = 100.0 * static_cast<double>(used) / static_cast<double>(total);
 
-  const double used_pct = 100.0 * static_cast<double>(used) / static_cast<double>(total);
+      addWindowLine(panel, row++, "Free: " + humanBytes(free) + " / " + humanBytes(total));
+      if (row < max_y - 1) {
+        drawBar(panel, row++, "Used", used_pct);
+      }
+    }
+  }
 
-  addWindowLine(panel, row++, "Free: " + humanBytes(free) + " / " + humanBytes(total));
-  if (row < max_y - 1) {
-    drawBar(panel, row++, "Used", used_pct);
+  if (snapshot.disk.devices.empty() || row >= max_y - 2) return;
+  wattron(panel, A_BOLD);
+  addWindowLine(panel, row++, "Device     Busy    Read   Write   Await");
+  wattroff(panel, A_BOLD);
+  size_t shown = 0;
+  for (const auto& d : snapshot.disk.devices) {
+    if (row >= max_y - 1 || shown++ == kMaxDiskPanelDevices) break;
+    char line[96];
+    std::snprintf(line, sizeof(line), "%-9.9s       %7s %7s %5.1fms", d.device.c_str(),
+                  formatCompactBytes(d.read_bytes_per_sec).c_str(), formatCompactBytes(d.write_bytes_per_sec).c_str(),
+                  d.await_ms);
+    addWindowLine(panel, row, line);
+    char busy[8];
+    std::snprintf(busy, sizeof(busy), "%3.0f%%", d.busy_percent);
+    addColoredText(panel, row++, 13, busy, colorPairForPercent(d.busy_percent));
   }
 }
 
-void renderHistoryPanel(WINDOW* panel, const MetricsHistory& history,
+void renderHistoryPanel(WINDOW* panel, HistoryGraphs* graphs, const MetricsHistory& history,
                         const std::vector<ProcessInfo>& processes, int selected_pid, int lock_pid,
-                        bool show_selection_highlight, SortMode sort_mode) {
+                        bool show_selection_highlight, SortMode sort_mode, size_t zoom,
+                        const std::string& command_title) {
   if (!panel) return;
 
   const int max_y = getmaxy(panel);
@@ -1014,6 +1638,8 @@ void renderHistoryPanel(WINDOW* panel, const MetricsHistory& history,
   addLegendItem("RAM", 2);
   addLegendItem("GPU", 1);
   addLegendItem("DISK", 6);
+  const HistoryZoom& view = kHistoryZooms[std::min(zoom, kHistoryZoomCount - 1)];
+  addColoredText(panel, legend_row, legend_col, std::string("h ") + view.label, 7);
 
   const int graph_top = row;
   const int min_graph_h = 4;
@@ -1047,23 +1673,18 @@ void renderHistoryPanel(WINDOW* panel, const MetricsHistory& history,
     mvwaddch(panel, graph_bottom, x, ACS_HLINE);
   }
 
-  BrailleCanvas cpu_cells = createBrailleCanvas(graph_w, graph_h);
-  BrailleCanvas cpu_temp_cells = createBrailleCanvas(graph_w, graph_h);
-  BrailleCanvas ram_cells = createBrailleCanvas(graph_w, graph_h);
-  BrailleCanvas gpu_cells = createBrailleCanvas(graph_w, graph_h);
-  BrailleCanvas disk_cells = createBrailleCanvas(graph_w, graph_h);
-
-  plotBrailleSeries(&cpu_cells, history.cpu_usage, 0.0, 100.0);
-  plotBrailleSeries(&cpu_temp_cells, history.cpu_temp, 0.0, 100.0);
-  plotBrailleSeries(&ram_cells, history.ram_usage, 0.0, 100.0);
-  plotBrailleSeries(&gpu_cells, history.gpu_usage, 0.0, 100.0);
-  plotBrailleSeries(&disk_cells, history.disk_usage, 0.0, 100.0);
+  const int64_t now_ms = wallClockMs();
+  updateHistoryCanvas(&graphs->cpu, history.cpu_usage, graph_w, graph_h, view.span_ms, now_ms, 0.0, 100.0);
+  updateHistoryCanvas(&graphs->cpu_temp, history.cpu_temp, graph_w, graph_h, view.span_ms, now_ms, 0.0, 100.0);
+  updateHistoryCanvas(&graphs->ram, history.ram_usage, graph_w, graph_h, view.span_ms, now_ms, 0.0, 100.0);
+  updateHistoryCanvas(&graphs->gpu, history.gpu_usage, graph_w, graph_h, view.span_ms, now_ms, 0.0, 100.0);
+  updateHistoryCanvas(&graphs->disk, history.disk_usage, graph_w, graph_h, view.span_ms, now_ms, 0.0, 100.0);
 
-  drawBrailleLayer(panel, disk_cells, graph_top, graph_left, 6);
-  drawBrailleLayer(panel, ram_cells, graph_top, graph_left, 2);
-  drawBrailleLayer(panel, cpu_temp_cells, graph_top, graph_left, 3);
-  drawBrailleLayer(panel, gpu_cells, graph_top, graph_left, 1);
-  drawBrailleLayer(panel, cpu_cells, graph_top, graph_left, 4);
+  drawBrailleLayer(panel, graphs->disk.canvas, graph_top, graph_left, 6);
+  drawBrailleLayer(panel, graphs->ram.canvas, graph_top, graph_left, 2);
+  drawBrailleLayer(panel, graphs->cpu_temp.canvas, graph_top, graph_left, 3);
+  drawBrailleLayer(panel, graphs->gpu.canvas, graph_top, graph_left, 1);
+  drawBrailleLayer(panel, graphs->cpu.canvas, graph_top, graph_left, 4);
 
   if (!has_table) {
     return;
@@ -1082,7 +1703,8 @@ void renderHistoryPanel(WINDOW* panel, const MetricsHistory& history,
 
   wattron(panel, A_BOLD);
   int col = 2;
-  std::string pid_text = "PID";
+  const bool group_rows = !processes.empty() && processes.front().procs > 0;
+  std::string pid_text = group_rows ? "PROCS" : "PID";
   std::string cpu_text = "CPU%";
   std::string mem_text = "MEM%";
   std::string gpu_text = "GPU%";
@@ -1132,8 +1754,29 @@ void renderHistoryPanel(WINDOW* panel, const MetricsHistory& history,
     }
     col += 8;
   }
-  
-  mvwaddstr(panel, table_row, col, "COMMAND");
+
+  /* Per-process I/O once there is room for it, or whenever it is the sort key. */
+  const bool show_io_cols = max_x >= 90 || sort_mode == SortMode::kIo || sort_mode == SortMode::kNet;
+  const int io_col = col;
+  if (show_io_cols) {
+    auto ioHeader = [&](const char* text, bool sorted) {
+      if (sorted) {
+        if (has_colors()) wattron(panel, COLOR_PAIR(4));
+        wattron(panel, A_UNDERLINE);
+      }
+      mvwaddstr(panel, table_row, col, text);
+      if (sorted) {
+        wattroff(panel, A_UNDERLINE);
+        if (has_colors()) wattroff(panel, COLOR_PAIR(4));
+      }
+      col += 8;
+    };
+    ioHeader(" READ/s", sort_mode == SortMode::kIo);
+    ioHeader("WRITE/s", sort_mode == SortMode::kIo);
+    ioHeader("  NET/s", sort_mode == SortMode::kNet);
+  }
+
+  mvwaddnstr(panel, table_row, col, command_title.c_str(), std::max(0, max_x - 2 - col));
   table_row++;
   wattroff(panel, A_BOLD);
 
@@ -1155,20 +1798,27 @@ void renderHistoryPanel(WINDOW* panel, const MetricsHistory& history,
     }
     
     std::ostringstream line;
-    line << std::setw(6) << process.pid << " "
+    line << std::setw(6) << (process.procs > 0 ? process.procs : process.pid) << " "
          << std::setw(6) << std::fixed << std::setprecision(1) << process.cpu_percent << " "
          << std::setw(6) << std::fixed << std::setprecision(1) << process.mem_percent;
     if (show_gpu_col) {
       line << " " << std::setw(6) << std::fixed << std::setprecision(1) << process.gpu_percent;
     }
-    line << " ";
-    if (is_locked) {
-      line << "*";
-    } else {
-      line << " ";
+    std::string text = line.str();
+    if (show_io_cols) {
+      /* Right-aligned under the 7-wide headers; addWindowLine starts the text at column 2. */
+      auto alignTo = [&text](int header_col, const std::string& value) {
+        const size_t end = static_cast<size_t>(header_col - 2 + 7);
+        text.append(text.size() + value.size() < end ? end - value.size() - text.size() : 1, ' ');
+        text += value;
+      };
+      alignTo(io_col, formatCompactBytes(process.io_read_bps));
+      alignTo(io_col + 8, formatCompactBytes(process.io_write_bps));
+      alignTo(io_col + 16, formatCompactBytes(process.net_bps));
     }
-    line << process.command;
-    addWindowLine(panel, table_row++, line.str());
+    text += is_locked ? " *" : "  ";
+    text += process.command;
+    addWindowLine(panel, table_row++, text);
     
     if (show_row_highlight) {
       wattroff(panel, A_REVERSE);
@@ -1436,6 +2086,25 @@ void renderZenMode(WINDOW* win, const Snapshot& snapshot, const Config& config,
                    humanBytes(used));
   }
 
+  /* One node is the whole machine; the section only says something with more. */
+  if (snapshot.numa_nodes.size() > 1) {
+    drawZenSectionHeader(win, left_row++, left_x, left_w, "NUMA", 5);
+    left_row++;
+    for (const auto& n : snapshot.numa_nodes) {
+      if (left_row >= max_y - 8) break;
+      const std::string free = humanBytes(static_cast<unsigned long long>(std::max(0LL, n.mem_free_kb)) * 1024ULL);
+      drawSummaryBar(left_row++, left_x, left_w, "Node " + std::to_string(n.node), n.usage_percent.value_or(0.0),
+                     free + " free");
+      char line[128];
+      std::snprintf(line, sizeof(line), "CPUs %s  miss %.0f/s  foreign %.0f/s", n.cpus.c_str(),
+                    n.miss_per_sec.value_or(0.0), n.foreign_per_sec.value_or(0.0));
+      const bool remote = n.miss_per_sec.value_or(0.0) > 0.0 || n.foreign_per_sec.value_or(0.0) > 0.0;
+      if (has_colors()) wattron(win, COLOR_PAIR(remote ? 3 : 7));
+      addClippedText(win, left_row++, left_x + 1, left_w - 2, line);
+      if (has_colors()) wattroff(win, COLOR_PAIR(remote ? 3 : 7));
+    }
+  }
+
   if (!snapshot.network.interface.empty()) {
     drawZenSectionHeader(win, left_row++, left_x, left_w, "Network", 6);
     left_row++;
@@ -1677,7 +2346,9 @@ void renderZenMode(WINDOW* win, const Snapshot& snapshot, const Config& config,
   const int pid_col = right_x;
   const int ram_col = pid_col + 10;
   const int pct_col = ram_col + 12;
-  const int bar_col = pct_col + 7;
+  const bool show_nodes = snapshot.numa_nodes.size() > 1;
+  const int node_col = pct_col + 7;
+  const int bar_col = node_col + (show_nodes ? 9 : 0);
   const int bar_width = std::max(8, std::min(14, right_w / 8));
   const int cmd_col = bar_col + bar_width + 3;
   const int cmd_width = std::max(10, right_x + right_w - cmd_col);
@@ -1687,6 +2358,7 @@ void renderZenMode(WINDOW* win, const Snapshot& snapshot, const Config& config,
   addClippedText(win, right_row, pid_col, 8, "PID");
   addClippedText(win, right_row, ram_col, 10, "RAM");
   addClippedText(win, right_row, pct_col, 5, "%");
+  if (show_nodes) addClippedText(win, right_row, node_col, 8, "NODE");
   addClippedText(win, right_row, cmd_col, cmd_width, "COMMAND");
   wattroff(win, A_BOLD);
   right_row++;
@@ -1730,6 +2402,12 @@ void renderZenMode(WINDOW* win, const Snapshot& snapshot, const Config& config,
       wattroff(win, COLOR_PAIR(color));
     }
 
+    if (show_nodes && proc.numa_node >= 0) {
+      char node[32];
+      std::snprintf(node, sizeof(node), "N%d %3.0f%%", std::min(proc.numa_node, 999),
+                    std::clamp(proc.numa_local_pct, 0.0, 100.0));
+      addClippedText(win, right_row, node_col, 8, node);
+    }
     drawMiniBar(win, right_row, bar_col, proc.mem_percent * 5.0, bar_width);
     addClippedText(win, right_row, cmd_col, cmd_width, clippedText(proc.command, cmd_width));
 
@@ -1774,11 +2452,18 @@ void drawHelpOverlay(WINDOW* overlay, const Config& config) {
   mvwaddstr(overlay, row++, 4, "q       Quit");
   mvwaddstr(overlay, row++, 4, "?       Toggle help");
   mvwaddstr(overlay, row++, 4, "z       Zen mode");
-  mvwaddstr(overlay, row++, 4, "s       Sort (CPU/MEM/GPU/PID)");
+  mvwaddstr(overlay, row++, 4, "s       Sort (CPU/MEM/GPU/IO/NET/PID)");
+  if (config.fleet_target.empty()) {
+    mvwaddstr(overlay, row++, 4, "g       Group (cgroup/container/unit/tree)");
+    if (config.group_mode != GroupMode::kNone) mvwaddstr(overlay, row++, 4, "Enter   Open group, Esc back");
+    if (config.replay_path.empty()) mvwaddstr(overlay, row++, 4, "/       Filter processes, Esc clears");
+  }
   mvwaddstr(overlay, row++, 4, "j/k     Move selection");
   mvwaddstr(overlay, row++, 4, "Up/Down Move selection");
   mvwaddstr(overlay, row++, 4, "1-9     Jump to row");
-  if (config.lock_pid > 0) {
+  if (!config.fleet_target.empty()) {
+    mvwaddstr(overlay, row++, 4, "b/Esc   Back to the fleet view");
+  } else if (config.lock_pid > 0) {
     std::string pid_msg = "l/u     Toggle lock on PID " + std::to_string(config.lock_pid);
     mvwaddstr(overlay, row++, 4, pid_msg.c_str());
   } else if (config.selected_pid > 0) {
@@ -1787,290 +2472,949 @@ void drawHelpOverlay(WINDOW* overlay, const Config& config) {
   } else {
     mvwaddstr(overlay, row++, 4, "l       Lock selected PID");
   }
-  mvwaddstr(overlay, row++, 4, "r       Refresh");
+  if (config.fleet_target.empty()) mvwaddstr(overlay, row++, 4, "r       Refresh");
+  mvwaddstr(overlay, row++, 4, "h       History span");
   mvwaddstr(overlay, row++, 4, "+/-     Speed");
+  mvwaddstr(overlay, row++, 4, "d       Plugin timings");
+  if (!config.replay_path.empty()) {
+    mvwaddstr(overlay, row++, 4, "Space   Pause/resume replay");
+    mvwaddstr(overlay, row++, 4, "</>  f  Seek 1 min, playback speed");
+  }
   mvwaddstr(overlay, row++, 4, "Any key - Close help");
 
   wnoutrefresh(overlay);
 }
 
-Snapshot collectSnapshot(hmon::core::PluginManager& pm, const Config& config) {
-  Snapshot snapshot;
+std::string formatOverlayMs(double ms) {
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), ms < 10.0 ? "%.2f" : ms < 100.0 ? "%.1f" : "%.0f", ms);
+  return buf;
+}
 
+std::string formatOverlayInterval(int64_t ms) {
+  char buf[24];
+  if (ms % 1000 == 0) std::snprintf(buf, sizeof(buf), "%llds", static_cast<long long>(ms / 1000));
+  else std::snprintf(buf, sizeof(buf), "%lldms", static_cast<long long>(ms));
+  return buf;
+}
 
-  snapshot.cpu.name = pm.get_string(HMON_METRIC_CPU_NAME, "Unknown CPU");
-  auto cores = pm.get_int64(HMON_METRIC_CPU_CORES);
-  if (cores) snapshot.cpu.total_cores = static_cast<int>(*cores);
-  auto threads = pm.get_int64(HMON_METRIC_CPU_THREADS);
-  if (threads) snapshot.cpu.total_threads = static_cast<int>(*threads);
-  auto temp = pm.get_double(HMON_METRIC_CPU_TEMP_C);
-  if (temp) snapshot.cpu.temperature_c = *temp;
-  auto freq = pm.get_double(HMON_METRIC_CPU_FREQ_MHZ);
-  if (freq) snapshot.cpu.frequency_mhz = *freq;
-  auto usage = pm.get_double(HMON_METRIC_CPU_USAGE_PCT);
-  if (usage) snapshot.cpu.usage_percent = *usage;
+/*
+ * Live cost of every plugin from the host's "self.plugins" table.  Unlike the
+ * help overlay it stays up while frames keep arriving, so it is redrawn on top
+ * of each one and the dashboard is invalidated when it closes.
+ */
+void drawPluginTimingsOverlay(const Snapshot& snapshot) {
+  int rows = 0, cols = 0;
+  getmaxyx(stdscr, rows, cols);
+  const int overlay_w = std::min(76, cols - 2);
+  const int overlay_h = std::min(static_cast<int>(snapshot.plugins.size()) + 5, rows - 2);
+  if (overlay_w < 40 || overlay_h < 6) return;
+  WINDOW* overlay = newwin(overlay_h, overlay_w, (rows - overlay_h) / 2, (cols - overlay_w) / 2);
+  if (!overlay) return;
+  werase(overlay);
+  box(overlay, ACS_VLINE, ACS_HLINE);
 
-  auto core_metrics = pm.get_by_prefix("cpu.core_usage_pct.");
-  for (const auto& m : core_metrics) {
-    if (m.value.type == HMON_VAL_DOUBLE) {
-      snapshot.cpu.core_usage_percent.push_back(m.value.v.f64);
-    }
-  }
+  char title[64];
+  std::snprintf(title, sizeof(title), " Plugin timings (ms) - collectors %.2f%% of a core ", snapshot.collect_cpu_pct);
+  mvwaddnstr(overlay, 0, std::max(1, (overlay_w - static_cast<int>(std::strlen(title))) / 2), title, overlay_w - 2);
 
+  char line[128];
+  std::snprintf(line, sizeof(line), "%-9s %6s %6s %6s %6s %6s %6s %6s %6s %6s", "Plugin", "Every", "Last", "p50",
+                "p99", "Max", "CPU99", "Metric", "Arena", "Alloc");
+  wattron(overlay, A_BOLD);
+  mvwaddnstr(overlay, 1, 2, line, overlay_w - 4);
+  wattroff(overlay, A_BOLD);
 
-  auto ram_total = pm.get_int64(HMON_METRIC_RAM_TOTAL_KB);
-  if (ram_total) snapshot.ram.total_kb = *ram_total;
-  auto ram_avail = pm.get_int64(HMON_METRIC_RAM_AVAILABLE_KB);
-  if (ram_avail) snapshot.ram.available_kb = *ram_avail;
+  int row = 2;
+  bool any_stale = false;
+  for (const auto& p : snapshot.plugins) {
+    if (row >= overlay_h - 2) break;
+    std::snprintf(line, sizeof(line), "%-9.9s %6s %6s %6s %6s %6s %6s %6lld %6s %6s", p.name.c_str(),
+                  formatOverlayInterval(p.interval_ms).c_str(), formatOverlayMs(p.wall_last_ms).c_str(),
+                  formatOverlayMs(p.wall_p50_ms).c_str(), formatOverlayMs(p.wall_p99_ms).c_str(),
+                  formatOverlayMs(p.wall_max_ms).c_str(), formatOverlayMs(p.cpu_p99_ms).c_str(),
+                  static_cast<long long>(p.metrics), formatCompactBytes(static_cast<double>(p.arena_bytes)).c_str(),
+                  formatCompactBytes(static_cast<double>(p.alloc_bytes)).c_str());
+    /* A plugin whose collect has ever failed stands out; one showing stale values is red. */
+    const attr_t attr = (p.failures > 0 ? A_BOLD : A_NORMAL) | (p.stale ? COLOR_PAIR(3) : A_NORMAL);
+    wattron(overlay, attr);
+    mvwaddnstr(overlay, row++, 2, line, overlay_w - 4);
+    wattroff(overlay, attr);
+    any_stale = any_stale || p.stale;
+  }
+  if (snapshot.plugins.empty()) mvwaddnstr(overlay, row, 2, "No timings yet", overlay_w - 4);
+  mvwaddnstr(overlay, overlay_h - 2, 2,
+             any_stale ? "Red: helper missed its deadline, values are stale. d - Close"
+                       : "Quantiles since start; Alloc is the last collect's heap use. d - Close",
+             overlay_w - 4);
 
+  wnoutrefresh(overlay);
+  delwin(overlay);
+}
 
-  auto swap_total = pm.get_int64("swap.total_kb");
-  if (swap_total) snapshot.swap.total_kb = *swap_total;
-  auto swap_free = pm.get_int64("swap.free_kb");
+/* Typed cell access to one table metric; missing columns, rows and null cells read as absent. */
+class TableReader {
+ public:
+  explicit TableReader(const hmon_table* table) : table_(table) {}
+
+  uint32_t rows() const { return table_ ? table_->row_count : 0; }
+  int column(const char* name, int type) const { return table_ ? hmon_table_column_index(table_, name, type) : -1; }
+
+  std::string str(uint32_t row, int col) const {
+    const char* s = col < 0 ? nullptr : hmon_table_row_const(table_, row)[col].str;
+    return s ? std::string(s) : std::string();
+  }
+  std::optional<int64_t> i64(uint32_t row, int col) const {
+    if (col < 0) return std::nullopt;
+    int64_t v = hmon_table_row_const(table_, row)[col].i64;
+    return v == HMON_TABLE_NULL_I64 ? std::nullopt : std::optional<int64_t>(v);
+  }
+  std::optional<double> f64(uint32_t row, int col) const {
+    if (col < 0) return std::nullopt;
+    double v = hmon_table_row_const(table_, row)[col].f64;
+    return std::isnan(v) ? std::nullopt : std::optional<double>(v);
+  }
+  std::optional<bool> b(uint32_t row, int col) const {
+    if (col < 0) return std::nullopt;
+    int32_t v = hmon_table_row_const(table_, row)[col].b;
+    return v < 0 ? std::nullopt : std::optional<bool>(v != 0);
+  }
+
+ private:
+  const hmon_table* table_;
+};
+
+/* Fixed keys resolved to registry ids once, so per-tick reads skip string hashing. */
+struct SnapshotKeys {
+  hmon::core::MetricId cpu_name, cpu_cores, cpu_threads, cpu_temp, cpu_freq, cpu_usage;
+  hmon::core::MetricId ram_total, ram_avail, swap_total, swap_free, numa_table, cpu_nodes_table;
+  hmon::core::MetricId disk_mount, disk_total, disk_free, disk_busy, disk_mounts_table, disk_io_table;
+  hmon::core::MetricId net_iface, net_rx, net_tx, net_table;
+  hmon::core::MetricId cpu_cores_table, gpu_table, gpu_cores_table, proc_table, proc_groups_table, proc_matches;
+  hmon::core::MetricId docker_table;
+  hmon::core::MetricId ports_table, systemd_table, db_table, web_table, cron_table, self_table, self_cpu, psi_table;
+  hmon::core::MetricId alerts_table;
+  hmon::core::MetricId perf_cores_table, perf_sockets_table, perf_pid, perf_pid_ipc, perf_pid_llc, perf_pid_branch;
+
+  explicit SnapshotKeys(hmon::core::PluginManager& pm)
+      : cpu_name(pm.resolve(HMON_METRIC_CPU_NAME)),
+        cpu_cores(pm.resolve(HMON_METRIC_CPU_CORES)),
+        cpu_threads(pm.resolve(HMON_METRIC_CPU_THREADS)),
+        cpu_temp(pm.resolve(HMON_METRIC_CPU_TEMP_C)),
+        cpu_freq(pm.resolve(HMON_METRIC_CPU_FREQ_MHZ)),
+        cpu_usage(pm.resolve(HMON_METRIC_CPU_USAGE_PCT)),
+        ram_total(pm.resolve(HMON_METRIC_RAM_TOTAL_KB)),
+        ram_avail(pm.resolve(HMON_METRIC_RAM_AVAILABLE_KB)),
+        swap_total(pm.resolve("swap.total_kb")),
+        swap_free(pm.resolve("swap.free_kb")),
+        numa_table(pm.resolve(HMON_METRIC_NUMA_NODES_TABLE)),
+        cpu_nodes_table(pm.resolve(HMON_METRIC_CPU_NODES_TABLE)),
+        disk_mount(pm.resolve(HMON_METRIC_DISK_MOUNT)),
+        disk_total(pm.resolve(HMON_METRIC_DISK_TOTAL_BYTES)),
+        disk_free(pm.resolve(HMON_METRIC_DISK_FREE_BYTES)),
+        disk_busy(pm.resolve(HMON_METRIC_DISK_BUSY_PCT)),
+        disk_mounts_table(pm.resolve(HMON_METRIC_DISK_MOUNTS_TABLE)),
+        disk_io_table(pm.resolve(HMON_METRIC_DISK_IO_TABLE)),
+        net_iface(pm.resolve(HMON_METRIC_NET_INTERFACE)),
+        net_rx(pm.resolve(HMON_METRIC_NET_RX_KBPS)),
+        net_tx(pm.resolve(HMON_METRIC_NET_TX_KBPS)),
+        net_table(pm.resolve(HMON_METRIC_NET_INTERFACES_TABLE)),
+        cpu_cores_table(pm.resolve(HMON_METRIC_CPU_CORES_TABLE)),
+        gpu_table(pm.resolve(HMON_METRIC_GPU_TABLE)),
+        gpu_cores_table(pm.resolve(HMON_METRIC_GPU_CORES_TABLE)),
+        proc_table(pm.resolve(HMON_METRIC_PROC_TABLE)),
+        proc_groups_table(pm.resolve(HMON_METRIC_PROC_GROUPS_TABLE)),
+        proc_matches(pm.resolve(HMON_METRIC_PROC_MATCHES)),
+        docker_table(pm.resolve(HMON_METRIC_DOCKER_TABLE)),
+        ports_table(pm.resolve(HMON_METRIC_PORTS_TABLE)),
+        systemd_table(pm.resolve(HMON_METRIC_SYSTEMD_TABLE)),
+        db_table(pm.resolve(HMON_METRIC_DB_TABLE)),
+        web_table(pm.resolve(HMON_METRIC_WEB_TABLE)),
+        cron_table(pm.resolve(HMON_METRIC_CRON_TABLE)),
+        self_table(pm.resolve(HMON_METRIC_SELF_PLUGINS_TABLE)),
+        self_cpu(pm.resolve(HMON_METRIC_SELF_COLLECT_CPU_PCT)),
+        psi_table(pm.resolve(HMON_METRIC_PSI_TABLE)),
+        alerts_table(pm.resolve(HMON_METRIC_ALERTS_TABLE)),
+        perf_cores_table(pm.resolve(HMON_METRIC_PERF_CORES_TABLE)),
+        perf_sockets_table(pm.resolve(HMON_METRIC_PERF_SOCKETS_TABLE)),
+        perf_pid(pm.resolve(HMON_METRIC_PERF_PID)),
+        perf_pid_ipc(pm.resolve(HMON_METRIC_PERF_PID_IPC)),
+        perf_pid_llc(pm.resolve(HMON_METRIC_PERF_PID_LLC_MPKI)),
+        perf_pid_branch(pm.resolve(HMON_METRIC_PERF_PID_BRANCH_MPKI)) {}
+};
+
+Snapshot collectSnapshot(hmon::core::PluginManager& pm, const SnapshotKeys& keys, const Config& config) {
+  Snapshot snapshot;
+
+
+  snapshot.cpu.name = pm.get_string(keys.cpu_name, "Unknown CPU");
+  auto cores = pm.get_int64(keys.cpu_cores);
+  if (cores) snapshot.cpu.total_cores = static_cast<int>(*cores);
+  auto threads = pm.get_int64(keys.cpu_threads);
+  if (threads) snapshot.cpu.total_threads = static_cast<int>(*threads);
+  auto temp = pm.get_double(keys.cpu_temp);
+  if (temp) snapshot.cpu.temperature_c = *temp;
+  auto freq = pm.get_double(keys.cpu_freq);
+  if (freq) snapshot.cpu.frequency_mhz = *freq;
+  auto usage = pm.get_double(keys.cpu_usage);
+  if (usage) snapshot.cpu.usage_percent = *usage;
+
+  /* Recordings from before the table had its own key kept it under cpu.cores. */
+  const hmon_table* per_core = pm.get_table(keys.cpu_cores_table);
+  TableReader cores_table(per_core ? per_core : pm.get_table(keys.cpu_cores));
+  int core_usage = cores_table.column("usage_pct", HMON_VAL_DOUBLE);
+  for (uint32_t r = 0; r < cores_table.rows(); ++r) {
+    snapshot.cpu.core_usage_percent.push_back(cores_table.f64(r, core_usage).value_or(0.0));
+  }
+
+  auto readCounters = [](const TableReader& t, uint32_t r, int ipc, int llc, int branch) {
+    PerfCounters c;
+    c.ipc = t.f64(r, ipc).value_or(-1.0);
+    c.llc_mpki = t.f64(r, llc).value_or(-1.0);
+    c.branch_mpki = t.f64(r, branch).value_or(-1.0);
+    return c;
+  };
+  TableReader perf_cores(pm.get_table(keys.perf_cores_table));
+  const int pc_ipc = perf_cores.column("ipc", HMON_VAL_DOUBLE);
+  const int pc_llc = perf_cores.column("llc_mpki", HMON_VAL_DOUBLE);
+  const int pc_branch = perf_cores.column("branch_mpki", HMON_VAL_DOUBLE);
+  for (uint32_t r = 0; r < perf_cores.rows(); ++r) {
+    snapshot.cpu.core_counters.push_back(readCounters(perf_cores, r, pc_ipc, pc_llc, pc_branch));
+  }
+  TableReader perf_sockets(pm.get_table(keys.perf_sockets_table));
+  const int ps_socket = perf_sockets.column("socket", HMON_VAL_INT64);
+  const int ps_ipc = perf_sockets.column("ipc", HMON_VAL_DOUBLE);
+  const int ps_llc = perf_sockets.column("llc_mpki", HMON_VAL_DOUBLE);
+  const int ps_branch = perf_sockets.column("branch_mpki", HMON_VAL_DOUBLE);
+  for (uint32_t r = 0; r < perf_sockets.rows(); ++r) {
+    snapshot.cpu.socket_counters.emplace_back(static_cast<int>(perf_sockets.i64(r, ps_socket).value_or(0)),
+                                              readCounters(perf_sockets, r, ps_ipc, ps_llc, ps_branch));
+  }
+  auto perf_pid = pm.get_int64(keys.perf_pid);
+  if (perf_pid) {
+    snapshot.cpu.counters_pid = static_cast<int>(*perf_pid);
+    snapshot.cpu.pid_counters.ipc = pm.get_double(keys.perf_pid_ipc).value_or(-1.0);
+    snapshot.cpu.pid_counters.llc_mpki = pm.get_double(keys.perf_pid_llc).value_or(-1.0);
+    snapshot.cpu.pid_counters.branch_mpki = pm.get_double(keys.perf_pid_branch).value_or(-1.0);
+  }
+
+
+  auto ram_total = pm.get_int64(keys.ram_total);
+  if (ram_total) snapshot.ram.total_kb = *ram_total;
+  auto ram_avail = pm.get_int64(keys.ram_avail);
+  if (ram_avail) snapshot.ram.available_kb = *ram_avail;
+
+
+  auto swap_total = pm.get_int64(keys.swap_total);
+  if (swap_total) snapshot.swap.total_kb = *swap_total;
+  auto swap_free = pm.get_int64(keys.swap_free);
   if (swap_free) snapshot.swap.free_kb = *swap_free;
 
+  TableReader numa(pm.get_table(keys.numa_table));
+  {
+    int c_node = numa.column("node", HMON_VAL_INT64);
+    int c_cpus = numa.column("cpus", HMON_VAL_STRING);
+    int c_total = numa.column("mem_total_kb", HMON_VAL_INT64);
+    int c_free = numa.column("mem_free_kb", HMON_VAL_INT64);
+    int c_miss = numa.column("numa_miss_ps", HMON_VAL_DOUBLE);
+    int c_foreign = numa.column("numa_foreign_ps", HMON_VAL_DOUBLE);
+    for (uint32_t r = 0; r < numa.rows(); ++r) {
+      NumaNodeInfo n;
+      n.node = static_cast<int>(numa.i64(r, c_node).value_or(0));
+      n.cpus = numa.str(r, c_cpus);
+      n.mem_total_kb = numa.i64(r, c_total).value_or(0);
+      n.mem_free_kb = numa.i64(r, c_free).value_or(0);
+      n.miss_per_sec = numa.f64(r, c_miss);
+      n.foreign_per_sec = numa.f64(r, c_foreign);
+      snapshot.numa_nodes.push_back(std::move(n));
+    }
+  }
+  TableReader cpu_nodes(pm.get_table(keys.cpu_nodes_table));
+  {
+    int c_node = cpu_nodes.column("node", HMON_VAL_INT64);
+    int c_usage = cpu_nodes.column("usage_pct", HMON_VAL_DOUBLE);
+    for (uint32_t r = 0; r < cpu_nodes.rows(); ++r) {
+      const int id = static_cast<int>(cpu_nodes.i64(r, c_node).value_or(-1));
+      for (auto& n : snapshot.numa_nodes) {
+        if (n.node == id) n.usage_percent = cpu_nodes.f64(r, c_usage);
+      }
+    }
+  }
 
-  snapshot.disk.mount_point = pm.get_string(HMON_METRIC_DISK_MOUNT, "/");
-  auto disk_total = pm.get_int64(HMON_METRIC_DISK_TOTAL_BYTES);
+
+  snapshot.disk.mount_point = pm.get_string(keys.disk_mount, "/");
+  auto disk_total = pm.get_int64(keys.disk_total);
   if (disk_total) snapshot.disk.total_bytes = static_cast<unsigned long long>(*disk_total);
-  auto disk_free = pm.get_int64(HMON_METRIC_DISK_FREE_BYTES);
+  auto disk_free = pm.get_int64(keys.disk_free);
   if (disk_free) snapshot.disk.free_bytes = static_cast<unsigned long long>(*disk_free);
+  snapshot.disk.busy_percent = pm.get_double(keys.disk_busy);
+
+  TableReader mounts(pm.get_table(keys.disk_mounts_table));
+  {
+    int c_mount = mounts.column("mount", HMON_VAL_STRING);
+    int c_device = mounts.column("device", HMON_VAL_STRING);
+    int c_fstype = mounts.column("fstype", HMON_VAL_STRING);
+    int c_total = mounts.column("total_bytes", HMON_VAL_INT64);
+    int c_free = mounts.column("free_bytes", HMON_VAL_INT64);
+    for (uint32_t r = 0; r < mounts.rows(); ++r) {
+      MountMetrics m;
+      m.mount_point = mounts.str(r, c_mount);
+      m.device = mounts.str(r, c_device);
+      m.fstype = mounts.str(r, c_fstype);
+      m.total_bytes = static_cast<unsigned long long>(std::max<int64_t>(0, mounts.i64(r, c_total).value_or(0)));
+      m.free_bytes = static_cast<unsigned long long>(std::max<int64_t>(0, mounts.i64(r, c_free).value_or(0)));
+      snapshot.disk.mounts.push_back(std::move(m));
+    }
+  }
 
+  TableReader disk_io(pm.get_table(keys.disk_io_table));
+  {
+    int c_device = disk_io.column("device", HMON_VAL_STRING);
+    int c_busy = disk_io.column("busy_pct", HMON_VAL_DOUBLE);
+    int c_read_iops = disk_io.column("read_iops", HMON_VAL_DOUBLE);
+    int c_write_iops = disk_io.column("write_iops", HMON_VAL_DOUBLE);
+    int c_read_bps = disk_io.column("read_bps", HMON_VAL_DOUBLE);
+    int c_write_bps = disk_io.column("write_bps", HMON_VAL_DOUBLE);
+    int c_await = disk_io.column("await_ms", HMON_VAL_DOUBLE);
+    int c_queue = disk_io.column("queue_depth", HMON_VAL_DOUBLE);
+    for (uint32_t r = 0; r < disk_io.rows(); ++r) {
+      DiskIoMetrics d;
+      d.device = disk_io.str(r, c_device);
+      d.busy_percent = disk_io.f64(r, c_busy).value_or(0.0);
+      d.read_iops = disk_io.f64(r, c_read_iops).value_or(0.0);
+      d.write_iops = disk_io.f64(r, c_write_iops).value_or(0.0);
+      d.read_bytes_per_sec = disk_io.f64(r, c_read_bps).value_or(0.0);
+      d.write_bytes_per_sec = disk_io.f64(r, c_write_bps).value_or(0.0);
+      d.await_ms = disk_io.f64(r, c_await).value_or(0.0);
+      d.queue_depth = disk_io.f64(r, c_queue).value_or(0.0);
+      snapshot.disk.devices.push_back(std::move(d));
+    }
+  }
 
-  snapshot.network.interface = pm.get_string(HMON_METRIC_NET_INTERFACE);
-  auto rx = pm.get_double(HMON_METRIC_NET_RX_KBPS);
+
+  snapshot.network.interface = pm.get_string(keys.net_iface);
+  auto rx = pm.get_double(keys.net_rx);
   if (rx) snapshot.network.rx_kbps = *rx;
-  auto tx = pm.get_double(HMON_METRIC_NET_TX_KBPS);
+  auto tx = pm.get_double(keys.net_tx);
   if (tx) snapshot.network.tx_kbps = *tx;
 
+  TableReader interfaces(pm.get_table(keys.net_table));
+  {
+    int c_name = interfaces.column("interface", HMON_VAL_STRING);
+    int c_rx = interfaces.column("rx_bps", HMON_VAL_DOUBLE);
+    int c_tx = interfaces.column("tx_bps", HMON_VAL_DOUBLE);
+    int c_rx_pps = interfaces.column("rx_pps", HMON_VAL_DOUBLE);
+    int c_tx_pps = interfaces.column("tx_pps", HMON_VAL_DOUBLE);
+    int c_rx_drops = interfaces.column("rx_drops_ps", HMON_VAL_DOUBLE);
+    int c_tx_drops = interfaces.column("tx_drops_ps", HMON_VAL_DOUBLE);
+    for (uint32_t r = 0; r < interfaces.rows(); ++r) {
+      NetInterfaceMetrics n;
+      n.name = interfaces.str(r, c_name);
+      n.rx_bytes_per_sec = interfaces.f64(r, c_rx).value_or(0.0);
+      n.tx_bytes_per_sec = interfaces.f64(r, c_tx).value_or(0.0);
+      n.rx_packets_per_sec = interfaces.f64(r, c_rx_pps).value_or(0.0);
+      n.tx_packets_per_sec = interfaces.f64(r, c_tx_pps).value_or(0.0);
+      n.rx_drops_per_sec = interfaces.f64(r, c_rx_drops).value_or(0.0);
+      n.tx_drops_per_sec = interfaces.f64(r, c_tx_drops).value_or(0.0);
+      snapshot.network.interfaces.push_back(std::move(n));
+    }
+  }
+
 
   if (config.show_gpu) {
-    auto gpu_metrics = pm.get_by_prefix("gpu.");
-    std::unordered_map<size_t, GpuMetrics> gpu_map;
-    for (const auto& m : gpu_metrics) {
-      size_t idx = 0;
-      if (std::sscanf(m.key.c_str(), "gpu.%zu.", &idx) != 1) continue;
-
-      if (m.key.find(".name") != std::string::npos && m.value.type == HMON_VAL_STRING) {
-        gpu_map[idx].name = m.value.v.str;
-      } else if (m.key.find(".source") != std::string::npos && m.value.type == HMON_VAL_STRING) {
-        gpu_map[idx].source = m.value.v.str;
-      } else if (m.key.find(".temp_c") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-        gpu_map[idx].temperature_c = m.value.v.f64;
-      } else if (m.key.find(".clock_mhz") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-        gpu_map[idx].core_clock_mhz = m.value.v.f64;
-      } else if (m.key.find(".usage_pct") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-        gpu_map[idx].utilization_percent = m.value.v.f64;
-      } else if (m.key.find(".power_w") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-        gpu_map[idx].power_w = m.value.v.f64;
-      } else if (m.key.find(".vram_used_mib") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-        gpu_map[idx].memory_used_mib = m.value.v.f64;
-      } else if (m.key.find(".vram_total_mib") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-        gpu_map[idx].memory_total_mib = m.value.v.f64;
-      } else if (m.key.find(".vram_usage_pct") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-        gpu_map[idx].memory_utilization_percent = m.value.v.f64;
-      } else if (m.key.find(".in_use") != std::string::npos && m.value.type == HMON_VAL_BOOL) {
-        gpu_map[idx].in_use = m.value.v.b != 0;
-      } else if (m.key.find(".core_usage.") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-        gpu_map[idx].gpu_core_usage_percent.push_back(m.value.v.f64);
-      }
-    }
-
-    for (size_t i = 0; i < gpu_map.size(); ++i) {
-      if (gpu_map.count(i)) {
-        snapshot.gpus.push_back(gpu_map[i]);
-      }
-    }
-  }
-
-
-  auto docker_metrics = pm.get_by_prefix("docker.");
-  std::unordered_map<size_t, DockerContainer> docker_map;
-  for (const auto& m : docker_metrics) {
-    size_t idx = 0;
-    if (std::sscanf(m.key.c_str(), "docker.%zu.", &idx) != 1) continue;
-
-    if (m.key.find(".name") != std::string::npos && m.value.type == HMON_VAL_STRING) {
-      docker_map[idx].name = m.value.v.str;
-    } else if (m.key.find(".image") != std::string::npos && m.value.type == HMON_VAL_STRING) {
-      docker_map[idx].image = m.value.v.str;
-    } else if (m.key.find(".state") != std::string::npos && m.value.type == HMON_VAL_STRING) {
-      docker_map[idx].state = m.value.v.str;
-    } else if (m.key.find(".cpu_pct") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-      docker_map[idx].cpu_percent = m.value.v.f64;
-    } else if (m.key.find(".mem_usage") != std::string::npos && m.value.type == HMON_VAL_INT64) {
-      docker_map[idx].mem_usage = static_cast<uint64_t>(m.value.v.i64);
-    } else if (m.key.find(".mem_limit") != std::string::npos && m.value.type == HMON_VAL_INT64) {
-      docker_map[idx].mem_limit = static_cast<uint64_t>(m.value.v.i64);
-    } else if (m.key.find(".mem_pct") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-      docker_map[idx].mem_percent = m.value.v.f64;
-    } else if (m.key.find(".net_rx_bps") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-      docker_map[idx].net_rx_bps = m.value.v.f64;
-    } else if (m.key.find(".net_tx_bps") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-      docker_map[idx].net_tx_bps = m.value.v.f64;
-    } else if (m.key.find(".net_rx_total") != std::string::npos && m.value.type == HMON_VAL_INT64) {
-      docker_map[idx].net_rx_total = static_cast<uint64_t>(m.value.v.i64);
-    } else if (m.key.find(".net_tx_total") != std::string::npos && m.value.type == HMON_VAL_INT64) {
-      docker_map[idx].net_tx_total = static_cast<uint64_t>(m.value.v.i64);
-    } else if (m.key.find(".blk_read_bps") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-      docker_map[idx].blk_read_bps = m.value.v.f64;
-    } else if (m.key.find(".blk_write_bps") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-      docker_map[idx].blk_write_bps = m.value.v.f64;
-    } else if (m.key.find(".pids") != std::string::npos && m.value.type == HMON_VAL_INT64) {
-      docker_map[idx].pids_current = static_cast<int>(m.value.v.i64);
-    }
-  }
-
-  for (size_t i = 0; i < docker_map.size(); ++i) {
-    if (docker_map.count(i)) {
-      snapshot.docker_containers.push_back(docker_map[i]);
+    TableReader gpus(pm.get_table(keys.gpu_table));
+    int c_name = gpus.column("name", HMON_VAL_STRING);
+    int c_source = gpus.column("source", HMON_VAL_STRING);
+    int c_temp = gpus.column("temp_c", HMON_VAL_DOUBLE);
+    int c_clock = gpus.column("clock_mhz", HMON_VAL_DOUBLE);
+    int c_usage = gpus.column("usage_pct", HMON_VAL_DOUBLE);
+    int c_power = gpus.column("power_w", HMON_VAL_DOUBLE);
+    int c_vram_used = gpus.column("vram_used_mib", HMON_VAL_DOUBLE);
+    int c_vram_total = gpus.column("vram_total_mib", HMON_VAL_DOUBLE);
+    int c_vram_pct = gpus.column("vram_usage_pct", HMON_VAL_DOUBLE);
+    int c_in_use = gpus.column("in_use", HMON_VAL_BOOL);
+    for (uint32_t r = 0; r < gpus.rows(); ++r) {
+      GpuMetrics g;
+      g.name = gpus.str(r, c_name);
+      g.source = gpus.str(r, c_source);
+      g.temperature_c = gpus.f64(r, c_temp);
+      g.core_clock_mhz = gpus.f64(r, c_clock);
+      g.utilization_percent = gpus.f64(r, c_usage);
+      g.power_w = gpus.f64(r, c_power);
+      g.memory_used_mib = gpus.f64(r, c_vram_used);
+      g.memory_total_mib = gpus.f64(r, c_vram_total);
+      g.memory_utilization_percent = gpus.f64(r, c_vram_pct);
+      g.in_use = gpus.b(r, c_in_use);
+      snapshot.gpus.push_back(std::move(g));
+    }
+
+    TableReader gpu_cores(pm.get_table(keys.gpu_cores_table));
+    int c_gpu = gpu_cores.column("gpu", HMON_VAL_INT64);
+    int c_core_usage = gpu_cores.column("usage_pct", HMON_VAL_DOUBLE);
+    for (uint32_t r = 0; r < gpu_cores.rows(); ++r) {
+      auto gpu = gpu_cores.i64(r, c_gpu);
+      auto usage = gpu_cores.f64(r, c_core_usage);
+      if (!gpu || !usage || *gpu < 0 || static_cast<size_t>(*gpu) >= snapshot.gpus.size()) continue;
+      snapshot.gpus[static_cast<size_t>(*gpu)].gpu_core_usage_percent.push_back(*usage);
+    }
+  }
+
+
+  TableReader containers(pm.get_table(keys.docker_table));
+  {
+    int c_name = containers.column("name", HMON_VAL_STRING);
+    int c_image = containers.column("image", HMON_VAL_STRING);
+    int c_state = containers.column("state", HMON_VAL_STRING);
+    int c_cpu = containers.column("cpu_pct", HMON_VAL_DOUBLE);
+    int c_mem = containers.column("mem_usage", HMON_VAL_INT64);
+    int c_mem_limit = containers.column("mem_limit", HMON_VAL_INT64);
+    int c_mem_pct = containers.column("mem_pct", HMON_VAL_DOUBLE);
+    int c_rx = containers.column("net_rx_bps", HMON_VAL_DOUBLE);
+    int c_tx = containers.column("net_tx_bps", HMON_VAL_DOUBLE);
+    int c_rx_total = containers.column("net_rx_total", HMON_VAL_INT64);
+    int c_tx_total = containers.column("net_tx_total", HMON_VAL_INT64);
+    int c_blk_read = containers.column("blk_read_bps", HMON_VAL_DOUBLE);
+    int c_blk_write = containers.column("blk_write_bps", HMON_VAL_DOUBLE);
+    int c_pids = containers.column("pids", HMON_VAL_INT64);
+    for (uint32_t r = 0; r < containers.rows(); ++r) {
+      DockerContainer c;
+      c.name = containers.str(r, c_name);
+      c.image = containers.str(r, c_image);
+      c.state = containers.str(r, c_state);
+      c.cpu_percent = containers.f64(r, c_cpu).value_or(0.0);
+      c.mem_usage = static_cast<uint64_t>(containers.i64(r, c_mem).value_or(0));
+      c.mem_limit = static_cast<uint64_t>(containers.i64(r, c_mem_limit).value_or(0));
+      c.mem_percent = containers.f64(r, c_mem_pct).value_or(0.0);
+      c.net_rx_bps = containers.f64(r, c_rx).value_or(0.0);
+      c.net_tx_bps = containers.f64(r, c_tx).value_or(0.0);
+      c.net_rx_total = static_cast<uint64_t>(containers.i64(r, c_rx_total).value_or(0));
+      c.net_tx_total = static_cast<uint64_t>(containers.i64(r, c_tx_total).value_or(0));
+      c.blk_read_bps = containers.f64(r, c_blk_read).value_or(0.0);
+      c.blk_write_bps = containers.f64(r, c_blk_write).value_or(0.0);
+      c.pids_current = static_cast<int>(containers.i64(r, c_pids).value_or(0));
+      snapshot.docker_containers.push_back(std::move(c));
     }
   }
 
   snapshot.docker_loading = snapshot.docker_containers.empty();
 
 
-  auto port_metrics = pm.get_by_prefix("ports.");
-  std::unordered_map<size_t, ListeningPort> port_map;
-  for (const auto& m : port_metrics) {
-    size_t idx = 0;
-    if (std::sscanf(m.key.c_str(), "ports.%zu.", &idx) != 1) continue;
-    if (m.key.find(".port") != std::string::npos && m.value.type == HMON_VAL_INT64)
-      port_map[idx].port = static_cast<uint16_t>(m.value.v.i64);
-    else if (m.key.find(".proto") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      port_map[idx].proto = m.value.v.str;
-    else if (m.key.find(".addr") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      port_map[idx].addr = m.value.v.str;
-    else if (m.key.find(".pid") != std::string::npos && m.value.type == HMON_VAL_INT64)
-      port_map[idx].pid = static_cast<int>(m.value.v.i64);
-    else if (m.key.find(".process") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      port_map[idx].process = m.value.v.str;
-  }
-  for (size_t i = 0; i < port_map.size(); ++i)
-    if (port_map.count(i)) snapshot.ports.push_back(port_map[i]);
-
-
-  auto svc_metrics = pm.get_by_prefix("systemd.");
-  std::unordered_map<size_t, ServiceInfo> svc_map;
-  for (const auto& m : svc_metrics) {
-    size_t idx = 0;
-    if (std::sscanf(m.key.c_str(), "systemd.%zu.", &idx) != 1) continue;
-    if (m.key.find(".name") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      svc_map[idx].name = m.value.v.str;
-    else if (m.key.find(".state") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      svc_map[idx].state = m.value.v.str;
-    else if (m.key.find(".sub") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      svc_map[idx].sub_state = m.value.v.str;
-    else if (m.key.find(".desc") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      svc_map[idx].description = m.value.v.str;
-  }
-  for (size_t i = 0; i < svc_map.size(); ++i)
-    if (svc_map.count(i)) snapshot.services.push_back(svc_map[i]);
-
-
-  auto db_metrics = pm.get_by_prefix("db.");
-  std::unordered_map<size_t, DbInfo> db_map;
-  for (const auto& m : db_metrics) {
-    size_t idx = 0;
-    if (std::sscanf(m.key.c_str(), "db.%zu.", &idx) != 1) continue;
-    if (m.key.find(".type") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      db_map[idx].type = m.value.v.str;
-    else if (m.key.find(".status") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      db_map[idx].status = m.value.v.str;
-    else if (m.key.find(".active_conns") != std::string::npos && m.value.type == HMON_VAL_INT64)
-      db_map[idx].active_connections = static_cast<int>(m.value.v.i64);
-    else if (m.key.find(".max_conns") != std::string::npos && m.value.type == HMON_VAL_INT64)
-      db_map[idx].max_connections = static_cast<int>(m.value.v.i64);
-    else if (m.key.find(".uptime") != std::string::npos && m.value.type == HMON_VAL_INT64)
-      db_map[idx].uptime_seconds = m.value.v.i64;
-    else if (m.key.find(".version") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      db_map[idx].version = m.value.v.str;
-  }
-  for (size_t i = 0; i < db_map.size(); ++i)
-    if (db_map.count(i)) snapshot.databases.push_back(db_map[i]);
-
-
-  auto ws_metrics = pm.get_by_prefix("web.");
-  std::unordered_map<size_t, WebServerInfo> ws_map;
-  for (const auto& m : ws_metrics) {
-    size_t idx = 0;
-    if (std::sscanf(m.key.c_str(), "web.%zu.", &idx) != 1) continue;
-    if (m.key.find(".type") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      ws_map[idx].type = m.value.v.str;
-    else if (m.key.find(".status") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      ws_map[idx].status = m.value.v.str;
-    else if (m.key.find(".active_conns") != std::string::npos && m.value.type == HMON_VAL_INT64)
-      ws_map[idx].active_connections = static_cast<int>(m.value.v.i64);
-    else if (m.key.find(".rps") != std::string::npos && m.value.type == HMON_VAL_DOUBLE)
-      ws_map[idx].requests_per_sec = m.value.v.f64;
-    else if (m.key.find(".total_req") != std::string::npos && m.value.type == HMON_VAL_INT64)
-      ws_map[idx].total_requests = m.value.v.i64;
-  }
-  for (size_t i = 0; i < ws_map.size(); ++i)
-    if (ws_map.count(i)) snapshot.webservers.push_back(ws_map[i]);
-
-
-  auto cron_metrics = pm.get_by_prefix("cron.");
-  std::unordered_map<size_t, CronJob> cron_map;
-  for (const auto& m : cron_metrics) {
-    size_t idx = 0;
-    if (std::sscanf(m.key.c_str(), "cron.%zu.", &idx) != 1) continue;
-    if (m.key.find(".schedule") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      cron_map[idx].schedule = m.value.v.str;
-    else if (m.key.find(".user") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      cron_map[idx].user = m.value.v.str;
-    else if (m.key.find(".command") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      cron_map[idx].command = m.value.v.str;
-    else if (m.key.find(".source") != std::string::npos && m.value.type == HMON_VAL_STRING)
-      cron_map[idx].source = m.value.v.str;
-  }
-  for (size_t i = 0; i < cron_map.size(); ++i)
-    if (cron_map.count(i)) snapshot.cron_jobs.push_back(cron_map[i]);
+  TableReader ports(pm.get_table(keys.ports_table));
+  {
+    int c_port = ports.column("port", HMON_VAL_INT64);
+    int c_proto = ports.column("proto", HMON_VAL_STRING);
+    int c_addr = ports.column("addr", HMON_VAL_STRING);
+    int c_pid = ports.column("pid", HMON_VAL_INT64);
+    int c_process = ports.column("process", HMON_VAL_STRING);
+    for (uint32_t r = 0; r < ports.rows(); ++r) {
+      ListeningPort p;
+      p.port = static_cast<uint16_t>(ports.i64(r, c_port).value_or(0));
+      p.proto = ports.str(r, c_proto);
+      p.addr = ports.str(r, c_addr);
+      p.pid = static_cast<int>(ports.i64(r, c_pid).value_or(-1));
+      p.process = ports.str(r, c_process);
+      snapshot.ports.push_back(std::move(p));
+    }
+  }
+
+
+  TableReader services(pm.get_table(keys.systemd_table));
+  {
+    int c_name = services.column("name", HMON_VAL_STRING);
+    int c_state = services.column("state", HMON_VAL_STRING);
+    int c_sub = services.column("sub", HMON_VAL_STRING);
+    int c_desc = services.column("desc", HMON_VAL_STRING);
+    for (uint32_t r = 0; r < services.rows(); ++r) {
+      ServiceInfo svc;
+      svc.name = services.str(r, c_name);
+      svc.state = services.str(r, c_state);
+      svc.sub_state = services.str(r, c_sub);
+      svc.description = services.str(r, c_desc);
+      snapshot.services.push_back(std::move(svc));
+    }
+  }
+
+
+  TableReader dbs(pm.get_table(keys.db_table));
+  {
+    int c_type = dbs.column("type", HMON_VAL_STRING);
+    int c_status = dbs.column("status", HMON_VAL_STRING);
+    int c_active = dbs.column("active_conns", HMON_VAL_INT64);
+    int c_max = dbs.column("max_conns", HMON_VAL_INT64);
+    int c_uptime = dbs.column("uptime", HMON_VAL_INT64);
+    int c_version = dbs.column("version", HMON_VAL_STRING);
+    for (uint32_t r = 0; r < dbs.rows(); ++r) {
+      DbInfo db;
+      db.type = dbs.str(r, c_type);
+      db.status = dbs.str(r, c_status);
+      db.active_connections = static_cast<int>(dbs.i64(r, c_active).value_or(0));
+      db.max_connections = static_cast<int>(dbs.i64(r, c_max).value_or(0));
+      db.uptime_seconds = dbs.i64(r, c_uptime).value_or(0);
+      db.version = dbs.str(r, c_version);
+      snapshot.databases.push_back(std::move(db));
+    }
+  }
+
+
+  TableReader servers(pm.get_table(keys.web_table));
+  {
+    int c_type = servers.column("type", HMON_VAL_STRING);
+    int c_status = servers.column("status", HMON_VAL_STRING);
+    int c_active = servers.column("active_conns", HMON_VAL_INT64);
+    int c_rps = servers.column("rps", HMON_VAL_DOUBLE);
+    int c_total = servers.column("total_req", HMON_VAL_INT64);
+    for (uint32_t r = 0; r < servers.rows(); ++r) {
+      WebServerInfo ws;
+      ws.type = servers.str(r, c_type);
+      ws.status = servers.str(r, c_status);
+      ws.active_connections = static_cast<int>(servers.i64(r, c_active).value_or(0));
+      ws.requests_per_sec = servers.f64(r, c_rps).value_or(0.0);
+      ws.total_requests = servers.i64(r, c_total).value_or(0);
+      snapshot.webservers.push_back(std::move(ws));
+    }
+  }
+
+
+  TableReader jobs(pm.get_table(keys.cron_table));
+  {
+    int c_schedule = jobs.column("schedule", HMON_VAL_STRING);
+    int c_user = jobs.column("user", HMON_VAL_STRING);
+    int c_command = jobs.column("command", HMON_VAL_STRING);
+    int c_source = jobs.column("source", HMON_VAL_STRING);
+    for (uint32_t r = 0; r < jobs.rows(); ++r) {
+      CronJob job;
+      job.schedule = jobs.str(r, c_schedule);
+      job.user = jobs.str(r, c_user);
+      job.command = jobs.str(r, c_command);
+      job.source = jobs.str(r, c_source);
+      snapshot.cron_jobs.push_back(std::move(job));
+    }
+  }
+
+  TableReader psi(pm.get_table(keys.psi_table));
+  {
+    int c_resource = psi.column("resource", HMON_VAL_STRING);
+    int c_some10 = psi.column("some_avg10", HMON_VAL_DOUBLE);
+    int c_some60 = psi.column("some_avg60", HMON_VAL_DOUBLE);
+    int c_full10 = psi.column("full_avg10", HMON_VAL_DOUBLE);
+    int c_stalled = psi.column("stalled", HMON_VAL_BOOL);
+    for (uint32_t r = 0; r < psi.rows(); ++r) {
+      PressureInfo p;
+      p.resource = psi.str(r, c_resource);
+      p.some_avg10 = psi.f64(r, c_some10).value_or(0.0);
+      p.some_avg60 = psi.f64(r, c_some60).value_or(0.0);
+      p.full_avg10 = psi.f64(r, c_full10);
+      p.stalled = psi.b(r, c_stalled).value_or(false);
+      snapshot.pressure.push_back(std::move(p));
+    }
+  }
+
+  TableReader alerts(pm.get_table(keys.alerts_table));
+  {
+    int c_rule = alerts.column("rule", HMON_VAL_STRING);
+    int c_metric = alerts.column("metric", HMON_VAL_STRING);
+    int c_instance = alerts.column("instance", HMON_VAL_STRING);
+    int c_state = alerts.column("state", HMON_VAL_STRING);
+    int c_value = alerts.column("value", HMON_VAL_DOUBLE);
+    for (uint32_t r = 0; r < alerts.rows(); ++r) {
+      AlertInfo a;
+      a.rule = alerts.str(r, c_rule);
+      a.metric = alerts.str(r, c_metric);
+      a.instance = alerts.str(r, c_instance);
+      a.firing = alerts.str(r, c_state) == "firing";
+      a.value = alerts.f64(r, c_value).value_or(0.0);
+      snapshot.alerts.push_back(std::move(a));
+    }
+  }
+
+
+  snapshot.collect_cpu_pct = pm.get_double(keys.self_cpu).value_or(0.0);
+  snapshot.process_matches = pm.get_int64(keys.proc_matches).value_or(-1);
+  TableReader self(pm.get_table(keys.self_table));
+  {
+    int c_plugin = self.column("plugin", HMON_VAL_STRING);
+    int c_collects = self.column("collects", HMON_VAL_INT64);
+    int c_failures = self.column("failures", HMON_VAL_INT64);
+    int c_interval = self.column("interval_ms", HMON_VAL_INT64);
+    int c_last = self.column("wall_last_ms", HMON_VAL_DOUBLE);
+    int c_p50 = self.column("wall_p50_ms", HMON_VAL_DOUBLE);
+    int c_p99 = self.column("wall_p99_ms", HMON_VAL_DOUBLE);
+    int c_max = self.column("wall_max_ms", HMON_VAL_DOUBLE);
+    int c_cpu_p99 = self.column("cpu_p99_ms", HMON_VAL_DOUBLE);
+    int c_metrics = self.column("metrics", HMON_VAL_INT64);
+    int c_arena = self.column("arena_bytes", HMON_VAL_INT64);
+    int c_alloc = self.column("alloc_bytes", HMON_VAL_INT64);
+    int c_allocs = self.column("allocs", HMON_VAL_INT64);
+    int c_stale = self.column("stale", HMON_VAL_BOOL);
+    for (uint32_t r = 0; r < self.rows(); ++r) {
+      PluginSelfMetrics p;
+      p.name = self.str(r, c_plugin);
+      p.collects = self.i64(r, c_collects).value_or(0);
+      p.failures = self.i64(r, c_failures).value_or(0);
+      p.interval_ms = self.i64(r, c_interval).value_or(0);
+      p.wall_last_ms = self.f64(r, c_last).value_or(0.0);
+      p.wall_p50_ms = self.f64(r, c_p50).value_or(0.0);
+      p.wall_p99_ms = self.f64(r, c_p99).value_or(0.0);
+      p.wall_max_ms = self.f64(r, c_max).value_or(0.0);
+      p.cpu_p99_ms = self.f64(r, c_cpu_p99).value_or(0.0);
+      p.metrics = self.i64(r, c_metrics).value_or(0);
+      p.arena_bytes = self.i64(r, c_arena).value_or(0);
+      p.alloc_bytes = self.i64(r, c_alloc).value_or(0);
+      p.allocs = self.i64(r, c_allocs).value_or(0);
+      p.stale = self.b(r, c_stale).value_or(false);
+      snapshot.plugins.push_back(std::move(p));
+    }
+  }
 
   return snapshot;
 }
 
-std::vector<ProcessInfo> collectProcesses(hmon::core::PluginManager& pm, size_t limit, SortMode /*sort_mode*/, int /*lock_pid*/) {
+/*
+ * Order rows for display and trim them to `limit`, keeping the locked PID.
+ * The plugin already ranks by the same mode; this covers the frames that were
+ * collected before a sort change reached it.
+ */
+void orderProcesses(std::vector<ProcessInfo>* rows, SortMode sort_mode, int lock_pid, size_t limit) {
+  auto by = [sort_mode](const ProcessInfo& a, const ProcessInfo& b) {
+    switch (sort_mode) {
+      case SortMode::kMem: return a.mem_percent > b.mem_percent;
+      case SortMode::kGpu: return a.gpu_percent > b.gpu_percent;
+      case SortMode::kPid: return a.pid < b.pid;
+      case SortMode::kIo: return a.io_read_bps + a.io_write_bps > b.io_read_bps + b.io_write_bps;
+      case SortMode::kNet: return a.net_bps > b.net_bps;
+      case SortMode::kCpu: break;
+    }
+    return a.cpu_percent > b.cpu_percent;
+  };
+  std::stable_sort(rows->begin(), rows->end(), by);
+  if (rows->size() <= limit) return;
+
+  auto locked = std::find_if(rows->begin(), rows->end(), [lock_pid](const ProcessInfo& p) { return p.pid == lock_pid; });
+  if (lock_pid > 0 && limit > 0 && locked >= rows->begin() + static_cast<std::ptrdiff_t>(limit)) {
+    (*rows)[limit - 1] = *locked;
+  }
+  rows->resize(limit);
+}
+
+/* Group rows from "proc.groups", as ProcessInfo with pid = group id and procs = member count. */
+std::vector<ProcessInfo> collectGroups(hmon::core::PluginManager& pm, const SnapshotKeys& keys) {
+  std::vector<ProcessInfo> groups;
+  TableReader table(pm.get_table(keys.proc_groups_table));
+  int c_group = table.column("group", HMON_VAL_INT64);
+  int c_procs = table.column("procs", HMON_VAL_INT64);
+  int c_cpu = table.column("cpu_pct", HMON_VAL_DOUBLE);
+  int c_mem = table.column("mem_pct", HMON_VAL_DOUBLE);
+  int c_gpu = table.column("gpu_pct", HMON_VAL_DOUBLE);
+  int c_io_read = table.column("io_read_bps", HMON_VAL_DOUBLE);
+  int c_io_write = table.column("io_write_bps", HMON_VAL_DOUBLE);
+  int c_net = table.column("net_bps", HMON_VAL_DOUBLE);
+  int c_name = table.column("name", HMON_VAL_STRING);
+  groups.reserve(table.rows());
+  for (uint32_t r = 0; r < table.rows(); ++r) {
+    ProcessInfo g;
+    g.pid = static_cast<int>(table.i64(r, c_group).value_or(0));
+    g.procs = std::max<int>(1, static_cast<int>(table.i64(r, c_procs).value_or(1)));
+    g.cpu_percent = table.f64(r, c_cpu).value_or(0.0);
+    g.mem_percent = table.f64(r, c_mem).value_or(0.0);
+    g.gpu_percent = table.f64(r, c_gpu).value_or(0.0);
+    g.io_read_bps = table.f64(r, c_io_read).value_or(0.0);
+    g.io_write_bps = table.f64(r, c_io_write).value_or(0.0);
+    g.net_bps = table.f64(r, c_net).value_or(0.0);
+    g.command = table.str(r, c_name);
+    groups.push_back(std::move(g));
+  }
+  return groups;
+}
+
+std::vector<ProcessInfo> collectProcesses(hmon::core::PluginManager& pm, const SnapshotKeys& keys, size_t limit,
+                                          SortMode sort_mode, int lock_pid, bool groups = false) {
+  if (groups) {
+    std::vector<ProcessInfo> rows = collectGroups(pm, keys);
+    orderProcesses(&rows, sort_mode, -1, limit);
+    return rows;
+  }
   std::vector<ProcessInfo> processes;
 
-  auto proc_metrics = pm.get_by_prefix("proc.");
-  std::unordered_map<size_t, ProcessInfo> proc_map;
-  for (const auto& m : proc_metrics) {
-    size_t idx = 0;
-    if (std::sscanf(m.key.c_str(), "proc.%zu.", &idx) != 1) continue;
+  TableReader procs(pm.get_table(keys.proc_table));
+  int c_pid = procs.column("pid", HMON_VAL_INT64);
+  int c_cpu = procs.column("cpu_pct", HMON_VAL_DOUBLE);
+  int c_mem = procs.column("mem_pct", HMON_VAL_DOUBLE);
+  int c_gpu = procs.column("gpu_pct", HMON_VAL_DOUBLE);
+  int c_io_read = procs.column("io_read_bps", HMON_VAL_DOUBLE);
+  int c_io_write = procs.column("io_write_bps", HMON_VAL_DOUBLE);
+  int c_net = procs.column("net_bps", HMON_VAL_DOUBLE);
+  int c_io_delay = procs.column("io_delay_pct", HMON_VAL_DOUBLE);
+  int c_numa_node = procs.column("numa_node", HMON_VAL_INT64);
+  int c_numa_local = procs.column("numa_local_pct", HMON_VAL_DOUBLE);
+  int c_command = procs.column("command", HMON_VAL_STRING);
+  processes.reserve(procs.rows());
+  for (uint32_t r = 0; r < procs.rows(); ++r) {
+    ProcessInfo p;
+    p.pid = static_cast<int>(procs.i64(r, c_pid).value_or(0));
+    p.cpu_percent = procs.f64(r, c_cpu).value_or(0.0);
+    p.mem_percent = procs.f64(r, c_mem).value_or(0.0);
+    p.gpu_percent = procs.f64(r, c_gpu).value_or(0.0);
+    p.io_read_bps = procs.f64(r, c_io_read).value_or(0.0);
+    p.io_write_bps = procs.f64(r, c_io_write).value_or(0.0);
+    p.net_bps = procs.f64(r, c_net).value_or(0.0);
+    p.io_delay_pct = procs.f64(r, c_io_delay).value_or(0.0);
+    p.numa_node = static_cast<int>(procs.i64(r, c_numa_node).value_or(-1));
+    p.numa_local_pct = procs.f64(r, c_numa_local).value_or(0.0);
+    p.command = procs.str(r, c_command);
+    processes.push_back(std::move(p));
+  }
+
+  orderProcesses(&processes, sort_mode, lock_pid, limit + (lock_pid > 0 ? 1 : 0));
+  return processes;
+}
+
+/* What the collector side hands the ncurses loop through the triple buffer. */
+struct UiFrame {
+  Snapshot snapshot;
+  std::vector<ProcessInfo> processes;
+  bool groups = false;          /* processes holds group rows */
+};
+
+std::vector<ProcessInfo> visibleProcesses(const std::vector<ProcessInfo>& all, const Config& config) {
+  std::vector<ProcessInfo> rows = all;
+  orderProcesses(&rows, config.sort_mode, showGroups(config) ? -1 : config.lock_pid, config.top_processes);
+  return rows;
+}
+
+/*
+ * Push the process table's row count, sort mode and lock to the plugin so it
+ * ranks what the UI shows; the perf plugin counts the locked PID too.
+ */
+void sendProcessControls(hmon::core::PluginManager& pm, const Config& config) {
+  pm.control("process", "process.limit", static_cast<int>(config.top_processes));
+  pm.control("process", "process.sort", static_cast<int>(config.sort_mode));
+  pm.control("process", "process.lock_pid", config.lock_pid);
+  pm.control("process", "process.group", static_cast<int>(config.group_mode));
+  pm.control("process", "process.group_filter", config.group_mode != GroupMode::kNone ? config.drill_group : -1);
+  pm.control_str("process", "process.filter", config.process_filter);
+  pm.control("perf", "perf.lock_pid", config.lock_pid);
+}
 
-    if (m.key.find(".pid") != std::string::npos && m.value.type == HMON_VAL_INT64) {
-      proc_map[idx].pid = static_cast<int>(m.value.v.i64);
-    } else if (m.key.find(".cpu_pct") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-      proc_map[idx].cpu_percent = m.value.v.f64;
-    } else if (m.key.find(".mem_pct") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-      proc_map[idx].mem_percent = m.value.v.f64;
-    } else if (m.key.find(".gpu_pct") != std::string::npos && m.value.type == HMON_VAL_DOUBLE) {
-      proc_map[idx].gpu_percent = m.value.v.f64;
-    } else if (m.key.find(".command") != std::string::npos && m.value.type == HMON_VAL_STRING) {
-      proc_map[idx].command = m.value.v.str;
+/*
+ * Hand the registry to `sink` whenever it changed, at most once per interval,
+ * so recorded and pushed frames keep the cadence the TUI would have shown.
+ * The sink takes the read lock itself and returns false to stop.
+ */
+template <typename Sink>
+void frameLoop(hmon::core::PluginManager& pm, const std::atomic<bool>& running, int interval_ms, Sink&& sink) {
+  uint64_t seen = 0;
+  auto next_frame = std::chrono::steady_clock::now();
+  while (running.load(std::memory_order_relaxed)) {
+    const uint64_t gen = pm.generation();
+    if (gen == seen) {
+      pm.wait_for_update(seen, std::chrono::milliseconds(1000));
+      continue;
     }
+    const auto now = std::chrono::steady_clock::now();
+    if (now < next_frame) {
+      std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(next_frame - now, std::chrono::milliseconds(200)));
+      continue;
+    }
+    seen = gen;
+    next_frame = now + std::chrono::milliseconds(interval_ms);
+    if (!sink()) return;
+  }
+}
+
+/* One thread per frame consumer, so a stalled fleet viewer never delays the recording. */
+std::vector<std::thread> startFrameSinks(hmon::core::PluginManager& pm, hmon::core::RecordingWriter* recorder,
+                                         hmon::core::FleetAgent* agent, const std::atomic<bool>& running,
+                                         int interval_ms) {
+  std::vector<std::thread> threads;
+  if (recorder) {
+    threads.emplace_back([&pm, recorder, &running, interval_ms]() {
+      frameLoop(pm, running, interval_ms, [&]() {
+        auto lock = pm.read_lock();
+        if (recorder->write(pm.registry(), wallClockMs()) == 0) return true;
+        std::cerr << "[hmon] record: write failed, recording stopped\n";
+        return false;
+      });
+    });
+  }
+  if (agent) {
+    threads.emplace_back([&pm, agent, &running, interval_ms]() {
+      frameLoop(pm, running, interval_ms, [&]() {
+        /* Connecting and sending stay outside the lock; only encoding reads the registry. */
+        if (!agent->connect()) return true;
+        {
+          auto lock = pm.read_lock();
+          agent->encode(pm.registry(), wallClockMs());
+        }
+        agent->flush();
+        return true;
+      });
+    });
   }
+  return threads;
+}
+
+/* Playback state shared by the input loop and the replay thread. */
+struct ReplayControl {
+  std::atomic<bool> running{true};
+  std::atomic<bool> paused{false};
+  std::atomic<size_t> speed_index{0};
+  std::atomic<int64_t> seek_ms{0};      /* pending relative seek */
+  std::atomic<int64_t> time_ms{0};      /* recorded time of the frame on screen */
+  std::atomic<bool> at_end{false};
+};
+
+constexpr int kReplaySpeeds[] = {1, 2, 4, 8, 16, 60};
+constexpr size_t kReplaySpeedCount = sizeof(kReplaySpeeds) / sizeof(kReplaySpeeds[0]);
+/* Gaps between recorded frames longer than this (hmon was not running) are skipped over. */
+constexpr int64_t kReplayMaxGapMs = 5000;
+
+/*
+ * Publish recorded frames into the registry at their recorded pace, scaled by
+ * the playback speed, so the normal publisher/render path shows them.
+ */
+void replayLoop(hmon::core::PluginManager& pm, size_t source, hmon::core::RecordingReader* reader,
+                ReplayControl* control) {
+  size_t frame = 0;
+  auto published_at = std::chrono::steady_clock::now();
+  auto show = [&](size_t target) {
+    if (!reader->seek(target)) return;
+    frame = target;
+    control->time_ms = reader->frame_time(frame);
+    control->at_end = frame + 1 >= reader->frame_count();
+    pm.publish_source(source, reader->list());
+    published_at = std::chrono::steady_clock::now();
+  };
+  show(0);
 
-  for (size_t i = 0; i < proc_map.size() && processes.size() < limit; ++i) {
-    if (proc_map.count(i)) {
-      processes.push_back(proc_map[i]);
+  while (control->running.load(std::memory_order_relaxed)) {
+    if (const int64_t seek = control->seek_ms.exchange(0); seek != 0) {
+      show(reader->frame_at(reader->frame_time(frame) + seek));
+      continue;
+    }
+    if (control->paused || frame + 1 >= reader->frame_count()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      continue;
     }
+    const int64_t gap = std::clamp<int64_t>(reader->frame_time(frame + 1) - reader->frame_time(frame), 0, kReplayMaxGapMs);
+    const auto due = published_at + std::chrono::milliseconds(gap / kReplaySpeeds[control->speed_index.load()]);
+    const auto now = std::chrono::steady_clock::now();
+    if (now < due) {
+      std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(due - now, std::chrono::milliseconds(50)));
+      continue;
+    }
+    show(frame + 1);
+  }
+}
+
+/* "host  [replay 2026-01-02 03:04:05 x4 paused]" for the header. */
+std::string replayLabel(const std::string& host, const ReplayControl& control) {
+  const auto t = static_cast<time_t>(control.time_ms.load() / 1000);
+  struct tm tm_buf;
+  localtime_r(&t, &tm_buf);
+  char when[32];
+  std::strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm_buf);
+  std::string label = host + "  [replay " + when + " x" + std::to_string(kReplaySpeeds[control.speed_index.load()]);
+  if (control.paused) label += " paused";
+  else if (control.at_end) label += " end";
+  return label + "]";
+}
+
+std::atomic<bool> g_headless_running{true};
+
+/*
+ * Agent mode: the plugin scheduler feeds the registry and the exporter serves
+ * it until SIGINT or SIGTERM.  ncurses is never initialised.  A pushing agent
+ * only serves HTTP when --listen asks for it.
+ */
+int runHeadless(hmon::core::PluginManager& pm, const Config& config, hmon::core::RecordingWriter* recorder,
+                hmon::core::FleetAgent* agent) {
+  hmon::core::MetricsExporter exporter(pm);
+  const bool exporting = !agent || config.listen_set;
+  if (exporting && exporter.listen(config.listen_address, config.listen_port) != 0) {
+    return 1;
   }
 
-  return processes;
+  struct sigaction sa{};
+  sa.sa_handler = [](int) { g_headless_running.store(false, std::memory_order_relaxed); };
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+
+  sendProcessControls(pm, config);
+  pm.control("docker", "docker.backend", config.docker_cgroup_backend ? 1 : 0);
+  pm.set_cpu_budget(config.cpu_budget_pct / 100.0);
+  pm.collect_all(kPrimeSample);
+  pm.start();
+  if (exporting) {
+    std::cerr << "[hmon] exporting on " << (config.listen_address.empty() ? "*" : config.listen_address) << ":"
+              << config.listen_port << "/metrics\n";
+  }
+  std::vector<std::thread> sinks = startFrameSinks(pm, recorder, agent, g_headless_running, config.refresh_interval_ms);
+  if (exporting) {
+    exporter.run(g_headless_running);
+  } else {
+    while (g_headless_running.load(std::memory_order_relaxed)) std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+  pm.wake_waiters();
+  for (auto& t : sinks) t.join();
+  pm.destroy_all();
+  return 0;
 }
 
-void updateHistory(MetricsHistory* history, const Snapshot& snapshot, size_t max_points,
-                   const std::optional<double>& disk_busy_percent) {
-  if (!history || max_points == 0) return;
+/* $XDG_CONFIG_HOME/hmon/alerts.conf, else ~/.config/hmon/alerts.conf; empty if neither is known. */
+std::string defaultAlertsPath() {
+  if (const char* config = std::getenv("XDG_CONFIG_HOME"); config && *config) {
+    return std::string(config) + "/hmon/alerts.conf";
+  }
+  if (const char* home = std::getenv("HOME"); home && *home) return std::string(home) + "/.config/hmon/alerts.conf";
+  return {};
+}
 
-  auto appendValue = [&](std::vector<double>& series, const std::optional<double>& value) {
-    const double next_value = std::max(0.0, std::min(100.0, value.value_or(series.empty() ? 0.0 : series.back())));
-    series.push_back(next_value);
-    if (series.size() > max_points) {
-      series.erase(series.begin(), series.begin() + static_cast<std::ptrdiff_t>(series.size() - max_points));
-    }
+/* $XDG_STATE_HOME/hmon/history, else ~/.local/state/hmon/history; empty if neither is known. */
+std::string historyFilePath() {
+  std::string dir;
+  if (const char* state = std::getenv("XDG_STATE_HOME"); state && *state) {
+    dir = state;
+  } else if (const char* home = std::getenv("HOME"); home && *home) {
+    dir = std::string(home) + "/.local/state";
+  } else {
+    return {};
+  }
+  return dir + "/hmon/history";
+}
+
+void loadHistory(MetricsHistory* history, const std::string& path) {
+  if (path.empty()) return;
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return;
+  for (auto* series : history->all()) {
+    if (!series->read(in)) return;
+  }
+}
+
+/* Rollup tiers survive restarts; raw samples only feed the live view and are dropped. */
+void saveHistory(MetricsHistory* history, const std::string& path) {
+  if (path.empty()) return;
+  std::error_code ec;
+  std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+  if (ec) return;
+  const std::string tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) return;
+    for (auto* series : history->all()) series->write(out);
+    if (!out) return;
+  }
+  std::rename(tmp.c_str(), path.c_str());
+}
+
+void updateHistory(MetricsHistory* history, const Snapshot& snapshot) {
+  if (!history) return;
+
+  const int64_t now_ms = wallClockMs();
+  auto appendValue = [&](hmon::core::HistorySeries& series, const std::optional<double>& value) {
+    const double next_value = std::max(0.0, std::min(100.0, value.value_or(series.last().value_or(0.0))));
+    series.append(next_value, now_ms);
   };
 
   appendValue(history->cpu_usage, snapshot.cpu.usage_percent);
@@ -2100,8 +3444,8 @@ void updateHistory(MetricsHistory* history, const Snapshot& snapshot, size_t max
     appendValue(history->gpu_vram_usage, std::nullopt);
   }
 
-  if (disk_busy_percent) {
-    appendValue(history->disk_usage, disk_busy_percent);
+  if (snapshot.disk.busy_percent) {
+    appendValue(history->disk_usage, snapshot.disk.busy_percent);
   } else if (snapshot.disk.total_bytes && snapshot.disk.free_bytes && *snapshot.disk.total_bytes > 0) {
     const double disk_pct = 100.0 * static_cast<double>(*snapshot.disk.total_bytes - *snapshot.disk.free_bytes) /
                             static_cast<double>(*snapshot.disk.total_bytes);
@@ -2111,15 +3455,15 @@ void updateHistory(MetricsHistory* history, const Snapshot& snapshot, size_t max
   }
 }
 
-void renderSnapshot(const Snapshot& snapshot, const MetricsHistory& history,
+void renderSnapshot(RenderCache* cache, const Snapshot& snapshot, const MetricsHistory& history,
                     const std::vector<ProcessInfo>& processes, const std::string& host,
                     const Config& config, int refresh_interval_ms, bool loading = false) {
-  erase();
-
   int rows = 0, cols = 0;
   getmaxyx(stdscr, rows, cols);
 
   if (rows < 18 || cols < 80) {
+    cache->invalidate();
+    erase();
     attron(A_BOLD);
     mvaddnstr(2, 2, "Terminal too small. Resize to at least 80x18.", std::max(0, cols - 4));
     mvaddnstr(3, 2, "Press q to quit.", std::max(0, cols - 4));
@@ -2129,17 +3473,72 @@ void renderSnapshot(const Snapshot& snapshot, const MetricsHistory& history,
   }
 
   if (config.zen_mode) {
+    cache->invalidate();
     renderZenMode(stdscr, snapshot, config, processes, loading);
+    if (config.show_plugin_timings) drawPluginTimingsOverlay(snapshot);
     doupdate();
     return;
   }
 
+  const int top = 2;
+  const int gap = 1;
+  const int margin = 1;
+  const int content_w = cols - 2 * margin - gap;
+  const int left_w = content_w / 2;
+  const int right_w = content_w - left_w;
+  const int x_left = margin;
+  const int x_right = x_left + left_w + gap;
+
+  const int content_h = rows - top - 2;
+  const int history_min_h = std::max(6, estimateHistoryRows() / 2);
+  const int min_panel_h = 4;
+  const int min_stack_h = min_panel_h * 3 + gap * 2;
+  const int left_pref_top_h = estimateCpuRows(snapshot) + 1;
+  const int left_pref_bottom_h = estimateRamRows(snapshot) + estimateNetworkRows(snapshot) + gap + 1;
+  const int right_pref_top_h = config.show_gpu ? estimateGpuRows(snapshot) + 1 : 0;
+  const int right_pref_bottom_h = estimateDiskRows(snapshot) + 1;
+  const int pref_stack_h = std::max(left_pref_top_h + gap + left_pref_bottom_h,
+                                    right_pref_top_h + gap + right_pref_bottom_h);
+  const int stack_h = std::min(content_h, std::max(min_stack_h, pref_stack_h));
+  const int remaining_h = content_h - stack_h;
+  const bool has_history_panel = config.show_history && remaining_h >= (history_min_h + gap);
+  const int history_h = has_history_panel ? (remaining_h - gap) : 0;
+
+  int cpu_h = min_panel_h, left_bottom_h = min_panel_h, gpu_h = min_panel_h, disk_h = min_panel_h;
+  splitColumnHeights(stack_h, left_pref_top_h, left_pref_bottom_h, gap, &cpu_h, &left_bottom_h);
+  splitColumnHeights(stack_h, right_pref_top_h, right_pref_bottom_h, gap, &gpu_h, &disk_h);
+  /* RAM and NETWORK share the left column below CPU; panels must not overlap for damage tracking. */
+  int ram_h = min_panel_h, net_h = min_panel_h;
+  splitColumnHeights(left_bottom_h, estimateRamRows(snapshot) + 1, estimateNetworkRows(snapshot) + 1, gap, &ram_h, &net_h);
+
+  const Rect cpu_rect{top, x_left, cpu_h, left_w};
+  const Rect ram_rect{top + cpu_h + gap, x_left, ram_h, left_w};
+  const Rect gpu_rect{top, x_right, gpu_h, right_w};
+  const Rect disk_rect{top + gpu_h + gap, x_right, disk_h, right_w};
+  const Rect history_rect{top + stack_h + gap, margin, history_h, cols - 2 * margin};
+  const Rect net_rect{ram_rect.y + ram_h + gap, x_left, net_h, left_w};
+
+  const uint64_t layout_hash = RenderHash()
+                                  .add(int64_t{rows}).add(int64_t{cols})
+                                  .add(cpu_rect).add(ram_rect).add(gpu_rect).add(disk_rect).add(net_rect)
+                                  .add(int64_t{config.show_gpu}).add(int64_t{has_history_panel})
+                                  .add(has_history_panel ? history_rect : Rect{})
+                                  .value();
+  if (!cache->valid || cache->layout_hash != layout_hash) {
+    cache->invalidate();
+    cache->layout_hash = layout_hash;
+    cache->valid = true;
+    erase();
+  }
+
   const std::string logo = " hmon " + std::string(version::kCurrent) + " ";
   const std::string status = "Host: " + host + "  |  Refresh: " +
                              (refresh_interval_ms >= 1000 ? std::to_string(refresh_interval_ms / 1000) + "s" :
                                                             std::to_string(refresh_interval_ms) + "ms");
   const std::string time_str = currentTimestamp();
 
+  move(0, 0);
+  clrtoeol();
   attron(A_BOLD);
   if (has_colors()) {
     attron(COLOR_PAIR(4));
@@ -2154,6 +3553,18 @@ void renderSnapshot(const Snapshot& snapshot, const MetricsHistory& history,
 
   mvaddnstr(0, static_cast<int>(logo.size()) + 1, status.c_str(), cols - static_cast<int>(logo.size()) - static_cast<int>(time_str.size()) - 2);
 
+  const auto firing = std::count_if(snapshot.alerts.begin(), snapshot.alerts.end(), [](const AlertInfo& a) { return a.firing; });
+  if (firing > 0) {
+    std::string alert_text = "  |  ALERT " + snapshot.alerts.front().rule;
+    if (firing > 1) alert_text += " (+" + std::to_string(firing - 1) + ")";
+    const int alert_col = static_cast<int>(logo.size() + 1 + status.size());
+    attron(A_BOLD);
+    if (has_colors()) attron(COLOR_PAIR(3));
+    mvaddnstr(0, alert_col, alert_text.c_str(), std::max(0, cols - alert_col - static_cast<int>(time_str.size()) - 2));
+    if (has_colors()) attroff(COLOR_PAIR(3));
+    attroff(A_BOLD);
+  }
+
   if (has_colors()) {
     attron(COLOR_PAIR(7));
   }
@@ -2166,126 +3577,139 @@ void renderSnapshot(const Snapshot& snapshot, const MetricsHistory& history,
     mvaddch(1, x, ACS_HLINE);
   }
 
-  std::string shortcuts = " q:Quit  z:Zen  s:Sort  l:Lock  u:Unlock  +/-:Speed  r:Refresh  ?:Help ";
+  std::string shortcuts = " q:Quit  z:Zen  s:Sort  /:Filter  l:Lock  u:Unlock  +/-:Speed  r:Refresh  ?:Help ";
+  if (!config.replay_path.empty()) {
+    shortcuts = " q:Quit  z:Zen  Space:Pause  </>:Seek  f:Playback  +/-:Speed  ?:Help ";
+  } else if (!config.fleet_target.empty()) {
+    shortcuts = " q:Quit  b:Fleet  z:Zen  s:Sort  h:History  +/-:Speed  ?:Help ";
+  }
   attron(A_REVERSE);
   mvaddnstr(rows - 1, 0, shortcuts.c_str(), cols);
   attroff(A_REVERSE);
 
-  if (loading) {
-    attron(A_BOLD);
-    mvaddnstr(3, 2, "Collecting system metrics...", cols - 4);
-    attroff(A_BOLD);
-  }
-
-  const int top = 2;
-  const int gap = 1;
-  const int margin = 1;
-  const int content_w = cols - 2 * margin - gap;
-  const int left_w = content_w / 2;
-  const int right_w = content_w - left_w;
-  const int x_left = margin;
-  const int x_right = x_left + left_w + gap;
-
-  const int content_h = rows - top - 2;
-  const int history_min_h = std::max(6, estimateHistoryRows() / 2);
-  const int min_panel_h = 4;
-  const int min_stack_h = min_panel_h * 3 + gap * 2;
-  const int left_pref_top_h = estimateCpuRows(snapshot) + 1;
-  const int left_pref_bottom_h = estimateRamRows() + estimateNetworkRows() + gap + 1;
-  const int right_pref_top_h = config.show_gpu ? estimateGpuRows(snapshot) + 1 : 0;
-  const int right_pref_bottom_h = estimateDiskRows() + 1;
-  const int pref_stack_h = std::max(left_pref_top_h + gap + left_pref_bottom_h,
-                                    right_pref_top_h + gap + right_pref_bottom_h);
-  const int stack_h = std::min(content_h, std::max(min_stack_h, pref_stack_h));
-  const int remaining_h = content_h - stack_h;
-  const bool has_history_panel = config.show_history && remaining_h >= (history_min_h + gap);
-  const int history_h = has_history_panel ? (remaining_h - gap) : 0;
+  /* Until the first sample each panel gets its frame and a placeholder; the next frame repaints all of them. */
+  if (loading) cache->valid = false;
+  auto body = [loading](auto render) {
+    return [loading, render](WINDOW* w) {
+      if (loading) drawPanelPlaceholder(w);
+      else render(w);
+    };
+  };
 
-  int cpu_h = min_panel_h, ram_h = min_panel_h, gpu_h = min_panel_h, disk_h = min_panel_h;
-  splitColumnHeights(stack_h, left_pref_top_h, left_pref_bottom_h, gap, &cpu_h, &ram_h);
-  splitColumnHeights(stack_h, right_pref_top_h, right_pref_bottom_h, gap, &gpu_h, &disk_h);
 
-  const Rect cpu_rect{top, x_left, cpu_h, left_w};
-  const Rect ram_rect{top + cpu_h + gap, x_left, ram_h, left_w};
-  const Rect gpu_rect{top, x_right, gpu_h, right_w};
-  const Rect disk_rect{top + gpu_h + gap, x_right, disk_h, right_w};
-  const Rect history_rect{top + stack_h + gap, margin, history_h, cols - 2 * margin};
-  const Rect net_rect{top + ram_h + gap, x_left, std::max(min_panel_h, content_h - cpu_h - ram_h - gap * 2), left_w};
-
-  WINDOW* cpu_panel = createPanel(cpu_rect, "CPU");
-  WINDOW* ram_panel = createPanel(ram_rect, "RAM");
-  WINDOW* gpu_panel = config.show_gpu ? createPanel(gpu_rect, "GPU") : nullptr;
-  WINDOW* net_panel = createPanel(net_rect, "NETWORK");
-  WINDOW* disk_panel = createPanel(disk_rect, "DISK");
-  WINDOW* history_panel = has_history_panel ? createPanel(history_rect, "ACTIVITY HISTORY") : nullptr;
-
-  renderCpuPanel(cpu_panel, snapshot);
-  renderNetworkPanel(net_panel, snapshot);
-  renderRamPanel(ram_panel, snapshot);
-  if (config.show_gpu) {
-    renderGpuPanel(gpu_panel, snapshot);
-  }
-  renderDiskPanel(disk_panel, snapshot);
-  if (has_history_panel) {
-    renderHistoryPanel(history_panel, history, processes, config.selected_pid, config.lock_pid,
-                       config.show_selection_highlight, config.sort_mode);
-  }
+  WINDOW* cpu_panel = acquirePanel(&cache->cpu, cpu_rect);
+  WINDOW* ram_panel = acquirePanel(&cache->ram, ram_rect);
+  WINDOW* gpu_panel = config.show_gpu ? acquirePanel(&cache->gpu, gpu_rect) : nullptr;
+  WINDOW* net_panel = acquirePanel(&cache->net, net_rect);
+  WINDOW* disk_panel = acquirePanel(&cache->disk, disk_rect);
+  WINDOW* history_panel = has_history_panel ? acquirePanel(&cache->history, history_rect) : nullptr;
 
+  /* After the first frame only the header and footer rows of stdscr change, and no panel covers them. */
   wnoutrefresh(stdscr);
 
-  if (cpu_panel) { wnoutrefresh(cpu_panel); delwin(cpu_panel); }
-  if (ram_panel) { wnoutrefresh(ram_panel); delwin(ram_panel); }
-  if (gpu_panel) { wnoutrefresh(gpu_panel); delwin(gpu_panel); }
-  if (net_panel) { wnoutrefresh(net_panel); delwin(net_panel); }
-  if (disk_panel) { wnoutrefresh(disk_panel); delwin(disk_panel); }
-  if (history_panel) { wnoutrefresh(history_panel); delwin(history_panel); }
-
-  doupdate();
-}
+  const auto& cpu = snapshot.cpu;
+  RenderHash cpu_hash;
+  cpu_hash.add(cpu.name).add(cpu.total_cores).add(cpu.total_threads)
+      .add(cpu.frequency_mhz).add(cpu.usage_percent).add(cpu.temperature_c);
+  for (const auto& c : cpu.core_counters) cpu_hash.add(formatPerfCounters(c));
+  for (const auto& [socket, c] : cpu.socket_counters) cpu_hash.add(int64_t{socket}).add(formatPerfCounters(c));
+  cpu_hash.add(int64_t{cpu.counters_pid}).add(formatPerfCounters(cpu.pid_counters));
+  updatePanel(&cache->cpu, cpu_panel, "CPU", firingAlert(snapshot, AlertPanel::kCpu), cpu_hash.value(),
+              body([&](WINDOW* w) { renderCpuPanel(w, snapshot); }));
 
-int main(int argc, char* argv[]) {
-  Config config = parseArgs(argc, argv);
+  const auto& net = snapshot.network;
+  RenderHash net_hash;
+  net_hash.add(net.interface).add(net.rx_kbps).add(net.tx_kbps);
+  for (const auto& n : net.interfaces) {
+    net_hash.add(n.name).add(formatCompactBytes(n.rx_bytes_per_sec)).add(formatCompactBytes(n.tx_bytes_per_sec))
+        .add(static_cast<int64_t>(std::lround(n.rx_drops_per_sec + n.tx_drops_per_sec)));
+  }
+  net_hash.add(static_cast<int64_t>(net.interfaces.size()));
+  updatePanel(&cache->net, net_panel, "NETWORK", firingAlert(snapshot, AlertPanel::kNet), net_hash.value(),
+              body([&](WINDOW* w) { renderNetworkPanel(w, snapshot); }));
+
+  /* Byte counts are shown to one decimal of the unit; one MiB is finer than any of them. */
+  auto mib = [](const auto& v) { return v ? std::optional<int64_t>(static_cast<int64_t>(*v) >> 20) : std::nullopt; };
+  auto kib_to_mib = [](const std::optional<long long>& v) { return v ? std::optional<int64_t>(*v >> 10) : std::nullopt; };
+  RenderHash ram_hash;
+  ram_hash.add(kib_to_mib(snapshot.ram.total_kb)).add(kib_to_mib(snapshot.ram.available_kb));
+  for (const auto& p : snapshot.pressure) {
+    ram_hash.add(p.resource).add(static_cast<int64_t>(std::lround(p.some_avg10 * 10.0))).add(int64_t{p.stalled});
+  }
+  updatePanel(&cache->ram, ram_panel, "RAM", firingAlert(snapshot, AlertPanel::kRam), ram_hash.value(),
+              body([&](WINDOW* w) { renderRamPanel(w, snapshot); }));
 
-  if (config.cli_error) {
-    std::cerr << *config.cli_error << "\n\n";
-    printHelp(argv[0]);
-    return 1;
+  if (config.show_gpu) {
+    RenderHash gpu_hash;
+    for (const auto& gpu : snapshot.gpus) {
+      gpu_hash.add(gpu.name).add(gpu.source).add(gpu.in_use).add(gpu.temperature_c).add(gpu.core_clock_mhz)
+          .add(gpu.utilization_percent).add(gpu.power_w).add(gpu.memory_used_mib).add(gpu.memory_total_mib)
+          .add(gpu.memory_utilization_percent);
+    }
+    gpu_hash.add(static_cast<int64_t>(snapshot.gpus.size()));
+    updatePanel(&cache->gpu, gpu_panel, "GPU", firingAlert(snapshot, AlertPanel::kGpu), gpu_hash.value(),
+                body([&](WINDOW* w) { renderGpuPanel(w, snapshot); }));
   }
 
-  if (config.show_help) {
-    printHelp(argv[0]);
-    return 0;
+  RenderHash disk_hash;
+  disk_hash.add(snapshot.disk.mount_point).add(mib(snapshot.disk.total_bytes)).add(mib(snapshot.disk.free_bytes));
+  for (const auto& m : snapshot.disk.mounts) {
+    disk_hash.add(m.mount_point).add(mib(std::optional<unsigned long long>(m.total_bytes)))
+        .add(mib(std::optional<unsigned long long>(m.free_bytes)));
   }
-
-  if (config.show_version) {
-    printVersion();
-    return 0;
+  disk_hash.add(static_cast<int64_t>(snapshot.disk.mounts.size()));
+  for (const auto& d : snapshot.disk.devices) {
+    disk_hash.add(d.device).add(formatCompactBytes(d.read_bytes_per_sec)).add(formatCompactBytes(d.write_bytes_per_sec))
+        .add(static_cast<int64_t>(std::lround(d.busy_percent))).add(static_cast<int64_t>(std::lround(d.await_ms * 10)));
   }
+  disk_hash.add(static_cast<int64_t>(snapshot.disk.devices.size()));
+  updatePanel(&cache->disk, disk_panel, "DISK", firingAlert(snapshot, AlertPanel::kDisk), disk_hash.value(),
+              body([&](WINDOW* w) { renderDiskPanel(w, snapshot); }));
 
-  std::setlocale(LC_ALL, "");
-
-
-  hmon::core::PluginManager pm;
-
-
-  pm.load_static();
-
-  if (pm.plugin_count() == 0) {
-    std::cerr << "hmon: no plugins found.\n";
-    return 1;
+  if (has_history_panel) {
+    RenderHash history_hash;
+    const auto& raw = history.cpu_usage.raw();
+    history_hash.add(raw.empty() ? int64_t{0} : raw.back().time_ms).add(static_cast<int64_t>(config.history_zoom));
+    for (const auto& p : processes) {
+      history_hash.add(int64_t{p.pid}).add(int64_t{p.procs}).add(p.cpu_percent).add(p.mem_percent).add(p.gpu_percent)
+          .add(p.io_read_bps).add(p.io_write_bps).add(p.net_bps).add(p.command);
+    }
+    std::string command_title = "COMMAND";
+    if (showGroups(config)) command_title = std::string(groupModeLabel(config.group_mode)) + " (Enter opens)";
+    else if (config.group_mode != GroupMode::kNone) command_title = "COMMAND in " + config.drill_group_name + " (Esc)";
+    if (!showGroups(config) && (config.filter_editing || !config.process_filter.empty())) {
+      command_title += "  /" + config.process_filter + (config.filter_editing ? "_" : "");
+      if (snapshot.process_matches >= 0 && !config.process_filter.empty()) {
+        command_title += " (" + std::to_string(snapshot.process_matches) + " match" +
+                         (snapshot.process_matches == 1 ? ")" : "es)");
+      }
+    }
+    history_hash.add(command_title);
+    history_hash.add(int64_t{config.selected_pid}).add(int64_t{config.lock_pid})
+        .add(int64_t{config.show_selection_highlight}).add(static_cast<int64_t>(config.sort_mode));
+    updatePanel(&cache->history, history_panel, "ACTIVITY HISTORY", firingAlert(snapshot, AlertPanel::kProcesses),
+                history_hash.value(), body([&](WINDOW* w) {
+      renderHistoryPanel(w, &cache->history_graphs, history, processes, config.selected_pid, config.lock_pid,
+                         config.show_selection_highlight, config.sort_mode, config.history_zoom, command_title);
+    }));
   }
 
-  if (pm.init_all() != 0) {
-    std::cerr << "hmon: failed to initialise one or more plugins.\n";
-    return 1;
-  }
+  if (config.show_plugin_timings) drawPluginTimingsOverlay(snapshot);
+  doupdate();
+}
 
+void initTerminal(const Config& config) {
   initscr();
   cbreak();
   noecho();
   curs_set(0);
   keypad(stdscr, TRUE);
   timeout(config.refresh_interval_ms);
+  /* Ask for focus reports (xterm mode 1004); terminals without it never send them. */
+  define_key("\033[I", kKeyFocusIn);
+  define_key("\033[O", kKeyFocusOut);
+  std::fputs("\033[?1004h", stdout);
+  std::fflush(stdout);
 
   if (has_colors() && config.show_colors) {
     start_color();
@@ -2319,40 +3743,611 @@ int main(int argc, char* argv[]) {
       init_pair(7, COLOR_WHITE, -1);
     }
   }
+}
+
+void closeTerminal() {
+  std::fputs("\033[?1004l", stdout);
+  std::fflush(stdout);
+  endwin();
+}
+
+/* One host's line in the fleet view. */
+struct FleetRow {
+  hmon::core::FleetServer::Host* host = nullptr;
+  std::string name;
+  bool connected = false;
+  int64_t age_ms = -1;  /* since the last frame; -1 before the first */
+  Snapshot snapshot;
+};
+
+/* A connected host that has sent nothing for this long is shown as stale. */
+constexpr int64_t kFleetStaleMs = 10000;
+
+std::string formatFleetRate(const std::optional<double>& kbps) {
+  if (!kbps) return "-";
+  char buf[16];
+  if (*kbps < 1000.0) std::snprintf(buf, sizeof(buf), "%.0fK", *kbps);
+  else if (*kbps < 1000.0 * 1000.0) std::snprintf(buf, sizeof(buf), "%.1fM", *kbps / 1000.0);
+  else std::snprintf(buf, sizeof(buf), "%.1fG", *kbps / (1000.0 * 1000.0));
+  return buf;
+}
+
+std::string formatFleetAge(int64_t age_ms) {
+  if (age_ms < 0) return "-";
+  const int64_t secs = age_ms / 1000;
+  if (secs < 60) return std::to_string(secs) + "s";
+  if (secs < 3600) return std::to_string(secs / 60) + "m";
+  return std::to_string(secs / 3600) + "h";
+}
+
+std::string fleetStateLabel(const FleetRow& row) {
+  if (!row.connected) return "down";
+  return row.age_ms < 0 || row.age_ms > kFleetStaleMs ? "stale" : "up";
+}
+
+void renderFleetView(const std::vector<FleetRow>& hosts, size_t selected, const std::string& target) {
+  int rows = 0, cols = 0;
+  getmaxyx(stdscr, rows, cols);
+  erase();
+
+  if (rows < 8 || cols < 80) {
+    attron(A_BOLD);
+    mvaddnstr(2, 2, "Terminal too small. Resize to at least 80x8.", std::max(0, cols - 4));
+    mvaddnstr(3, 2, "Press q to quit.", std::max(0, cols - 4));
+    attroff(A_BOLD);
+    refresh();
+    return;
+  }
+
+  const size_t up = static_cast<size_t>(std::count_if(hosts.begin(), hosts.end(),
+                                                      [](const FleetRow& row) { return row.connected; }));
+  const std::string logo = " hmon " + std::string(version::kCurrent) + " ";
+  const std::string status = "Fleet: " + std::to_string(hosts.size()) + " hosts, " + std::to_string(up) +
+                             " up  |  Listening: " + target;
+  const std::string time_str = currentTimestamp();
+
+  attron(A_BOLD);
+  if (has_colors()) attron(COLOR_PAIR(4) | A_REVERSE);
+  mvaddnstr(0, 0, logo.c_str(), static_cast<int>(logo.size()));
+  if (has_colors()) attroff(COLOR_PAIR(4) | A_REVERSE);
+  attroff(A_BOLD);
+  mvaddnstr(0, static_cast<int>(logo.size()) + 1, status.c_str(),
+            cols - static_cast<int>(logo.size()) - static_cast<int>(time_str.size()) - 2);
+  if (has_colors()) attron(COLOR_PAIR(7));
+  mvaddnstr(0, cols - static_cast<int>(time_str.size()) - 1, time_str.c_str(), static_cast<int>(time_str.size()));
+  if (has_colors()) attroff(COLOR_PAIR(7));
+  mvhline(1, 0, ACS_HLINE, cols);
+
+  /* HOST(14) STATE(6), three bar + percent columns, NET(15) DISK(5) SEEN(5); the bars take the slack. */
+  const int bar_w = std::clamp((cols - 1 - 71) / 3, 2, 20);
+  const int col_state = 16;
+  const int col_cpu = col_state + 7;
+  const int col_ram = col_cpu + bar_w + 7;
+  const int col_gpu = col_ram + bar_w + 7;
+  const int col_net = col_gpu + bar_w + 7;
+  const int col_disk = col_net + 16;
+  const int col_seen = col_disk + 6;
+
+  attron(A_BOLD);
+  mvaddstr(2, 1, "HOST");
+  mvaddstr(2, col_state, "STATE");
+  mvaddstr(2, col_cpu, "CPU");
+  mvaddstr(2, col_ram, "RAM");
+  mvaddstr(2, col_gpu, "GPU");
+  mvaddstr(2, col_net, "NET RX/TX");
+  mvaddstr(2, col_disk, "DISK");
+  mvaddstr(2, col_seen, "SEEN");
+  attroff(A_BOLD);
+
+  if (hosts.empty()) {
+    if (has_colors()) attron(COLOR_PAIR(7));
+    mvaddnstr(4, 1, ("Waiting for agents: hmon --headless --push <this host>:<port>  (listening on " + target + ")").c_str(),
+              cols - 2);
+    if (has_colors()) attroff(COLOR_PAIR(7));
+  }
+
+  const size_t visible = static_cast<size_t>(std::max(1, rows - 4));
+  const size_t first = selected >= visible ? selected - visible + 1 : 0;
+  auto percentColumn = [&](int row, int col, const std::optional<double>& percent, bool dim) {
+    if (!percent) {
+      mvaddstr(row, col, "N/A");
+      return;
+    }
+    if (!dim) drawMiniBar(stdscr, row, col, *percent, bar_w);
+    else mvhline(row, col, ' ', bar_w);
+    char text[8];
+    std::snprintf(text, sizeof(text), "%4.0f%%", *percent);
+    mvaddstr(row, col + bar_w + 1, text);
+  };
+
+  for (size_t i = first; i < hosts.size() && i < first + visible; ++i) {
+    const FleetRow& host = hosts[i];
+    const Snapshot& snap = host.snapshot;
+    const int row = 3 + static_cast<int>(i - first);
+    const bool dim = !host.connected;
+    const bool is_selected = i == selected;
+
+    if (dim && has_colors()) attron(COLOR_PAIR(7));
+    if (is_selected) attron(A_REVERSE);
+    mvhline(row, 0, ' ', cols);
+    mvaddnstr(row, 1, clippedText(host.name, 14).c_str(), 14);
+    if (is_selected) attroff(A_REVERSE);
+
+    const std::string state = fleetStateLabel(host);
+    if (!dim && has_colors()) attron(COLOR_PAIR(state == "up" ? 1 : 2));
+    mvaddstr(row, col_state, state.c_str());
+    if (!dim && has_colors()) attroff(COLOR_PAIR(state == "up" ? 1 : 2));
+
+    std::optional<double> ram;
+    if (snap.ram.total_kb && snap.ram.available_kb && *snap.ram.total_kb > 0) {
+      ram = 100.0 * static_cast<double>(*snap.ram.total_kb - *snap.ram.available_kb) / static_cast<double>(*snap.ram.total_kb);
+    }
+    std::optional<double> gpu;
+    if (anyGpuHasTelemetry(snap.gpus)) gpu = snap.gpus[pickDisplayGpuIndex(snap.gpus)].utilization_percent;
+    std::optional<double> disk;
+    if (snap.disk.total_bytes && snap.disk.free_bytes && *snap.disk.total_bytes > 0) {
+      disk = 100.0 * static_cast<double>(*snap.disk.total_bytes - *snap.disk.free_bytes) / static_cast<double>(*snap.disk.total_bytes);
+    }
+
+    percentColumn(row, col_cpu, snap.cpu.usage_percent, dim);
+    percentColumn(row, col_ram, ram, dim);
+    percentColumn(row, col_gpu, gpu, dim);
+    mvaddnstr(row, col_net, (formatFleetRate(snap.network.rx_kbps) + "/" + formatFleetRate(snap.network.tx_kbps)).c_str(), 15);
+    if (disk) {
+      char text[8];
+      std::snprintf(text, sizeof(text), "%3.0f%%", *disk);
+      mvaddstr(row, col_disk, text);
+    } else {
+      mvaddstr(row, col_disk, "N/A");
+    }
+    mvaddnstr(row, col_seen, formatFleetAge(host.age_ms).c_str(), std::max(0, cols - col_seen - 1));
+    if (dim && has_colors()) attroff(COLOR_PAIR(7));
+  }
+
+  attron(A_REVERSE);
+  mvaddnstr(rows - 1, 0, " q:Quit  j/k:Select  Enter:Host details ", cols);
+  attroff(A_REVERSE);
+  refresh();
+}
+
+/* Header label of a drilled-in host: "name  [fleet: up]" or "[fleet: down, seen 5m ago]". */
+std::string fleetHostLabel(const FleetRow& row) {
+  const std::string state = fleetStateLabel(row);
+  if (state == "up") return row.name + "  [fleet]";
+  return row.name + "  [fleet: " + state + ", seen " + formatFleetAge(row.age_ms) + " ago]";
+}
+
+/*
+ * Central view for agents started with --push: one line per host, Enter to
+ * open a host in the usual dashboard.  The FleetServer thread feeds each
+ * host's registry; this loop only reads them.
+ */
+int runFleetViewer(Config config) {
+  hmon::core::FleetServer server;
+  if (server.listen(config.fleet_target) != 0) {
+    return 1;
+  }
+  std::atomic<bool> serving{true};
+  std::thread server_thread([&]() { server.run(serving); });
+
+  initTerminal(config);
+  set_escdelay(25);
+
+  using Host = hmon::core::FleetServer::Host;
+  std::unordered_map<const Host*, std::unique_ptr<SnapshotKeys>> host_keys;
+  auto keysFor = [&](Host* host) -> const SnapshotKeys& {
+    auto& keys = host_keys[host];
+    if (!keys) keys = std::make_unique<SnapshotKeys>(host->metrics);
+    return *keys;
+  };
 
-  const std::string host = hostName();
-  MetricsHistory history;
+  std::vector<FleetRow> rows;
+  auto refreshRows = [&]() {
+    const auto hosts = server.hosts();
+    const int64_t now = wallClockMs();
+    rows.resize(hosts.size());
+    for (size_t i = 0; i < hosts.size(); ++i) {
+      Host* host = hosts[i];
+      const SnapshotKeys& keys = keysFor(host);
+      FleetRow& row = rows[i];
+      row.host = host;
+      row.name = host->name;
+      row.connected = host->connected;
+      const int64_t last = host->last_frame_ms;
+      row.age_ms = last > 0 ? std::max<int64_t>(0, now - last) : -1;
+      auto lock = host->metrics.read_lock();
+      row.snapshot = collectSnapshot(host->metrics, keys, config);
+    }
+  };
+
+  size_t selected = 0;
+  std::optional<size_t> drilled;
+  MetricsHistory history(config.history_points);
+  RenderCache render_cache;
+  Snapshot snapshot;
+  std::vector<ProcessInfo> processes;
+  std::string host;
   int refresh_interval_ms = config.refresh_interval_ms;
   bool show_help_overlay = false;
 
-  renderSnapshot(Snapshot{}, history, {}, host, config, refresh_interval_ms, true);
+  /* Drill-down frame: the same collection the local dashboard's publisher does, against the host's registry. */
+  auto collectDrilled = [&]() {
+    const FleetRow& row = rows[*drilled];
+    const SnapshotKeys& keys = keysFor(row.host);
+    {
+      auto lock = row.host->metrics.read_lock();
+      snapshot = collectSnapshot(row.host->metrics, keys, config);
+      processes = visibleProcesses(collectProcesses(row.host->metrics, keys, config.top_processes, config.sort_mode,
+                                                    config.lock_pid), config);
+    }
+    syncSelection(processes, &config);
+    host = fleetHostLabel(row);
+  };
+  auto render = [&]() {
+    if (drilled) renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
+    else renderFleetView(rows, selected, config.fleet_target);
+  };
+
+  refreshRows();
+  render();
 
-  auto collect_future = std::async(std::launch::async, [&]() {
-    pm.collect_all();
-  });
+  while (true) {
+    const int ch = getch();
+
+    if (ch == 'q' || ch == 'Q') {
+      break;
+    }
+
+    if (show_help_overlay) {
+      if (ch == ERR) continue;
+      show_help_overlay = false;
+      timeout(refresh_interval_ms);
+      render_cache.invalidate();
+      render();
+      continue;
+    }
+
+    if (!drilled) {
+      if ((ch == KEY_DOWN || ch == 'j' || ch == 'J') && selected + 1 < rows.size()) {
+        ++selected;
+      } else if ((ch == KEY_UP || ch == 'k' || ch == 'K') && selected > 0) {
+        --selected;
+      } else if ((ch == '\n' || ch == '\r' || ch == KEY_ENTER) && selected < rows.size()) {
+        drilled = selected;
+        history = MetricsHistory(config.history_points);
+        render_cache.invalidate();
+        render_cache.history_graphs = HistoryGraphs{};
+        config.selected_pid = -1;
+        config.lock_pid = -1;
+        config.zen_mode = false;
+        collectDrilled();
+        updateHistory(&history, snapshot);
+      } else if (ch == ERR) {
+        refreshRows();
+      }
+      render();
+      continue;
+    }
+
+    if (ch == 'b' || ch == 'B' || ch == 27 || ch == KEY_BACKSPACE || ch == 127) {
+      drilled.reset();
+      render_cache.invalidate();
+      refreshRows();
+      render();
+      continue;
+    }
+
+    if (ch == '?') {
+      show_help_overlay = true;
+      timeout(-1);
+      int term_rows, term_cols;
+      getmaxyx(stdscr, term_rows, term_cols);
+      const int overlay_h = std::min(17, term_rows - 4);
+      const int overlay_w = std::min(54, term_cols - 4);
+      WINDOW* help_win = newwin(overlay_h, overlay_w, (term_rows - overlay_h) / 2, (term_cols - overlay_w) / 2);
+      drawHelpOverlay(help_win, config);
+      delwin(help_win);
+      doupdate();
+      continue;
+    }
+
+    if (ch == KEY_RESIZE) {
+      render_cache.invalidate();
+    } else if (ch == 'd' || ch == 'D') {
+      config.show_plugin_timings = !config.show_plugin_timings;
+      if (!config.show_plugin_timings) render_cache.invalidate();
+    } else if (ch == 'z' || ch == 'Z') {
+      config.zen_mode = !config.zen_mode;
+      config.zen_focus = ZenFocus::kNone;
+    } else if (ch == 's' || ch == 'S') {
+      config.sort_mode = nextSortMode(config.sort_mode);
+      collectDrilled();
+    } else if (!config.zen_mode && (ch == KEY_UP || ch == 'k' || ch == 'K')) {
+      config.show_selection_highlight = true;
+      moveSelection(processes, &config, -1);
+    } else if (!config.zen_mode && (ch == KEY_DOWN || ch == 'j' || ch == 'J')) {
+      config.show_selection_highlight = true;
+      moveSelection(processes, &config, 1);
+    } else if (ch == 'h' || ch == 'H') {
+      config.history_zoom = (config.history_zoom + 1) % kHistoryZoomCount;
+    } else if ((ch == '+' || ch == '=') && refresh_interval_ms > 100) {
+      refresh_interval_ms = std::max(100, refresh_interval_ms - 100);
+      timeout(refresh_interval_ms);
+    } else if ((ch == '-' || ch == '_') && refresh_interval_ms < 10000) {
+      refresh_interval_ms = std::min(10000, refresh_interval_ms + 100);
+      timeout(refresh_interval_ms);
+    } else if (ch == ERR) {
+      refreshRows();
+      collectDrilled();
+      updateHistory(&history, snapshot);
+    } else {
+      continue;
+    }
+    render();
+  }
+
+  closeTerminal();
+  serving = false;
+  server_thread.join();
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  /* An --isolate'd plugin's helper: this binary again, serving one plugin over stdin/stdout. */
+  if (argc == 3 && std::strcmp(argv[1], "--plugin-helper") == 0) {
+    return hmon::core::PluginManager::run_helper(argv[2]);
+  }
+
+  Config config = parseArgs(argc, argv);
+
+  if (config.cli_error) {
+    std::cerr << *config.cli_error << "\n\n";
+    printHelp(argv[0]);
+    return 1;
+  }
+
+  if (config.show_help) {
+    printHelp(argv[0]);
+    return 0;
+  }
+
+  if (config.show_version) {
+    printVersion();
+    return 0;
+  }
+
+  std::setlocale(LC_ALL, "");
+
+  if (!config.fleet_target.empty()) {
+    return runFleetViewer(config);
+  }
+
+  /* Declared before the manager, whose scheduler evaluates it until destroy_all(). */
+  hmon::core::AlertEngine alerts;
+  hmon::core::PluginManager pm;
+  hmon::core::RecordingReader replay;
+  const bool replaying = !config.replay_path.empty();
+  size_t replay_source = 0;
+
+  if (replaying) {
+    if (replay.open(config.replay_path) != 0) {
+      return 1;
+    }
+    replay_source = pm.add_source("replay");
+  } else {
+    pm.load_static();
+    for (const auto& [name, deadline_ms] : config.isolate) {
+      if (!pm.isolate(name, std::chrono::milliseconds(deadline_ms))) {
+        std::cerr << "hmon: --isolate: no plugin named \"" << name << "\".\n";
+        return 1;
+      }
+    }
+  }
+
+  if (pm.plugin_count() == 0) {
+    std::cerr << "hmon: no plugins found.\n";
+    return 1;
+  }
+
+  /* A replay shows the alerts it recorded, not this machine's rules. */
+  if (!replaying) {
+    if (!config.alerts_set) config.alerts_path = defaultAlertsPath();
+    const bool present = !config.alerts_path.empty() && access(config.alerts_path.c_str(), F_OK) == 0;
+    if (config.alerts_set || present) {
+      if (alerts.load(config.alerts_path) != 0) return 1;
+    }
+    alerts.set_log(config.headless);
+    pm.set_alerts(&alerts);
+  }
 
-  collect_future.wait();
+  hmon::core::RecordingWriter recorder;
+  if (!config.record_path.empty() && recorder.open(config.record_path, hostName()) != 0) {
+    return 1;
+  }
 
-  Snapshot snapshot = collectSnapshot(pm, config);
-  std::vector<ProcessInfo> processes = collectProcesses(pm, config.top_processes, config.sort_mode, config.lock_pid);
+  std::unique_ptr<hmon::core::FleetAgent> agent;
+  if (!config.push_target.empty()) {
+    agent = std::make_unique<hmon::core::FleetAgent>(config.push_target, hostName(), config.headless);
+  }
+
+  if (config.headless) {
+    if (pm.init_all() != 0) {
+      std::cerr << "hmon: failed to initialise one or more plugins.\n";
+      return 1;
+    }
+    return runHeadless(pm, config, config.record_path.empty() ? nullptr : &recorder, agent.get());
+  }
+
+  /* The layout is painted before any plugin is initialised; init and the first samples fill it in. */
+  initTerminal(config);
+
+  const std::string host_name = replaying ? replay.host() : hostName();
+  std::string host = host_name;
+  const SnapshotKeys snapshot_keys(pm);
+  MetricsHistory history(config.history_points);
+  RenderCache render_cache;
+  /* A replay's samples are not this machine's history; keep them out of the history file. */
+  const bool persist_history = config.show_history && !replaying;
+  if (persist_history) loadHistory(&history, historyFilePath());
+  int refresh_interval_ms = config.refresh_interval_ms;
+  bool show_help_overlay = false;
+
+  renderSnapshot(&render_cache, Snapshot{}, history, {}, host, config, refresh_interval_ms, true);
+
+  ReplayControl replay_control;
+  std::thread replayer;
+  if (replaying) {
+    replayer = std::thread([&]() { replayLoop(pm, replay_source, &replay, &replay_control); });
+  } else {
+    auto startup = std::async(std::launch::async, [&]() {
+      if (pm.init_all() != 0) return false;
+      sendProcessControls(pm, config);
+      pm.control("docker", "docker.backend", config.docker_cgroup_backend ? 1 : 0);
+      pm.set_cpu_budget(config.cpu_budget_pct / 100.0);
+      pm.collect_all(kPrimeSample);
+      return true;
+    });
+    /* The placeholder layout follows a resize while plugins come up. */
+    timeout(50);
+    while (startup.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      if (getch() == KEY_RESIZE) renderSnapshot(&render_cache, Snapshot{}, history, {}, host, config, refresh_interval_ms, true);
+    }
+    timeout(refresh_interval_ms);
+    if (!startup.get()) {
+      closeTerminal();
+      std::cerr << "hmon: failed to initialise one or more plugins.\n";
+      return 1;
+    }
+    pm.start();
+  }
+
+  std::atomic<bool> sinks_running{true};
+  std::vector<std::thread> sinks = startFrameSinks(pm, config.record_path.empty() ? nullptr : &recorder, agent.get(),
+                                                   sinks_running, config.refresh_interval_ms);
+
+  /*
+   * A publisher thread turns registry updates into UiFrames; the input loop
+   * below only ever swaps in the newest finished frame, so key handling never
+   * waits on collection or on the registry lock.
+   */
+  hmon::core::TripleBuffer<UiFrame> frames;
+  std::atomic<bool> publisher_running{true};
+  std::atomic<SortMode> shared_sort_mode{config.sort_mode};
+  std::atomic<int> shared_lock_pid{config.lock_pid};
+  std::atomic<bool> shared_groups{showGroups(config)};
+  const Config collect_config = config;
+  std::thread publisher([&]() {
+    uint64_t seen = 0;
+    while (publisher_running.load(std::memory_order_relaxed)) {
+      const uint64_t gen = pm.generation();
+      if (gen == seen) {
+        pm.wait_for_update(seen, std::chrono::milliseconds(1000));
+        continue;
+      }
+      seen = gen;
+      UiFrame& frame = frames.back();
+      {
+        auto lock = pm.read_lock();
+        frame.snapshot = collectSnapshot(pm, snapshot_keys, collect_config);
+        frame.groups = shared_groups.load();
+        frame.processes = collectProcesses(pm, snapshot_keys, collect_config.top_processes, shared_sort_mode.load(),
+                                           shared_lock_pid.load(), frame.groups);
+      }
+      frames.publish();
+    }
+  });
+
+  while (!frames.update()) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  Snapshot snapshot = frames.front().snapshot;
+  std::vector<ProcessInfo> processes = visibleProcesses(frames.front().processes, config);
   syncSelection(processes, &config);
-  updateHistory(&history, snapshot, config.history_points, computeRootDiskBusyPercent());
-  renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms, false);
+  if (replaying) host = replayLabel(host_name, replay_control);
+  updateHistory(&history, snapshot);
+  renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms, false);
 
   while (true) {
     const int ch = getch();
+    if (replaying) host = replayLabel(host_name, replay_control);
+
+    if (ch == kKeyFocusIn || ch == kKeyFocusOut) {
+      /* A recording or push still wants every sample while the window is in the background. */
+      const bool visible = ch == kKeyFocusIn;
+      if (visible || sinks.empty()) pm.set_visible(visible);
+      timeout(visible ? refresh_interval_ms : kUnfocusedTimeoutMs);
+      if (visible) {
+        render_cache.invalidate();
+        renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
+      }
+      continue;
+    }
+    if (ch != ERR) pm.note_activity();
+
+    /* While a filter is typed every key edits it, and each edit is ranked by the plugin at once. */
+    if (!replaying && ch != ERR && ch != KEY_RESIZE &&
+        (config.filter_editing || (ch == '/' && !showGroups(config)) || (ch == 27 && !config.process_filter.empty()))) {
+      std::string filter = config.process_filter;
+      if (!config.filter_editing) {
+        if (ch == '/') config.filter_editing = true;
+        else filter.clear();
+      } else if (ch == 27) {
+        config.filter_editing = false;
+        filter.clear();
+      } else if (ch == '\n' || ch == '\r' || ch == KEY_ENTER) {
+        config.filter_editing = false;
+      } else if (ch == KEY_BACKSPACE || ch == 127 || ch == 8) {
+        if (!filter.empty()) filter.pop_back();
+      } else if (ch >= 32 && ch < 127 && filter.size() < 64) {
+        filter.push_back(static_cast<char>(ch));
+      }
+      if (filter != config.process_filter) {
+        config.process_filter = filter;
+        config.selected_pid = -1;
+        config.show_selection_highlight = false;
+        pm.control_str("process", "process.filter", filter);
+        pm.request_refresh("process");
+        /* Ranking the last scan again is quick; show its answer with the keystroke rather than a tick later. */
+        const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+        while (std::chrono::steady_clock::now() < until) {
+          if (frames.update() && frames.front().groups == showGroups(config)) {
+            snapshot = frames.front().snapshot;
+            processes = visibleProcesses(frames.front().processes, config);
+            syncSelection(processes, &config);
+            updateHistory(&history, snapshot);
+            break;
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+      }
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
+      continue;
+    }
 
     if (ch == 'q' || ch == 'Q') {
       break;
     }
 
+    if (replaying && !show_help_overlay && (ch == ' ' || ch == '<' || ch == ',' || ch == '>' || ch == '.' ||
+                                             ch == 'f' || ch == 'F')) {
+      if (ch == ' ') {
+        replay_control.paused = !replay_control.paused;
+      } else if (ch == 'f' || ch == 'F') {
+        replay_control.speed_index = (replay_control.speed_index + 1) % kReplaySpeedCount;
+      } else {
+        replay_control.seek_ms += (ch == '<' || ch == ',') ? -60000 : 60000;
+      }
+      host = replayLabel(host_name, replay_control);
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
+      continue;
+    }
+
     if (ch == '?') {
       show_help_overlay = !show_help_overlay;
       if (show_help_overlay) {
         timeout(-1);
         int rows, cols;
         getmaxyx(stdscr, rows, cols);
-        int overlay_h = std::min(16, rows - 4);
+        int overlay_h = std::min((config.replay_path.empty() ? 19 : 20) + (config.group_mode != GroupMode::kNone ? 1 : 0),
+                                 rows - 4);
         int overlay_w = std::min(54, cols - 4);
         int start_y = (rows - overlay_h) / 2;
         int start_x = (cols - overlay_w) / 2;
@@ -2363,7 +4358,8 @@ int main(int argc, char* argv[]) {
         doupdate();
       } else {
         timeout(refresh_interval_ms);
-        renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+        render_cache.invalidate();
+        renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       }
       continue;
     }
@@ -2371,12 +4367,21 @@ int main(int argc, char* argv[]) {
     if (show_help_overlay && ch != ERR) {
       show_help_overlay = false;
       timeout(refresh_interval_ms);
-      renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+      render_cache.invalidate();
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       continue;
     }
 
     if (ch == KEY_RESIZE) {
-      renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+      render_cache.invalidate();
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
+      continue;
+    }
+
+    if (ch == 'd' || ch == 'D') {
+      config.show_plugin_timings = !config.show_plugin_timings;
+      if (!config.show_plugin_timings) render_cache.invalidate();
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       continue;
     }
 
@@ -2391,7 +4396,7 @@ int main(int argc, char* argv[]) {
       } else {
         pm.control("docker", "docker.enable", 0);
       }
-      renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       continue;
     }
 
@@ -2406,7 +4411,7 @@ int main(int argc, char* argv[]) {
         if (it == available.end() || it + 1 == available.end()) config.zen_focus = available.front();
         else config.zen_focus = *(it + 1);
       }
-      renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       continue;
     }
 
@@ -2424,7 +4429,7 @@ int main(int argc, char* argv[]) {
         int total = static_cast<int>(snapshot.services.size());
         config.zen_services_scroll = std::min(config.zen_services_scroll + 1, std::max(0, total - max_show));
       }
-      renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       continue;
     }
 
@@ -2432,54 +4437,80 @@ int main(int argc, char* argv[]) {
       config.zen_docker_scroll = std::max(0, config.zen_docker_scroll - 1);
       config.zen_ports_scroll = std::max(0, config.zen_ports_scroll - 1);
       config.zen_services_scroll = std::max(0, config.zen_services_scroll - 1);
-      renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       continue;
     }
 
     if (ch == 's' || ch == 'S') {
-      switch (config.sort_mode) {
-        case SortMode::kCpu: config.sort_mode = SortMode::kMem; break;
-        case SortMode::kMem: config.sort_mode = SortMode::kGpu; break;
-        case SortMode::kGpu: config.sort_mode = SortMode::kPid; break;
-        case SortMode::kPid: config.sort_mode = SortMode::kCpu; break;
-      }
-      processes = collectProcesses(pm, config.top_processes, config.sort_mode, config.lock_pid);
+      config.sort_mode = nextSortMode(config.sort_mode);
+      shared_sort_mode = config.sort_mode;
+      sendProcessControls(pm, config);
+      pm.request_refresh();
+      processes = visibleProcesses(frames.front().processes, config);
       syncSelection(processes, &config);
-      renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
+      continue;
+    }
+
+    if (ch == 'g' || ch == 'G' || (config.drill_group > 0 && (ch == 27 || ch == KEY_BACKSPACE || ch == 127)) ||
+        (showGroups(config) && (ch == '\n' || ch == '\r' || ch == KEY_ENTER) && config.selected_pid > 0)) {
+      if (ch == 'g' || ch == 'G') {
+        config.group_mode = nextGroupMode(config.group_mode);
+        config.drill_group = -1;
+      } else if (config.drill_group > 0) {
+        config.drill_group = -1;
+      } else {
+        config.drill_group = config.selected_pid;
+        auto it = std::find_if(processes.begin(), processes.end(),
+                               [&](const ProcessInfo& p) { return p.pid == config.selected_pid; });
+        config.drill_group_name = it != processes.end() ? it->command : std::to_string(config.selected_pid);
+      }
+      /* Group ids and PIDs share the selection, so neither survives the switch. */
+      config.selected_pid = -1;
+      config.show_selection_highlight = false;
+      shared_groups = showGroups(config);
+      sendProcessControls(pm, config);
+      pm.request_refresh();
+      processes.clear();
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       continue;
     }
 
     if (ch == KEY_UP || ch == 'k' || ch == 'K') {
       config.show_selection_highlight = true;
       moveSelection(processes, &config, -1);
-      renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       continue;
     }
 
     if (ch == KEY_DOWN || ch == 'j' || ch == 'J') {
       config.show_selection_highlight = true;
       moveSelection(processes, &config, 1);
-      renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       continue;
     }
 
     if (ch == 'l' || ch == 'L') {
-      if (config.selected_pid > 0) {
+      if (config.selected_pid > 0 && !showGroups(config)) {
         if (config.lock_pid == config.selected_pid) {
           config.lock_pid = -1;
         } else {
           config.lock_pid = config.selected_pid;
         }
+        shared_lock_pid = config.lock_pid;
+        sendProcessControls(pm, config);
       }
       config.show_selection_highlight = false;
-      renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       continue;
     }
 
     if (ch == 'u' || ch == 'U') {
       config.lock_pid = -1;
+      shared_lock_pid = -1;
+      sendProcessControls(pm, config);
       config.show_selection_highlight = false;
-      renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       continue;
     }
 
@@ -2488,18 +4519,19 @@ int main(int argc, char* argv[]) {
       if (idx < static_cast<int>(processes.size())) {
         config.selected_pid = processes[static_cast<size_t>(idx)].pid;
         config.show_selection_highlight = true;
-        renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+        renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       }
       continue;
     }
 
     if (ch == 'r' || ch == 'R') {
-      pm.collect_all();
-      snapshot = collectSnapshot(pm, config);
-      processes = collectProcesses(pm, config.top_processes, config.sort_mode, config.lock_pid);
-      syncSelection(processes, &config);
-      updateHistory(&history, snapshot, config.history_points, computeRootDiskBusyPercent());
-      renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+      pm.request_refresh();
+      continue;
+    }
+
+    if (ch == 'h' || ch == 'H') {
+      config.history_zoom = (config.history_zoom + 1) % kHistoryZoomCount;
+      renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       continue;
     }
 
@@ -2507,7 +4539,7 @@ int main(int argc, char* argv[]) {
       if (refresh_interval_ms > 100) {
         refresh_interval_ms = std::max(100, refresh_interval_ms - 100);
         timeout(refresh_interval_ms);
-        renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+        renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       }
       continue;
     }
@@ -2516,7 +4548,7 @@ int main(int argc, char* argv[]) {
       if (refresh_interval_ms < 10000) {
         refresh_interval_ms = std::min(10000, refresh_interval_ms + 100);
         timeout(refresh_interval_ms);
-        renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+        renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
       }
       continue;
     }
@@ -2525,15 +4557,28 @@ int main(int argc, char* argv[]) {
       continue;
     }
 
-    pm.collect_all();
-    snapshot = collectSnapshot(pm, config);
-    processes = collectProcesses(pm, config.top_processes, config.sort_mode, config.lock_pid);
-    syncSelection(processes, &config);
-    updateHistory(&history, snapshot, config.history_points, computeRootDiskBusyPercent());
-    renderSnapshot(snapshot, history, processes, host, config, refresh_interval_ms);
+    if (frames.update()) {
+      snapshot = frames.front().snapshot;
+      /* A frame collected before the last g/Enter/Esc holds the other kind of row. */
+      if (frames.front().groups == showGroups(config)) {
+        processes = visibleProcesses(frames.front().processes, config);
+        syncSelection(processes, &config);
+      }
+      /* Only a new frame is a new sample; a timeout without one would repeat the last. */
+      updateHistory(&history, snapshot);
+    }
+    renderSnapshot(&render_cache, snapshot, history, processes, host, config, refresh_interval_ms);
   }
 
+  replay_control.running = false;
+  if (replayer.joinable()) replayer.join();
+  sinks_running = false;
+  publisher_running = false;
+  pm.wake_waiters();
+  for (auto& t : sinks) t.join();
+  publisher.join();
+  if (persist_history) saveHistory(&history, historyFilePath());
   pm.destroy_all();
-  endwin();
+  closeTerminal();
   return 0;
 }
@@ -1,21 +1,32 @@
 #include "cpu_collector.hpp"
 
 #include <algorithm>
-#include <array>
 #include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
 #include <filesystem>
 #include <fstream>
-#include <numeric>
 #include <optional>
 #include <set>
-#include <sstream>
 #include <string>
+#include <unistd.h>
 #include <vector>
 
+#include "hmon/fs_root.hpp"
+
 namespace fs = std::filesystem;
 
 namespace {
 
+using hmon::core::procRoot;
+using hmon::core::sysRoot;
+using hmon::plugins::cpu::CpuTimes;
+
+constexpr auto kSensorRediscoverInterval = std::chrono::seconds(60);
+
 bool isCpuDir(const std::string& name) {
     if (name.size() <= 3 || name.rfind("cpu", 0) != 0) return false;
     return std::all_of(name.begin() + 3, name.end(),
@@ -55,14 +66,6 @@ std::string toLower(const std::string& s) {
     return out;
 }
 
-std::optional<long long> readLL(const fs::path& p) {
-    std::ifstream f(p);
-    if (!f) return std::nullopt;
-    long long v;
-    if (f >> v) return v;
-    return std::nullopt;
-}
-
 std::optional<std::string> readFirstLine(const fs::path& p) {
     std::ifstream f(p);
     if (!f) return std::nullopt;
@@ -89,12 +92,100 @@ std::optional<double> parseDouble(const std::string& s) {
     }
 }
 
+/* Read the whole file at offset 0, growing the buffer until it fits. */
+bool readWhole(int fd, std::string* buf) {
+    if (buf->empty()) buf->resize(16384);
+    while (true) {
+        const ssize_t n = pread(fd, buf->data(), buf->size(), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (static_cast<size_t>(n) < buf->size()) {
+            buf->resize(static_cast<size_t>(n));
+            return true;
+        }
+        buf->resize(buf->size() * 2);
+    }
+}
+
+int openRead(const fs::path& p) {
+    return ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+/* A sysfs integer attribute, re-read from offset 0 of an open fd. */
+std::optional<long long> preadLL(int fd) {
+    char buf[32];
+    const ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) return std::nullopt;
+    buf[n] = '\0';
+    char* end = nullptr;
+    const long long v = std::strtoll(buf, &end, 10);
+    if (end == buf) return std::nullopt;
+    return v;
+}
+
+uint64_t parseCounter(const char** p, const char* end) {
+    const char* s = *p;
+    while (s < end && *s == ' ') ++s;
+    uint64_t v = 0;
+    while (s < end && static_cast<unsigned>(*s - '0') < 10) v = v * 10 + static_cast<uint64_t>(*s++ - '0');
+    *p = s;
+    return v;
+}
+
+/*
+ * Fill `out` from the leading "cpu"/"cpuN" lines: row 0 is the aggregate,
+ * cores follow in listed order.  Missing trailing fields (older kernels)
+ * read as zero.  Returns the row count.
+ */
+size_t parseCpuLines(const std::string& text, CpuTimes* out) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    size_t rows = 0;
+    while (end - p > 3 && p[0] == 'c' && p[1] == 'p' && p[2] == 'u') {
+        p += 3;
+        int cpu = -1;
+        if (p < end && static_cast<unsigned>(*p - '0') < 10) {
+            cpu = 0;
+            while (p < end && static_cast<unsigned>(*p - '0') < 10) cpu = cpu * 10 + (*p++ - '0');
+        }
+        while (p < end && *p != ' ') ++p;
+        if (rows >= out->size()) {
+            const size_t n = std::max<size_t>(rows + 1, out->size() * 2);
+            for (auto* v : {&out->user, &out->nice, &out->system, &out->idle,
+                            &out->iowait, &out->irq, &out->softirq, &out->steal}) {
+                v->resize(n, 0);
+            }
+            out->cpu.resize(n, -1);
+        }
+        out->cpu[rows] = cpu;
+        out->user[rows] = parseCounter(&p, end);
+        out->nice[rows] = parseCounter(&p, end);
+        out->system[rows] = parseCounter(&p, end);
+        out->idle[rows] = parseCounter(&p, end);
+        out->iowait[rows] = parseCounter(&p, end);
+        out->irq[rows] = parseCounter(&p, end);
+        out->softirq[rows] = parseCounter(&p, end);
+        out->steal[rows] = parseCounter(&p, end);
+        ++rows;
+        while (p < end && *p != '\n') ++p;
+        if (p < end) ++p;
+    }
+    for (auto* v : {&out->user, &out->nice, &out->system, &out->idle,
+                    &out->iowait, &out->irq, &out->softirq, &out->steal}) {
+        v->resize(rows);
+    }
+    out->cpu.resize(rows);
+    return rows;
+}
+
 }
 
 namespace hmon::plugins::cpu {
 
 std::string collectName() {
-    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::ifstream cpuinfo(procRoot() + "/cpuinfo");
     if (!cpuinfo) return "Unknown CPU";
 
     std::optional<std::string> model_fb;
@@ -124,7 +215,7 @@ std::string collectName() {
 }
 
 std::optional<int> collectThreadCount() {
-    const fs::path cpu_base("/sys/devices/system/cpu");
+    const fs::path cpu_base(sysRoot() + "/devices/system/cpu");
     int count = 0;
 
     if (fs::exists(cpu_base)) {
@@ -134,7 +225,7 @@ std::optional<int> collectThreadCount() {
     }
     if (count > 0) return count;
 
-    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::ifstream cpuinfo(procRoot() + "/cpuinfo");
     if (!cpuinfo) return std::nullopt;
     std::string line;
     while (std::getline(cpuinfo, line)) {
@@ -146,7 +237,7 @@ std::optional<int> collectThreadCount() {
 }
 
 std::optional<int> collectCoreCount() {
-    const fs::path cpu_base("/sys/devices/system/cpu");
+    const fs::path cpu_base(sysRoot() + "/devices/system/cpu");
     std::set<std::string> unique;
 
     if (fs::exists(cpu_base)) {
@@ -160,7 +251,7 @@ std::optional<int> collectCoreCount() {
     }
     if (!unique.empty()) return static_cast<int>(unique.size());
 
-    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::ifstream cpuinfo(procRoot() + "/cpuinfo");
     if (!cpuinfo) return std::nullopt;
 
     std::set<std::string> unique2;
@@ -196,198 +287,211 @@ std::optional<int> collectCoreCount() {
     return std::nullopt;
 }
 
-std::optional<double> collectTemperature() {
-    const fs::path thermal_base("/sys/class/thermal");
-    std::optional<double> preferred_max, fallback_max;
-
-    if (fs::exists(thermal_base)) {
-        for (const auto& e : fs::directory_iterator(thermal_base)) {
-            std::string zone = e.path().filename().string();
-            if (zone.rfind("thermal_zone", 0) != 0) continue;
-
-            auto raw = readLL(e.path() / "temp");
-            if (!raw) continue;
-            auto c = normalizeTempC(*raw);
-            if (!c) continue;
-
-            std::string type = toLower(readFirstLine(e.path() / "type").value_or(""));
-            bool preferred = type.find("cpu") != std::string::npos ||
-                             type.find("package") != std::string::npos ||
-                             type.find("x86_pkg_temp") != std::string::npos ||
-                             type.find("tctl") != std::string::npos ||
-                             type.find("tdie") != std::string::npos;
-
-            if (preferred) {
-                if (!preferred_max || *c > *preferred_max) preferred_max = *c;
-            } else {
-                if (!fallback_max || *c > *fallback_max) fallback_max = *c;
-            }
-        }
-    }
-
-    if (preferred_max) return preferred_max;
-    if (fallback_max) return fallback_max;
+void CpuSensors::close() {
+    for (const auto& t : temps) ::close(t.fd);
+    for (int fd : freqs) ::close(fd);
+    if (cpuinfo_fd >= 0) ::close(cpuinfo_fd);
+    temps.clear();
+    freqs.clear();
+    cpuinfo_fd = -1;
+}
 
-    /* hwmon fallback */
-    const fs::path hwmon_base("/sys/class/hwmon");
-    if (!fs::exists(hwmon_base)) return std::nullopt;
+static void discoverSensors(CpuPluginCtx* ctx) {
+    CpuSensors& s = ctx->sensors;
+    s.close();
+
+    const fs::path thermal_base(sysRoot() + "/class/thermal");
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator(thermal_base, ec)) {
+        std::string zone = e.path().filename().string();
+        if (zone.rfind("thermal_zone", 0) != 0) continue;
+
+        std::string type = toLower(readFirstLine(e.path() / "type").value_or(""));
+        bool preferred = type.find("cpu") != std::string::npos ||
+                         type.find("package") != std::string::npos ||
+                         type.find("x86_pkg_temp") != std::string::npos ||
+                         type.find("tctl") != std::string::npos ||
+                         type.find("tdie") != std::string::npos;
+        int fd = openRead(e.path() / "temp");
+        if (fd >= 0) s.temps.push_back({fd, preferred ? 0 : 1});
+    }
 
-    std::optional<double> hwmon_pref, hwmon_fb;
-    for (const auto& hw : fs::directory_iterator(hwmon_base)) {
+    const fs::path hwmon_base(sysRoot() + "/class/hwmon");
+    for (const auto& hw : fs::directory_iterator(hwmon_base, ec)) {
         std::string chip = toLower(readFirstLine(hw.path() / "name").value_or(""));
         bool cpu_chip = hwmonLooksCpu(chip);
 
-        for (const auto& f : fs::directory_iterator(hw.path())) {
+        std::error_code hw_ec;
+        for (const auto& f : fs::directory_iterator(hw.path(), hw_ec)) {
             std::string fn = f.path().filename().string();
-            if (fn.rfind("temp", 0) != 0 || fn.rfind("_input") != fn.size() - 6) continue;
-
-            auto raw = readLL(f.path());
-            if (!raw) continue;
-            auto c = normalizeTempC(*raw);
-            if (!c) continue;
+            if (fn.rfind("temp", 0) != 0 || fn.size() < 6 || fn.rfind("_input") != fn.size() - 6) continue;
 
             std::string label_fn = fn;
             label_fn.replace(label_fn.size() - 6, 6, "_label");
             std::string label = toLower(readFirstLine(hw.path() / label_fn).value_or(""));
-            bool cpu_label = hwmonLabelLooksCpuTemp(label);
+            int tier = hwmonLabelLooksCpuTemp(label) ? 2 : (cpu_chip ? 3 : -1);
+            if (tier < 0) continue;
+            int fd = openRead(f.path());
+            if (fd >= 0) s.temps.push_back({fd, tier});
+        }
+    }
 
-            if (cpu_label) {
-                if (!hwmon_pref || *c > *hwmon_pref) hwmon_pref = *c;
-            } else if (cpu_chip) {
-                if (!hwmon_fb || *c > *hwmon_fb) hwmon_fb = *c;
-            }
+    const fs::path cpu_base(sysRoot() + "/devices/system/cpu");
+    for (const auto& e : fs::directory_iterator(cpu_base, ec)) {
+        if (!isCpuDir(e.path().filename().string())) continue;
+        int fd = openRead(e.path() / "cpufreq" / "scaling_cur_freq");
+        if (fd >= 0) s.freqs.push_back(fd);
+    }
+    if (s.freqs.empty()) s.cpuinfo_fd = openRead(procRoot() + "/cpuinfo");
+
+    ctx->threads = collectThreadCount();
+    ctx->cores = collectCoreCount();
+    ctx->nodes = hmon::core::readNumaNodes();
+    ctx->node_of.clear();
+    for (size_t n = 0; n < ctx->nodes.size(); ++n) {
+        for (int cpu : ctx->nodes[n].cpus) {
+            if (static_cast<size_t>(cpu) >= ctx->node_of.size()) ctx->node_of.resize(static_cast<size_t>(cpu) + 1, -1);
+            ctx->node_of[static_cast<size_t>(cpu)] = static_cast<int>(n);
         }
     }
-    if (hwmon_pref) return hwmon_pref;
-    return hwmon_fb;
+    s.discovered_at = std::chrono::steady_clock::now();
+    s.stale = false;
 }
 
-std::optional<double> collectFrequency() {
-    std::vector<double> mhz;
-    const fs::path cpu_base("/sys/devices/system/cpu");
+void refreshSensors(CpuPluginCtx* ctx) {
+    CpuSensors& s = ctx->sensors;
+    if (s.online_fd < 0) s.online_fd = openRead(sysRoot() + "/devices/system/cpu/online");
+    if (s.online_fd >= 0) {
+        std::string online;
+        if (readWhole(s.online_fd, &online) && online != s.online) {
+            s.online = std::move(online);
+            s.stale = true;
+        }
+    }
+    /* Thermal and hwmon drivers can load late; pick them up without a hotplug event. */
+    if (std::chrono::steady_clock::now() - s.discovered_at > kSensorRediscoverInterval) s.stale = true;
+    if (s.stale) discoverSensors(ctx);
+}
 
-    if (fs::exists(cpu_base)) {
-        for (const auto& e : fs::directory_iterator(cpu_base)) {
-            if (!isCpuDir(e.path().filename().string())) continue;
-            auto khz = readLL(e.path() / "cpufreq" / "scaling_cur_freq");
-            if (khz && *khz > 0) mhz.push_back(static_cast<double>(*khz) / 1000.0);
+std::optional<double> collectTemperature(CpuPluginCtx* ctx) {
+    std::optional<double> hottest[4];
+    for (const auto& t : ctx->sensors.temps) {
+        auto raw = preadLL(t.fd);
+        if (!raw) continue;
+        auto c = normalizeTempC(*raw);
+        if (!c) continue;
+        auto& best = hottest[t.tier];
+        if (!best || *c > *best) best = *c;
+    }
+    for (const auto& best : hottest) {
+        if (best) return best;
+    }
+    return std::nullopt;
+}
+
+std::optional<double> collectFrequency(CpuPluginCtx* ctx) {
+    const CpuSensors& s = ctx->sensors;
+    double sum = 0.0;
+    size_t count = 0;
+    for (int fd : s.freqs) {
+        auto khz = preadLL(fd);
+        if (khz && *khz > 0) {
+            sum += static_cast<double>(*khz) / 1000.0;
+            ++count;
         }
     }
 
-    if (mhz.empty()) {
-        std::ifstream cpuinfo("/proc/cpuinfo");
-        std::string line;
-        while (std::getline(cpuinfo, line)) {
-            if (line.rfind("cpu MHz", 0) != 0) continue;
+    if (count == 0 && s.cpuinfo_fd >= 0 && readWhole(s.cpuinfo_fd, &ctx->read_buf)) {
+        size_t pos = 0;
+        while ((pos = ctx->read_buf.find("cpu MHz", pos)) != std::string::npos) {
+            size_t eol = ctx->read_buf.find('\n', pos);
+            std::string line = ctx->read_buf.substr(pos, eol == std::string::npos ? std::string::npos : eol - pos);
+            pos = eol;
             auto colon = line.find(':');
             if (colon == std::string::npos) continue;
             auto v = parseDouble(line.substr(colon + 1));
-            if (v && *v > 0.0) mhz.push_back(*v);
+            if (v && *v > 0.0) {
+                sum += *v;
+                ++count;
+            }
         }
     }
 
-    if (mhz.empty()) return std::nullopt;
-    double sum = std::accumulate(mhz.begin(), mhz.end(), 0.0);
-    return sum / static_cast<double>(mhz.size());
+    if (count == 0) return std::nullopt;
+    return sum / static_cast<double>(count);
 }
 
-std::optional<double> collectUsagePercent(CpuPluginCtx* ctx) {
-    std::ifstream stat("/proc/stat");
-    if (!stat) return std::nullopt;
-
-    std::string tag;
-    unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
-    stat >> tag >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal;
-    if (tag != "cpu") return std::nullopt;
-
-    unsigned long long idle_ticks = idle + iowait;
-    unsigned long long total_ticks = user + nice + system + idle + iowait + irq + softirq + steal;
-
-    if (!ctx->cpu_usage_initialized || total_ticks < ctx->prev_total || idle_ticks < ctx->prev_idle) {
-        ctx->prev_idle = idle_ticks;
-        ctx->prev_total = total_ticks;
-        ctx->cpu_usage_initialized = true;
-        return std::nullopt;
-    }
-
-    unsigned long long total_delta = total_ticks - ctx->prev_total;
-    unsigned long long idle_delta = idle_ticks - ctx->prev_idle;
-
-    ctx->prev_idle = idle_ticks;
-    ctx->prev_total = total_ticks;
-
-    if (total_delta == 0) return std::nullopt;
-
-    double usage = 100.0 * (1.0 - static_cast<double>(idle_delta) / static_cast<double>(total_delta));
-    return std::max(0.0, std::min(100.0, usage));
+CpuPluginCtx::~CpuPluginCtx() {
+    sensors.close();
+    if (sensors.online_fd >= 0) ::close(sensors.online_fd);
+    if (stat_fd >= 0) ::close(stat_fd);
 }
 
-std::vector<double> collectPerCoreUsagePercent(CpuPluginCtx* ctx) {
-    std::vector<double> core_usage;
-
-    std::ifstream stat("/proc/stat");
-    if (!stat) return core_usage;
-
-    std::string line;
-    std::vector<std::array<unsigned long long, 8>> cpu_values;
-
-    while (std::getline(stat, line)) {
-        if (line.size() <= 3 || line[0] != 'c' || line[1] != 'p' || line[2] != 'u' || !std::isdigit(line[3]))
-            continue;
-
-        std::istringstream iss(line);
-        std::string tag;
-        iss >> tag;
-
-        std::array<unsigned long long, 8> vals{};
-        bool valid = true;
-        for (int i = 0; i < 8; i++) {
-            if (!(iss >> vals[i])) { valid = false; break; }
-        }
-        if (valid) cpu_values.push_back(vals);
+bool collectUsage(CpuPluginCtx* ctx) {
+    if (ctx->stat_fd < 0) {
+        ctx->stat_fd = ::open((procRoot() + "/stat").c_str(), O_RDONLY | O_CLOEXEC);
+        if (ctx->stat_fd < 0) return false;
     }
-
-    if (cpu_values.empty()) return core_usage;
-
-    if (ctx->core_states.size() != cpu_values.size()) {
-        ctx->core_states.resize(cpu_values.size());
-        for (size_t i = 0; i < cpu_values.size(); i++) {
-            ctx->core_states[i].user = cpu_values[i][0];
-            ctx->core_states[i].nice = cpu_values[i][1];
-            ctx->core_states[i].system = cpu_values[i][2];
-            ctx->core_states[i].idle = cpu_values[i][3];
-            ctx->core_states[i].iowait = cpu_values[i][4];
-            ctx->core_states[i].irq = cpu_values[i][5];
-            ctx->core_states[i].softirq = cpu_values[i][6];
-            ctx->core_states[i].steal = cpu_values[i][7];
-            ctx->core_states[i].initialized = true;
-        }
-        return core_usage;
+    if (!readWhole(ctx->stat_fd, &ctx->stat_buf)) return false;
+
+    const size_t rows = parseCpuLines(ctx->stat_buf, &ctx->cur);
+    if (rows == 0) return false;
+    if (!ctx->has_prev || ctx->prev.size() != rows) {
+        /* First sample, or a core went on- or offline: nothing to diff against yet. */
+        std::swap(ctx->prev, ctx->cur);
+        ctx->has_prev = true;
+        ctx->usage.resize(0);
+        return false;
     }
 
-    core_usage.reserve(cpu_values.size());
-    for (size_t i = 0; i < cpu_values.size(); i++) {
-        const auto& v = cpu_values[i];
-        auto& s = ctx->core_states[i];
-
-        unsigned long long total_delta =
-            (v[0] - s.user) + (v[1] - s.nice) + (v[2] - s.system) +
-            (v[3] - s.idle) + (v[4] - s.iowait) + (v[5] - s.irq) +
-            (v[6] - s.softirq) + (v[7] - s.steal);
-        unsigned long long idle_total = (v[3] - s.idle) + (v[4] - s.iowait);
-
-        s.user = v[0]; s.nice = v[1]; s.system = v[2]; s.idle = v[3];
-        s.iowait = v[4]; s.irq = v[5]; s.softirq = v[6]; s.steal = v[7];
-
-        if (total_delta == 0) {
-            core_usage.push_back(0.0);
-        } else {
-            double usage = 100.0 * (1.0 - static_cast<double>(idle_total) / static_cast<double>(total_delta));
-            core_usage.push_back(std::max(0.0, std::min(100.0, usage)));
-        }
+    const CpuTimes& a = ctx->prev;
+    const CpuTimes& b = ctx->cur;
+    CpuUsage& u = ctx->usage;
+    u.resize(rows);
+    /* Counters can step backwards (iowait does on some kernels); treat that as no time. */
+    auto delta = [](uint64_t now, uint64_t then) { return now > then ? now - then : 0; };
+    for (size_t i = 0; i < rows; ++i) {
+        const uint64_t user = delta(b.user[i], a.user[i]) + delta(b.nice[i], a.nice[i]);
+        const uint64_t system = delta(b.system[i], a.system[i]);
+        const uint64_t idle = delta(b.idle[i], a.idle[i]);
+        const uint64_t iowait = delta(b.iowait[i], a.iowait[i]);
+        const uint64_t irq = delta(b.irq[i], a.irq[i]) + delta(b.softirq[i], a.softirq[i]);
+        const uint64_t steal = delta(b.steal[i], a.steal[i]);
+        const uint64_t total = user + system + idle + iowait + irq + steal;
+        const double scale = total > 0 ? 100.0 / static_cast<double>(total) : 0.0;
+        u.usage[i] = static_cast<double>(total - idle - iowait) * scale;
+        u.user[i] = static_cast<double>(user) * scale;
+        u.system[i] = static_cast<double>(system) * scale;
+        u.iowait[i] = static_cast<double>(iowait) * scale;
+        u.irq[i] = static_cast<double>(irq) * scale;
+        u.steal[i] = static_cast<double>(steal) * scale;
     }
+    std::swap(ctx->prev, ctx->cur);
+    return true;
+}
 
-    return core_usage;
+std::vector<NodeUsage> collectNodeUsage(const CpuPluginCtx* ctx) {
+    std::vector<NodeUsage> out;
+    const CpuUsage& u = ctx->usage;
+    /* After collectUsage() the newest sample sits in prev, rows matching usage. */
+    const std::vector<int>& cpus = ctx->prev.cpu;
+    if (ctx->nodes.empty() || u.size() < 2 || cpus.size() != u.size()) return out;
+    out.resize(ctx->nodes.size());
+    for (size_t n = 0; n < out.size(); ++n) out[n].node = ctx->nodes[n].id;
+    for (size_t i = 1; i < u.size(); ++i) {
+        const auto cpu = static_cast<size_t>(cpus[i]);
+        if (cpus[i] < 0 || cpu >= ctx->node_of.size() || ctx->node_of[cpu] < 0) continue;
+        NodeUsage& node = out[static_cast<size_t>(ctx->node_of[cpu])];
+        ++node.cpus;
+        node.usage += u.usage[i];
+        node.iowait += u.iowait[i];
+    }
+    for (auto& node : out) {
+        if (node.cpus == 0) continue;
+        node.usage = std::max(0.0, std::min(100.0, node.usage / node.cpus));
+        node.iowait /= node.cpus;
+    }
+    return out;
 }
 
 } /* namespace hmon::plugins::cpu */
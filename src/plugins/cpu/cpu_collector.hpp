@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cctype>
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <limits>
@@ -12,33 +13,99 @@
 #include <string>
 #include <vector>
 
+#include "hmon/numa.hpp"
+
 namespace hmon::plugins::cpu {
 
-struct CpuPluginCtx {
-    unsigned long long prev_idle = 0;
-    unsigned long long prev_total = 0;
-    bool cpu_usage_initialized = false;
-
-    struct CoreState {
-        unsigned long long user = 0;
-        unsigned long long nice = 0;
-        unsigned long long system = 0;
-        unsigned long long idle = 0;
-        unsigned long long iowait = 0;
-        unsigned long long irq = 0;
-        unsigned long long softirq = 0;
-        unsigned long long steal = 0;
-        bool initialized = false;
+/*
+ * Jiffy counters from the "cpu" lines of /proc/stat, one array per field.
+ * Index 0 is the aggregate line and index i + 1 the i-th listed core, so one
+ * loop over all of them turns two samples into percentages.
+ */
+struct CpuTimes {
+    std::vector<uint64_t> user, nice, system, idle, iowait, irq, softirq, steal;
+    std::vector<int> cpu;               /* the N of "cpuN", -1 for the aggregate */
+
+    size_t size() const { return user.size(); }
+    void resize(size_t n) {
+        for (auto* v : {&user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal}) v->assign(n, 0);
+        cpu.assign(n, -1);
+    }
+};
+
+/* Shares of the interval between the last two samples, in percent, indexed like CpuTimes. */
+struct CpuUsage {
+    std::vector<double> usage, user, system, iowait, irq, steal;
+
+    size_t size() const { return usage.size(); }
+    void resize(size_t n) {
+        for (auto* v : {&usage, &user, &system, &iowait, &irq, &steal}) v->assign(n, 0.0);
+    }
+};
+
+/*
+ * Sensor files found by discoverSensors(), held open and re-read with pread.
+ * Temperatures carry a preference tier (0 = CPU thermal zone, 1 = other
+ * thermal zone, 2 = hwmon input labelled as CPU, 3 = other input on a CPU
+ * hwmon chip); the reading is the hottest input of the best tier that has one.
+ */
+struct CpuSensors {
+    struct Temp {
+        int fd = -1;
+        int tier = 0;
     };
-    std::vector<CoreState> core_states;
+    std::vector<Temp> temps;
+    std::vector<int> freqs;             /* cpuN/cpufreq/scaling_cur_freq */
+    int cpuinfo_fd = -1;                /* frequency fallback when there is no cpufreq */
+    int online_fd = -1;                 /* /sys/devices/system/cpu/online, watched for hotplug */
+    std::string online;
+    std::chrono::steady_clock::time_point discovered_at{};
+    bool stale = true;
+
+    void close();
+};
+
+/* One NUMA node's share of the last interval: the mean over its online CPUs. */
+struct NodeUsage {
+    int node = 0;
+    int cpus = 0;
+    double usage = 0.0;
+    double iowait = 0.0;
+};
+
+struct CpuPluginCtx {
+    std::string name;
+    std::optional<int> cores;
+    std::optional<int> threads;
+    CpuSensors sensors;
+    std::string read_buf;
+    /* Re-read with the sensors, so hotplug keeps them current. */
+    std::vector<hmon::core::NumaNode> nodes;
+    std::vector<int> node_of;           /* by CPU number: index into nodes, -1 if in none */
+
+    int stat_fd = -1;
+    std::string stat_buf;
+    CpuTimes prev;
+    CpuTimes cur;
+    bool has_prev = false;
+    CpuUsage usage;
+
+    CpuPluginCtx() = default;
+    CpuPluginCtx(const CpuPluginCtx&) = delete;
+    CpuPluginCtx& operator=(const CpuPluginCtx&) = delete;
+    ~CpuPluginCtx();
 };
 
 std::string collectName();
 std::optional<int> collectCoreCount();
 std::optional<int> collectThreadCount();
-std::optional<double> collectTemperature();
-std::optional<double> collectFrequency();
-std::optional<double> collectUsagePercent(CpuPluginCtx* ctx);
-std::vector<double> collectPerCoreUsagePercent(CpuPluginCtx* ctx);
+/* Re-resolve sensor paths and core/thread counts if the CPU set changed or the sensors are old. */
+void refreshSensors(CpuPluginCtx* ctx);
+std::optional<double> collectTemperature(CpuPluginCtx* ctx);
+std::optional<double> collectFrequency(CpuPluginCtx* ctx);
+/* Sample /proc/stat once; true when ctx->usage holds the interval since the previous sample. */
+bool collectUsage(CpuPluginCtx* ctx);
+/* ctx->usage rolled up by NUMA node; empty without NUMA nodes or a usage sample. */
+std::vector<NodeUsage> collectNodeUsage(const CpuPluginCtx* ctx);
 
 }
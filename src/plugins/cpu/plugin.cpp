@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <string>
@@ -16,74 +17,80 @@ static int cpu_plugin_init(hmon_plugin_ctx** out) {
     if (!out) return -1;
     auto* ctx = new (std::nothrow) CpuContext();
     if (!ctx) return -1;
+    ctx->collector.name = hmon::plugins::cpu::collectName();
+    hmon::plugins::cpu::refreshSensors(&ctx->collector);
     *out = reinterpret_cast<hmon_plugin_ctx*>(ctx);
     return 0;
 }
 
-static void appendMetric(hmon_metric_list* list, const char* key, int type, const void* value) {
-    if (list->count >= list->capacity) {
-        size_t new_cap = list->capacity == 0 ? 32 : list->capacity * 2;
-        auto* new_items = static_cast<hmon_metric*>(std::realloc(list->items, new_cap * sizeof(hmon_metric)));
-        if (!new_items) return;
-        list->items = new_items;
-        list->capacity = new_cap;
-    }
-    auto* item = &list->items[list->count];
-    item->key = key;
-    item->value.type = type;
-    switch (type) {
-    case HMON_VAL_STRING: {
-        const char* src = static_cast<const char*>(value);
-        char* dup = strdup(src ? src : "");
-        item->value.v.str = dup;
-        break;
-    }
-    case HMON_VAL_INT64:
-        item->value.v.i64 = *static_cast<const int64_t*>(value);
-        break;
-    case HMON_VAL_DOUBLE:
-        item->value.v.f64 = *static_cast<const double*>(value);
-        break;
-    case HMON_VAL_BOOL:
-        item->value.v.b = *static_cast<const int32_t*>(value);
-        break;
-    }
-    ++list->count;
-}
-
-static int cpu_plugin_collect(hmon_plugin_ctx* ctx, hmon_metric_list* out_list) {
-    if (!ctx || !out_list) return -1;
+static int cpu_plugin_collect(hmon_plugin_ctx* ctx, hmon_metric_list* out_list, hmon_arena* arena) {
+    if (!ctx || !out_list || !arena) return -1;
     auto* c = reinterpret_cast<CpuContext*>(ctx);
 
-    std::string name = hmon::plugins::cpu::collectName();
+    hmon::plugins::cpu::refreshSensors(&c->collector);
+    const std::string& name = c->collector.name;
     int64_t cores = 0, threads = 0;
     double temp = 0.0, freq = 0.0, usage = 0.0;
     bool has_cores = false, has_threads = false, has_temp = false, has_freq = false, has_usage = false;
 
-    auto tc = hmon::plugins::cpu::collectThreadCount();
-    if (tc) { threads = *tc; has_threads = true; }
-    auto cc = hmon::plugins::cpu::collectCoreCount();
-    if (cc) { cores = *cc; has_cores = true; }
-    auto t = hmon::plugins::cpu::collectTemperature();
+    if (c->collector.threads) { threads = *c->collector.threads; has_threads = true; }
+    if (c->collector.cores) { cores = *c->collector.cores; has_cores = true; }
+    auto t = hmon::plugins::cpu::collectTemperature(&c->collector);
     if (t) { temp = *t; has_temp = true; }
-    auto f = hmon::plugins::cpu::collectFrequency();
+    auto f = hmon::plugins::cpu::collectFrequency(&c->collector);
     if (f) { freq = *f; has_freq = true; }
-    auto u = hmon::plugins::cpu::collectUsagePercent(&c->collector);
-    if (u) { usage = *u; has_usage = true; }
-    auto per_core = hmon::plugins::cpu::collectPerCoreUsagePercent(&c->collector);
+    const auto& u = c->collector.usage;
+    if (hmon::plugins::cpu::collectUsage(&c->collector)) {
+        usage = std::max(0.0, std::min(100.0, u.usage[0]));
+        has_usage = true;
+    }
+    const uint32_t core_rows = u.size() > 1 ? static_cast<uint32_t>(u.size() - 1) : 0;
+    const std::vector<int>& cpus = c->collector.prev.cpu;     /* newest sample, rows matching u */
 
-    appendMetric(out_list, HMON_METRIC_CPU_NAME, HMON_VAL_STRING, name.c_str());
-    if (has_cores)  appendMetric(out_list, HMON_METRIC_CPU_CORES, HMON_VAL_INT64, &cores);
-    if (has_threads) appendMetric(out_list, HMON_METRIC_CPU_THREADS, HMON_VAL_INT64, &threads);
-    if (has_temp)   appendMetric(out_list, HMON_METRIC_CPU_TEMP_C, HMON_VAL_DOUBLE, &temp);
-    if (has_freq)   appendMetric(out_list, HMON_METRIC_CPU_FREQ_MHZ, HMON_VAL_DOUBLE, &freq);
-    if (has_usage)  appendMetric(out_list, HMON_METRIC_CPU_USAGE_PCT, HMON_VAL_DOUBLE, &usage);
+    hmon_metric_append(out_list, arena, HMON_METRIC_CPU_NAME, HMON_VAL_STRING, name.c_str());
+    if (has_cores)  hmon_metric_append(out_list, arena, HMON_METRIC_CPU_CORES, HMON_VAL_INT64, &cores);
+    if (has_threads) hmon_metric_append(out_list, arena, HMON_METRIC_CPU_THREADS, HMON_VAL_INT64, &threads);
+    if (has_temp)   hmon_metric_append(out_list, arena, HMON_METRIC_CPU_TEMP_C, HMON_VAL_DOUBLE, &temp);
+    if (has_freq)   hmon_metric_append(out_list, arena, HMON_METRIC_CPU_FREQ_MHZ, HMON_VAL_DOUBLE, &freq);
+    if (has_usage)  hmon_metric_append(out_list, arena, HMON_METRIC_CPU_USAGE_PCT, HMON_VAL_DOUBLE, &usage);
 
-    for (size_t i = 0; i < per_core.size(); ++i) {
-        char key[64];
-        std::snprintf(key, sizeof(key), "%s.%zu", HMON_METRIC_CPU_CORE_USAGE_PCT, i);
-        double val = per_core[i];
-        appendMetric(out_list, strdup(key), HMON_VAL_DOUBLE, &val);
+    static const hmon_table_column kCoreColumns[] = {
+        {"cpu", HMON_VAL_INT64}, {"usage_pct", HMON_VAL_DOUBLE}, {"user_pct", HMON_VAL_DOUBLE}, {"system_pct", HMON_VAL_DOUBLE},
+        {"iowait_pct", HMON_VAL_DOUBLE}, {"irq_pct", HMON_VAL_DOUBLE}, {"steal_pct", HMON_VAL_DOUBLE},
+    };
+    auto* cores_table = hmon_metric_append_table(out_list, arena, HMON_METRIC_CPU_CORES_TABLE, kCoreColumns, 7,
+                                                 core_rows);
+    for (uint32_t i = 0; cores_table && i < cores_table->row_count; ++i) {
+        auto* row = hmon_table_row(cores_table, i);
+        row[0].i64 = i + 1 < cpus.size() ? cpus[i + 1] : HMON_TABLE_NULL_I64;
+        row[1].f64 = std::max(0.0, std::min(100.0, u.usage[i + 1]));
+        row[2].f64 = u.user[i + 1];
+        row[3].f64 = u.system[i + 1];
+        row[4].f64 = u.iowait[i + 1];
+        row[5].f64 = u.irq[i + 1];
+        row[6].f64 = u.steal[i + 1];
+    }
+
+    /* Memoryless nodes have no CPUs to report. */
+    const auto nodes = hmon::plugins::cpu::collectNodeUsage(&c->collector);
+    uint32_t node_rows = 0;
+    for (const auto& n : nodes) node_rows += n.cpus > 0 ? 1 : 0;
+    static const hmon_table_column kNodeColumns[] = {
+        {"node", HMON_VAL_INT64}, {"cpus", HMON_VAL_INT64}, {"usage_pct", HMON_VAL_DOUBLE},
+        {"iowait_pct", HMON_VAL_DOUBLE},
+    };
+    if (node_rows > 0) {
+        auto* node_table = hmon_metric_append_table(out_list, arena, HMON_METRIC_CPU_NODES_TABLE, kNodeColumns, 4,
+                                                    node_rows);
+        uint32_t r = 0;
+        for (const auto& n : nodes) {
+            if (!node_table || n.cpus == 0) continue;
+            auto* row = hmon_table_row(node_table, r++);
+            row[0].i64 = n.node;
+            row[1].i64 = n.cpus;
+            row[2].f64 = n.usage;
+            row[3].f64 = n.iowait;
+        }
     }
     return 0;
 }
@@ -93,19 +100,4 @@ static void cpu_plugin_destroy(hmon_plugin_ctx* ctx) {
     delete reinterpret_cast<CpuContext*>(ctx);
 }
 
-static void cpu_plugin_free_list(hmon_metric_list* list) {
-    if (!list) return;
-    for (size_t i = 0; i < list->count; ++i) {
-        if (list->items[i].value.type == HMON_VAL_STRING && list->items[i].value.v.str) {
-            if (std::strncmp(list->items[i].key, "cpu.core_usage_pct", 18) == 0)
-                free(const_cast<char*>(list->items[i].key));
-            free(const_cast<char*>(list->items[i].value.v.str));
-        }
-    }
-    free(list->items);
-    list->items = nullptr;
-    list->count = 0;
-    list->capacity = 0;
-}
-
-HMON_STATIC_PLUGIN("cpu", cpu_plugin_init, cpu_plugin_collect, cpu_plugin_destroy, cpu_plugin_free_list, nullptr)
+HMON_STATIC_PLUGIN("cpu", cpu_plugin_init, cpu_plugin_collect, cpu_plugin_destroy, nullptr, 250)
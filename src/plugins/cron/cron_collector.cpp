@@ -64,48 +64,87 @@ static void parseCrontab(const std::string& path, const std::string& source,
     }
 }
 
+constexpr const char* kSystemCrontab = "/etc/crontab";
+constexpr const char* kCronD = "/etc/cron.d";
+/* RHEL keeps user crontabs in /var/spool/cron itself, Debian in its crontabs/ subdirectory. */
+constexpr const char* kSpoolDirs[] = {"/var/spool/cron", "/var/spool/cron/crontabs"};
+
+bool isSpoolDir(const std::string& dir) {
+    for (const char* d : kSpoolDirs) {
+        if (dir == d) return true;
+    }
+    return false;
 }
 
-namespace hmon::plugins::cron {
+/* Re-parse one crontab file into the cache, or drop it when it is gone or not a crontab location. */
+void refreshFile(hmon::plugins::cron::CronPluginCtx* ctx, const fs::path& path) {
+    const std::string key = path.string();
+    const std::string dir = path.parent_path().string();
+    std::error_code ec;
+    ctx->files.erase(key);
+    if (!fs::is_regular_file(path, ec)) return;
+
+    std::vector<hmon::plugins::cron::CronJob> jobs;
+    const std::string name = path.filename().string();
+    if (key == kSystemCrontab) {
+        parseCrontab(key, key, "root", jobs);
+    } else if (dir == kCronD) {
+        parseCrontab(key, name, "root", jobs);
+    } else if (isSpoolDir(dir)) {
+        parseCrontab(key, "user:" + name, name, jobs);
+    } else {
+        return;
+    }
+    ctx->files.emplace(key, std::move(jobs));
+}
 
-std::vector<CronJob> collectCronJobs(CronPluginCtx* ctx) {
-    if (ctx) {
-        auto elapsed = std::chrono::steady_clock::now() - ctx->last_cache_time;
-        if (!ctx->cached_result.empty() &&
-            std::chrono::duration_cast<std::chrono::seconds>(elapsed).count() < CronPluginCtx::TTL_SECONDS) {
-            return ctx->cached_result;
-        }
+void rescanDir(hmon::plugins::cron::CronPluginCtx* ctx, const std::string& dir) {
+    for (auto it = ctx->files.begin(); it != ctx->files.end();) {
+        if (fs::path(it->first).parent_path() == dir) it = ctx->files.erase(it);
+        else ++it;
     }
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) refreshFile(ctx, entry.path());
+}
 
-    std::vector<CronJob> jobs;
+void rescanAll(hmon::plugins::cron::CronPluginCtx* ctx) {
+    ctx->files.clear();
+    refreshFile(ctx, kSystemCrontab);
+    rescanDir(ctx, kCronD);
+    for (const char* d : kSpoolDirs) rescanDir(ctx, d);
+}
 
-    parseCrontab("/etc/crontab", "/etc/crontab", "root", jobs);
+}
 
-    std::error_code ec;
-    if (fs::exists("/etc/cron.d", ec)) {
-        for (const auto& entry : fs::directory_iterator("/etc/cron.d", ec)) {
-            if (entry.is_regular_file()) {
-                parseCrontab(entry.path().string(), entry.path().filename().string(), "root", jobs);
-            }
-        }
-    }
+namespace hmon::plugins::cron {
 
-    std::string crontab_dir = "/var/spool/cron";
-    if (!fs::exists(crontab_dir, ec)) {
-        crontab_dir = "/var/spool/cron/crontabs";
+std::vector<CronJob> collectCronJobs(CronPluginCtx* ctx) {
+    std::vector<CronJob> jobs;
+    if (!ctx) return jobs;
+
+    if (!ctx->watching && ctx->watcher.ok()) {
+        ctx->watcher.watch(kSystemCrontab);
+        ctx->watcher.watch(kCronD);
+        for (const char* d : kSpoolDirs) ctx->watcher.watch(d);
+        ctx->watching = true;
     }
-    if (fs::exists(crontab_dir, ec)) {
-        for (const auto& entry : fs::directory_iterator(crontab_dir, ec)) {
-            if (entry.is_regular_file()) {
-                std::string user = entry.path().filename().string();
-                parseCrontab(entry.path().string(), "user:" + user, user, jobs);
-            }
+
+    bool overflow = false;
+    auto changed = ctx->watcher.changes(&overflow);
+    if (!ctx->loaded || overflow || !ctx->watcher.ok()) {
+        rescanAll(ctx);
+        ctx->loaded = true;
+    } else {
+        for (const auto& path : changed) {
+            if (path == kCronD || isSpoolDir(path)) rescanDir(ctx, path);
+            else refreshFile(ctx, path);
         }
     }
 
-    if (ctx) {
-        ctx->cached_result = jobs;
-        ctx->last_cache_time = std::chrono::steady_clock::now();
+    auto system = ctx->files.find(kSystemCrontab);
+    if (system != ctx->files.end()) jobs = system->second;
+    for (const auto& [path, file_jobs] : ctx->files) {
+        if (path != kSystemCrontab) jobs.insert(jobs.end(), file_jobs.begin(), file_jobs.end());
     }
     return jobs;
 }
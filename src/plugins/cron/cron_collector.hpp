@@ -2,9 +2,12 @@
 
 #include <chrono>
 #include <cstdint>
+#include <map>
 #include <string>
 #include <vector>
 
+#include "hmon/file_watcher.hpp"
+
 namespace hmon::plugins::cron {
 
 struct CronJob {
@@ -14,11 +17,15 @@ struct CronJob {
     std::string source;
 };
 
+/*
+ * Jobs are cached per crontab file and a file is re-parsed only when the
+ * watcher reports it changed; without inotify every collect re-reads all.
+ */
 struct CronPluginCtx {
-    std::vector<CronJob> jobs;
-    std::vector<CronJob> cached_result;
-    std::chrono::steady_clock::time_point last_cache_time;
-    static constexpr int TTL_SECONDS = 60;
+    hmon::core::FileWatcher watcher;
+    bool watching = false;
+    bool loaded = false;
+    std::map<std::string, std::vector<CronJob>> files;     /* by path */
 };
 
 std::vector<CronJob> collectCronJobs(CronPluginCtx* ctx);
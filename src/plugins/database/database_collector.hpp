@@ -6,6 +6,8 @@
 #include <string>
 #include <vector>
 
+#include "wire_clients.hpp"
+
 namespace hmon::plugins::database {
 
 struct DbInfo {
@@ -19,9 +21,11 @@ struct DbInfo {
 
 struct DatabasePluginCtx {
     std::vector<DbInfo> databases;
-    std::vector<DbInfo> cached_result;
-    std::chrono::steady_clock::time_point last_cache_time;
-    static constexpr int TTL_SECONDS = 15;
+    /* Kept open between ticks. */
+    WireConnection postgres;
+    WireConnection mysql;
+    WireConnection redis;
+    WireConnection mongo;
 };
 
 std::vector<DbInfo> collectDatabases(DatabasePluginCtx* ctx);
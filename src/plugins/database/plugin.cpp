@@ -10,12 +10,11 @@
 
 extern "C" {
     int database_plugin_init(hmon_plugin_ctx**);
-    int database_plugin_collect(hmon_plugin_ctx*, hmon_metric_list*);
+    int database_plugin_collect(hmon_plugin_ctx*, hmon_metric_list*, hmon_arena*);
     void database_plugin_destroy(hmon_plugin_ctx*);
-    void database_plugin_free_list(hmon_metric_list*);
 }
 
-HMON_STATIC_PLUGIN("database", database_plugin_init, database_plugin_collect, database_plugin_destroy, database_plugin_free_list, nullptr)
+HMON_STATIC_PLUGIN("database", database_plugin_init, database_plugin_collect, database_plugin_destroy, nullptr, 15000)
 
 extern "C" {
 
@@ -27,50 +26,41 @@ HMON_PLUGIN_EXPORT int database_plugin_init(hmon_plugin_ctx** out) {
     return 0;
 }
 
-static void appendMetric(hmon_metric_list* list, const char* key, int type, const void* value) {
-    if (list->count >= list->capacity) {
-        size_t new_cap = list->capacity == 0 ? 32 : list->capacity * 2;
-        auto* new_items = static_cast<hmon_metric*>(std::realloc(list->items, new_cap * sizeof(hmon_metric)));
-        if (!new_items) return;
-        list->items = new_items;
-        list->capacity = new_cap;
-    }
-    auto* item = &list->items[list->count];
-    item->key = key;
-    item->value.type = type;
-    switch (type) {
-    case HMON_VAL_STRING: item->value.v.str = strdup(static_cast<const char*>(value) ? static_cast<const char*>(value) : ""); break;
-    case HMON_VAL_INT64: item->value.v.i64 = *static_cast<const int64_t*>(value); break;
-    case HMON_VAL_DOUBLE: item->value.v.f64 = *static_cast<const double*>(value); break;
-    case HMON_VAL_BOOL: item->value.v.b = *static_cast<const int32_t*>(value); break;
-    }
-    ++list->count;
-}
+static const hmon_table_column kColumns[] = {
+    {"type", HMON_VAL_STRING},
+    {"status", HMON_VAL_STRING},
+    {"active_conns", HMON_VAL_INT64},
+    {"max_conns", HMON_VAL_INT64},
+    {"uptime", HMON_VAL_INT64},
+    {"version", HMON_VAL_STRING},
+};
+enum : uint32_t {
+    kColType,
+    kColStatus,
+    kColActiveConns,
+    kColMaxConns,
+    kColUptime,
+    kColVersion,
+    kColumnCount
+};
 
-HMON_PLUGIN_EXPORT int database_plugin_collect(hmon_plugin_ctx* ctx, hmon_metric_list* out_list) {
-    if (!ctx || !out_list) return -1;
+HMON_PLUGIN_EXPORT int database_plugin_collect(hmon_plugin_ctx* ctx, hmon_metric_list* out_list, hmon_arena* arena) {
+    if (!ctx || !out_list || !arena) return -1;
     auto* c = reinterpret_cast<hmon::plugins::database::DatabasePluginCtx*>(ctx);
     auto dbs = hmon::plugins::database::collectDatabases(c);
-    for (size_t i = 0; i < dbs.size(); ++i) {
+    auto* table = hmon_metric_append_table(out_list, arena, HMON_METRIC_DB_TABLE, kColumns, kColumnCount, static_cast<uint32_t>(dbs.size()));
+    if (!table) return 0;
+    for (uint32_t i = 0; i < table->row_count; ++i) {
         const auto& d = dbs[i];
-        char key[128];
-        std::snprintf(key, sizeof(key), "db.%zu.type", i);
-        appendMetric(out_list, strdup(key), HMON_VAL_STRING, d.type.c_str());
-        std::snprintf(key, sizeof(key), "db.%zu.status", i);
-        appendMetric(out_list, strdup(key), HMON_VAL_STRING, d.status.c_str());
-        std::snprintf(key, sizeof(key), "db.%zu.active_conns", i);
-        int64_t ac = d.active_connections;
-        appendMetric(out_list, strdup(key), HMON_VAL_INT64, &ac);
-        std::snprintf(key, sizeof(key), "db.%zu.max_conns", i);
-        int64_t mc = d.max_connections;
-        appendMetric(out_list, strdup(key), HMON_VAL_INT64, &mc);
-        std::snprintf(key, sizeof(key), "db.%zu.uptime", i);
-        int64_t up = d.uptime_seconds;
-        appendMetric(out_list, strdup(key), HMON_VAL_INT64, &up);
-        std::snprintf(key, sizeof(key), "db.%zu.version", i);
-        appendMetric(out_list, strdup(key), HMON_VAL_STRING, d.version.c_str());
+        auto* row = hmon_table_row(table, i);
+        row[kColActiveConns].i64 = d.active_connections;
+        row[kColMaxConns].i64 = d.max_connections;
+        row[kColUptime].i64 = d.uptime_seconds;
+        hmon_table_set_str(arena, table, i, kColType, d.type.c_str());
+        hmon_table_set_str(arena, table, i, kColStatus, d.status.c_str());
+        hmon_table_set_str(arena, table, i, kColVersion, d.version.c_str());
     }
-    return 0;
+    return dbs.empty() ? HMON_COLLECT_ABSENT : 0;
 }
 
 HMON_PLUGIN_EXPORT void database_plugin_destroy(hmon_plugin_ctx* ctx) {
@@ -78,17 +68,4 @@ HMON_PLUGIN_EXPORT void database_plugin_destroy(hmon_plugin_ctx* ctx) {
     delete reinterpret_cast<hmon::plugins::database::DatabasePluginCtx*>(ctx);
 }
 
-HMON_PLUGIN_EXPORT void database_plugin_free_list(hmon_metric_list* list) {
-    if (!list) return;
-    for (size_t i = 0; i < list->count; ++i) {
-        if (list->items[i].value.type == HMON_VAL_STRING && list->items[i].value.v.str)
-            free(const_cast<char*>(list->items[i].value.v.str));
-        free(const_cast<char*>(list->items[i].key));
-    }
-    free(list->items);
-    list->items = nullptr;
-    list->count = 0;
-    list->capacity = 0;
-}
-
 }
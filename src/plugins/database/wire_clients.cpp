@@ -0,0 +1,687 @@
+#include "wire_clients.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pwd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "database_collector.hpp"
+
+namespace hmon::plugins::database {
+
+namespace {
+
+constexpr int kConnectTimeoutMs = 500;
+constexpr int kIoTimeoutMs = 2000;
+constexpr size_t kMaxReplyBytes = 4 * 1024 * 1024;
+
+std::string envOr(const char* name, const std::string& fallback) {
+    const char* value = std::getenv(name);
+    return value && *value ? value : fallback;
+}
+
+/* The CLI tools log in as the invoking user by default. */
+std::string loginName() {
+    if (const passwd* pw = getpwuid(geteuid())) return pw->pw_name;
+    return envOr("USER", "");
+}
+
+std::optional<int64_t> toInt64(const std::string& s) {
+    if (s.empty()) return std::nullopt;
+    char* end = nullptr;
+    errno = 0;
+    const long long v = std::strtoll(s.c_str(), &end, 10);
+    if (errno != 0 || end == s.c_str()) return std::nullopt;
+    return v;
+}
+
+uint32_t be32(const char* p) {
+    const auto* u = reinterpret_cast<const uint8_t*>(p);
+    return (uint32_t{u[0]} << 24) | (uint32_t{u[1]} << 16) | (uint32_t{u[2]} << 8) | u[3];
+}
+
+uint16_t be16(const char* p) {
+    const auto* u = reinterpret_cast<const uint8_t*>(p);
+    return static_cast<uint16_t>((u[0] << 8) | u[1]);
+}
+
+uint32_t le32(const char* p) {
+    const auto* u = reinterpret_cast<const uint8_t*>(p);
+    return u[0] | (uint32_t{u[1]} << 8) | (uint32_t{u[2]} << 16) | (uint32_t{u[3]} << 24);
+}
+
+uint32_t le24(const char* p) {
+    const auto* u = reinterpret_cast<const uint8_t*>(p);
+    return u[0] | (uint32_t{u[1]} << 8) | (uint32_t{u[2]} << 16);
+}
+
+uint16_t le16(const char* p) {
+    const auto* u = reinterpret_cast<const uint8_t*>(p);
+    return static_cast<uint16_t>(u[0] | (u[1] << 8));
+}
+
+void putBe32(std::string* out, uint32_t v) {
+    for (int shift = 24; shift >= 0; shift -= 8) out->push_back(static_cast<char>(v >> shift));
+}
+
+void putLe(std::string* out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) out->push_back(static_cast<char>(v >> (i * 8)));
+}
+
+int connectWithTimeout(int family, const sockaddr* addr, socklen_t len) {
+    const int fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, addr, len) != 0) {
+        int err = errno;
+        if (err == EINPROGRESS) {
+            pollfd pfd{fd, POLLOUT, 0};
+            socklen_t err_len = sizeof(err);
+            if (poll(&pfd, 1, kConnectTimeoutMs) != 1 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) != 0) {
+                err = ETIMEDOUT;
+            }
+        }
+        if (err != 0) {
+            ::close(fd);
+            return -1;
+        }
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    timeval tv{kIoTimeoutMs / 1000, (kIoTimeoutMs % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+int connectUnix(const std::string& path) {
+    sockaddr_un addr{};
+    if (path.empty() || path.size() >= sizeof(addr.sun_path) || access(path.c_str(), F_OK) != 0) return -1;
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return connectWithTimeout(AF_UNIX, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+}
+
+int connectTcp(std::string host, const std::string& port) {
+    if (host.empty() || host == "localhost") host = "127.0.0.1";
+    const auto port_num = toInt64(port);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    if (!port_num || *port_num <= 0 || *port_num > 65535 || inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+        return -1;
+    }
+    addr.sin_port = htons(static_cast<uint16_t>(*port_num));
+    return connectWithTimeout(AF_INET, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+}
+
+bool sendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t n = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+    return true;
+}
+
+/* Read until the connection's buffer holds at least `n` bytes. */
+bool fill(WireConnection* conn, size_t n) {
+    if (n > kMaxReplyBytes) return false;
+    char buf[16384];
+    while (conn->in.size() < n) {
+        const ssize_t got = recv(conn->fd, buf, sizeof(buf), 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        conn->in.append(buf, static_cast<size_t>(got));
+    }
+    return true;
+}
+
+/*
+ * Reuse the open connection if it still works, otherwise dial and log in
+ * again.  Servers drop idle clients, so a failed exchange on a reused
+ * connection gets one fresh attempt.
+ */
+template <typename Dial, typename Login, typename Exchange>
+bool probe(WireConnection* conn, DbInfo* db, Dial&& dial, Login&& login, Exchange&& exchange) {
+    if (conn->fd >= 0) {
+        if (exchange(conn, db)) return true;
+        conn->close();
+    }
+    conn->fd = dial();
+    if (conn->fd < 0) return false;
+    conn->in.clear();
+    if (!login(conn) || !exchange(conn, db)) conn->close();
+    return true;
+}
+
+/* PostgreSQL: startup message, then the simple query protocol. */
+
+bool pgRead(WireConnection* conn, char* type, std::string* body) {
+    if (!fill(conn, 5)) return false;
+    const uint32_t len = be32(conn->in.data() + 1);
+    if (len < 4 || !fill(conn, 1 + static_cast<size_t>(len))) return false;
+    *type = conn->in[0];
+    body->assign(conn->in, 5, len - 4);
+    conn->in.erase(0, 1 + static_cast<size_t>(len));
+    return true;
+}
+
+int pgDial() {
+    const std::string host = envOr("PGHOST", "");
+    const std::string port = envOr("PGPORT", "5432");
+    if (host.empty() || host[0] == '/') {
+        for (const std::string& dir : host.empty() ? std::vector<std::string>{"/var/run/postgresql", "/tmp"}
+                                                    : std::vector<std::string>{host}) {
+            const int fd = connectUnix(dir + "/.s.PGSQL." + port);
+            if (fd >= 0) return fd;
+        }
+        if (!host.empty()) return -1;
+    }
+    return connectTcp(host, port);
+}
+
+/* Only trust and peer logins get through; anything that wants a password is refused here. */
+bool pgLogin(WireConnection* conn) {
+    const std::string user = envOr("PGUSER", loginName());
+    std::string params;
+    auto param = [&](const char* key, const std::string& value) {
+        params.append(key).push_back('\0');
+        params.append(value).push_back('\0');
+    };
+    param("user", user);
+    param("database", envOr("PGDATABASE", user));
+    param("application_name", "hmon");
+    params.push_back('\0');
+
+    std::string startup;
+    putBe32(&startup, static_cast<uint32_t>(params.size() + 8));
+    putBe32(&startup, 196608);  /* protocol 3.0 */
+    startup += params;
+    if (!sendAll(conn->fd, startup)) return false;
+
+    char type;
+    std::string body;
+    while (pgRead(conn, &type, &body)) {
+        if (type == 'Z') return true;
+        if (type == 'E') return false;
+        if (type == 'R' && (body.size() < 4 || be32(body.data()) != 0)) return false;
+    }
+    return false;
+}
+
+constexpr std::string_view kPgQuery =
+    "SELECT (SELECT count(*) FROM pg_stat_activity WHERE state = 'active'), "
+    "current_setting('max_connections'), "
+    "extract(epoch from now() - pg_postmaster_start_time())::bigint, version()";
+
+bool pgExchange(WireConnection* conn, DbInfo* db) {
+    std::string query(1, 'Q');
+    putBe32(&query, static_cast<uint32_t>(kPgQuery.size() + 5));
+    query.append(kPgQuery).push_back('\0');
+    if (!sendAll(conn->fd, query)) return false;
+
+    std::vector<std::string> row;
+    char type;
+    std::string body;
+    while (pgRead(conn, &type, &body)) {
+        if (type == 'D' && body.size() >= 2) {
+            row.clear();
+            size_t pos = 2;
+            for (uint16_t i = 0, n = be16(body.data()); i < n && pos + 4 <= body.size(); ++i) {
+                const uint32_t len = be32(body.data() + pos);
+                pos += 4;
+                if (len == UINT32_MAX) {
+                    row.emplace_back();
+                    continue;
+                }
+                row.push_back(body.substr(pos, len));
+                pos += len;
+            }
+        } else if (type == 'Z') {
+            if (row.size() < 4) return true;    /* the query failed; the connection is still good */
+            db->active_connections = static_cast<int>(toInt64(row[0]).value_or(0));
+            db->max_connections = static_cast<int>(toInt64(row[1]).value_or(0));
+            db->uptime_seconds = toInt64(row[2]).value_or(0);
+            db->version = row[3];
+            if (db->version.size() > 40) db->version = db->version.substr(0, 40) + "...";
+            return true;
+        }
+    }
+    return false;
+}
+
+/* MySQL/MariaDB: protocol 41 handshake, then one multi-statement COM_QUERY. */
+
+constexpr uint32_t kClientLongPassword = 0x1;
+constexpr uint32_t kClientProtocol41 = 0x200;
+constexpr uint32_t kClientTransactions = 0x2000;
+constexpr uint32_t kClientSecureConnection = 0x8000;
+constexpr uint32_t kClientMultiStatements = 0x10000;
+constexpr uint32_t kClientMultiResults = 0x20000;
+constexpr uint32_t kClientPluginAuth = 0x80000;
+constexpr uint16_t kServerMoreResultsExist = 0x8;
+
+bool mysqlRead(WireConnection* conn, std::string* payload, uint8_t* seq) {
+    if (!fill(conn, 4)) return false;
+    const uint32_t len = le24(conn->in.data());
+    if (!fill(conn, 4 + static_cast<size_t>(len))) return false;
+    *seq = static_cast<uint8_t>(conn->in[3]);
+    payload->assign(conn->in, 4, len);
+    conn->in.erase(0, 4 + static_cast<size_t>(len));
+    return true;
+}
+
+bool mysqlSend(WireConnection* conn, uint8_t seq, std::string_view payload) {
+    std::string packet;
+    putLe(&packet, payload.size(), 3);
+    packet.push_back(static_cast<char>(seq));
+    packet.append(payload);
+    return sendAll(conn->fd, packet);
+}
+
+/* Length-encoded integer at `*pos`; NULL (0xfb) reads as nullopt. */
+std::optional<uint64_t> lenenc(const std::string& p, size_t* pos) {
+    if (*pos >= p.size()) return std::nullopt;
+    const auto first = static_cast<uint8_t>(p[(*pos)++]);
+    int bytes = 0;
+    if (first < 0xfb) return first;
+    if (first == 0xfc) bytes = 2;
+    else if (first == 0xfd) bytes = 3;
+    else if (first == 0xfe) bytes = 8;
+    else return std::nullopt;
+    if (*pos + static_cast<size_t>(bytes) > p.size()) return std::nullopt;
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) v |= uint64_t{static_cast<uint8_t>(p[*pos + i])} << (8 * i);
+    *pos += static_cast<size_t>(bytes);
+    return v;
+}
+
+bool isEof(const std::string& p) {
+    return !p.empty() && static_cast<uint8_t>(p[0]) == 0xfe && p.size() < 9;
+}
+
+int mysqlDial() {
+    for (const std::string& path : {envOr("MYSQL_UNIX_PORT", ""), std::string("/var/run/mysqld/mysqld.sock"),
+                                    std::string("/run/mysqld/mysqld.sock"), std::string("/var/lib/mysql/mysql.sock"),
+                                    std::string("/tmp/mysql.sock")}) {
+        const int fd = connectUnix(path);
+        if (fd >= 0) return fd;
+    }
+    return connectTcp("127.0.0.1", envOr("MYSQL_TCP_PORT", "3306"));
+}
+
+/* Log in with an empty password, which is also all unix_socket/auth_socket accounts need. */
+bool mysqlLogin(WireConnection* conn) {
+    std::string p;
+    uint8_t seq = 0;
+    if (!mysqlRead(conn, &p, &seq) || p.empty() || p[0] != 10) return false;
+    size_t pos = p.find('\0', 1);
+    if (pos == std::string::npos) return false;
+    pos += 1 + 4 + 8 + 1;   /* version terminator, connection id, scramble part 1, filler */
+    if (pos + 2 > p.size()) return false;
+    uint32_t caps = le16(p.data() + pos);
+    pos += 2;
+    std::string plugin = "mysql_native_password";
+    if (pos + 16 <= p.size()) {
+        pos += 1 + 2;       /* charset, status */
+        caps |= uint32_t{le16(p.data() + pos)} << 16;
+        pos += 2;
+        const auto scramble_len = static_cast<uint8_t>(p[pos]);
+        pos += 1 + 10;
+        if (caps & kClientSecureConnection) pos += std::max(13, scramble_len - 8);
+        if ((caps & kClientPluginAuth) && pos < p.size()) plugin = p.substr(pos, p.find('\0', pos) - pos);
+    }
+
+    const uint32_t flags = kClientLongPassword | kClientProtocol41 | kClientTransactions | kClientSecureConnection |
+                           kClientMultiStatements | kClientMultiResults | (caps & kClientPluginAuth);
+    std::string response;
+    putLe(&response, flags, 4);
+    putLe(&response, 1u << 24, 4);  /* max packet */
+    response.push_back(33);         /* utf8_general_ci */
+    response.append(23, '\0');
+    response.append(loginName()).push_back('\0');
+    response.push_back('\0');       /* empty auth response */
+    if (flags & kClientPluginAuth) response.append(plugin).push_back('\0');
+    if (!mysqlSend(conn, static_cast<uint8_t>(seq + 1), response)) return false;
+
+    for (int round = 0; round < 4; ++round) {
+        if (!mysqlRead(conn, &p, &seq) || p.empty()) return false;
+        const auto kind = static_cast<uint8_t>(p[0]);
+        if (kind == 0x00) return true;
+        if (kind == 0xfe) {
+            /* Auth switch: the other plugin gets the same empty password. */
+            if (!mysqlSend(conn, static_cast<uint8_t>(seq + 1), "")) return false;
+            continue;
+        }
+        /* caching_sha2_password fast-auth result; 3 means accepted and an OK follows. */
+        if (kind == 0x01 && p.size() >= 2 && p[1] == 3) continue;
+        return false;
+    }
+    return false;
+}
+
+constexpr std::string_view kMysqlQuery =
+    "\x03SHOW GLOBAL STATUS WHERE Variable_name IN ('Threads_connected', 'Uptime'); "
+    "SELECT @@max_connections, VERSION()";
+
+bool mysqlExchange(WireConnection* conn, DbInfo* db) {
+    if (!mysqlSend(conn, 0, kMysqlQuery)) return false;
+
+    std::vector<std::vector<std::string>> rows;
+    std::string p;
+    uint8_t seq = 0;
+    bool more = true;
+    while (more) {
+        if (!mysqlRead(conn, &p, &seq) || p.empty()) return false;
+        const auto kind = static_cast<uint8_t>(p[0]);
+        if (kind == 0xff) break;    /* the statement failed; nothing further follows */
+        size_t pos = 0;
+        if (kind == 0x00) {
+            pos = 1;
+            lenenc(p, &pos);
+            lenenc(p, &pos);
+            more = pos + 2 <= p.size() && (le16(p.data() + pos) & kServerMoreResultsExist);
+            continue;
+        }
+        const uint64_t columns = lenenc(p, &pos).value_or(0);
+        for (uint64_t i = 0; i < columns; ++i) {
+            if (!mysqlRead(conn, &p, &seq)) return false;
+        }
+        if (!mysqlRead(conn, &p, &seq) || !isEof(p)) return false;
+        while (true) {
+            if (!mysqlRead(conn, &p, &seq) || p.empty()) return false;
+            if (static_cast<uint8_t>(p[0]) == 0xff) {
+                more = false;
+                break;
+            }
+            if (isEof(p)) {
+                more = p.size() >= 5 && (le16(p.data() + 3) & kServerMoreResultsExist);
+                break;
+            }
+            std::vector<std::string>& row = rows.emplace_back();
+            pos = 0;
+            for (uint64_t i = 0; i < columns; ++i) {
+                const auto len = lenenc(p, &pos);
+                if (!len || pos + *len > p.size()) {
+                    row.emplace_back();
+                    continue;
+                }
+                row.push_back(p.substr(pos, *len));
+                pos += *len;
+            }
+        }
+    }
+
+    for (const auto& row : rows) {
+        if (row.size() != 2) continue;
+        if (row[0] == "Threads_connected") db->active_connections = static_cast<int>(toInt64(row[1]).value_or(0));
+        else if (row[0] == "Uptime") db->uptime_seconds = toInt64(row[1]).value_or(0);
+        else if (auto max = toInt64(row[0])) {
+            db->max_connections = static_cast<int>(*max);
+            db->version = row[1];
+        }
+    }
+    return true;
+}
+
+/* Redis: pipelined RESP commands. */
+
+void respCommand(std::string* out, std::initializer_list<std::string_view> args) {
+    out->append("*").append(std::to_string(args.size())).append("\r\n");
+    for (std::string_view arg : args) {
+        out->append("$").append(std::to_string(arg.size())).append("\r\n").append(arg).append("\r\n");
+    }
+}
+
+bool respLine(WireConnection* conn, std::string* line) {
+    size_t end;
+    while ((end = conn->in.find("\r\n")) == std::string::npos) {
+        if (!fill(conn, conn->in.size() + 1)) return false;
+    }
+    line->assign(conn->in, 0, end);
+    conn->in.erase(0, end + 2);
+    return !line->empty();
+}
+
+/* One reply, with every string in it appended to `out`; `error` is set for a '-' reply. */
+bool respRead(WireConnection* conn, std::vector<std::string>* out, bool* error, int depth = 0) {
+    std::string line;
+    if (depth > 4 || !respLine(conn, &line)) return false;
+    const char kind = line[0];
+    line.erase(0, 1);
+    if (kind == '+' || kind == ':' || kind == '-') {
+        if (kind == '-') *error = true;
+        out->push_back(std::move(line));
+        return true;
+    }
+    const int64_t n = toInt64(line).value_or(-2);
+    if (kind == '$') {
+        if (n < 0) {
+            out->emplace_back();
+            return n == -1;
+        }
+        if (!fill(conn, static_cast<size_t>(n) + 2)) return false;
+        out->push_back(conn->in.substr(0, static_cast<size_t>(n)));
+        conn->in.erase(0, static_cast<size_t>(n) + 2);
+        return true;
+    }
+    if (kind == '*') {
+        for (int64_t i = 0; i < n; ++i) {
+            if (!respRead(conn, out, error, depth + 1)) return false;
+        }
+        return n >= -1;
+    }
+    return false;
+}
+
+int redisDial() {
+    return connectTcp("127.0.0.1", "6379");
+}
+
+bool redisLogin(WireConnection* conn) {
+    const char* password = std::getenv("REDISCLI_AUTH");
+    if (!password || !*password) return true;
+    std::string auth;
+    respCommand(&auth, {"AUTH", password});
+    std::vector<std::string> reply;
+    bool error = false;
+    return sendAll(conn->fd, auth) && respRead(conn, &reply, &error) && !error;
+}
+
+bool redisExchange(WireConnection* conn, DbInfo* db) {
+    std::string commands;
+    respCommand(&commands, {"INFO"});
+    respCommand(&commands, {"CONFIG", "GET", "maxclients"});
+    if (!sendAll(conn->fd, commands)) return false;
+
+    std::vector<std::string> info, maxclients;
+    bool info_error = false, config_error = false;
+    if (!respRead(conn, &info, &info_error) || !respRead(conn, &maxclients, &config_error)) return false;
+    if (!info_error && !info.empty()) {
+        size_t start = 0;
+        const std::string& text = info[0];
+        while (start < text.size()) {
+            size_t end = text.find('\n', start);
+            if (end == std::string::npos) end = text.size();
+            std::string_view line(text.data() + start, end - start);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            start = end + 1;
+            const size_t colon = line.find(':');
+            if (colon == std::string_view::npos) continue;
+            const std::string_view key = line.substr(0, colon);
+            const std::string value(line.substr(colon + 1));
+            if (key == "redis_version") db->version = value;
+            else if (key == "uptime_in_seconds") db->uptime_seconds = toInt64(value).value_or(0);
+            else if (key == "connected_clients") db->active_connections = static_cast<int>(toInt64(value).value_or(0));
+        }
+    }
+    if (!config_error && maxclients.size() >= 2) db->max_connections = static_cast<int>(toInt64(maxclients[1]).value_or(0));
+    return true;
+}
+
+/* MongoDB: OP_MSG running serverStatus, answered with a BSON document. */
+
+constexpr int32_t kOpMsg = 2013;
+
+struct BsonValue {
+    uint8_t type = 0;
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+/* Size of a value of `type` at `p`, or SIZE_MAX for unknown or truncated values. */
+size_t bsonValueSize(uint8_t type, const char* p, const char* end) {
+    const auto avail = static_cast<size_t>(end - p);
+    const int64_t n = avail >= 4 ? static_cast<int32_t>(le32(p)) : -1;
+    switch (type) {
+    case 0x01: case 0x09: case 0x11: case 0x12: return 8;
+    case 0x02: case 0x0D: case 0x0E:            return n >= 1 ? static_cast<size_t>(4 + n) : SIZE_MAX;
+    case 0x03: case 0x04: case 0x0F:            return n >= 5 ? static_cast<size_t>(n) : SIZE_MAX;
+    case 0x05:                                  return n >= 0 ? static_cast<size_t>(5 + n) : SIZE_MAX;
+    case 0x07:                                  return 12;
+    case 0x08:                                  return 1;
+    case 0x06: case 0x0A: case 0x7F: case 0xFF: return 0;
+    case 0x10:                                  return 4;
+    case 0x13:                                  return 16;
+    case 0x0B: {
+        const auto* first = static_cast<const char*>(std::memchr(p, 0, avail));
+        if (!first) return SIZE_MAX;
+        const auto* second = static_cast<const char*>(std::memchr(first + 1, 0, static_cast<size_t>(end - first - 1)));
+        return second ? static_cast<size_t>(second + 1 - p) : SIZE_MAX;
+    }
+    default:                                    return SIZE_MAX;
+    }
+}
+
+bool bsonFind(const BsonValue& doc, std::string_view name, BsonValue* out) {
+    if ((doc.type != 0x03 && doc.type != 0) || doc.size < 5) return false;
+    const char* p = doc.data + 4;
+    const char* end = doc.data + std::min<size_t>(doc.size, le32(doc.data)) - 1;
+    while (p < end) {
+        const auto type = static_cast<uint8_t>(*p++);
+        const auto* nul = static_cast<const char*>(std::memchr(p, 0, static_cast<size_t>(end - p)));
+        if (!nul) return false;
+        const std::string_view key(p, static_cast<size_t>(nul - p));
+        p = nul + 1;
+        const size_t size = bsonValueSize(type, p, end);
+        if (size == SIZE_MAX || size > static_cast<size_t>(end - p)) return false;
+        if (key == name) {
+            *out = BsonValue{type, p, size};
+            return true;
+        }
+        p += size;
+    }
+    return false;
+}
+
+std::optional<double> bsonNumber(const BsonValue& doc, std::string_view name) {
+    BsonValue v;
+    if (!bsonFind(doc, name, &v)) return std::nullopt;
+    if (v.type == 0x01) {
+        double d;
+        std::memcpy(&d, v.data, sizeof(d));
+        return d;
+    }
+    if (v.type == 0x10) return static_cast<int32_t>(le32(v.data));
+    if (v.type == 0x12) return static_cast<double>(static_cast<int64_t>(le32(v.data) | uint64_t{le32(v.data + 4)} << 32));
+    return std::nullopt;
+}
+
+int mongoDial() {
+    const int fd = connectUnix("/tmp/mongodb-27017.sock");
+    return fd >= 0 ? fd : connectTcp("127.0.0.1", "27017");
+}
+
+bool mongoLogin(WireConnection*) {
+    return true;
+}
+
+bool mongoExchange(WireConnection* conn, DbInfo* db) {
+    static int32_t request_id = 0;
+    std::string doc;
+    putLe(&doc, 0, 4);
+    doc.push_back(0x10);
+    doc.append("serverStatus").push_back('\0');
+    putLe(&doc, 1, 4);
+    doc.push_back(0x02);
+    doc.append("$db").push_back('\0');
+    putLe(&doc, 6, 4);
+    doc.append("admin").push_back('\0');
+    doc.push_back('\0');
+    const uint32_t doc_size = static_cast<uint32_t>(doc.size());
+    for (int i = 0; i < 4; ++i) doc[static_cast<size_t>(i)] = static_cast<char>(doc_size >> (i * 8));
+
+    std::string msg;
+    putLe(&msg, 16 + 4 + 1 + doc.size(), 4);
+    putLe(&msg, static_cast<uint32_t>(++request_id), 4);
+    putLe(&msg, 0, 4);
+    putLe(&msg, kOpMsg, 4);
+    putLe(&msg, 0, 4);          /* flag bits */
+    msg.push_back(0);           /* section kind 0: body */
+    msg += doc;
+    if (!sendAll(conn->fd, msg)) return false;
+
+    if (!fill(conn, 16)) return false;
+    const uint32_t len = le32(conn->in.data());
+    if (len < 16 + 4 + 1 + 5 || !fill(conn, len)) return false;
+    const bool op_msg = static_cast<int32_t>(le32(conn->in.data() + 12)) == kOpMsg && conn->in[20] == 0;
+    const std::string reply = conn->in.substr(21, len - 21);
+    conn->in.erase(0, len);
+    if (!op_msg) return false;
+
+    const BsonValue status{0x03, reply.data(), reply.size()};
+    if (bsonNumber(status, "ok").value_or(0.0) != 1.0) return true;     /* e.g. authentication required */
+    BsonValue version, connections;
+    if (bsonFind(status, "version", &version) && version.type == 0x02 && version.size > 4) {
+        db->version.assign(version.data + 4, version.size - 5);
+    }
+    db->uptime_seconds = static_cast<int64_t>(bsonNumber(status, "uptime").value_or(0.0));
+    if (bsonFind(status, "connections", &connections)) {
+        db->active_connections = static_cast<int>(bsonNumber(connections, "current").value_or(0.0));
+        db->max_connections = db->active_connections + static_cast<int>(bsonNumber(connections, "available").value_or(0.0));
+    }
+    return true;
+}
+
+}
+
+WireConnection::~WireConnection() {
+    close();
+}
+
+void WireConnection::close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+    in.clear();
+}
+
+bool probePostgres(WireConnection* conn, DbInfo* db) {
+    return probe(conn, db, pgDial, pgLogin, pgExchange);
+}
+
+bool probeMysql(WireConnection* conn, DbInfo* db) {
+    return probe(conn, db, mysqlDial, mysqlLogin, mysqlExchange);
+}
+
+bool probeRedis(WireConnection* conn, DbInfo* db) {
+    return probe(conn, db, redisDial, redisLogin, redisExchange);
+}
+
+bool probeMongo(WireConnection* conn, DbInfo* db) {
+    return probe(conn, db, mongoDial, mongoLogin, mongoExchange);
+}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+namespace hmon::plugins::database {
+
+struct DbInfo;
+
+/*
+ * One persistent connection to a local database server.  Probes reuse it
+ * across ticks; any protocol or socket error closes it and the next probe
+ * dials again.  Only password-less local logins are attempted (peer/trust,
+ * unix_socket, an empty MySQL password, Redis without requirepass unless
+ * REDISCLI_AUTH is set), which is what the CLI tools got without a config.
+ */
+struct WireConnection {
+    int fd = -1;
+    std::string in;             /* bytes received and not yet consumed */
+
+    ~WireConnection();
+    void close();
+};
+
+/*
+ * Each probe fills `db` and returns true when the server answered, even if it
+ * refused us (status "running", counters left at zero); false means nothing
+ * is listening and the caller reports it stopped.  All of an engine's
+ * queries go out in one round trip.
+ */
+bool probePostgres(WireConnection* conn, DbInfo* db);
+bool probeMysql(WireConnection* conn, DbInfo* db);
+bool probeRedis(WireConnection* conn, DbInfo* db);
+bool probeMongo(WireConnection* conn, DbInfo* db);
+
+}
@@ -1,18 +1,32 @@
 #include "docker_collector.hpp"
 
 #include <algorithm>
+#include <array>
+#include <cctype>
 #include <cerrno>
 #include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
 #include <functional>
 #include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
+#include <unordered_map>
 #include <vector>
 
+#include "hmon/fs_root.hpp"
+
 namespace {
 
+using hmon::core::procRoot;
+using hmon::core::sysRoot;
+
 static size_t skipJsonValue(const std::string& data, size_t pos) {
     if (pos >= data.size()) return pos;
     char c = data[pos];
@@ -320,167 +334,729 @@ static std::string httpGetUnixSocket(const std::string& socket_path, const std::
     return body;
 }
 
-static std::vector<hmon::plugins::docker::ContainerStats> doCollect(const std::string& sock,
-                                              std::vector<hmon::plugins::docker::ContainerStats>& prev) {
-    std::vector<hmon::plugins::docker::ContainerStats> result;
+/*
+ * Fold one stats document into `cs`.  Counters are cumulative, so byte rates
+ * are derived from the previous sample of the same container and the time
+ * between the two samples arriving.
+ */
+static void applyStats(const std::string& stats_json, hmon::plugins::docker::ContainerStats& cs,
+                       std::chrono::steady_clock::time_point now) {
+    double dt = 0.0;
+    if (cs.sample_time != std::chrono::steady_clock::time_point{}) {
+        dt = std::chrono::duration<double>(now - cs.sample_time).count();
+    }
+    cs.sample_time = now;
 
-    std::string containers_json = httpGetUnixSocket(sock, "/containers/json");
-    if (containers_json.empty()) return prev;
+    std::string cpu_obj = extractObject(stats_json, "cpu_stats");
+    if (!cpu_obj.empty()) {
+        cs.system_cpu_usage = extractUint64(cpu_obj, "system_cpu_usage");
+        cs.online_cpus = extractInt(cpu_obj, "online_cpus");
+        std::string usage_obj = extractObject(cpu_obj, "cpu_usage");
+        if (!usage_obj.empty()) {
+            cs.cpu_usage_total = extractUint64(usage_obj, "total_usage");
+        }
+    }
 
-    forEachTopLevelArray(containers_json, [&](const std::string& elem) {
-        hmon::plugins::docker::ContainerStats cs;
-        cs.id = extractString(elem, "Id");
-        cs.name = extractArrayString(elem, "Names");
-        if (!cs.name.empty() && cs.name[0] == '/') cs.name = cs.name.substr(1);
-        cs.image = extractString(elem, "Image");
-        cs.state = extractString(elem, "State");
-        if (!cs.id.empty()) result.push_back(std::move(cs));
-    });
+    std::string precpu_obj = extractObject(stats_json, "precpu_stats");
+    if (!precpu_obj.empty()) {
+        cs.prev_system_cpu_usage = extractUint64(precpu_obj, "system_cpu_usage");
+        std::string pusage_obj = extractObject(precpu_obj, "cpu_usage");
+        if (!pusage_obj.empty()) {
+            cs.prev_cpu_usage_total = extractUint64(pusage_obj, "total_usage");
+        }
+    }
 
-    if (result.empty()) return prev;
+    if (cs.cpu_usage_total > 0 && cs.system_cpu_usage > 0 &&
+        cs.prev_cpu_usage_total > 0 && cs.prev_system_cpu_usage > 0 &&
+        cs.cpu_usage_total >= cs.prev_cpu_usage_total && cs.system_cpu_usage > cs.prev_system_cpu_usage) {
+        uint64_t cpu_delta = cs.cpu_usage_total - cs.prev_cpu_usage_total;
+        uint64_t sys_delta = cs.system_cpu_usage - cs.prev_system_cpu_usage;
+        cs.cpu_percent = 100.0 * static_cast<double>(cpu_delta) / static_cast<double>(sys_delta);
+    }
+    cs.cpu_initialized = true;
 
-    for (auto& cs : result) {
-        std::string stats_json = httpGetUnixSocket(sock, "/containers/" + cs.id + "/stats?stream=false");
-        if (stats_json.empty()) continue;
+    std::string mem_obj = extractObject(stats_json, "memory_stats");
+    if (!mem_obj.empty()) {
+        cs.mem_usage = extractUint64(mem_obj, "usage");
+        cs.mem_limit = extractUint64(mem_obj, "limit");
+        std::string stats_str = extractObject(mem_obj, "stats");
+        if (!stats_str.empty()) {
+            cs.mem_cache = extractUint64(stats_str, "total_inactive_file");
+        }
+        if (cs.mem_limit > 0) {
+            cs.mem_percent = 100.0 * static_cast<double>(cs.mem_usage) / static_cast<double>(cs.mem_limit);
+        }
+    }
 
-        std::string cpu_obj = extractObject(stats_json, "cpu_stats");
-        if (!cpu_obj.empty()) {
-            cs.system_cpu_usage = extractUint64(cpu_obj, "system_cpu_usage");
-            cs.online_cpus = extractInt(cpu_obj, "online_cpus");
-            std::string usage_obj = extractObject(cpu_obj, "cpu_usage");
-            if (!usage_obj.empty()) {
-                cs.cpu_usage_total = extractUint64(usage_obj, "total_usage");
+    uint64_t total_rx = 0, total_tx = 0;
+    std::string net_obj = extractObject(stats_json, "networks");
+    if (!net_obj.empty()) {
+        /* networks is an object {"eth0": {...}, ...}, iterate each value */
+        size_t pos = 1; /* skip opening { */
+        while (pos < net_obj.size()) {
+            while (pos < net_obj.size() && net_obj[pos] != '"') ++pos;
+            if (pos >= net_obj.size()) break;
+            /* skip key string */
+            ++pos;
+            while (pos < net_obj.size() && net_obj[pos] != '"') {
+                if (net_obj[pos] == '\\' && pos + 1 < net_obj.size()) ++pos;
+                ++pos;
             }
+            if (pos < net_obj.size()) ++pos; /* closing quote */
+            /* skip colon and whitespace */
+            while (pos < net_obj.size() && (net_obj[pos] == ' ' || net_obj[pos] == ':' || net_obj[pos] == '\t' || net_obj[pos] == '\n' || net_obj[pos] == '\r')) ++pos;
+            if (pos >= net_obj.size()) break;
+            /* extract the value object */
+            size_t val_start = pos;
+            pos = skipJsonValue(net_obj, pos);
+            std::string iface = net_obj.substr(val_start, pos - val_start);
+            total_rx += extractUint64(iface, "rx_bytes");
+            total_tx += extractUint64(iface, "tx_bytes");
+            /* skip comma */
+            while (pos < net_obj.size() && (net_obj[pos] == ',' || net_obj[pos] == ' ' || net_obj[pos] == '\t' || net_obj[pos] == '\n' || net_obj[pos] == '\r')) ++pos;
         }
+    }
 
-        std::string precpu_obj = extractObject(stats_json, "precpu_stats");
-        if (!precpu_obj.empty()) {
-            cs.prev_system_cpu_usage = extractUint64(precpu_obj, "system_cpu_usage");
-            std::string pusage_obj = extractObject(precpu_obj, "cpu_usage");
-            if (!pusage_obj.empty()) {
-                cs.prev_cpu_usage_total = extractUint64(pusage_obj, "total_usage");
-            }
+    /* Docker reports cumulative bytes since container start — use directly as totals. */
+    cs.net_rx_total = total_rx;
+    cs.net_tx_total = total_tx;
+    cs.net_rx_bytes = total_rx;
+    cs.net_tx_bytes = total_tx;
+
+    if (cs.net_initialized && dt > 0.0 && total_rx >= cs.prev_net_rx && total_tx >= cs.prev_net_tx) {
+        cs.net_rx_bps = static_cast<double>(total_rx - cs.prev_net_rx) / dt;
+        cs.net_tx_bps = static_cast<double>(total_tx - cs.prev_net_tx) / dt;
+    }
+    cs.prev_net_rx = total_rx;
+    cs.prev_net_tx = total_tx;
+    cs.net_initialized = true;
+
+    uint64_t blk_read = 0, blk_write = 0;
+    std::string blkio = extractObject(stats_json, "blkio_stats");
+    if (!blkio.empty()) {
+        forEachInArray(blkio, "io_service_bytes_recursive", [&](const std::string& entry) {
+            std::string op = extractString(entry, "Op");
+            uint64_t val = extractUint64(entry, "Value");
+            if (op == "Read" || op == "read") blk_read += val;
+            else if (op == "Write" || op == "write") blk_write += val;
+        });
+    }
+    cs.blk_read_bytes = blk_read;
+    cs.blk_write_bytes = blk_write;
+
+    if (cs.blk_initialized && dt > 0.0 && blk_read >= cs.prev_blk_read && blk_write >= cs.prev_blk_write) {
+        cs.blk_read_bps = static_cast<double>(blk_read - cs.prev_blk_read) / dt;
+        cs.blk_write_bps = static_cast<double>(blk_write - cs.prev_blk_write) / dt;
+    }
+    cs.prev_blk_read = blk_read;
+    cs.prev_blk_write = blk_write;
+    cs.blk_initialized = true;
+
+    std::string pids_obj = extractObject(stats_json, "pids_stats");
+    if (!pids_obj.empty()) {
+        cs.pids_current = extractInt(pids_obj, "current");
+    }
+}
+
+/*
+ * Direct cgroup v2 reader for one container.  The counter files are opened
+ * once when the container is first seen and re-read with pread() afterwards.
+ */
+class CgroupFiles {
+public:
+    enum File { kCpuStat, kMemCurrent, kMemStat, kMemMax, kIoStat, kPidsCurrent, kProcs, kFileCount };
+
+    CgroupFiles() { fds_.fill(-1); }
+    ~CgroupFiles() { reset(); }
+    CgroupFiles(const CgroupFiles&) = delete;
+    CgroupFiles& operator=(const CgroupFiles&) = delete;
+    CgroupFiles(CgroupFiles&& other) noexcept : fds_(other.fds_) { other.fds_.fill(-1); }
+    CgroupFiles& operator=(CgroupFiles&& other) noexcept {
+        if (this != &other) {
+            reset();
+            fds_ = other.fds_;
+            other.fds_.fill(-1);
         }
+        return *this;
+    }
 
-        if (cs.cpu_usage_total > 0 && cs.system_cpu_usage > 0 &&
-            cs.prev_cpu_usage_total > 0 && cs.prev_system_cpu_usage > 0) {
-            uint64_t cpu_delta = cs.cpu_usage_total - cs.prev_cpu_usage_total;
-            uint64_t sys_delta = cs.system_cpu_usage - cs.prev_system_cpu_usage;
-            if (sys_delta > 0) {
-                cs.cpu_percent = 100.0 * static_cast<double>(cpu_delta) / static_cast<double>(sys_delta);
-            }
+    /* Locate the scope for a container id under the usual systemd and cgroupfs layouts. */
+    bool open(const std::string& id) {
+        static const char* const kLayouts[] = {
+            "%s/fs/cgroup/system.slice/docker-%s.scope",
+            "%s/fs/cgroup/docker/%s",
+            "%s/fs/cgroup/machine.slice/libpod-%s.scope",
+            "%s/fs/cgroup/system.slice/libpod-%s.scope",
+        };
+        static const char* const kNames[kFileCount] = {
+            "cpu.stat", "memory.current", "memory.stat", "memory.max", "io.stat", "pids.current", "cgroup.procs",
+        };
+        for (const char* layout : kLayouts) {
+            char dir[PATH_MAX];
+            std::snprintf(dir, sizeof(dir), layout, sysRoot().c_str(), id.c_str());
+            int dfd = ::open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dfd < 0) continue;
+            for (int i = 0; i < kFileCount; ++i) fds_[i] = openat(dfd, kNames[i], O_RDONLY | O_CLOEXEC);
+            ::close(dfd);
+            if (fds_[kCpuStat] >= 0 && fds_[kMemCurrent] >= 0) return true;
+            reset();
         }
-        cs.cpu_initialized = true;
+        return false;
+    }
 
-        std::string mem_obj = extractObject(stats_json, "memory_stats");
-        if (!mem_obj.empty()) {
-            cs.mem_usage = extractUint64(mem_obj, "usage");
-            cs.mem_limit = extractUint64(mem_obj, "limit");
-            std::string stats_str = extractObject(mem_obj, "stats");
-            if (!stats_str.empty()) {
-                cs.mem_cache = extractUint64(stats_str, "total_inactive_file");
-            }
-            if (cs.mem_limit > 0) {
-                cs.mem_percent = 100.0 * static_cast<double>(cs.mem_usage) / static_cast<double>(cs.mem_limit);
-            }
+    /* Read a whole file into buf; returns the length, or -1 if it is gone. */
+    ssize_t read(File f, char* buf, size_t size) const {
+        if (fds_[f] < 0) return -1;
+        ssize_t n = pread(fds_[f], buf, size - 1, 0);
+        if (n < 0) return -1;
+        buf[n] = '\0';
+        return n;
+    }
+
+private:
+    void reset() {
+        for (int& fd : fds_) {
+            if (fd >= 0) ::close(fd);
+            fd = -1;
         }
+    }
 
-        uint64_t total_rx = 0, total_tx = 0;
-        std::string net_obj = extractObject(stats_json, "networks");
-        if (!net_obj.empty()) {
-            /* networks is an object {"eth0": {...}, ...}, iterate each value */
-            size_t pos = 1; /* skip opening { */
-            while (pos < net_obj.size()) {
-                while (pos < net_obj.size() && net_obj[pos] != '"') ++pos;
-                if (pos >= net_obj.size()) break;
-                /* skip key string */
-                ++pos;
-                while (pos < net_obj.size() && net_obj[pos] != '"') {
-                    if (net_obj[pos] == '\\' && pos + 1 < net_obj.size()) ++pos;
-                    ++pos;
-                }
-                if (pos < net_obj.size()) ++pos; /* closing quote */
-                /* skip colon and whitespace */
-                while (pos < net_obj.size() && (net_obj[pos] == ' ' || net_obj[pos] == ':' || net_obj[pos] == '\t' || net_obj[pos] == '\n' || net_obj[pos] == '\r')) ++pos;
-                if (pos >= net_obj.size()) break;
-                /* extract the value object */
-                size_t val_start = pos;
-                pos = skipJsonValue(net_obj, pos);
-                std::string iface = net_obj.substr(val_start, pos - val_start);
-                total_rx += extractUint64(iface, "rx_bytes");
-                total_tx += extractUint64(iface, "tx_bytes");
-                /* skip comma */
-                while (pos < net_obj.size() && (net_obj[pos] == ',' || net_obj[pos] == ' ' || net_obj[pos] == '\t' || net_obj[pos] == '\n' || net_obj[pos] == '\r')) ++pos;
+    std::array<int, kFileCount> fds_;
+};
+
+/* Value of "key <n>" in a flat-keyed file such as cpu.stat or memory.stat. */
+static uint64_t flatKeyValue(const char* buf, const char* key) {
+    size_t klen = std::strlen(key);
+    for (const char* line = buf; *line;) {
+        if (std::strncmp(line, key, klen) == 0 && line[klen] == ' ') {
+            return std::strtoull(line + klen + 1, nullptr, 10);
+        }
+        const char* nl = std::strchr(line, '\n');
+        if (!nl) break;
+        line = nl + 1;
+    }
+    return 0;
+}
+
+/* Sum "name=value" fields across every device line of io.stat. */
+static uint64_t ioStatSum(const char* buf, const char* field) {
+    uint64_t total = 0;
+    size_t flen = std::strlen(field);
+    for (const char* p = std::strstr(buf, field); p; p = std::strstr(p + flen, field)) {
+        if (p != buf && p[-1] != ' ') continue;
+        if (p[flen] != '=') continue;
+        total += std::strtoull(p + flen + 1, nullptr, 10);
+    }
+    return total;
+}
+
+static uint64_t hostMemTotalBytes() {
+    static const uint64_t total = []() -> uint64_t {
+        std::FILE* f = std::fopen((procRoot() + "/meminfo").c_str(), "r");
+        if (!f) return 0;
+        char line[256];
+        uint64_t kb = 0;
+        while (std::fgets(line, sizeof(line), f)) {
+            if (std::strncmp(line, "MemTotal:", 9) == 0) {
+                kb = std::strtoull(line + 9, nullptr, 10);
+                break;
             }
         }
+        std::fclose(f);
+        return kb * 1024;
+    }();
+    return total;
+}
+
+/* Network counters live in the container's netns, reachable through any member PID. */
+static bool readNetDev(int pid, uint64_t& rx, uint64_t& tx) {
+    char path[PATH_MAX];
+    std::snprintf(path, sizeof(path), "%s/%d/net/dev", procRoot().c_str(), pid);
+    std::FILE* f = std::fopen(path, "r");
+    if (!f) return false;
+    char line[512];
+    rx = tx = 0;
+    while (std::fgets(line, sizeof(line), f)) {
+        char* colon = std::strchr(line, ':');
+        if (!colon) continue;
+        const char* name = line;
+        while (*name == ' ') ++name;
+        if (std::strncmp(name, "lo:", 3) == 0) continue;
+        unsigned long long v[9] = {};
+        if (std::sscanf(colon + 1, "%llu %llu %llu %llu %llu %llu %llu %llu %llu",
+                        &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8]) == 9) {
+            rx += v[0];
+            tx += v[8];
+        }
+    }
+    std::fclose(f);
+    return true;
+}
 
-        /* Docker reports cumulative bytes since container start — use directly as totals. */
-        cs.net_rx_total = total_rx;
-        cs.net_tx_total = total_tx;
-        cs.net_rx_bytes = total_rx;
-        cs.net_tx_bytes = total_tx;
+/* Fill `cs` from cgroup v2 counters; CPU% is usage over wall time across all CPUs, like the API path. */
+static void applyCgroupStats(const CgroupFiles& cg, hmon::plugins::docker::ContainerStats& cs,
+                             std::chrono::steady_clock::time_point now, int ncpu) {
+    double dt = 0.0;
+    if (cs.sample_time != std::chrono::steady_clock::time_point{}) {
+        dt = std::chrono::duration<double>(now - cs.sample_time).count();
+    }
+    cs.sample_time = now;
 
-        if (cs.net_initialized) {
-            cs.net_rx_bps = static_cast<double>(total_rx - cs.prev_net_rx);
-            cs.net_tx_bps = static_cast<double>(total_tx - cs.prev_net_tx);
+    char buf[4096];
+    if (cg.read(CgroupFiles::kCpuStat, buf, sizeof(buf)) > 0) {
+        uint64_t usage_usec = flatKeyValue(buf, "usage_usec");
+        if (cs.cpu_initialized && dt > 0.0 && usage_usec >= cs.cpu_usage_total && ncpu > 0) {
+            double delta_s = static_cast<double>(usage_usec - cs.cpu_usage_total) / 1e6;
+            cs.cpu_percent = 100.0 * delta_s / (dt * ncpu);
         }
-        cs.prev_net_rx = total_rx;
-        cs.prev_net_tx = total_tx;
-        cs.net_initialized = true;
+        cs.prev_cpu_usage_total = cs.cpu_usage_total;
+        cs.cpu_usage_total = usage_usec;
+        cs.online_cpus = ncpu;
+        cs.cpu_initialized = true;
+    }
+
+    if (cg.read(CgroupFiles::kMemCurrent, buf, sizeof(buf)) > 0) {
+        cs.mem_usage = std::strtoull(buf, nullptr, 10);
+    }
+    if (cg.read(CgroupFiles::kMemStat, buf, sizeof(buf)) > 0) {
+        cs.mem_cache = flatKeyValue(buf, "inactive_file");
+    }
+    if (cg.read(CgroupFiles::kMemMax, buf, sizeof(buf)) > 0) {
+        cs.mem_limit = std::strncmp(buf, "max", 3) == 0 ? hostMemTotalBytes() : std::strtoull(buf, nullptr, 10);
+    }
+    if (cs.mem_limit > 0) {
+        cs.mem_percent = 100.0 * static_cast<double>(cs.mem_usage) / static_cast<double>(cs.mem_limit);
+    }
 
-        uint64_t blk_read = 0, blk_write = 0;
-        std::string blkio = extractObject(stats_json, "blkio_stats");
-        if (!blkio.empty()) {
-            forEachInArray(blkio, "io_service_bytes_recursive", [&](const std::string& entry) {
-                std::string op = extractString(entry, "Op");
-                uint64_t val = extractUint64(entry, "Value");
-                if (op == "Read") blk_read += val;
-                else if (op == "Write") blk_write += val;
-            });
+    if (cg.read(CgroupFiles::kIoStat, buf, sizeof(buf)) >= 0) {
+        uint64_t blk_read = ioStatSum(buf, "rbytes");
+        uint64_t blk_write = ioStatSum(buf, "wbytes");
+        if (cs.blk_initialized && dt > 0.0 && blk_read >= cs.prev_blk_read && blk_write >= cs.prev_blk_write) {
+            cs.blk_read_bps = static_cast<double>(blk_read - cs.prev_blk_read) / dt;
+            cs.blk_write_bps = static_cast<double>(blk_write - cs.prev_blk_write) / dt;
         }
         cs.blk_read_bytes = blk_read;
         cs.blk_write_bytes = blk_write;
-
-        if (cs.blk_initialized) {
-            cs.blk_read_bps = static_cast<double>(blk_read - cs.prev_blk_read);
-            cs.blk_write_bps = static_cast<double>(blk_write - cs.prev_blk_write);
-        }
         cs.prev_blk_read = blk_read;
         cs.prev_blk_write = blk_write;
         cs.blk_initialized = true;
+    }
+
+    if (cg.read(CgroupFiles::kPidsCurrent, buf, sizeof(buf)) > 0) {
+        cs.pids_current = static_cast<int>(std::strtol(buf, nullptr, 10));
+    }
 
-        std::string pids_obj = extractObject(stats_json, "pids_stats");
-        if (!pids_obj.empty()) {
-            cs.pids_current = extractInt(pids_obj, "current");
+    uint64_t rx = 0, tx = 0;
+    if (cg.read(CgroupFiles::kProcs, buf, sizeof(buf)) > 0 && readNetDev(std::atoi(buf), rx, tx)) {
+        if (cs.net_initialized && dt > 0.0 && rx >= cs.prev_net_rx && tx >= cs.prev_net_tx) {
+            cs.net_rx_bps = static_cast<double>(rx - cs.prev_net_rx) / dt;
+            cs.net_tx_bps = static_cast<double>(tx - cs.prev_net_tx) / dt;
         }
+        cs.net_rx_total = cs.net_rx_bytes = rx;
+        cs.net_tx_total = cs.net_tx_bytes = tx;
+        cs.prev_net_rx = rx;
+        cs.prev_net_tx = tx;
+        cs.net_initialized = true;
     }
+}
 
-    return result;
+static int connectUnixSocket(const std::string& socket_path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
 }
 
+/*
+ * A long-lived streaming response (stats?stream=true or /events).  Docker
+ * writes one JSON document per line inside a chunked body; feed() decodes the
+ * chunks incrementally and hands every complete line to the caller.
+ */
+struct StreamConn {
+    enum class Kind { kStats, kEvents };
+
+    int fd = -1;
+    Kind kind = Kind::kStats;
+    std::string container_id;
+    std::string raw;
+    std::string body;
+    bool headers_done = false;
+    bool chunked = false;
+    size_t chunk_left = 0;     /* bytes of the current chunk not yet consumed */
+    bool chunk_trailer = false; /* expecting the CRLF after a chunk */
+
+    /* Returns false when the stream ended or is malformed. */
+    bool feed(const char* data, size_t len, const std::function<void(const std::string&)>& on_doc) {
+        raw.append(data, len);
+        if (!headers_done) {
+            size_t end = raw.find("\r\n\r\n");
+            if (end == std::string::npos) return raw.size() < 65536;
+            std::string headers = raw.substr(0, end);
+            raw.erase(0, end + 4);
+            if (headers.compare(0, 9, "HTTP/1.1 ") != 0 && headers.compare(0, 9, "HTTP/1.0 ") != 0) return false;
+            if (headers.compare(9, 3, "200") != 0) return false;
+            std::transform(headers.begin(), headers.end(), headers.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            chunked = headers.find("transfer-encoding: chunked") != std::string::npos;
+            headers_done = true;
+        }
+
+        if (!chunked) {
+            body += raw;
+            raw.clear();
+        } else {
+            size_t pos = 0;
+            while (pos < raw.size()) {
+                if (chunk_trailer) {
+                    if (raw.size() - pos < 2) break;
+                    pos += 2;
+                    chunk_trailer = false;
+                    continue;
+                }
+                if (chunk_left == 0) {
+                    size_t crlf = raw.find("\r\n", pos);
+                    if (crlf == std::string::npos) break;
+                    size_t size = std::strtoul(raw.c_str() + pos, nullptr, 16);
+                    pos = crlf + 2;
+                    if (size == 0) return false;
+                    chunk_left = size;
+                }
+                size_t take = std::min(chunk_left, raw.size() - pos);
+                body.append(raw, pos, take);
+                pos += take;
+                chunk_left -= take;
+                if (chunk_left == 0) chunk_trailer = true;
+            }
+            raw.erase(0, pos);
+        }
+
+        size_t start = 0;
+        size_t nl;
+        while ((nl = body.find('\n', start)) != std::string::npos) {
+            if (nl > start) on_doc(body.substr(start, nl - start));
+            start = nl + 1;
+        }
+        body.erase(0, start);
+        return body.size() < (1u << 20);
+    }
+};
+
+/*
+ * Background event loop: one streaming stats connection per running container
+ * and one /events subscription, all on a single epoll set.  The container list
+ * is re-read only when an event says it changed (plus a slow safety refresh).
+ */
+class StreamingCollector {
+public:
+    explicit StreamingCollector(hmon::plugins::docker::DockerPluginCtx* ctx) : ctx_(ctx) {}
+
+    ~StreamingCollector() {
+        for (auto& [fd, conn] : conns_) close(fd);
+        if (epoll_fd_ >= 0) close(epoll_fd_);
+    }
+
+    void run() {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) return;
+        struct epoll_event wake {};
+        wake.events = EPOLLIN;
+        wake.data.fd = ctx_->wake_fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, ctx_->wake_fd, &wake);
+
+        list_dirty_ = true;
+        struct epoll_event events[64];
+        char buf[16384];
+        while (ctx_->running) {
+            auto now = std::chrono::steady_clock::now();
+            if (events_fd_ < 0 && now >= next_events_retry_) {
+                openEvents();
+                next_events_retry_ = now + std::chrono::seconds(2);
+            }
+            auto backend = ctx_->backend.load();
+            if (backend != backend_) {
+                backend_ = backend;
+                list_dirty_ = true;
+            }
+            if (list_dirty_ || now >= next_list_refresh_) refreshList(now);
+
+            int n = epoll_wait(epoll_fd_, events, 64, hmon::plugins::docker::DockerPluginCtx::CACHE_INTERVAL_MS);
+            if (n < 0 && errno != EINTR) break;
+            now = std::chrono::steady_clock::now();
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == ctx_->wake_fd) {
+                    uint64_t counter;
+                    ssize_t ignored = read(fd, &counter, sizeof(counter));
+                    (void)ignored;
+                    continue;
+                }
+                auto it = conns_.find(fd);
+                if (it == conns_.end()) continue;
+                if (!drain(it->second, buf, sizeof(buf), now)) closeConn(fd);
+            }
+            if (!cgroups_.empty() && now >= next_cgroup_sample_) {
+                sampleCgroups(now);
+                next_cgroup_sample_ = now + std::chrono::milliseconds(hmon::plugins::docker::DockerPluginCtx::CACHE_INTERVAL_MS);
+            }
+            if (dirty_ && now - last_publish_ >= std::chrono::milliseconds(hmon::plugins::docker::DockerPluginCtx::CACHE_INTERVAL_MS)) {
+                publish(now);
+            }
+        }
+    }
+
+private:
+    bool drain(StreamConn& conn, char* buf, size_t size, std::chrono::steady_clock::time_point now) {
+        while (true) {
+            ssize_t n = recv(conn.fd, buf, size, MSG_DONTWAIT);
+            if (n > 0) {
+                bool ok = conn.feed(buf, static_cast<size_t>(n), [&](const std::string& doc) {
+                    if (conn.kind == StreamConn::Kind::kEvents) {
+                        onEvent(doc);
+                    } else {
+                        auto st = stats_.find(conn.container_id);
+                        if (st != stats_.end()) {
+                            applyStats(doc, st->second, now);
+                            dirty_ = true;
+                        }
+                    }
+                });
+                if (!ok) return false;
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            if (n < 0 && errno == EINTR) continue;
+            return false;
+        }
+    }
+
+    void onEvent(const std::string& doc) {
+        std::string action = extractString(doc, "Action");
+        if (action.empty()) action = extractString(doc, "status");
+        if (action.rfind("exec_", 0) == 0 || action.rfind("health_status", 0) == 0 ||
+            action == "top" || action == "attach" || action == "resize") {
+            return;
+        }
+        list_dirty_ = true;
+    }
+
+    int openStream(const std::string& path, StreamConn::Kind kind, const std::string& id) {
+        int fd = connectUnixSocket(ctx_->socket_path);
+        if (fd < 0) return -1;
+        std::string request =
+            "GET " + path + " HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Accept: application/json\r\n"
+            "\r\n";
+        if (send(fd, request.c_str(), request.size(), MSG_NOSIGNAL) < 0) {
+            close(fd);
+            return -1;
+        }
+        struct epoll_event ev {};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            return -1;
+        }
+        StreamConn conn;
+        conn.fd = fd;
+        conn.kind = kind;
+        conn.container_id = id;
+        conns_.emplace(fd, std::move(conn));
+        return fd;
+    }
+
+    void openEvents() {
+        events_fd_ = openStream("/events?filters=%7B%22type%22%3A%5B%22container%22%5D%7D",
+                                StreamConn::Kind::kEvents, "");
+        /* Anything may have changed while we were not subscribed. */
+        if (events_fd_ >= 0) list_dirty_ = true;
+    }
+
+    void closeConn(int fd) {
+        auto it = conns_.find(fd);
+        if (it == conns_.end()) return;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        if (it->second.kind == StreamConn::Kind::kEvents) {
+            events_fd_ = -1;
+        } else {
+            stream_fd_.erase(it->second.container_id);
+            /* The container may have gone; let the list decide whether to reopen. */
+            list_dirty_ = true;
+        }
+        conns_.erase(it);
+    }
+
+    void refreshList(std::chrono::steady_clock::time_point now) {
+        list_dirty_ = false;
+        next_list_refresh_ = now + std::chrono::seconds(30);
+
+        std::string containers_json = httpGetUnixSocket(ctx_->socket_path, "/containers/json");
+        if (containers_json.empty()) {
+            next_list_refresh_ = now + std::chrono::seconds(2);
+            return;
+        }
+
+        std::vector<std::string> order;
+        std::unordered_map<std::string, hmon::plugins::docker::ContainerStats> next;
+        forEachTopLevelArray(containers_json, [&](const std::string& elem) {
+            std::string id = extractString(elem, "Id");
+            if (id.empty()) return;
+            auto old = stats_.find(id);
+            hmon::plugins::docker::ContainerStats cs = old != stats_.end() ? std::move(old->second)
+                                                                           : hmon::plugins::docker::ContainerStats{};
+            cs.id = id;
+            cs.name = extractArrayString(elem, "Names");
+            if (!cs.name.empty() && cs.name[0] == '/') cs.name = cs.name.substr(1);
+            cs.image = extractString(elem, "Image");
+            cs.state = extractString(elem, "State");
+            order.push_back(id);
+            next[id] = std::move(cs);
+        });
+
+        for (auto it = cgroups_.begin(); it != cgroups_.end();) {
+            auto st = next.find(it->first);
+            bool keep = backend_ == hmon::plugins::docker::StatsBackend::kCgroup &&
+                        st != next.end() && st->second.state == "running";
+            it = keep ? std::next(it) : cgroups_.erase(it);
+        }
+        if (backend_ == hmon::plugins::docker::StatsBackend::kCgroup) {
+            for (const auto& id : order) {
+                if (next[id].state != "running" || cgroups_.count(id)) continue;
+                CgroupFiles cg;
+                if (cg.open(id)) cgroups_.emplace(id, std::move(cg));
+            }
+        }
+
+        for (auto it = stream_fd_.begin(); it != stream_fd_.end();) {
+            auto st = next.find(it->first);
+            if (st == next.end() || st->second.state != "running" || cgroups_.count(it->first)) {
+                int fd = it->second;
+                it = stream_fd_.erase(it);
+                epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+                close(fd);
+                conns_.erase(fd);
+            } else {
+                ++it;
+            }
+        }
+        for (const auto& id : order) {
+            if (next[id].state != "running" || stream_fd_.count(id) || cgroups_.count(id)) continue;
+            int fd = openStream("/containers/" + id + "/stats?stream=true", StreamConn::Kind::kStats, id);
+            if (fd >= 0) stream_fd_[id] = fd;
+        }
+
+        order_ = std::move(order);
+        stats_ = std::move(next);
+        dirty_ = true;
+        publish(now);
+    }
+
+    void sampleCgroups(std::chrono::steady_clock::time_point now) {
+        for (const auto& [id, cg] : cgroups_) {
+            auto st = stats_.find(id);
+            if (st != stats_.end()) applyCgroupStats(cg, st->second, now, ncpu_);
+        }
+        dirty_ = true;
+    }
+
+    void publish(std::chrono::steady_clock::time_point now) {
+        std::vector<hmon::plugins::docker::ContainerStats> snapshot;
+        snapshot.reserve(order_.size());
+        for (const auto& id : order_) {
+            auto it = stats_.find(id);
+            if (it != stats_.end()) snapshot.push_back(it->second);
+        }
+        {
+            std::lock_guard<std::mutex> lock(ctx_->data_mutex);
+            ctx_->containers = std::move(snapshot);
+            if (!ctx_->containers.empty()) ctx_->has_data = true;
+        }
+        dirty_ = false;
+        last_publish_ = now;
+    }
+
+    hmon::plugins::docker::DockerPluginCtx* ctx_;
+    int epoll_fd_ = -1;
+    int events_fd_ = -1;
+    std::unordered_map<int, StreamConn> conns_;
+    std::unordered_map<std::string, int> stream_fd_;
+    std::unordered_map<std::string, hmon::plugins::docker::ContainerStats> stats_;
+    std::unordered_map<std::string, CgroupFiles> cgroups_;
+    std::vector<std::string> order_;
+    hmon::plugins::docker::StatsBackend backend_ = hmon::plugins::docker::StatsBackend::kApi;
+    int ncpu_ = std::max(1, static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN)));
+    bool list_dirty_ = true;
+    bool dirty_ = false;
+    std::chrono::steady_clock::time_point next_list_refresh_{};
+    std::chrono::steady_clock::time_point next_events_retry_{};
+    std::chrono::steady_clock::time_point last_publish_{};
+    std::chrono::steady_clock::time_point next_cgroup_sample_{};
+};
+
 }
 
 namespace hmon::plugins::docker {
 
 void startBackgroundCollector(DockerPluginCtx* ctx) {
     if (ctx->running) return;
+    if (ctx->worker.joinable()) ctx->worker.join();
+    if (ctx->wake_fd < 0) ctx->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (ctx->wake_fd < 0) return;
     ctx->running = true;
     ctx->worker = std::thread([ctx]() {
-        while (ctx->running) {
-            auto fresh = doCollect(ctx->socket_path, ctx->containers);
-            {
-                std::lock_guard<std::mutex> lock(ctx->data_mutex);
-                ctx->containers = std::move(fresh);
-                if (!ctx->containers.empty()) ctx->has_data = true;
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(DockerPluginCtx::CACHE_INTERVAL_MS));
-        }
+        StreamingCollector collector(ctx);
+        collector.run();
     });
-    ctx->worker.detach();
 }
 
 void stopBackgroundCollector(DockerPluginCtx* ctx) {
     ctx->running = false;
+    if (ctx->wake_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(ctx->wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+    if (ctx->worker.joinable()) ctx->worker.join();
+    if (ctx->wake_fd >= 0) {
+        close(ctx->wake_fd);
+        ctx->wake_fd = -1;
+    }
+}
+
+std::string dockerSocketPath() {
+    const char* env_socket = std::getenv("DOCKER_HOST");
+    if (env_socket && std::strncmp(env_socket, "unix://", 7) == 0) return env_socket + 7;
+    return "/var/run/docker.sock";
+}
+
+std::unordered_map<uint16_t, std::string> listPublishedPorts(const std::string& socket_path) {
+    std::unordered_map<uint16_t, std::string> result;
+    std::string containers_json = httpGetUnixSocket(socket_path, "/containers/json");
+    if (containers_json.empty()) return result;
+
+    forEachTopLevelArray(containers_json, [&](const std::string& elem) {
+        std::string name = extractArrayString(elem, "Names");
+        if (!name.empty() && name[0] == '/') name = name.substr(1);
+        if (name.empty()) return;
+        forEachInArray(elem, "Ports", [&](const std::string& port) {
+            int public_port = extractInt(port, "PublicPort");
+            if (public_port > 0 && public_port <= 65535) {
+                result.emplace(static_cast<uint16_t>(public_port), name);
+            }
+        });
+    });
+    return result;
 }
 
 }
@@ -1,10 +1,12 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace hmon::plugins::docker {
@@ -46,18 +48,31 @@ struct ContainerStats {
 
     int pids_current = 0;
 
+    /* Arrival time of the last stats sample, for per-second rates. */
+    std::chrono::steady_clock::time_point sample_time{};
+
     /* Cumulative totals (persist across collect calls). */
     uint64_t net_rx_total = 0;
     uint64_t net_tx_total = 0;
 };
 
+/*
+ * Where per-container counters come from.  kApi streams them from the engine;
+ * kCgroup reads the container's cgroup v2 files directly and only asks the
+ * engine for names and images (containers without a cgroup v2 directory still
+ * fall back to the API stream).
+ */
+enum class StatsBackend { kApi = 0, kCgroup = 1 };
+
 struct DockerPluginCtx {
     std::string socket_path;
+    std::atomic<StatsBackend> backend{StatsBackend::kApi};
 
     mutable std::mutex data_mutex;
     std::vector<ContainerStats> containers;
 
     std::thread worker;
+    int wake_fd = -1;   /* eventfd that interrupts the worker's epoll_wait on stop */
     std::atomic<bool> running{false};
     std::atomic<bool> has_data{false};
 
@@ -67,4 +82,9 @@ struct DockerPluginCtx {
 void startBackgroundCollector(DockerPluginCtx* ctx);
 void stopBackgroundCollector(DockerPluginCtx* ctx);
 
+/* Engine socket from DOCKER_HOST (unix:// only), else /var/run/docker.sock. */
+std::string dockerSocketPath();
+/* Published host port -> container name, from one /containers/json request. */
+std::unordered_map<uint16_t, std::string> listPublishedPorts(const std::string& socket_path);
+
 }
@@ -1,18 +1,26 @@
 #include "gpu_collector.hpp"
 
 #include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
 #include <filesystem>
 #include <fstream>
 #include <optional>
-#include <regex>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <unistd.h>
 #include <vector>
 
+#include "hmon/fs_root.hpp"
+
 namespace fs = std::filesystem;
 
 namespace {
 
+constexpr auto kCardRediscoverInterval = std::chrono::seconds(60);
+
 std::string trim(const std::string& s) {
     auto b = s.find_first_not_of(" \t\r\n");
     if (b == std::string::npos) return "";
@@ -66,6 +74,40 @@ std::optional<std::string> readFirstLine(const fs::path& p) {
     return std::nullopt;
 }
 
+/* Read the whole file at offset 0, growing the buffer until it fits. */
+bool readWhole(int fd, std::string* buf) {
+    if (buf->empty()) buf->resize(4096);
+    while (true) {
+        const ssize_t n = pread(fd, buf->data(), buf->size(), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (static_cast<size_t>(n) < buf->size()) {
+            buf->resize(static_cast<size_t>(n));
+            return true;
+        }
+        buf->resize(buf->size() * 2);
+    }
+}
+
+int openRead(const fs::path& p) {
+    return ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+/* A sysfs integer attribute, re-read from offset 0 of an open fd. */
+std::optional<long long> preadLL(int fd) {
+    if (fd < 0) return std::nullopt;
+    char buf[32];
+    const ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) return std::nullopt;
+    buf[n] = '\0';
+    char* end = nullptr;
+    const long long v = std::strtoll(buf, &end, 10);
+    if (end == buf) return std::nullopt;
+    return v;
+}
+
 std::optional<double> normalizePercent(long long raw) {
     if (raw < 0) return std::nullopt;
     return std::min(100.0, static_cast<double>(raw));
@@ -117,24 +159,6 @@ std::optional<std::string> readDriver(const fs::path& dev) {
     return std::nullopt;
 }
 
-std::optional<bool> detectInUse(const fs::path& drm, const fs::path& card, const fs::path& dev) {
-    std::string prefix = card.filename().string() + "-";
-    bool saw_status = false;
-    for (const auto& e : fs::directory_iterator(drm)) {
-        std::string name = e.path().filename().string();
-        if (name.rfind(prefix, 0) != 0) continue;
-        if (name.find("render") != std::string::npos) continue;
-        auto status = readFirstLine(e.path() / "status");
-        if (!status) continue;
-        saw_status = true;
-        if (toLower(*status) == "connected") return true;
-    }
-    if (saw_status) return false;
-    auto boot = readLL(dev / "boot_vga");
-    if (boot) return *boot == 1;
-    return std::nullopt;
-}
-
 int score(const hmon::plugins::gpu::GpuInfo& g) {
     int s = 0;
     if (g.temperature_c) s += 2;
@@ -152,66 +176,133 @@ bool looksNvidia(const hmon::plugins::gpu::GpuInfo& g) {
     return n.find("nvidia") != std::string::npos || src.find("nvidia") != std::string::npos;
 }
 
-std::optional<double> readAmdClock(const fs::path& p) {
-    std::ifstream f(p);
-    if (!f) return std::nullopt;
-    std::regex pattern(R"(:\s*([0-9]+(?:\.[0-9]+)?)\s*[Mm][Hh][Zz].*\*)");
-    std::string line;
-    while (std::getline(f, line)) {
-        std::smatch match;
-        if (std::regex_search(line, match, pattern)) {
-            try { return std::stod(match[1].str()); } catch (...) { return std::nullopt; }
+/*
+ * pp_dpm_sclk lists the DPM levels as "N: <clock>Mhz" and marks the current
+ * one with '*'; scan for that line and parse the clock in place.
+ */
+std::optional<double> parseActiveSclk(std::string_view text) {
+    while (!text.empty()) {
+        size_t eol = text.find('\n');
+        std::string_view line = text.substr(0, eol);
+        text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+        if (line.find('*') == std::string_view::npos) continue;
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) return std::nullopt;
+        const char* p = line.data() + colon + 1;
+        const char* end = line.data() + line.size();
+        while (p < end && (*p == ' ' || *p == '\t')) ++p;
+        double v = 0.0;
+        bool digits = false;
+        while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+            v = v * 10.0 + (*p++ - '0');
+            digits = true;
+        }
+        if (p < end && *p == '.') {
+            double scale = 0.1;
+            for (++p; p < end && static_cast<unsigned>(*p - '0') < 10; ++p, scale *= 0.1) v += (*p - '0') * scale;
+        }
+        if (!digits) return std::nullopt;
+        while (p < end && (*p == ' ' || *p == '\t')) ++p;
+        if (end - p < 3 || std::tolower(static_cast<unsigned char>(p[0])) != 'm' ||
+            std::tolower(static_cast<unsigned char>(p[1])) != 'h' ||
+            std::tolower(static_cast<unsigned char>(p[2])) != 'z') {
+            return std::nullopt;
         }
+        return v;
     }
     return std::nullopt;
 }
 
-std::vector<double> amdCoreUsage(const fs::path& dev) {
-    std::vector<double> result;
-    auto gpu_busy = readLL(dev / "gpu_busy_percent");
-    if (gpu_busy) {
-        auto n = normalizePercent(*gpu_busy);
-        if (n) result.push_back(*n);
-    }
-    auto mem_busy = readLL(dev / "mem_busy_percent");
-    if (mem_busy) {
-        auto n = normalizePercent(*mem_busy);
-        if (n) result.push_back(*n);
+bool isTempInput(const std::string& fn) {
+    return fn.rfind("temp", 0) == 0 && fn.size() > 10 && fn.compare(fn.size() - 6, 6, "_input") == 0;
+}
+
+/* The first power attribute that reads back; power1_average is EOPNOTSUPP on some amdgpu parts. */
+int openHwmonPower(const fs::path& hwmon) {
+    for (const char* name : {"power1_average", "power1_input", "power2_average", "power2_input"}) {
+        int fd = openRead(hwmon / name);
+        if (fd < 0) continue;
+        if (preadLL(fd)) return fd;
+        ::close(fd);
     }
-    return result;
+    return -1;
 }
 
-std::optional<double> readHwmonPower(const fs::path& sensor) {
-    auto uw = readLL(sensor / "power1_average");
-    if (!uw) uw = readLL(sensor / "power1_input");
-    if (!uw) uw = readLL(sensor / "power2_average");
-    if (!uw) uw = readLL(sensor / "power2_input");
-    if (uw && *uw > 0) return static_cast<double>(*uw) / 1000000.0;
-    return std::nullopt;
+std::vector<fs::path> sortedEntries(const fs::path& dir) {
+    std::vector<fs::path> entries;
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator(dir, ec)) entries.push_back(e.path());
+    std::sort(entries.begin(), entries.end());
+    return entries;
 }
 
-std::optional<double> readSensorsPower() {
-    std::string output = runCommand("sensors -j 2>/dev/null");
-    if (output.empty()) return std::nullopt;
+void discoverCards(hmon::plugins::gpu::DrmCards* d) {
+    d->close();
+    const auto entries = sortedEntries(hmon::core::sysRoot() + "/class/drm");
+    for (const auto& card : entries) {
+        std::string name = card.filename().string();
+        if (name.rfind("card", 0) != 0 || name.find('-') != std::string::npos) continue;
 
-    std::istringstream stream(output);
-    std::string line;
-    while (std::getline(stream, line)) {
-        if (line.find("power") != std::string::npos && line.find("W") != std::string::npos) {
-
-            for (size_t i = 0; i < line.size(); i++) {
-                if (std::isdigit(line[i]) || line[i] == '.') {
-                    try {
-                        size_t pos = 0;
-                        double v = std::stod(line.substr(i), &pos);
-                        if (v > 0 && v < 10000) return v;
-                    } catch (...) {}
-                    break;
-                }
+        std::error_code ec;
+        fs::path dev = card / "device";
+        if (!fs::exists(dev, ec) || !isDisplayClass(dev)) continue;
+
+        auto vendor = readFirstLine(dev / "vendor");
+        auto driver = readDriver(dev);
+
+        hmon::plugins::gpu::DrmCard c;
+        c.source = driver ? ("sysfs/" + *driver) : "sysfs";
+        c.name = name + " (" + vendorName(vendor) + ")";
+
+        std::string prefix = name + "-";
+        for (const auto& conn : entries) {
+            std::string cn = conn.filename().string();
+            if (cn.rfind(prefix, 0) != 0 || cn.find("render") != std::string::npos) continue;
+            int fd = openRead(conn / "status");
+            if (fd >= 0) c.connector_fds.push_back(fd);
+        }
+        auto boot = readLL(dev / "boot_vga");
+        if (boot) c.boot_vga = *boot == 1;
+
+        for (const auto& hw : sortedEntries(dev / "hwmon")) {
+            if (c.power_fd < 0) c.power_fd = openHwmonPower(hw);
+            if (c.temp_fd >= 0) continue;
+            for (const auto& f : sortedEntries(hw)) {
+                if (!isTempInput(f.filename().string())) continue;
+                c.temp_fd = openRead(f);
+                if (c.temp_fd >= 0) break;
             }
         }
+
+        /* i915 puts the GT frequency on the card node, amdgpu the DPM table on the device. */
+        c.freq_fd = openRead(card / "gt_cur_freq_mhz");
+        if (c.freq_fd < 0) c.freq_fd = openRead(dev / "gt_cur_freq_mhz");
+        c.sclk_fd = openRead(dev / "pp_dpm_sclk");
+        c.busy_fd = openRead(dev / "gpu_busy_percent");
+        c.mem_busy_fd = openRead(dev / "mem_busy_percent");
+        c.vram_used_fd = openRead(dev / "mem_info_vram_used");
+        if (c.vram_used_fd < 0) c.vram_used_fd = openRead(dev / "mem_info_vis_vram_used");
+        c.vram_total = readLL(dev / "mem_info_vram_total");
+        if (!c.vram_total) c.vram_total = readLL(dev / "mem_info_vis_vram_total");
+
+        d->cards.push_back(std::move(c));
     }
-    return std::nullopt;
+    d->discovered_at = std::chrono::steady_clock::now();
+    d->stale = false;
+}
+
+std::optional<bool> readInUse(const hmon::plugins::gpu::DrmCard& c) {
+    bool saw_status = false;
+    for (int fd : c.connector_fds) {
+        char buf[16];
+        const ssize_t n = pread(fd, buf, sizeof(buf), 0);
+        if (n <= 0) continue;
+        saw_status = true;
+        if (n >= 9 && std::memcmp(buf, "connected", 9) == 0) return true;
+    }
+    if (saw_status) return false;
+    return c.boot_vga;
 }
 
 std::vector<hmon::plugins::gpu::GpuInfo> fromNvidiaSmi() {
@@ -256,67 +347,71 @@ std::vector<hmon::plugins::gpu::GpuInfo> fromNvidiaSmi() {
     return result;
 }
 
-std::vector<hmon::plugins::gpu::GpuInfo> fromSysfs(std::optional<double> sensors_power) {
+std::vector<hmon::plugins::gpu::GpuInfo> fromNvml(hmon::plugins::gpu::NvmlLibrary& nvml) {
     std::vector<hmon::plugins::gpu::GpuInfo> result;
-    const fs::path drm("/sys/class/drm");
-    if (!fs::exists(drm)) return result;
-
-    for (const auto& card : fs::directory_iterator(drm)) {
-        std::string name = card.path().filename().string();
-        if (name.rfind("card", 0) != 0 || name.find('-') != std::string::npos) continue;
+    for (auto& s : nvml.sampleDevices()) {
+        hmon::plugins::gpu::GpuInfo g;
+        g.name = std::move(s.name);
+        g.source = "nvml";
+        g.temperature_c = s.temperature_c;
+        g.core_clock_mhz = s.sm_clock_mhz;
+        g.utilization_percent = s.utilization_percent;
+        g.power_w = s.power_w;
+        g.memory_used_mib = s.memory_used_mib;
+        g.memory_total_mib = s.memory_total_mib;
+        g.memory_utilization_percent = s.memory_utilization_percent;
 
-        fs::path dev = card.path() / "device";
-        if (!fs::exists(dev) || !isDisplayClass(dev)) continue;
+        g.gpu_core_usage_percent = {g.utilization_percent.value_or(0.0)};
+        if (g.memory_utilization_percent) {
+            g.gpu_core_usage_percent.push_back(*g.memory_utilization_percent);
+        }
+        result.push_back(std::move(g));
+    }
+    return result;
+}
 
-        auto vendor = readFirstLine(dev / "vendor");
-        auto driver = readDriver(dev);
+std::vector<hmon::plugins::gpu::GpuInfo> fromSysfs(hmon::plugins::gpu::GpuPluginCtx* ctx) {
+    auto& d = ctx->drm;
+    /* Drivers can bind late and eGPUs come and go; re-walk the tree now and then. */
+    if (std::chrono::steady_clock::now() - d.discovered_at > kCardRediscoverInterval) d.stale = true;
+    if (d.stale) discoverCards(&d);
 
+    std::vector<hmon::plugins::gpu::GpuInfo> result;
+    result.reserve(d.cards.size());
+    for (const auto& c : d.cards) {
         hmon::plugins::gpu::GpuInfo g;
-        g.source = driver ? ("sysfs/" + *driver) : "sysfs";
-        g.name = name + " (" + vendorName(vendor) + ")";
-        g.in_use = detectInUse(drm, card.path(), dev);
-
-        if (fs::exists(dev / "hwmon")) {
-            for (const auto& hw : fs::directory_iterator(dev / "hwmon")) {
-                if (!fs::is_directory(hw.path())) continue;
-                if (!g.power_w) g.power_w = readHwmonPower(hw.path());
-                for (const auto& f : fs::directory_iterator(hw.path())) {
-                    std::string fn = f.path().filename().string();
-                    if (!g.temperature_c && fn.rfind("temp", 0) == 0 && fn.rfind("_input") == fn.size() - 6) {
-                        auto raw = readLL(f.path());
-                        if (raw) g.temperature_c = static_cast<double>(*raw) / 1000.0;
-                    }
-                }
-            }
-        }
+        g.name = c.name;
+        g.source = c.source;
+        g.in_use = readInUse(c);
+
+        auto temp = preadLL(c.temp_fd);
+        if (temp) g.temperature_c = static_cast<double>(*temp) / 1000.0;
+        auto uw = preadLL(c.power_fd);
+        if (uw && *uw > 0) g.power_w = static_cast<double>(*uw) / 1000000.0;
 
-        auto clk = readLL(dev / "gt_cur_freq_mhz");
+        auto clk = preadLL(c.freq_fd);
         if (clk && *clk > 0) {
             g.core_clock_mhz = static_cast<double>(*clk);
-        } else {
-            g.core_clock_mhz = readAmdClock(dev / "pp_dpm_sclk");
+        } else if (c.sclk_fd >= 0 && readWhole(c.sclk_fd, &ctx->read_buf)) {
+            g.core_clock_mhz = parseActiveSclk(ctx->read_buf);
         }
 
-        auto util = readLL(dev / "gpu_busy_percent");
-        if (util) g.utilization_percent = normalizePercent(*util);
-
-        g.gpu_core_usage_percent = amdCoreUsage(dev);
-
-        auto vram_used = readLL(dev / "mem_info_vram_used");
-        if (!vram_used) vram_used = readLL(dev / "mem_info_vis_vram_used");
-        auto vram_total = readLL(dev / "mem_info_vram_total");
-        if (!vram_total) vram_total = readLL(dev / "mem_info_vis_vram_total");
+        auto busy = preadLL(c.busy_fd);
+        if (busy) g.utilization_percent = normalizePercent(*busy);
+        if (g.utilization_percent) g.gpu_core_usage_percent.push_back(*g.utilization_percent);
+        auto mem_busy = preadLL(c.mem_busy_fd);
+        if (mem_busy) {
+            auto n = normalizePercent(*mem_busy);
+            if (n) g.gpu_core_usage_percent.push_back(*n);
+        }
 
-        if (vram_used && vram_total && *vram_total > 0) {
+        auto vram_used = preadLL(c.vram_used_fd);
+        if (vram_used && c.vram_total && *c.vram_total > 0) {
             g.memory_used_mib = static_cast<double>(*vram_used) / (1024.0 * 1024.0);
-            g.memory_total_mib = static_cast<double>(*vram_total) / (1024.0 * 1024.0);
-            if (*g.memory_total_mib > 0.0) {
-                g.memory_utilization_percent = 100.0 * (*g.memory_used_mib) / (*g.memory_total_mib);
-            }
+            g.memory_total_mib = static_cast<double>(*c.vram_total) / (1024.0 * 1024.0);
+            g.memory_utilization_percent = 100.0 * (*g.memory_used_mib) / (*g.memory_total_mib);
         }
 
-        if (!g.power_w && sensors_power) g.power_w = sensors_power;
-
         result.push_back(std::move(g));
     }
 
@@ -333,10 +428,26 @@ std::vector<hmon::plugins::gpu::GpuInfo> fromSysfs(std::optional<double> sensors
 
 namespace hmon::plugins::gpu {
 
-std::vector<GpuInfo> collectGpus() {
-    auto nvidia = fromNvidiaSmi();
-    auto sensors_power = readSensorsPower();
-    auto sysfs = fromSysfs(sensors_power);
+void DrmCards::close() {
+    for (const auto& c : cards) {
+        for (int fd : {c.temp_fd, c.power_fd, c.freq_fd, c.sclk_fd, c.busy_fd, c.mem_busy_fd, c.vram_used_fd}) {
+            if (fd >= 0) ::close(fd);
+        }
+        for (int fd : c.connector_fds) ::close(fd);
+    }
+    cards.clear();
+}
+
+GpuPluginCtx::~GpuPluginCtx() {
+    drm.close();
+}
+
+std::vector<GpuInfo> collectGpus(GpuPluginCtx* ctx) {
+    if (!ctx) return {};
+    std::vector<GpuInfo> nvidia;
+    if (ctx->nvml.open()) nvidia = fromNvml(ctx->nvml);
+    if (nvidia.empty()) nvidia = fromNvidiaSmi();
+    auto sysfs = fromSysfs(ctx);
 
     if (!nvidia.empty()) {
         std::vector<bool> sysfs_used(sysfs.size(), false);
@@ -371,7 +482,6 @@ std::vector<GpuInfo> collectGpus() {
         }
 
         for (auto& g : nvidia) {
-            if (!g.power_w && sensors_power) g.power_w = sensors_power;
             if (!g.memory_utilization_percent && g.memory_used_mib && g.memory_total_mib && *g.memory_total_mib > 0.0) {
                 g.memory_utilization_percent = 100.0 * (*g.memory_used_mib) / (*g.memory_total_mib);
             }
@@ -1,16 +1,55 @@
 #pragma once
 
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <optional>
-#include <regex>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "nvml_backend.hpp"
+
 namespace hmon::plugins::gpu {
 
-struct GpuPluginCtx {};
+/*
+ * One /sys/class/drm/cardN resolved by discoverCards(): the static identity is
+ * read once and every attribute sampled per tick is held open and re-read
+ * with pread.  Missing attributes stay at -1.
+ */
+struct DrmCard {
+    std::string name;                   /* "card0 (AMD)" */
+    std::string source;                 /* "sysfs/<driver>" */
+    int temp_fd = -1;                   /* first hwmon temp*_input */
+    int power_fd = -1;                  /* first readable hwmon power{1,2}_{average,input}, in uW */
+    int freq_fd = -1;                   /* i915 gt_cur_freq_mhz */
+    int sclk_fd = -1;                   /* amdgpu pp_dpm_sclk */
+    int busy_fd = -1;                   /* gpu_busy_percent */
+    int mem_busy_fd = -1;               /* mem_busy_percent */
+    int vram_used_fd = -1;
+    std::optional<long long> vram_total;
+    std::vector<int> connector_fds;     /* cardN-<connector>/status */
+    std::optional<bool> boot_vga;
+};
+
+struct DrmCards {
+    std::vector<DrmCard> cards;
+    std::chrono::steady_clock::time_point discovered_at{};
+    bool stale = true;
+
+    void close();
+};
+
+struct GpuPluginCtx {
+    NvmlLibrary nvml;
+    DrmCards drm;
+    std::string read_buf;
+
+    GpuPluginCtx() = default;
+    GpuPluginCtx(const GpuPluginCtx&) = delete;
+    GpuPluginCtx& operator=(const GpuPluginCtx&) = delete;
+    ~GpuPluginCtx();
+};
 
 struct GpuInfo {
     std::string name;
@@ -26,6 +65,6 @@ struct GpuInfo {
     std::vector<double> gpu_core_usage_percent;
 };
 
-std::vector<GpuInfo> collectGpus();
+std::vector<GpuInfo> collectGpus(GpuPluginCtx* ctx);
 
 }
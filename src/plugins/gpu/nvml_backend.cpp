@@ -0,0 +1,181 @@
+#include "nvml_backend.hpp"
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+/* Subset of nvml.h; values are part of NVML's stable ABI. */
+constexpr int kNvmlSuccess = 0;
+constexpr int kNvmlErrorInsufficientSize = 7;
+constexpr int kNvmlErrorNotFound = 6;
+constexpr int kNvmlTemperatureGpu = 0;
+constexpr int kNvmlClockSm = 1;
+constexpr unsigned int kNvmlNameLength = 96;
+
+struct NvmlUtilization {
+    unsigned int gpu;
+    unsigned int memory;
+};
+
+struct NvmlMemory {
+    unsigned long long total;
+    unsigned long long free;
+    unsigned long long used;
+};
+
+struct NvmlProcessUtilizationSample {
+    unsigned int pid;
+    unsigned long long timeStamp;
+    unsigned int smUtil;
+    unsigned int memUtil;
+    unsigned int encUtil;
+    unsigned int decUtil;
+};
+
+template <typename Fn>
+bool resolveSymbol(void* handle, const char* name, Fn& out) {
+    out = reinterpret_cast<Fn>(dlsym(handle, name));
+    return out != nullptr;
+}
+
+}
+
+namespace hmon::plugins::gpu {
+
+NvmlLibrary::~NvmlLibrary() {
+    close();
+}
+
+void NvmlLibrary::close() {
+    if (!handle_) return;
+    if (shutdown_) shutdown_();
+    dlclose(handle_);
+    handle_ = nullptr;
+    devices_.clear();
+    names_.clear();
+    last_seen_us_.clear();
+}
+
+bool NvmlLibrary::open() {
+    if (handle_) return true;
+    if (attempted_) return false;
+    attempted_ = true;
+
+    handle_ = dlopen("libnvidia-ml.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (!handle_) handle_ = dlopen("libnvidia-ml.so", RTLD_NOW | RTLD_LOCAL);
+    if (!handle_) return false;
+
+    bool ok = resolveSymbol(handle_, "nvmlInit_v2", init_)
+           && resolveSymbol(handle_, "nvmlShutdown", shutdown_)
+           && resolveSymbol(handle_, "nvmlDeviceGetCount_v2", get_count_)
+           && resolveSymbol(handle_, "nvmlDeviceGetHandleByIndex_v2", get_handle_)
+           && resolveSymbol(handle_, "nvmlDeviceGetName", get_name_)
+           && resolveSymbol(handle_, "nvmlDeviceGetTemperature", get_temperature_)
+           && resolveSymbol(handle_, "nvmlDeviceGetClockInfo", get_clock_)
+           && resolveSymbol(handle_, "nvmlDeviceGetUtilizationRates", get_utilization_)
+           && resolveSymbol(handle_, "nvmlDeviceGetPowerUsage", get_power_)
+           && resolveSymbol(handle_, "nvmlDeviceGetMemoryInfo", get_memory_);
+    /* Per-process sampling is missing on old drivers; device metrics still work. */
+    resolveSymbol(handle_, "nvmlDeviceGetProcessUtilization", get_process_utilization_);
+
+    if (!ok || init_() != kNvmlSuccess) {
+        shutdown_ = nullptr;
+        dlclose(handle_);
+        handle_ = nullptr;
+        return false;
+    }
+
+    unsigned int count = 0;
+    if (get_count_(&count) != kNvmlSuccess || count == 0) {
+        close();
+        return false;
+    }
+    for (unsigned int i = 0; i < count; ++i) {
+        void* dev = nullptr;
+        if (get_handle_(i, &dev) != kNvmlSuccess) continue;
+        char name[kNvmlNameLength] = {};
+        if (get_name_(dev, name, sizeof(name)) != kNvmlSuccess) name[0] = '\0';
+        devices_.push_back(dev);
+        names_.emplace_back(name[0] ? name : "NVIDIA GPU");
+    }
+    last_seen_us_.assign(devices_.size(), 0);
+    if (devices_.empty()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+std::vector<NvmlDeviceSample> NvmlLibrary::sampleDevices() {
+    std::vector<NvmlDeviceSample> result;
+    if (!handle_) return result;
+    result.reserve(devices_.size());
+
+    for (size_t i = 0; i < devices_.size(); ++i) {
+        void* dev = devices_[i];
+        NvmlDeviceSample s;
+        s.name = names_[i];
+
+        unsigned int value = 0;
+        if (get_temperature_(dev, kNvmlTemperatureGpu, &value) == kNvmlSuccess) {
+            s.temperature_c = static_cast<double>(value);
+        }
+        if (get_clock_(dev, kNvmlClockSm, &value) == kNvmlSuccess) {
+            s.sm_clock_mhz = static_cast<double>(value);
+        }
+        if (get_power_(dev, &value) == kNvmlSuccess) {
+            s.power_w = static_cast<double>(value) / 1000.0;
+        }
+
+        NvmlUtilization util{};
+        if (get_utilization_(dev, &util) == kNvmlSuccess) {
+            s.utilization_percent = static_cast<double>(util.gpu);
+            s.memory_utilization_percent = static_cast<double>(util.memory);
+        }
+
+        NvmlMemory mem{};
+        if (get_memory_(dev, &mem) == kNvmlSuccess) {
+            s.memory_used_mib = static_cast<double>(mem.used) / (1024.0 * 1024.0);
+            s.memory_total_mib = static_cast<double>(mem.total) / (1024.0 * 1024.0);
+        }
+
+        result.push_back(std::move(s));
+    }
+    return result;
+}
+
+std::unordered_map<int, double> NvmlLibrary::sampleProcessUtilization() {
+    std::unordered_map<int, double> result;
+    if (!handle_ || !get_process_utilization_) return result;
+
+    std::vector<NvmlProcessUtilizationSample> samples;
+    for (size_t i = 0; i < devices_.size(); ++i) {
+        unsigned int count = 0;
+        int rc = get_process_utilization_(devices_[i], nullptr, &count, last_seen_us_[i]);
+        if (rc == kNvmlErrorNotFound || count == 0) continue;
+        if (rc != kNvmlSuccess && rc != kNvmlErrorInsufficientSize) continue;
+
+        samples.resize(count);
+        rc = get_process_utilization_(devices_[i], samples.data(), &count, last_seen_us_[i]);
+        if (rc != kNvmlSuccess) continue;
+
+        /* Several samples per PID may arrive for one device; keep the peak, then sum across devices. */
+        std::unordered_map<int, double> device_peak;
+        for (unsigned int k = 0; k < count; ++k) {
+            const auto& s = samples[k];
+            last_seen_us_[i] = std::max(last_seen_us_[i], s.timeStamp);
+            double& peak = device_peak[static_cast<int>(s.pid)];
+            peak = std::max(peak, static_cast<double>(s.smUtil));
+        }
+        for (const auto& [pid, util] : device_peak) {
+            double& slot = result[pid];
+            slot = std::min(100.0, slot + util);
+        }
+    }
+    return result;
+}
+
+} /* namespace hmon::plugins::gpu */
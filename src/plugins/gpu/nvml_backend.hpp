@@ -0,0 +1,65 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace hmon::plugins::gpu {
+
+/*
+ * Minimal NVML binding resolved with dlopen() at runtime, so hmon has no
+ * build-time dependency on the CUDA toolkit.  The library and the device
+ * handles stay open for the lifetime of the owning plugin context; each tick
+ * is a handful of ioctl-backed calls instead of a fork/exec of nvidia-smi.
+ */
+struct NvmlDeviceSample {
+    std::string name;
+    std::optional<double> temperature_c;
+    std::optional<double> sm_clock_mhz;
+    std::optional<double> utilization_percent;
+    std::optional<double> memory_utilization_percent;
+    std::optional<double> power_w;
+    std::optional<double> memory_used_mib;
+    std::optional<double> memory_total_mib;
+};
+
+class NvmlLibrary {
+public:
+    NvmlLibrary() = default;
+    ~NvmlLibrary();
+    NvmlLibrary(const NvmlLibrary&) = delete;
+    NvmlLibrary& operator=(const NvmlLibrary&) = delete;
+
+    /* Load libnvidia-ml and enumerate devices; cheap to call again after a failure. */
+    bool open();
+    bool ready() const { return handle_ != nullptr; }
+
+    std::vector<NvmlDeviceSample> sampleDevices();
+    /* SM utilization per PID across all devices since the previous call. */
+    std::unordered_map<int, double> sampleProcessUtilization();
+
+private:
+    void close();
+
+    void* handle_ = nullptr;
+    bool attempted_ = false;
+    std::vector<void*> devices_;
+    std::vector<std::string> names_;
+    std::vector<unsigned long long> last_seen_us_;
+
+    /* NVML entry points; signatures use plain C types instead of nvml.h. */
+    int (*init_)() = nullptr;
+    int (*shutdown_)() = nullptr;
+    int (*get_count_)(unsigned int*) = nullptr;
+    int (*get_handle_)(unsigned int, void**) = nullptr;
+    int (*get_name_)(void*, char*, unsigned int) = nullptr;
+    int (*get_temperature_)(void*, int, unsigned int*) = nullptr;
+    int (*get_clock_)(void*, int, unsigned int*) = nullptr;
+    int (*get_utilization_)(void*, void*) = nullptr;
+    int (*get_power_)(void*, unsigned int*) = nullptr;
+    int (*get_memory_)(void*, void*) = nullptr;
+    int (*get_process_utilization_)(void*, void*, unsigned int*, unsigned long long) = nullptr;
+};
+
+} /* namespace hmon::plugins::gpu */
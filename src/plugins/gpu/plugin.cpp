@@ -1,5 +1,6 @@
 #include <cstdlib>
 #include <cstring>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -8,123 +9,90 @@
 #include "gpu_collector.hpp"
 
 
-struct GpuContext {};
-
 static int gpu_plugin_init(hmon_plugin_ctx** out) {
     if (!out) return -1;
-    auto* ctx = new (std::nothrow) GpuContext();
+    auto* ctx = new (std::nothrow) hmon::plugins::gpu::GpuPluginCtx();
     if (!ctx) return -1;
     *out = reinterpret_cast<hmon_plugin_ctx*>(ctx);
     return 0;
 }
 
-static void appendMetric(hmon_metric_list* list, const char* key, int type, const void* value) {
-    if (list->count >= list->capacity) {
-        size_t new_cap = list->capacity == 0 ? 64 : list->capacity * 2;
-        auto* new_items = static_cast<hmon_metric*>(std::realloc(list->items, new_cap * sizeof(hmon_metric)));
-        if (!new_items) return;
-        list->items = new_items;
-        list->capacity = new_cap;
-    }
-    auto* item = &list->items[list->count];
-    item->key = key;
-    item->value.type = type;
-    switch (type) {
-    case HMON_VAL_STRING: {
-        const char* src = static_cast<const char*>(value);
-        char* dup = strdup(src ? src : "");
-        item->value.v.str = dup;
-        break;
-    }
-    case HMON_VAL_INT64:
-        item->value.v.i64 = *static_cast<const int64_t*>(value);
-        break;
-    case HMON_VAL_DOUBLE:
-        item->value.v.f64 = *static_cast<const double*>(value);
-        break;
-    case HMON_VAL_BOOL:
-        item->value.v.b = *static_cast<const int32_t*>(value);
-        break;
-    }
-    ++list->count;
-}
+/* Absent readings are NaN (doubles) or -1 (in_use), per the table null convention. */
+static const hmon_table_column kColumns[] = {
+    {"name", HMON_VAL_STRING},
+    {"source", HMON_VAL_STRING},
+    {"temp_c", HMON_VAL_DOUBLE},
+    {"clock_mhz", HMON_VAL_DOUBLE},
+    {"usage_pct", HMON_VAL_DOUBLE},
+    {"power_w", HMON_VAL_DOUBLE},
+    {"vram_used_mib", HMON_VAL_DOUBLE},
+    {"vram_total_mib", HMON_VAL_DOUBLE},
+    {"vram_usage_pct", HMON_VAL_DOUBLE},
+    {"in_use", HMON_VAL_BOOL},
+};
+enum : uint32_t {
+    kColName,
+    kColSource,
+    kColTempC,
+    kColClockMhz,
+    kColUsagePct,
+    kColPowerW,
+    kColVramUsedMib,
+    kColVramTotalMib,
+    kColVramUsagePct,
+    kColInUse,
+    kColumnCount
+};
 
-static int gpu_plugin_collect(hmon_plugin_ctx* ctx, hmon_metric_list* out_list) {
-    (void)ctx;
-    if (!out_list) return -1;
-    auto gpus = hmon::plugins::gpu::collectGpus();
-    for (size_t i = 0; i < gpus.size(); ++i) {
+static constexpr double kNull = std::numeric_limits<double>::quiet_NaN();
+
+static int gpu_plugin_collect(hmon_plugin_ctx* ctx, hmon_metric_list* out_list, hmon_arena* arena) {
+    if (!ctx || !out_list || !arena) return -1;
+    auto* c = reinterpret_cast<hmon::plugins::gpu::GpuPluginCtx*>(ctx);
+    auto gpus = hmon::plugins::gpu::collectGpus(c);
+    auto* table = hmon_metric_append_table(out_list, arena, HMON_METRIC_GPU_TABLE, kColumns, kColumnCount,
+                                           static_cast<uint32_t>(gpus.size()));
+    if (!table) return 0;
+    size_t core_rows = 0;
+    for (uint32_t i = 0; i < table->row_count; ++i) {
         const auto& g = gpus[i];
-        char key[128];
-        std::snprintf(key, sizeof(key), "gpu.%zu.name", i);
-        appendMetric(out_list, strdup(key), HMON_VAL_STRING, g.name.c_str());
-        std::snprintf(key, sizeof(key), "gpu.%zu.source", i);
-        appendMetric(out_list, strdup(key), HMON_VAL_STRING, g.source.c_str());
-        if (g.temperature_c) {
-            std::snprintf(key, sizeof(key), "gpu.%zu.temp_c", i);
-            double v = *g.temperature_c;
-            appendMetric(out_list, strdup(key), HMON_VAL_DOUBLE, &v);
-        }
-        if (g.core_clock_mhz) {
-            std::snprintf(key, sizeof(key), "gpu.%zu.clock_mhz", i);
-            double v = *g.core_clock_mhz;
-            appendMetric(out_list, strdup(key), HMON_VAL_DOUBLE, &v);
-        }
-        if (g.utilization_percent) {
-            std::snprintf(key, sizeof(key), "gpu.%zu.usage_pct", i);
-            double v = *g.utilization_percent;
-            appendMetric(out_list, strdup(key), HMON_VAL_DOUBLE, &v);
-        }
-        if (g.power_w) {
-            std::snprintf(key, sizeof(key), "gpu.%zu.power_w", i);
-            double v = *g.power_w;
-            appendMetric(out_list, strdup(key), HMON_VAL_DOUBLE, &v);
-        }
-        if (g.memory_used_mib) {
-            std::snprintf(key, sizeof(key), "gpu.%zu.vram_used_mib", i);
-            double v = *g.memory_used_mib;
-            appendMetric(out_list, strdup(key), HMON_VAL_DOUBLE, &v);
-        }
-        if (g.memory_total_mib) {
-            std::snprintf(key, sizeof(key), "gpu.%zu.vram_total_mib", i);
-            double v = *g.memory_total_mib;
-            appendMetric(out_list, strdup(key), HMON_VAL_DOUBLE, &v);
-        }
-        if (g.memory_utilization_percent) {
-            std::snprintf(key, sizeof(key), "gpu.%zu.vram_usage_pct", i);
-            double v = *g.memory_utilization_percent;
-            appendMetric(out_list, strdup(key), HMON_VAL_DOUBLE, &v);
-        }
-        if (g.in_use.has_value()) {
-            std::snprintf(key, sizeof(key), "gpu.%zu.in_use", i);
-            int32_t v = *g.in_use ? 1 : 0;
-            appendMetric(out_list, strdup(key), HMON_VAL_BOOL, &v);
-        }
-        for (size_t c = 0; c < g.gpu_core_usage_percent.size(); ++c) {
-            std::snprintf(key, sizeof(key), "gpu.%zu.core_usage.%zu", i, c);
-            double v = g.gpu_core_usage_percent[c];
-            appendMetric(out_list, strdup(key), HMON_VAL_DOUBLE, &v);
+        auto* row = hmon_table_row(table, i);
+        hmon_table_set_str(arena, table, i, kColName, g.name.c_str());
+        hmon_table_set_str(arena, table, i, kColSource, g.source.c_str());
+        row[kColTempC].f64 = g.temperature_c.value_or(kNull);
+        row[kColClockMhz].f64 = g.core_clock_mhz.value_or(kNull);
+        row[kColUsagePct].f64 = g.utilization_percent.value_or(kNull);
+        row[kColPowerW].f64 = g.power_w.value_or(kNull);
+        row[kColVramUsedMib].f64 = g.memory_used_mib.value_or(kNull);
+        row[kColVramTotalMib].f64 = g.memory_total_mib.value_or(kNull);
+        row[kColVramUsagePct].f64 = g.memory_utilization_percent.value_or(kNull);
+        row[kColInUse].b = g.in_use.has_value() ? (*g.in_use ? 1 : 0) : -1;
+        core_rows += g.gpu_core_usage_percent.size();
+    }
+
+    static const hmon_table_column kCoreColumns[] = {
+        {"gpu", HMON_VAL_INT64}, {"core", HMON_VAL_INT64}, {"usage_pct", HMON_VAL_DOUBLE},
+    };
+    auto* cores = hmon_metric_append_table(out_list, arena, HMON_METRIC_GPU_CORES_TABLE, kCoreColumns, 3,
+                                           static_cast<uint32_t>(core_rows));
+    if (!cores) return 0;
+    uint32_t r = 0;
+    for (size_t i = 0; i < table->row_count; ++i) {
+        const auto& usage = gpus[i].gpu_core_usage_percent;
+        for (size_t core = 0; core < usage.size(); ++core) {
+            auto* row = hmon_table_row(cores, r++);
+            row[0].i64 = static_cast<int64_t>(i);
+            row[1].i64 = static_cast<int64_t>(core);
+            row[2].f64 = usage[core];
         }
     }
-    return 0;
+    /* No device, nor nvidia-smi to ask: looked for again now and then, not every second. */
+    return gpus.empty() ? HMON_COLLECT_ABSENT : 0;
 }
 
 static void gpu_plugin_destroy(hmon_plugin_ctx* ctx) {
     if (!ctx) return;
-    delete reinterpret_cast<GpuContext*>(ctx);
-}
-
-static void gpu_plugin_free_list(hmon_metric_list* list) {
-    if (!list) return;
-    for (size_t i = 0; i < list->count; ++i) {
-        if (list->items[i].value.type == HMON_VAL_STRING && list->items[i].value.v.str)
-            free(const_cast<char*>(list->items[i].value.v.str));
-        free(const_cast<char*>(list->items[i].key));
-    }
-    free(list->items);
-    list->items = nullptr;
-    list->count = 0;
-    list->capacity = 0;
+    delete reinterpret_cast<hmon::plugins::gpu::GpuPluginCtx*>(ctx);
 }
 
-HMON_STATIC_PLUGIN("gpu", gpu_plugin_init, gpu_plugin_collect, gpu_plugin_destroy, gpu_plugin_free_list, nullptr)
+HMON_STATIC_PLUGIN("gpu", gpu_plugin_init, gpu_plugin_collect, gpu_plugin_destroy, nullptr, 1000)
@@ -0,0 +1,205 @@
+#include "perf_collector.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "hmon/fs_root.hpp"
+#include "hmon/numa.hpp"
+
+namespace hmon::plugins::perf {
+
+namespace {
+
+using hmon::core::parseCpuList;
+using hmon::core::procRoot;
+using hmon::core::sysRoot;
+
+/* A locked PID with more threads than this is counted on its first kMaxThreads only. */
+constexpr size_t kMaxThreads = 256;
+
+constexpr uint64_t kHardwareEvents[kCounterCount] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,         /* last-level cache on every PMU the kernel maps it for */
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+int perfEventOpen(perf_event_attr* attr, int pid, int cpu, int group_fd) {
+    return static_cast<int>(::syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, PERF_FLAG_FD_CLOEXEC));
+}
+
+/* The counters describe this machine's CPUs and tasks; a relocated /proc or /sys cannot be matched to them. */
+bool liveRoots() { return procRoot() == "/proc" && sysRoot() == "/sys"; }
+
+std::string readLine(const std::string& path) {
+    std::string out;
+    if (FILE* f = std::fopen(path.c_str(), "re")) {
+        char buf[4096];
+        if (std::fgets(buf, sizeof(buf), f)) out = buf;
+        std::fclose(f);
+    }
+    while (!out.empty() && (out.back() == '\n' || out.back() == ' ')) out.pop_back();
+    return out;
+}
+
+void closeGroups(std::map<int, CounterGroup>* groups) {
+    for (auto& [tid, group] : *groups) group.close();
+    groups->clear();
+}
+
+}
+
+bool CounterGroup::open(int pid, int cpu, bool exclude_kernel) {
+    close();
+    for (int c = 0; c < kCounterCount; ++c) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = kHardwareEvents[c];
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = exclude_kernel ? 1 : 0;
+        attr.exclude_hv = 1;
+        const int fd = perfEventOpen(&attr, pid, cpu, c == kCycles ? -1 : fds[kCycles]);
+        if (fd < 0) {
+            /* Without cycles and instructions there is no IPC; the miss counters are optional. */
+            if (c == kCycles || c == kInstructions) {
+                close();
+                return false;
+            }
+            continue;
+        }
+        fds[c] = fd;
+        slot[c] = members++;
+    }
+    return true;
+}
+
+void CounterGroup::close() {
+    for (int c = 0; c < kCounterCount; ++c) {
+        if (fds[c] >= 0) ::close(fds[c]);
+        fds[c] = -1;
+        slot[c] = -1;
+    }
+    members = 0;
+    has_prev = false;
+    has_delta = false;
+}
+
+bool CounterGroup::sample() {
+    has_delta = false;
+    if (fds[kCycles] < 0) return false;
+    /* nr, time_enabled, time_running, then one value per member. */
+    uint64_t buf[3 + kCounterCount];
+    const ssize_t n = ::read(fds[kCycles], buf, sizeof(buf));
+    if (n < static_cast<ssize_t>((3 + members) * sizeof(uint64_t)) || buf[0] != static_cast<uint64_t>(members)) {
+        return false;
+    }
+    /* Multiplexing scales every member of a group alike, so the ratios need no correction. */
+    const bool ran = buf[2] > 0;
+    uint64_t cur[kCounterCount] = {};
+    for (int c = 0; c < kCounterCount; ++c) {
+        if (slot[c] >= 0) cur[c] = buf[3 + slot[c]];
+    }
+    if (has_prev && ran) {
+        for (int c = 0; c < kCounterCount; ++c) delta[c] = cur[c] >= prev[c] ? cur[c] - prev[c] : 0;
+        has_delta = true;
+    }
+    std::memcpy(prev, cur, sizeof(prev));
+    has_prev = true;
+    return has_delta;
+}
+
+void CounterTotals::add(const CounterGroup& group) {
+    if (!group.has_delta) return;
+    for (int c = 0; c < kCounterCount; ++c) {
+        count[c] += group.delta[c];
+        has[c] = has[c] && group.slot[c] >= 0;
+    }
+    any = true;
+}
+
+Efficiency CounterTotals::efficiency() const {
+    Efficiency e;
+    if (!any) return e;
+    const double instructions = static_cast<double>(count[kInstructions]);
+    if (count[kCycles] > 0) e.ipc = instructions / static_cast<double>(count[kCycles]);
+    if (count[kInstructions] > 0) {
+        if (has[kLlcMisses]) e.llc_mpki = static_cast<double>(count[kLlcMisses]) * 1000.0 / instructions;
+        if (has[kBranchMisses]) e.branch_mpki = static_cast<double>(count[kBranchMisses]) * 1000.0 / instructions;
+    }
+    return e;
+}
+
+PerfPluginCtx::~PerfPluginCtx() {
+    for (auto& core : cores) core.group.close();
+    closeGroups(&threads);
+}
+
+bool openCores(PerfPluginCtx* ctx) {
+    if (!ctx || !liveRoots()) return false;
+    const std::string cpu_dir = sysRoot() + "/devices/system/cpu";
+    for (int cpu : parseCpuList(readLine(cpu_dir + "/online"))) {
+        CoreCounters core;
+        core.cpu = cpu;
+        const std::string package = readLine(cpu_dir + "/cpu" + std::to_string(cpu) + "/topology/physical_package_id");
+        core.socket = package.empty() ? 0 : std::atoi(package.c_str());
+        /* Kernel time needs perf_event_paranoid <= 1 or CAP_PERFMON; count user time alone otherwise. */
+        if (!core.group.open(-1, cpu, false) && !core.group.open(-1, cpu, true)) continue;
+        ctx->cores.push_back(core);
+    }
+    return !ctx->cores.empty();
+}
+
+void sampleCores(PerfPluginCtx* ctx) {
+    for (auto& core : ctx->cores) core.group.sample();
+}
+
+bool sampleLockedPid(PerfPluginCtx* ctx, CounterTotals* out) {
+    if (!ctx || !out) return false;
+    const int pid = ctx->lock_pid.load();
+    if (pid != ctx->threads_pid) {
+        closeGroups(&ctx->threads);
+        ctx->threads_pid = pid;
+        ctx->threads_refused = false;
+    }
+    if (pid <= 0 || ctx->threads_refused || !liveRoots()) return false;
+
+    DIR* dir = ::opendir((procRoot() + "/" + std::to_string(pid) + "/task").c_str());
+    if (!dir) {
+        closeGroups(&ctx->threads);
+        return false;
+    }
+    std::map<int, CounterGroup> live;
+    while (dirent* e = ::readdir(dir)) {
+        if (e->d_name[0] < '0' || e->d_name[0] > '9') continue;
+        const int tid = std::atoi(e->d_name);
+        auto it = ctx->threads.find(tid);
+        if (it != ctx->threads.end()) {
+            live.emplace(tid, it->second);
+            ctx->threads.erase(it);
+            continue;
+        }
+        if (live.size() >= kMaxThreads) continue;
+        /* Another user's process needs CAP_PERFMON; kernel time needs perf_event_paranoid <= 1. */
+        CounterGroup group;
+        if (group.open(tid, -1, false) || group.open(tid, -1, true)) live.emplace(tid, group);
+    }
+    ::closedir(dir);
+    closeGroups(&ctx->threads);     /* threads that exited */
+    ctx->threads = std::move(live);
+    /* Not one thread could be counted: no PMU or no permission, so stop asking until the lock moves. */
+    if (ctx->threads.empty()) ctx->threads_refused = true;
+
+    for (auto& [tid, group] : ctx->threads) {
+        group.sample();
+        out->add(group);
+    }
+    return out->any;
+}
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace hmon::plugins::perf {
+
+/* Group members in read order; the leader counts cycles. */
+enum Counter : int {
+    kCycles,
+    kInstructions,
+    kLlcMisses,
+    kBranchMisses,
+    kCounterCount
+};
+
+/*
+ * One perf_event group: the cycles leader plus whichever of the other
+ * counters the PMU accepted, read together with a single read() so every
+ * member covers the same interval.  `slot[c]` is the counter's position in
+ * the group read, or -1 when it could not be opened.
+ */
+struct CounterGroup {
+    int fds[kCounterCount] = {-1, -1, -1, -1};
+    int slot[kCounterCount] = {-1, -1, -1, -1};
+    int members = 0;
+    uint64_t prev[kCounterCount] = {};
+    uint64_t delta[kCounterCount] = {};     /* by Counter */
+    bool has_prev = false;
+    bool has_delta = false;
+
+    bool open(int pid, int cpu, bool exclude_kernel);
+    void close();
+    /* One group read; true when `delta` holds the counts since the previous read. */
+    bool sample();
+};
+
+/* Derived ratios; each is -1 when its counter is missing or nothing ran. */
+struct Efficiency {
+    double ipc = -1.0;
+    double llc_mpki = -1.0;
+    double branch_mpki = -1.0;
+};
+
+/* Deltas summed over several groups, e.g. a socket's CPUs or a process's threads. */
+struct CounterTotals {
+    uint64_t count[kCounterCount] = {};
+    bool has[kCounterCount] = {true, true, true, true};
+    bool any = false;
+
+    void add(const CounterGroup& group);
+    Efficiency efficiency() const;
+};
+
+struct CoreCounters {
+    int cpu = 0;
+    int socket = 0;
+    CounterGroup group;
+};
+
+/*
+ * Per-CPU groups are opened once at init and kept for the plugin's life; a
+ * CPU that refuses (offline, no PMU, perf_event_paranoid) is simply absent.
+ * The locked PID gets one group per thread, re-synced with its task list on
+ * every collect.
+ */
+struct PerfPluginCtx {
+    std::vector<CoreCounters> cores;
+    std::atomic<int> lock_pid{-1};         /* set by the perf.lock_pid control */
+    int threads_pid = -1;                   /* whose threads `threads` holds */
+    bool threads_refused = false;
+    std::map<int, CounterGroup> threads;    /* by tid */
+
+    PerfPluginCtx() = default;
+    PerfPluginCtx(const PerfPluginCtx&) = delete;
+    PerfPluginCtx& operator=(const PerfPluginCtx&) = delete;
+    ~PerfPluginCtx();
+};
+
+/* Open a group on every online CPU; false when none could be opened. */
+bool openCores(PerfPluginCtx* ctx);
+void sampleCores(PerfPluginCtx* ctx);
+/* Follow the locked PID's threads and sample them; false when nothing is locked or nothing counted. */
+bool sampleLockedPid(PerfPluginCtx* ctx, CounterTotals* out);
+
+}
@@ -0,0 +1,117 @@
+#include <map>
+#include <string>
+#include <vector>
+
+#include "hmon/plugin_abi.h"
+#include "hmon/static_plugins.hpp"
+#include "perf_collector.hpp"
+
+
+static hmon::plugins::perf::PerfPluginCtx* g_perf_ctx = nullptr;
+
+static int perf_plugin_init(hmon_plugin_ctx** out) {
+    if (!out) return -1;
+    auto* ctx = new (std::nothrow) hmon::plugins::perf::PerfPluginCtx();
+    if (!ctx) return -1;
+    /* No per-CPU counters (no PMU, or perf_event_paranoid) still leaves the locked PID's own. */
+    hmon::plugins::perf::openCores(ctx);
+    g_perf_ctx = ctx;
+    *out = reinterpret_cast<hmon_plugin_ctx*>(ctx);
+    return 0;
+}
+
+static const hmon_table_column kCoreColumns[] = {
+    {"cpu", HMON_VAL_INT64},
+    {"socket", HMON_VAL_INT64},
+    {"ipc", HMON_VAL_DOUBLE},
+    {"llc_mpki", HMON_VAL_DOUBLE},
+    {"branch_mpki", HMON_VAL_DOUBLE},
+};
+enum : uint32_t {
+    kColCpu,
+    kColSocket,
+    kColCoreIpc,
+    kColCoreLlcMpki,
+    kColCoreBranchMpki,
+    kCoreColumnCount
+};
+
+static const hmon_table_column kSocketColumns[] = {
+    {"socket", HMON_VAL_INT64},
+    {"ipc", HMON_VAL_DOUBLE},
+    {"llc_mpki", HMON_VAL_DOUBLE},
+    {"branch_mpki", HMON_VAL_DOUBLE},
+};
+enum : uint32_t {
+    kColSocketId,
+    kColSocketIpc,
+    kColSocketLlcMpki,
+    kColSocketBranchMpki,
+    kSocketColumnCount
+};
+
+static int perf_plugin_collect(hmon_plugin_ctx* ctx, hmon_metric_list* out_list, hmon_arena* arena) {
+    if (!ctx || !out_list || !arena) return -1;
+    using hmon::plugins::perf::CounterTotals;
+    using hmon::plugins::perf::Efficiency;
+    auto* c = reinterpret_cast<hmon::plugins::perf::PerfPluginCtx*>(ctx);
+
+    hmon::plugins::perf::sampleCores(c);
+    std::vector<Efficiency> cores;
+    std::map<int, CounterTotals> sockets;
+    for (const auto& core : c->cores) {
+        CounterTotals one;
+        one.add(core.group);
+        cores.push_back(one.efficiency());
+        sockets[core.socket].add(core.group);
+    }
+
+    /* Nothing counted yet (first tick) publishes nothing rather than a row of unknowns. */
+    const bool counted = !sockets.empty() && sockets.begin()->second.any;
+    auto* core_table = hmon_metric_append_table(out_list, arena, HMON_METRIC_PERF_CORES_TABLE, kCoreColumns,
+                                                kCoreColumnCount, counted ? static_cast<uint32_t>(cores.size()) : 0);
+    for (uint32_t i = 0; core_table && i < core_table->row_count; ++i) {
+        auto* row = hmon_table_row(core_table, i);
+        row[kColCpu].i64 = c->cores[i].cpu;
+        row[kColSocket].i64 = c->cores[i].socket;
+        row[kColCoreIpc].f64 = cores[i].ipc;
+        row[kColCoreLlcMpki].f64 = cores[i].llc_mpki;
+        row[kColCoreBranchMpki].f64 = cores[i].branch_mpki;
+    }
+    auto* socket_table = hmon_metric_append_table(out_list, arena, HMON_METRIC_PERF_SOCKETS_TABLE, kSocketColumns,
+                                                  kSocketColumnCount, counted ? static_cast<uint32_t>(sockets.size()) : 0);
+    uint32_t r = 0;
+    for (const auto& [socket, totals] : sockets) {
+        if (!socket_table || r >= socket_table->row_count) break;
+        const Efficiency e = totals.efficiency();
+        auto* row = hmon_table_row(socket_table, r++);
+        row[kColSocketId].i64 = socket;
+        row[kColSocketIpc].f64 = e.ipc;
+        row[kColSocketLlcMpki].f64 = e.llc_mpki;
+        row[kColSocketBranchMpki].f64 = e.branch_mpki;
+    }
+
+    CounterTotals pid_totals;
+    if (hmon::plugins::perf::sampleLockedPid(c, &pid_totals)) {
+        const int64_t pid = c->threads_pid;
+        const Efficiency e = pid_totals.efficiency();
+        hmon_metric_append(out_list, arena, HMON_METRIC_PERF_PID, HMON_VAL_INT64, &pid);
+        hmon_metric_append(out_list, arena, HMON_METRIC_PERF_PID_IPC, HMON_VAL_DOUBLE, &e.ipc);
+        hmon_metric_append(out_list, arena, HMON_METRIC_PERF_PID_LLC_MPKI, HMON_VAL_DOUBLE, &e.llc_mpki);
+        hmon_metric_append(out_list, arena, HMON_METRIC_PERF_PID_BRANCH_MPKI, HMON_VAL_DOUBLE, &e.branch_mpki);
+    }
+    return 0;
+}
+
+static void perf_plugin_destroy(hmon_plugin_ctx* ctx) {
+    if (!ctx) return;
+    g_perf_ctx = nullptr;
+    delete reinterpret_cast<hmon::plugins::perf::PerfPluginCtx*>(ctx);
+}
+
+static void perf_plugin_control(const char* key, int value) {
+    if (!g_perf_ctx || !key) return;
+    if (std::string(key) == "perf.lock_pid") g_perf_ctx->lock_pid = value > 0 ? value : -1;
+}
+
+HMON_STATIC_PLUGIN("perf", perf_plugin_init, perf_plugin_collect, perf_plugin_destroy, perf_plugin_control, 1000)
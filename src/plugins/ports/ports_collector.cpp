@@ -1,25 +1,37 @@
 #include "ports_collector.hpp"
+#include "docker_collector.hpp"
 
 #include <algorithm>
 #include <arpa/inet.h>
 #include <cerrno>
 #include <chrono>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <dirent.h>
 #include <fstream>
 #include <limits.h>
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/sock_diag.h>
+#include <netinet/in.h>
 #include <pwd.h>
 #include <sstream>
 #include <string>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <unistd.h>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "hmon/fs_root.hpp"
+
 namespace {
 
+using hmon::core::procRoot;
+
 struct SocketEntry {
     uint16_t port;
     std::string proto;
@@ -30,9 +42,14 @@ struct SocketEntry {
 
 static std::string decodeIpv4(const std::string& hex_addr) {
     if (hex_addr.size() != 8) return "";
-    unsigned int a, b, c, d;
-    if (sscanf(hex_addr.c_str(), "%02x%02x%02x%02x", &a, &b, &c, &d) != 4) return "";
-    return std::to_string(a) + "." + std::to_string(b) + "." + std::to_string(c) + "." + std::to_string(d);
+    /* The kernel prints the raw 32-bit word, so it is already in memory order. */
+    uint32_t word = 0;
+    if (sscanf(hex_addr.c_str(), "%08x", &word) != 1) return "";
+    struct in_addr addr4;
+    std::memcpy(&addr4, &word, sizeof(word));
+    char buf[INET_ADDRSTRLEN];
+    if (inet_ntop(AF_INET, &addr4, buf, sizeof(buf))) return buf;
+    return "";
 }
 
 static std::string decodeIpv6(const std::string& hex_addr) {
@@ -43,7 +60,8 @@ static std::string decodeIpv6(const std::string& hex_addr) {
         std::string chunk = hex_addr.substr(i * 8, 8);
         unsigned int part;
         if (sscanf(chunk.c_str(), "%08x", &part) != 1) return "";
-        reinterpret_cast<uint32_t*>(&addr6.s6_addr)[i] = htonl(part);
+        uint32_t word = part;
+        std::memcpy(&addr6.s6_addr[i * 4], &word, sizeof(word));
     }
     if (inet_ntop(AF_INET6, &addr6, buf, sizeof(buf))) return buf;
     return "";
@@ -91,58 +109,154 @@ static std::vector<SocketEntry> parseProcNetFile(const std::string& path, const
     return result;
 }
 
-static std::unordered_map<uint64_t, std::string> buildInodeMap() {
-    std::unordered_map<uint64_t, std::string> result;
-    DIR* proc = opendir("/proc");
-    if (!proc) return result;
+/* Tag NETLINK_SOCK_DIAG replies with a sequence number so stale ones are skipped. */
+static uint32_t g_diag_seq = 0;
+
+constexpr uint8_t kTcpListen = 10;
+constexpr uint8_t kTcpClose = 7;   /* unconnected UDP sockets report TCP_CLOSE */
+
+static int openDiagSocket() {
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+    if (fd < 0) return -1;
+    struct timeval tv {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+/*
+ * One inet_diag dump for a family/protocol pair, filtered in the kernel to the
+ * given TCP states, so only listening sockets ever cross into userspace.
+ */
+static bool diagDump(int fd, uint8_t family, uint8_t protocol, uint8_t state,
+                     const std::string& proto, std::vector<SocketEntry>& out) {
+    struct {
+        struct nlmsghdr nlh;
+        struct inet_diag_req_v2 req;
+    } msg {};
+    const uint32_t seq = ++g_diag_seq;
+    msg.nlh.nlmsg_len = sizeof(msg);
+    msg.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    msg.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    msg.nlh.nlmsg_seq = seq;
+    msg.req.sdiag_family = family;
+    msg.req.sdiag_protocol = protocol;
+    msg.req.idiag_states = 1u << state;
+
+    struct sockaddr_nl nladdr {};
+    nladdr.nl_family = AF_NETLINK;
+    if (sendto(fd, &msg, sizeof(msg), 0, reinterpret_cast<struct sockaddr*>(&nladdr), sizeof(nladdr)) < 0) {
+        return false;
+    }
+
+    alignas(struct nlmsghdr) char buf[32768];
+    while (true) {
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len < 0 && errno == EINTR) continue;
+        if (len <= 0) return false;
+
+        int remaining = static_cast<int>(len);
+        for (auto* h = reinterpret_cast<struct nlmsghdr*>(buf); NLMSG_OK(h, remaining); h = NLMSG_NEXT(h, remaining)) {
+            if (h->nlmsg_seq != seq) continue;
+            if (h->nlmsg_type == NLMSG_DONE) return true;
+            if (h->nlmsg_type == NLMSG_ERROR) return false;
+            if (h->nlmsg_type != SOCK_DIAG_BY_FAMILY) continue;
+            if (h->nlmsg_len < NLMSG_LENGTH(sizeof(struct inet_diag_msg))) continue;
+
+            const auto* d = static_cast<const struct inet_diag_msg*>(NLMSG_DATA(h));
+            SocketEntry se;
+            se.port = ntohs(d->id.idiag_sport);
+            if (se.port == 0) continue;
+            se.proto = proto;
+            char addr[INET6_ADDRSTRLEN];
+            if (!inet_ntop(family, d->id.idiag_src, addr, sizeof(addr))) continue;
+            se.local_addr = addr;
+            se.inode = d->idiag_inode;
+            se.uid = d->idiag_uid;
+            out.push_back(std::move(se));
+        }
+    }
+}
+
+static bool collectViaDiag(hmon::plugins::ports::PortsPluginCtx* ctx, std::vector<SocketEntry>& out) {
+    if (ctx->diag_broken) return false;
+    if (ctx->diag_fd < 0) ctx->diag_fd = openDiagSocket();
+    if (ctx->diag_fd < 0) {
+        ctx->diag_broken = true;
+        return false;
+    }
+
+    bool ok = diagDump(ctx->diag_fd, AF_INET, IPPROTO_TCP, kTcpListen, "tcp", out)
+           && diagDump(ctx->diag_fd, AF_INET6, IPPROTO_TCP, kTcpListen, "tcp6", out)
+           && diagDump(ctx->diag_fd, AF_INET, IPPROTO_UDP, kTcpClose, "udp", out)
+           && diagDump(ctx->diag_fd, AF_INET6, IPPROTO_UDP, kTcpClose, "udp6", out);
+    if (!ok) {
+        /* A half-read dump leaves the socket out of sync; never reuse it. */
+        close(ctx->diag_fd);
+        ctx->diag_fd = -1;
+        out.clear();
+        if (!ctx->diag_verified) ctx->diag_broken = true;
+        return false;
+    }
+    ctx->diag_verified = true;
+    return true;
+}
+
+static std::string readComm(int pid) {
+    char comm_path[PATH_MAX];
+    std::snprintf(comm_path, sizeof(comm_path), "%s/%d/comm", procRoot().c_str(), pid);
+    std::ifstream comm(comm_path);
+    std::string name;
+    if (comm) std::getline(comm, name);
+    return name;
+}
+
+/*
+ * Find the owners of inodes not seen before.  The /proc/<pid>/fd walk stops as
+ * soon as every pending inode is found, and inodes that could not be resolved
+ * are cached as ownerless so they are not searched for again next tick.
+ */
+static void resolveNewInodes(hmon::plugins::ports::PortsPluginCtx* ctx, std::unordered_set<uint64_t> pending) {
+    if (pending.empty()) return;
+    for (uint64_t inode : pending) ctx->inode_owners.emplace(inode, hmon::plugins::ports::InodeOwner{});
+
+    DIR* proc = opendir(procRoot().c_str());
+    if (!proc) return;
 
     struct dirent* entry;
-    while ((entry = readdir(proc)) != nullptr) {
+    while (!pending.empty() && (entry = readdir(proc)) != nullptr) {
         if (entry->d_type != DT_DIR) continue;
-        bool is_pid = true;
+        bool is_pid = entry->d_name[0] != '\0';
         for (const char* p = entry->d_name; *p; ++p) {
             if (*p < '0' || *p > '9') { is_pid = false; break; }
         }
-        if (!is_pid || entry->d_name[0] == '\0') continue;
+        if (!is_pid) continue;
 
-        int pid = std::stoi(entry->d_name);
-        char fd_path[256];
-        std::snprintf(fd_path, sizeof(fd_path), "/proc/%d/fd", pid);
+        int pid = std::atoi(entry->d_name);
+        char fd_path[PATH_MAX];
+        std::snprintf(fd_path, sizeof(fd_path), "%s/%d/fd", procRoot().c_str(), pid);
         DIR* fd_dir = opendir(fd_path);
         if (!fd_dir) continue;
 
         std::string process_name;
         struct dirent* fd_entry;
-        while ((fd_entry = readdir(fd_dir)) != nullptr) {
+        while (!pending.empty() && (fd_entry = readdir(fd_dir)) != nullptr) {
             if (fd_entry->d_type != DT_LNK) continue;
-            char link_path[PATH_MAX];
-            std::snprintf(link_path, sizeof(link_path), "/proc/%d/fd/%s", pid, fd_entry->d_name);
-            char target[PATH_MAX];
-            ssize_t len = readlink(link_path, target, sizeof(target) - 1);
-            if (len <= 0) continue;
+            char target[64];
+            ssize_t len = readlinkat(dirfd(fd_dir), fd_entry->d_name, target, sizeof(target) - 1);
+            if (len <= 8) continue;
             target[len] = '\0';
             if (std::strncmp(target, "socket:[", 8) != 0) continue;
-            char* end_bracket = std::strchr(target + 8, ']');
-            if (!end_bracket) continue;
-            *end_bracket = '\0';
-            uint64_t inode = 0;
-            try { inode = std::stoull(target + 8); } catch (...) { continue; }
-            if (inode == 0 || result.count(inode)) continue;
-
-            if (process_name.empty()) {
-                char comm_path[256];
-                std::snprintf(comm_path, sizeof(comm_path), "/proc/%d/comm", pid);
-                std::ifstream comm(comm_path);
-                if (comm) std::getline(comm, process_name);
-            }
-            if (!process_name.empty()) {
-                result[inode] = process_name;
-            }
+            uint64_t inode = std::strtoull(target + 8, nullptr, 10);
+            if (inode == 0 || pending.erase(inode) == 0) continue;
+
+            if (process_name.empty()) process_name = readComm(pid);
+            auto& owner = ctx->inode_owners[inode];
+            owner.pid = pid;
+            owner.process = process_name;
         }
         closedir(fd_dir);
     }
     closedir(proc);
-    return result;
 }
 
 static std::string uidToName(uint32_t uid) {
@@ -155,33 +269,43 @@ static std::string uidToName(uint32_t uid) {
 
 namespace hmon::plugins::ports {
 
-std::vector<ListeningPort> collectListeningPorts(PortsPluginCtx* ctx) {
-    if (ctx) {
-        auto elapsed = std::chrono::steady_clock::now() - ctx->last_cache_time;
-        if (!ctx->cached_result.empty() &&
-            std::chrono::duration_cast<std::chrono::seconds>(elapsed).count() < PortsPluginCtx::TTL_SECONDS) {
-            return ctx->cached_result;
-        }
-    }
+PortsPluginCtx::~PortsPluginCtx() {
+    if (diag_fd >= 0) close(diag_fd);
+}
 
+std::vector<ListeningPort> collectListeningPorts(PortsPluginCtx* ctx) {
     std::vector<ListeningPort> result;
 
-    std::vector<std::pair<std::string, std::string>> files = {
-        {"/proc/net/tcp", "tcp"},
-        {"/proc/net/tcp6", "tcp6"},
-        {"/proc/net/udp", "udp"},
-        {"/proc/net/udp6", "udp6"}
-    };
-
     std::vector<SocketEntry> all_sockets;
-    for (const auto& [path, proto] : files) {
-        auto entries = parseProcNetFile(path, proto);
-        all_sockets.insert(all_sockets.end(), entries.begin(), entries.end());
+    /* sock_diag always describes this machine; a relocated procfs is read from its files. */
+    if (procRoot() != "/proc" || !collectViaDiag(ctx, all_sockets)) {
+        std::vector<std::pair<std::string, std::string>> files = {
+            {"/net/tcp", "tcp"},
+            {"/net/tcp6", "tcp6"},
+            {"/net/udp", "udp"},
+            {"/net/udp6", "udp6"}
+        };
+        for (const auto& [path, proto] : files) {
+            auto entries = parseProcNetFile(procRoot() + path, proto);
+            all_sockets.insert(all_sockets.end(), entries.begin(), entries.end());
+        }
     }
 
-    auto inode_map = buildInodeMap();
+    std::unordered_set<uint64_t> live;
+    std::unordered_set<uint64_t> pending;
+    for (const auto& se : all_sockets) {
+        if (se.inode == 0) continue;
+        live.insert(se.inode);
+        if (!ctx->inode_owners.count(se.inode)) pending.insert(se.inode);
+    }
+    for (auto it = ctx->inode_owners.begin(); it != ctx->inode_owners.end();) {
+        if (!live.count(it->first)) it = ctx->inode_owners.erase(it);
+        else ++it;
+    }
+    resolveNewInodes(ctx, std::move(pending));
 
     std::unordered_set<std::string> seen;
+    bool needs_docker = false;
     for (auto& se : all_sockets) {
         std::string proto_base = (se.proto == "tcp" || se.proto == "tcp6") ? "tcp" : "udp";
         std::string key = std::to_string(se.port) + ":" + proto_base;
@@ -194,9 +318,10 @@ std::vector<ListeningPort> collectListeningPorts(PortsPluginCtx* ctx) {
         lp.local_addr = se.local_addr;
 
         if (se.inode > 0) {
-            auto it = inode_map.find(se.inode);
-            if (it != inode_map.end()) {
-                lp.process = it->second;
+            auto it = ctx->inode_owners.find(se.inode);
+            if (it != ctx->inode_owners.end()) {
+                lp.pid = it->second.pid;
+                lp.process = it->second.process;
             }
         }
 
@@ -205,55 +330,25 @@ std::vector<ListeningPort> collectListeningPorts(PortsPluginCtx* ctx) {
         } else if (lp.process.empty() && se.uid == 0) {
             lp.process = "root";
         }
+        if (lp.process == "root" || lp.process == "docker-proxy") needs_docker = true;
 
         result.push_back(std::move(lp));
     }
 
-    // Attempt to resolve 'root' ports to docker containers
-    std::unordered_map<uint16_t, std::string> docker_ports;
-    FILE* pipe = popen("docker ps --format '{{.Names}}|{{.Ports}}' 2>/dev/null", "r");
-    if (pipe) {
-        char buf[256];
-        while (fgets(buf, sizeof(buf), pipe)) {
-            std::string line(buf);
-            size_t bar = line.find('|');
-            if (bar != std::string::npos) {
-                std::string name = line.substr(0, bar);
-                std::string ports = line.substr(bar + 1);
-                std::istringstream iss(ports);
-                std::string token;
-                while (std::getline(iss, token, ',')) {
-                    size_t arrow = token.find("->");
-                    if (arrow != std::string::npos) {
-                        size_t colon = token.rfind(':', arrow);
-                        if (colon != std::string::npos) {
-                            try {
-                                uint16_t dport = static_cast<uint16_t>(std::stoi(token.substr(colon + 1, arrow - colon - 1)));
-                                docker_ports[dport] = name;
-                            } catch (...) {}
-                        }
-                    }
-                }
-            }
-        }
-        pclose(pipe);
-    }
-
-    for (auto& lp : result) {
-        if (lp.process == "root" || lp.process.empty()) {
-            if (docker_ports.count(lp.port)) {
-                lp.process = docker_ports[lp.port];
-            }
+    /* Published container ports show up as root or docker-proxy; name them after the container. */
+    if (needs_docker) {
+        if (ctx->docker_socket.empty()) ctx->docker_socket = hmon::plugins::docker::dockerSocketPath();
+        auto docker_ports = hmon::plugins::docker::listPublishedPorts(ctx->docker_socket);
+        for (auto& lp : result) {
+            if (lp.process != "root" && lp.process != "docker-proxy") continue;
+            auto it = docker_ports.find(lp.port);
+            if (it != docker_ports.end()) lp.process = it->second;
         }
     }
 
     std::sort(result.begin(), result.end(),
               [](const ListeningPort& a, const ListeningPort& b) { return a.port < b.port; });
 
-    if (ctx) {
-        ctx->cached_result = result;
-        ctx->last_cache_time = std::chrono::steady_clock::now();
-    }
     return result;
 }
 
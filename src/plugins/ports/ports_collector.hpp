@@ -3,6 +3,7 @@
 #include <chrono>
 #include <cstdint>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace hmon::plugins::ports {
@@ -15,11 +16,24 @@ struct ListeningPort {
     std::string process;
 };
 
+/* Owner of a socket inode, kept for as long as the socket keeps listening. */
+struct InodeOwner {
+    int pid = -1;
+    std::string process;
+};
+
 struct PortsPluginCtx {
+    PortsPluginCtx() = default;
+    ~PortsPluginCtx();
+    PortsPluginCtx(const PortsPluginCtx&) = delete;
+    PortsPluginCtx& operator=(const PortsPluginCtx&) = delete;
+
     std::vector<ListeningPort> ports;
-    std::vector<ListeningPort> cached_result;
-    std::chrono::steady_clock::time_point last_cache_time;
-    static constexpr int TTL_SECONDS = 5;
+    int diag_fd = -1;           /* NETLINK_SOCK_DIAG socket, opened on first use */
+    bool diag_verified = false; /* at least one dump succeeded */
+    bool diag_broken = false;   /* kernel refused sock_diag; use /proc/net */
+    std::unordered_map<uint64_t, InodeOwner> inode_owners;
+    std::string docker_socket;
 };
 
 std::vector<ListeningPort> collectListeningPorts(PortsPluginCtx* ctx);
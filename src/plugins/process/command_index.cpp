@@ -0,0 +1,70 @@
+#include "command_index.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+namespace hmon::plugins::process {
+
+namespace {
+
+unsigned char fold(char c) {
+    return static_cast<unsigned char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+}
+
+template <typename Fn>
+void CommandIndex::forEachTrigram(std::string_view text, Fn fn) {
+    text = text.substr(0, kIndexedChars);
+    if (text.size() < 3) return;
+    /* A trigram repeated within one command is posted once. */
+    std::vector<uint32_t> seen;
+    seen.reserve(text.size() - 2);
+    for (size_t i = 0; i + 3 <= text.size(); ++i) {
+        seen.push_back(static_cast<uint32_t>(fold(text[i])) << 16 | static_cast<uint32_t>(fold(text[i + 1])) << 8 |
+                       fold(text[i + 2]));
+    }
+    std::sort(seen.begin(), seen.end());
+    seen.erase(std::unique(seen.begin(), seen.end()), seen.end());
+    for (uint32_t t : seen) fn(t);
+}
+
+void CommandIndex::add(int pid, std::string_view command) {
+    forEachTrigram(command, [&](uint32_t t) { postings_[t].push_back(pid); });
+}
+
+void CommandIndex::remove(int pid, std::string_view command) {
+    forEachTrigram(command, [&](uint32_t t) {
+        auto it = postings_.find(t);
+        if (it == postings_.end()) return;
+        auto& list = it->second;
+        auto pos = std::find(list.begin(), list.end(), pid);
+        if (pos != list.end()) {
+            *pos = list.back();
+            list.pop_back();
+        }
+        if (list.empty()) postings_.erase(it);
+    });
+}
+
+const std::vector<int>* CommandIndex::shortest(std::string_view needle) const {
+    const std::vector<int>* best = nullptr;
+    bool missing = false;
+    forEachTrigram(needle, [&](uint32_t t) {
+        auto it = postings_.find(t);
+        if (it == postings_.end()) {
+            missing = true;
+            return;
+        }
+        if (!best || it->second.size() < best->size()) best = &it->second;
+    });
+    return missing ? nullptr : best;
+}
+
+bool CommandIndex::contains(std::string_view command, std::string_view needle) {
+    command = command.substr(0, kIndexedChars);
+    return std::search(command.begin(), command.end(), needle.begin(), needle.end(),
+                       [](char a, char b) { return fold(a) == static_cast<unsigned char>(b); }) != command.end();
+}
+
+}
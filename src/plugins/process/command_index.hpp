@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace hmon::plugins::process {
+
+/*
+ * Case-insensitive trigram index over command lines, kept in step with the
+ * scanner: a PID is added once when its command line is read (after its
+ * name, since /proc/<pid>/comm is what the table shows) and removed when it
+ * exits or is recycled, so a search never touches /proc.  Only the first
+ * kIndexedChars of a command line are indexed and matched; that covers the
+ * program and its leading arguments without a long classpath swamping the
+ * posting lists.
+ */
+class CommandIndex {
+public:
+    static constexpr size_t kIndexedChars = 256;
+
+    void add(int pid, std::string_view command);
+    void remove(int pid, std::string_view command);
+
+    /*
+     * PIDs whose command contains `needle`, lower case and at least three
+     * characters long (shorter ones have no trigram to look up); `command`
+     * maps a PID to its command line for the final check.
+     */
+    template <typename CommandFn>
+    void find(std::string_view needle, CommandFn command, std::vector<int>* out) const {
+        const std::vector<int>* pool = shortest(needle);
+        if (!pool) return;
+        for (int pid : *pool) {
+            if (contains(command(pid), needle)) out->push_back(pid);
+        }
+    }
+
+    /* Case-insensitive substring test over the indexed prefix of `command`. */
+    static bool contains(std::string_view command, std::string_view needle);
+
+private:
+    /* The posting list of the filter's rarest trigram, or nullptr when one has none. */
+    const std::vector<int>* shortest(std::string_view needle) const;
+    template <typename Fn>
+    static void forEachTrigram(std::string_view text, Fn fn);
+
+    std::unordered_map<uint32_t, std::vector<int>> postings_;
+};
+
+}
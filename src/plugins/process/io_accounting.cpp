@@ -0,0 +1,388 @@
+#include "io_accounting.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/genetlink.h>
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <linux/taskstats.h>
+#include <linux/tcp.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "hmon/fs_root.hpp"
+
+namespace {
+
+using hmon::core::procRoot;
+
+/* Requests per sendmsg(); the replies (~450 bytes each) stay well inside the default receive buffer. */
+constexpr size_t kTaskstatsBatch = 128;
+constexpr uint8_t kTcpListen = 10;
+
+/* The kernel's taskstats and sockets describe this machine; a relocated procfs cannot be matched against them. */
+bool liveProc() { return procRoot() == "/proc"; }
+
+bool parsePid(const char* name, int* pid) {
+    if (*name < '0' || *name > '9') return false;
+    int v = 0;
+    for (const char* p = name; *p; ++p) {
+        if (*p < '0' || *p > '9') return false;
+        v = v * 10 + (*p - '0');
+    }
+    *pid = v;
+    return v > 0;
+}
+
+void setReceiveTimeout(int fd) {
+    struct timeval tv {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+/* Append one generic netlink request carrying a single attribute. */
+void appendGenlRequest(std::vector<char>& buf, uint16_t type, uint8_t cmd, uint16_t attr, const void* data,
+                       size_t len, uint32_t seq) {
+    const size_t attr_len = NLA_HDRLEN + len;
+    const size_t total = NLMSG_LENGTH(GENL_HDRLEN) + NLA_ALIGN(attr_len);
+    const size_t at = buf.size();
+    buf.resize(at + NLMSG_ALIGN(total), 0);
+    auto* nlh = reinterpret_cast<struct nlmsghdr*>(buf.data() + at);
+    nlh->nlmsg_len = static_cast<uint32_t>(total);
+    nlh->nlmsg_type = type;
+    nlh->nlmsg_flags = NLM_F_REQUEST;
+    nlh->nlmsg_seq = seq;
+    auto* genl = static_cast<struct genlmsghdr*>(NLMSG_DATA(nlh));
+    genl->cmd = cmd;
+    genl->version = 1;
+    auto* na = reinterpret_cast<struct nlattr*>(reinterpret_cast<char*>(genl) + GENL_HDRLEN);
+    na->nla_type = attr;
+    na->nla_len = static_cast<uint16_t>(attr_len);
+    std::memcpy(reinterpret_cast<char*>(na) + NLA_HDRLEN, data, len);
+}
+
+bool sendAll(int fd, const std::vector<char>& buf) {
+    struct sockaddr_nl kernel {};
+    kernel.nl_family = AF_NETLINK;
+    return sendto(fd, buf.data(), buf.size(), 0, reinterpret_cast<struct sockaddr*>(&kernel), sizeof(kernel)) ==
+           static_cast<ssize_t>(buf.size());
+}
+
+/* Calls f(type, payload, length) for each attribute in [data, data + len). */
+template <typename F>
+void forEachAttr(const char* data, size_t len, F&& f) {
+    while (len >= NLA_HDRLEN) {
+        struct nlattr na;
+        std::memcpy(&na, data, sizeof(na));
+        if (na.nla_len < NLA_HDRLEN || na.nla_len > len) return;
+        f(na.nla_type & NLA_TYPE_MASK, data + NLA_HDRLEN, static_cast<size_t>(na.nla_len - NLA_HDRLEN));
+        const size_t step = NLA_ALIGN(na.nla_len);
+        if (step >= len) return;
+        data += step;
+        len -= step;
+    }
+}
+
+void listThreads(int pid, std::vector<int>* tids) {
+    char path[PATH_MAX];
+    std::snprintf(path, sizeof(path), "%s/%d/task", procRoot().c_str(), pid);
+    DIR* dir = opendir(path);
+    if (!dir) return;
+    struct dirent* entry;
+    int tid = 0;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (parsePid(entry->d_name, &tid)) tids->push_back(tid);
+    }
+    closedir(dir);
+}
+
+uint64_t fieldAfter(const char* buf, const char* label) {
+    const char* p = std::strstr(buf, label);
+    return p ? std::strtoull(p + std::strlen(label), nullptr, 10) : 0;
+}
+
+/* /proc/<pid>/io: read by the owner or with CAP_SYS_PTRACE, summed over live and exited threads. */
+void readProcIo(int pid, hmon::plugins::process::IoSample* out) {
+    char path[PATH_MAX];
+    std::snprintf(path, sizeof(path), "%s/%d/io", procRoot().c_str(), pid);
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    char buf[512];
+    ssize_t n = ::read(fd, buf, sizeof(buf) - 1);
+    ::close(fd);
+    if (n <= 0) return;
+    buf[n] = '\0';
+    out->read_bytes = fieldAfter(buf, "\nread_bytes: ");
+    /* Anchored on the newline so cancelled_write_bytes does not match. */
+    out->write_bytes = fieldAfter(buf, "\nwrite_bytes: ");
+    out->valid = true;
+}
+
+}
+
+namespace hmon::plugins::process {
+
+IoAccounting::~IoAccounting() {
+    closeTaskstats();
+    if (diag_fd_ >= 0) ::close(diag_fd_);
+}
+
+void IoAccounting::closeTaskstats() {
+    if (taskstats_fd_ >= 0) ::close(taskstats_fd_);
+    taskstats_fd_ = -1;
+}
+
+/* Resolve the TASKSTATS family once and probe it with our own thread; a refusal means procfs from then on. */
+bool IoAccounting::openTaskstats() {
+    if (taskstats_attempted_) return taskstats_fd_ >= 0;
+    taskstats_attempted_ = true;
+    if (!liveProc()) return false;
+
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+    if (fd < 0) return false;
+    struct sockaddr_nl local {};
+    local.nl_family = AF_NETLINK;
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) != 0) {
+        ::close(fd);
+        return false;
+    }
+    setReceiveTimeout(fd);
+
+    std::vector<char> req;
+    const uint32_t seq = ++seq_;
+    appendGenlRequest(req, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, CTRL_ATTR_FAMILY_NAME, TASKSTATS_GENL_NAME,
+                      sizeof(TASKSTATS_GENL_NAME), seq);
+    alignas(struct nlmsghdr) char buf[8192];
+    ssize_t len = sendAll(fd, req) ? recv(fd, buf, sizeof(buf), 0) : -1;
+    int remaining = static_cast<int>(len);
+    for (auto* h = reinterpret_cast<struct nlmsghdr*>(buf); len > 0 && NLMSG_OK(h, remaining);
+         h = NLMSG_NEXT(h, remaining)) {
+        if (h->nlmsg_seq != seq || h->nlmsg_type != GENL_ID_CTRL) continue;
+        const char* attrs = static_cast<const char*>(NLMSG_DATA(h)) + GENL_HDRLEN;
+        forEachAttr(attrs, h->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN), [&](int type, const char* data, size_t n) {
+            if (type == CTRL_ATTR_FAMILY_ID && n >= sizeof(uint16_t)) std::memcpy(&taskstats_family_, data, sizeof(uint16_t));
+        });
+    }
+    if (taskstats_family_ == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    taskstats_fd_ = fd;
+    std::vector<IoSample> probe;
+    if (!queryThreads({static_cast<int>(gettid())}, &probe) || !probe[0].valid) {
+        closeTaskstats();
+        return false;
+    }
+    return true;
+}
+
+/*
+ * TASKSTATS_CMD_GET for every tid, kTaskstatsBatch requests per sendmsg().
+ * Each reply is matched to its request by sequence number; ESRCH (the thread
+ * exited) leaves that sample invalid.  Any other error fails the whole call.
+ */
+bool IoAccounting::queryThreads(const std::vector<int>& tids, std::vector<IoSample>* out) {
+    out->assign(tids.size(), IoSample{});
+    std::vector<char> req;
+    alignas(struct nlmsghdr) char buf[65536];
+    for (size_t first = 0; first < tids.size(); first += kTaskstatsBatch) {
+        const size_t count = std::min(kTaskstatsBatch, tids.size() - first);
+        const uint32_t base = seq_ + 1;
+        seq_ += static_cast<uint32_t>(count);
+        req.clear();
+        for (size_t i = 0; i < count; ++i) {
+            const uint32_t tid = static_cast<uint32_t>(tids[first + i]);
+            appendGenlRequest(req, taskstats_family_, TASKSTATS_CMD_GET, TASKSTATS_CMD_ATTR_PID, &tid, sizeof(tid),
+                              base + static_cast<uint32_t>(i));
+        }
+        if (!sendAll(taskstats_fd_, req)) return false;
+
+        size_t answered = 0;
+        while (answered < count) {
+            ssize_t len = recv(taskstats_fd_, buf, sizeof(buf), 0);
+            if (len < 0 && errno == EINTR) continue;
+            if (len <= 0) return false;
+            int remaining = static_cast<int>(len);
+            for (auto* h = reinterpret_cast<struct nlmsghdr*>(buf); NLMSG_OK(h, remaining); h = NLMSG_NEXT(h, remaining)) {
+                const uint32_t idx = h->nlmsg_seq - base;
+                if (h->nlmsg_seq < base || idx >= count) continue;
+                ++answered;
+                if (h->nlmsg_type == NLMSG_ERROR) {
+                    const auto* err = static_cast<const struct nlmsgerr*>(NLMSG_DATA(h));
+                    if (err->error != -ESRCH) return false;
+                    continue;
+                }
+                if (h->nlmsg_type != taskstats_family_) continue;
+                IoSample& sample = (*out)[first + idx];
+                const char* attrs = static_cast<const char*>(NLMSG_DATA(h)) + GENL_HDRLEN;
+                forEachAttr(attrs, h->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN), [&](int type, const char* data, size_t n) {
+                    if (type != TASKSTATS_TYPE_AGGR_PID) return;
+                    forEachAttr(data, n, [&](int inner, const char* stats, size_t size) {
+                        if (inner != TASKSTATS_TYPE_STATS) return;
+                        /* Newer kernels only append to struct taskstats; older ones may send a shorter one. */
+                        if (size < offsetof(struct taskstats, write_bytes) + sizeof(uint64_t)) return;
+                        std::memcpy(&sample.read_bytes, stats + offsetof(struct taskstats, read_bytes), sizeof(uint64_t));
+                        std::memcpy(&sample.write_bytes, stats + offsetof(struct taskstats, write_bytes), sizeof(uint64_t));
+                        sample.valid = true;
+                    });
+                });
+            }
+        }
+    }
+    return true;
+}
+
+void IoAccounting::sampleStorage(const std::vector<IoRequest>& pids, std::vector<IoSample>* out) {
+    out->assign(pids.size(), IoSample{});
+    if (pids.empty()) return;
+    if (openTaskstats()) {
+        std::vector<int> tids;
+        std::vector<size_t> owner;
+        tids.reserve(pids.size());
+        owner.reserve(pids.size());
+        for (size_t i = 0; i < pids.size(); ++i) {
+            const size_t before = tids.size();
+            if (pids[i].threads > 1) listThreads(pids[i].pid, &tids);
+            if (tids.size() == before) tids.push_back(pids[i].pid);
+            owner.resize(tids.size(), i);
+        }
+        std::vector<IoSample> threads;
+        if (queryThreads(tids, &threads)) {
+            size_t t = 0;
+            for (size_t i = 0; i < pids.size(); ++i) {
+                IoSample& sample = (*out)[i];
+                ThreadIo* carry = pids[i].carry;
+                std::unordered_map<int, IoSample> live;
+                for (; t < tids.size() && owner[t] == i; ++t) {
+                    if (!threads[t].valid) continue;
+                    sample.read_bytes += threads[t].read_bytes;
+                    sample.write_bytes += threads[t].write_bytes;
+                    sample.valid = true;
+                    if (carry) live.emplace(tids[t], threads[t]);
+                }
+                if (!carry || !sample.valid) continue;
+                for (const auto& [tid, prev] : carry->last) {
+                    if (live.count(tid)) continue;
+                    carry->exited_read += prev.read_bytes;
+                    carry->exited_write += prev.write_bytes;
+                }
+                carry->last = std::move(live);
+                sample.read_bytes += carry->exited_read;
+                sample.write_bytes += carry->exited_write;
+            }
+            return;
+        }
+        /* Lost the permission or the socket fell out of step; procfs from here on. */
+        closeTaskstats();
+        out->assign(pids.size(), IoSample{});
+    }
+    for (size_t i = 0; i < pids.size(); ++i) readProcIo(pids[i].pid, &(*out)[i]);
+}
+
+/* One inet_diag dump of every non-listening TCP socket with its tcp_info, into tcp_bytes_. */
+bool IoAccounting::dumpTcp(uint8_t family) {
+    struct {
+        struct nlmsghdr nlh;
+        struct inet_diag_req_v2 req;
+    } msg {};
+    const uint32_t seq = ++seq_;
+    msg.nlh.nlmsg_len = sizeof(msg);
+    msg.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    msg.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    msg.nlh.nlmsg_seq = seq;
+    msg.req.sdiag_family = family;
+    msg.req.sdiag_protocol = IPPROTO_TCP;
+    msg.req.idiag_ext = 1u << (INET_DIAG_INFO - 1);
+    msg.req.idiag_states = ~(1u << kTcpListen);
+
+    struct sockaddr_nl nladdr {};
+    nladdr.nl_family = AF_NETLINK;
+    if (sendto(diag_fd_, &msg, sizeof(msg), 0, reinterpret_cast<struct sockaddr*>(&nladdr), sizeof(nladdr)) < 0) {
+        return false;
+    }
+
+    alignas(struct nlmsghdr) char buf[32768];
+    while (true) {
+        ssize_t len = recv(diag_fd_, buf, sizeof(buf), 0);
+        if (len < 0 && errno == EINTR) continue;
+        if (len <= 0) return false;
+
+        int remaining = static_cast<int>(len);
+        for (auto* h = reinterpret_cast<struct nlmsghdr*>(buf); NLMSG_OK(h, remaining); h = NLMSG_NEXT(h, remaining)) {
+            if (h->nlmsg_seq != seq) continue;
+            if (h->nlmsg_type == NLMSG_DONE) return true;
+            if (h->nlmsg_type == NLMSG_ERROR) return false;
+            if (h->nlmsg_type != SOCK_DIAG_BY_FAMILY) continue;
+            if (h->nlmsg_len < NLMSG_LENGTH(sizeof(struct inet_diag_msg))) continue;
+
+            const auto* d = static_cast<const struct inet_diag_msg*>(NLMSG_DATA(h));
+            if (d->idiag_inode == 0) continue;      /* TIME_WAIT and orphans belong to no process */
+            int attr_len = static_cast<int>(h->nlmsg_len - NLMSG_LENGTH(sizeof(*d)));
+            for (auto* rta = reinterpret_cast<const struct rtattr*>(d + 1); RTA_OK(rta, attr_len);
+                 rta = RTA_NEXT(rta, attr_len)) {
+                if (rta->rta_type != INET_DIAG_INFO) continue;
+                if (RTA_PAYLOAD(rta) < offsetof(struct tcp_info, tcpi_bytes_received) + sizeof(uint64_t)) break;
+                const char* info = static_cast<const char*>(RTA_DATA(rta));
+                uint64_t acked = 0, received = 0;
+                std::memcpy(&acked, info + offsetof(struct tcp_info, tcpi_bytes_acked), sizeof(acked));
+                std::memcpy(&received, info + offsetof(struct tcp_info, tcpi_bytes_received), sizeof(received));
+                tcp_bytes_[d->idiag_inode] = acked + received;
+                break;
+            }
+        }
+    }
+}
+
+bool IoAccounting::sampleNet(const std::vector<int>& pids, std::vector<uint64_t>* out) {
+    if (diag_broken_ || !liveProc()) return false;
+    if (diag_fd_ < 0) {
+        diag_fd_ = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+        if (diag_fd_ < 0) {
+            diag_broken_ = true;
+            return false;
+        }
+        setReceiveTimeout(diag_fd_);
+    }
+    tcp_bytes_.clear();
+    if (!dumpTcp(AF_INET) || !dumpTcp(AF_INET6)) {
+        /* A half-read dump leaves the socket out of sync; start over next tick. */
+        ::close(diag_fd_);
+        diag_fd_ = -1;
+        return false;
+    }
+
+    out->assign(pids.size(), 0);
+    if (tcp_bytes_.empty()) return true;
+    for (size_t i = 0; i < pids.size(); ++i) {
+        char path[PATH_MAX];
+        std::snprintf(path, sizeof(path), "%s/%d/fd", procRoot().c_str(), pids[i]);
+        DIR* dir = opendir(path);
+        if (!dir) continue;
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (entry->d_type != DT_LNK) continue;
+            char target[64];
+            ssize_t len = readlinkat(dirfd(dir), entry->d_name, target, sizeof(target) - 1);
+            if (len <= 8) continue;
+            target[len] = '\0';
+            if (std::strncmp(target, "socket:[", 8) != 0) continue;
+            auto it = tcp_bytes_.find(std::strtoull(target + 8, nullptr, 10));
+            if (it != tcp_bytes_.end()) (*out)[i] += it->second;
+        }
+        closedir(dir);
+    }
+    return true;
+}
+
+}
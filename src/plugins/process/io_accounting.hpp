@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace hmon::plugins::process {
+
+/* One process's cumulative counters; `valid` is false when it could not be read. */
+struct IoSample {
+    uint64_t read_bytes = 0;
+    uint64_t write_bytes = 0;
+    bool valid = false;
+};
+
+/* Per-thread counters from the last taskstats read, and what threads that have since exited had done. */
+struct ThreadIo {
+    std::unordered_map<int, IoSample> last;
+    uint64_t exited_read = 0;
+    uint64_t exited_write = 0;
+};
+
+struct IoRequest {
+    int pid = 0;
+    int threads = 1;            /* from stat; only multi-threaded PIDs have their task list read */
+    ThreadIo* carry = nullptr;  /* kept by the caller for as long as the process lives */
+};
+
+/*
+ * Per-process storage I/O and TCP traffic, read on demand for a batch of
+ * PIDs once per tick.  Storage bytes come from taskstats over generic
+ * netlink: one TASKSTATS_CMD_GET per thread (the TGID form carries no I/O
+ * counters), packed many to a sendmsg().  Taskstats only sees live threads,
+ * so a thread's last counters are carried in the request's ThreadIo once it
+ * exits, keeping the process total from dropping.  Without CAP_NET_ADMIN it
+ * falls back to /proc/<pid>/io, which the kernel sums itself.  TCP bytes come from a single sock_diag dump
+ * (tcp_info bytes_acked + bytes_received per socket) matched against the
+ * PIDs' socket fds; UDP has no per-socket byte counters.
+ */
+class IoAccounting {
+public:
+    IoAccounting() = default;
+    ~IoAccounting();
+    IoAccounting(const IoAccounting&) = delete;
+    IoAccounting& operator=(const IoAccounting&) = delete;
+
+    void sampleStorage(const std::vector<IoRequest>& pids, std::vector<IoSample>* out);
+    /* Bytes through each PID's TCP sockets; false if the dump failed and `out` is untouched. */
+    bool sampleNet(const std::vector<int>& pids, std::vector<uint64_t>* out);
+
+    bool usingTaskstats() const { return taskstats_fd_ >= 0; }
+
+private:
+    bool openTaskstats();
+    void closeTaskstats();
+    bool queryThreads(const std::vector<int>& tids, std::vector<IoSample>* out);
+    bool dumpTcp(uint8_t family);
+
+    int taskstats_fd_ = -1;
+    uint16_t taskstats_family_ = 0;
+    bool taskstats_attempted_ = false;
+    uint32_t seq_ = 0;
+
+    int diag_fd_ = -1;
+    bool diag_broken_ = false;
+    std::unordered_map<uint64_t, uint64_t> tcp_bytes_;     /* socket inode -> bytes both ways */
+};
+
+}
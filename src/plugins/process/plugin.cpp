@@ -1,5 +1,9 @@
+#include <cctype>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <limits>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -8,75 +12,175 @@
 #include "process_collector.hpp"
 
 
+static hmon::plugins::process::ProcessPluginCtx* g_process_ctx = nullptr;
+
+static void process_plugin_control(const char* key, int value);
+static void process_plugin_control_str(const char* key, const char* value);
+
+static constexpr double kNull = std::numeric_limits<double>::quiet_NaN();
+
+/* A new filter is applied to a scan up to this old; typing should not cost a /proc walk per key. */
+constexpr auto kRefilterAge = std::chrono::seconds(1);
+
 static int process_plugin_init(hmon_plugin_ctx** out) {
     if (!out) return -1;
     auto* ctx = new (std::nothrow) hmon::plugins::process::ProcessPluginCtx();
     if (!ctx) return -1;
+    g_process_ctx = ctx;
     *out = reinterpret_cast<hmon_plugin_ctx*>(ctx);
     return 0;
 }
 
-static void appendMetric(hmon_metric_list* list, const char* key, int type, const void* value) {
-    if (list->count >= list->capacity) {
-        size_t new_cap = list->capacity == 0 ? 64 : list->capacity * 2;
-        auto* new_items = static_cast<hmon_metric*>(std::realloc(list->items, new_cap * sizeof(hmon_metric)));
-        if (!new_items) return;
-        list->items = new_items;
-        list->capacity = new_cap;
-    }
-    auto* item = &list->items[list->count];
-    item->key = key;
-    item->value.type = type;
-    switch (type) {
-    case HMON_VAL_STRING: item->value.v.str = strdup(static_cast<const char*>(value) ? static_cast<const char*>(value) : ""); break;
-    case HMON_VAL_INT64: item->value.v.i64 = *static_cast<const int64_t*>(value); break;
-    case HMON_VAL_DOUBLE: item->value.v.f64 = *static_cast<const double*>(value); break;
-    case HMON_VAL_BOOL: item->value.v.b = *static_cast<const int32_t*>(value); break;
-    }
-    ++list->count;
-}
+/* One row per process; kColumnCount keeps the enum and the schema in step. */
+static const hmon_table_column kColumns[] = {
+    {"pid", HMON_VAL_INT64},
+    {"cpu_pct", HMON_VAL_DOUBLE},
+    {"mem_pct", HMON_VAL_DOUBLE},
+    {"gpu_pct", HMON_VAL_DOUBLE},
+    {"io_read_bps", HMON_VAL_DOUBLE},
+    {"io_write_bps", HMON_VAL_DOUBLE},
+    {"net_bps", HMON_VAL_DOUBLE},
+    {"io_delay_pct", HMON_VAL_DOUBLE},
+    {"numa_node", HMON_VAL_INT64},
+    {"numa_local_pct", HMON_VAL_DOUBLE},
+    {"command", HMON_VAL_STRING},
+};
+enum : uint32_t {
+    kColPid,
+    kColCpuPct,
+    kColMemPct,
+    kColGpuPct,
+    kColIoReadBps,
+    kColIoWriteBps,
+    kColNetBps,
+    kColIoDelayPct,
+    kColNumaNode,
+    kColNumaLocalPct,
+    kColCommand,
+    kColumnCount
+};
 
-static int process_plugin_collect(hmon_plugin_ctx* ctx, hmon_metric_list* out_list) {
-    if (!ctx || !out_list) return -1;
+/* One row per group while process.group is set. */
+static const hmon_table_column kGroupColumns[] = {
+    {"group", HMON_VAL_INT64},
+    {"procs", HMON_VAL_INT64},
+    {"cpu_pct", HMON_VAL_DOUBLE},
+    {"mem_pct", HMON_VAL_DOUBLE},
+    {"gpu_pct", HMON_VAL_DOUBLE},
+    {"io_read_bps", HMON_VAL_DOUBLE},
+    {"io_write_bps", HMON_VAL_DOUBLE},
+    {"net_bps", HMON_VAL_DOUBLE},
+    {"name", HMON_VAL_STRING},
+};
+enum : uint32_t {
+    kColGroupId,
+    kColGroupProcs,
+    kColGroupCpuPct,
+    kColGroupMemPct,
+    kColGroupGpuPct,
+    kColGroupIoReadBps,
+    kColGroupIoWriteBps,
+    kColGroupNetBps,
+    kColGroupName,
+    kGroupColumnCount
+};
+
+static int process_plugin_collect(hmon_plugin_ctx* ctx, hmon_metric_list* out_list, hmon_arena* arena) {
+    if (!ctx || !out_list || !arena) return -1;
     auto* c = reinterpret_cast<hmon::plugins::process::ProcessPluginCtx*>(ctx);
-    auto procs = hmon::plugins::process::collectTopProcesses(c, 20, c->sort_mode, c->lock_pid);
-    for (size_t i = 0; i < procs.size(); ++i) {
+    const auto group_mode = c->group_mode.load();
+    const uint64_t filter_version = c->filter_version.load();
+    std::string filter;
+    {
+        std::lock_guard<std::mutex> lock(c->filter_mutex);
+        filter = c->filter;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    const bool rescan = filter_version == c->applied_filter_version || now - c->last_scan >= kRefilterAge;
+    c->applied_filter_version = filter_version;
+    if (rescan) c->last_scan = now;
+    std::vector<hmon::plugins::process::GroupEntry> groups;
+    auto procs = hmon::plugins::process::collectTopProcesses(c, c->limit.load(), c->sort_mode.load(), c->lock_pid.load(),
+                                                             group_mode, c->group_filter.load(), filter, rescan,
+                                                             &groups);
+    auto* table = hmon_metric_append_table(out_list, arena, HMON_METRIC_PROC_TABLE, kColumns, kColumnCount, static_cast<uint32_t>(procs.size()));
+    if (!table) return 0;
+    for (uint32_t i = 0; i < table->row_count; ++i) {
         const auto& p = procs[i];
-        char key[128];
-        std::snprintf(key, sizeof(key), "proc.%zu.pid", i);
-        int64_t pid = p.pid;
-        appendMetric(out_list, strdup(key), HMON_VAL_INT64, &pid);
-        std::snprintf(key, sizeof(key), "proc.%zu.cpu_pct", i);
-        double cpu = p.cpu_percent;
-        appendMetric(out_list, strdup(key), HMON_VAL_DOUBLE, &cpu);
-        std::snprintf(key, sizeof(key), "proc.%zu.mem_pct", i);
-        double mem = p.mem_percent;
-        appendMetric(out_list, strdup(key), HMON_VAL_DOUBLE, &mem);
-        std::snprintf(key, sizeof(key), "proc.%zu.gpu_pct", i);
-        double gpu = p.gpu_percent;
-        appendMetric(out_list, strdup(key), HMON_VAL_DOUBLE, &gpu);
-        std::snprintf(key, sizeof(key), "proc.%zu.command", i);
-        appendMetric(out_list, strdup(key), HMON_VAL_STRING, p.command.c_str());
+        auto* row = hmon_table_row(table, i);
+        row[kColPid].i64 = p.pid;
+        row[kColCpuPct].f64 = p.cpu_percent;
+        row[kColMemPct].f64 = p.mem_percent;
+        row[kColGpuPct].f64 = p.gpu_percent;
+        row[kColIoReadBps].f64 = p.io_read_bps;
+        row[kColIoWriteBps].f64 = p.io_write_bps;
+        row[kColNetBps].f64 = p.net_bps;
+        row[kColIoDelayPct].f64 = p.io_delay_pct;
+        row[kColNumaNode].i64 = p.numa_node >= 0 ? p.numa_node : HMON_TABLE_NULL_I64;
+        row[kColNumaLocalPct].f64 = p.numa_node >= 0 ? p.numa_local_pct : kNull;
+        hmon_table_set_str(arena, table, i, kColCommand, p.command.c_str());
+    }
+    if (!filter.empty()) {
+        const auto matches = static_cast<int64_t>(c->filter_matches);
+        hmon_metric_append(out_list, arena, HMON_METRIC_PROC_MATCHES, HMON_VAL_INT64, &matches);
+    }
+    if (group_mode != hmon::plugins::process::GroupMode::kNone) {
+        auto* group_table = hmon_metric_append_table(out_list, arena, HMON_METRIC_PROC_GROUPS_TABLE, kGroupColumns,
+                                                     kGroupColumnCount, static_cast<uint32_t>(groups.size()));
+        for (uint32_t i = 0; group_table && i < group_table->row_count; ++i) {
+            const auto& g = groups[i];
+            auto* row = hmon_table_row(group_table, i);
+            row[kColGroupId].i64 = g.id;
+            row[kColGroupProcs].i64 = g.procs;
+            row[kColGroupCpuPct].f64 = g.cpu_percent;
+            row[kColGroupMemPct].f64 = g.mem_percent;
+            row[kColGroupGpuPct].f64 = g.gpu_percent;
+            row[kColGroupIoReadBps].f64 = g.io_read_bps;
+            row[kColGroupIoWriteBps].f64 = g.io_write_bps;
+            row[kColGroupNetBps].f64 = g.net_bps;
+            hmon_table_set_str(arena, group_table, i, kColGroupName, g.name.c_str());
+        }
     }
     return 0;
 }
 
 static void process_plugin_destroy(hmon_plugin_ctx* ctx) {
     if (!ctx) return;
+    g_process_ctx = nullptr;
     delete reinterpret_cast<hmon::plugins::process::ProcessPluginCtx*>(ctx);
 }
 
-static void process_plugin_free_list(hmon_metric_list* list) {
-    if (!list) return;
-    for (size_t i = 0; i < list->count; ++i) {
-        if (list->items[i].value.type == HMON_VAL_STRING && list->items[i].value.v.str)
-            free(const_cast<char*>(list->items[i].value.v.str));
-        free(const_cast<char*>(list->items[i].key));
+static void process_plugin_control(const char* key, int value) {
+    if (!g_process_ctx || !key) return;
+    std::string k(key);
+    if (k == "process.limit") {
+        if (value > 0) g_process_ctx->limit = static_cast<size_t>(value);
+    } else if (k == "process.sort") {
+        if (value >= 0 && value <= static_cast<int>(hmon::plugins::process::SortMode::kNet)) {
+            g_process_ctx->sort_mode = static_cast<hmon::plugins::process::SortMode>(value);
+        }
+    } else if (k == "process.lock_pid") {
+        g_process_ctx->lock_pid = value > 0 ? value : -1;
+    } else if (k == "process.group") {
+        if (value >= 0 && value <= static_cast<int>(hmon::plugins::process::GroupMode::kTree)) {
+            g_process_ctx->group_mode = static_cast<hmon::plugins::process::GroupMode>(value);
+        }
+    } else if (k == "process.group_filter") {
+        g_process_ctx->group_filter = value > 0 ? value : -1;
+    }
+}
+
+static void process_plugin_control_str(const char* key, const char* value) {
+    if (!g_process_ctx || !key || !value || std::strcmp(key, "process.filter") != 0) return;
+    std::string filter(value);
+    for (char& ch : filter) ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    {
+        std::lock_guard<std::mutex> lock(g_process_ctx->filter_mutex);
+        if (g_process_ctx->filter == filter) return;
+        g_process_ctx->filter = std::move(filter);
     }
-    free(list->items);
-    list->items = nullptr;
-    list->count = 0;
-    list->capacity = 0;
+    ++g_process_ctx->filter_version;
 }
 
-HMON_STATIC_PLUGIN("process", process_plugin_init, process_plugin_collect, process_plugin_destroy, process_plugin_free_list, nullptr)
+HMON_STATIC_PLUGIN_FULL("process", process_plugin_init, process_plugin_collect, process_plugin_destroy,
+                        process_plugin_control, 1000, nullptr, process_plugin_control_str)
@@ -1,18 +1,27 @@
 #include "process_collector.hpp"
 
 #include <algorithm>
+#include <cctype>
 #include <cerrno>
+#include <climits>
 #include <cstring>
 #include <dirent.h>
+#include <fcntl.h>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <sys/resource.h>
 #include <unistd.h>
 #include <unordered_map>
 #include <vector>
 
+#include "hmon/fs_root.hpp"
+#include "hmon/numa.hpp"
+
 namespace {
 
+using hmon::core::procRoot;
+
 static long getPageSize() {
     return sysconf(_SC_PAGESIZE);
 }
@@ -22,7 +31,7 @@ static long getClockTicks() {
 }
 
 static long readTotalMemKb() {
-    std::ifstream f("/proc/meminfo");
+    std::ifstream f(procRoot() + "/meminfo");
     if (!f) return 0;
     std::string line;
     while (std::getline(f, line)) {
@@ -43,27 +52,29 @@ static bool isPidDir(const char* name) {
     return true;
 }
 
-static std::string readCmdline(int pid) {
-    char path[64];
-    std::snprintf(path, sizeof(path), "/proc/%d/comm", pid);
-    std::ifstream comm(path);
-    if (comm) {
-        std::string line;
-        std::getline(comm, line);
-        if (!line.empty()) return line;
-    }
-
-    std::snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
-    std::ifstream f(path, std::ios::binary);
-    if (!f) return "";
 
-    std::string cmdline;
+static std::string readProcFile(int pid, const char* name) {
+    char path[PATH_MAX];
+    std::snprintf(path, sizeof(path), "%s/%d/%s", procRoot().c_str(), pid, name);
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return "";
+    std::string out;
     char buf[512];
-    while (f.read(buf, sizeof(buf))) {
-        cmdline.append(buf, static_cast<size_t>(f.gcount()));
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0) {
+        out.append(buf, static_cast<size_t>(n));
+        if (out.size() >= 4096) break;
     }
-    cmdline.append(buf, static_cast<size_t>(f.gcount()));
+    ::close(fd);
+    return out;
+}
+
+static std::string readCmdline(int pid) {
+    std::string line = readProcFile(pid, "comm");
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+    if (!line.empty()) return line;
 
+    std::string cmdline = readProcFile(pid, "cmdline");
     if (cmdline.empty()) return "";
 
     for (char& c : cmdline) {
@@ -79,6 +90,24 @@ static std::string readCmdline(int pid) {
     return cmdline;
 }
 
+/* What the filter searches: the name, then the full command line, cut to what the index covers. */
+static std::string readSearchText(int pid, const std::string& name) {
+    std::string text = name;
+    std::string cmdline = readProcFile(pid, "cmdline");
+    for (char& c : cmdline) {
+        if (c == '\0') c = ' ';
+    }
+    while (!cmdline.empty() && cmdline.back() == ' ') cmdline.pop_back();
+    if (!cmdline.empty()) {
+        text.push_back(' ');
+        text += cmdline;
+    }
+    if (text.size() > hmon::plugins::process::CommandIndex::kIndexedChars) {
+        text.resize(hmon::plugins::process::CommandIndex::kIndexedChars);
+    }
+    return text;
+}
+
 static std::string trim(const std::string& s) {
     const auto start = s.find_first_not_of(" \t\r\n");
     if (start == std::string::npos) return "";
@@ -99,7 +128,9 @@ static std::string runCommand(const char* cmd) {
     return result;
 }
 
-static std::unordered_map<int, double> readGpuUsageByPid() {
+static std::unordered_map<int, double> readGpuUsageByPid(hmon::plugins::process::ProcessPluginCtx* ctx) {
+    if (ctx->nvml.open()) return ctx->nvml.sampleProcessUtilization();
+
     std::unordered_map<int, double> usage_by_pid;
     const std::string output = runCommand("nvidia-smi pmon -c 1 2>/dev/null");
     if (output.empty()) return usage_by_pid;
@@ -131,206 +162,718 @@ static std::unordered_map<int, double> readGpuUsageByPid() {
     }
     return usage_by_pid;
 }
-
-struct ProcInfo {
-    int pid;
-    uint64_t utime;
-    uint64_t stime;
-    uint64_t rss_pages;
-    std::string command;
+/* Fields of /proc/<pid>/stat after the ")" that closes comm; numbering follows proc(5). */
+struct StatFields {
+    int ppid = 0;
+    uint64_t utime = 0;
+    uint64_t stime = 0;
+    int num_threads = 1;
+    unsigned long long starttime = 0;
+    long rss = 0;
+    uint64_t blkio_ticks = 0;
 };
 
-static std::vector<ProcInfo> readAllProcesses() {
-    std::vector<ProcInfo> result;
-    DIR* dir = opendir("/proc");
-    if (!dir) return result;
+static const char* skipField(const char* p, const char* end) {
+    while (p < end && *p != ' ') ++p;
+    while (p < end && *p == ' ') ++p;
+    return p;
+}
+
+static const char* parseUnsigned(const char* p, const char* end, unsigned long long& out) {
+    unsigned long long v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + static_cast<unsigned long long>(*p - '0');
+        ++p;
+    }
+    out = v;
+    while (p < end && *p == ' ') ++p;
+    return p;
+}
+
+static bool parseStat(const char* buf, size_t len, StatFields& out) {
+    const char* end = buf + len;
+    const char* rp = static_cast<const char*>(memrchr(buf, ')', len));
+    if (!rp || rp + 2 >= end) return false;
+    const char* p = rp + 2;
+
+    /* p is at field 3 (state); ppid is 4, utime 14, stime 15, num_threads 20, starttime 22, rss 24,
+     * delayacct_blkio_ticks 42. */
+    unsigned long long v = 0;
+    p = skipField(p, end);
+    p = parseUnsigned(p, end, v);
+    out.ppid = static_cast<int>(v);
+    for (int field = 5; field < 14; ++field) p = skipField(p, end);
+    p = parseUnsigned(p, end, v);
+    out.utime = v;
+    p = parseUnsigned(p, end, v);
+    out.stime = v;
+    for (int field = 16; field < 20; ++field) p = skipField(p, end);
+    p = parseUnsigned(p, end, v);
+    out.num_threads = v > 0 ? static_cast<int>(v) : 1;
+    p = skipField(p, end);
+    p = parseUnsigned(p, end, v);
+    out.starttime = v;
+    p = skipField(p, end);
+    if (p < end && *p == '-') {
+        out.rss = 0;
+        p = skipField(p, end);
+    } else {
+        p = parseUnsigned(p, end, v);
+        out.rss = static_cast<long>(v);
+    }
+    for (int field = 25; field < 42; ++field) p = skipField(p, end);
+    parseUnsigned(p, end, v);
+    out.blkio_ticks = v;
+    return true;
+}
+
+/* Re-read one PID's stat; returns false once the process is gone. */
+static bool sampleStat(hmon::plugins::process::ProcessPluginCtx* ctx, int pid,
+                       hmon::plugins::process::PidEntry& e, StatFields& out) {
+    char buf[2048];
+    ssize_t n = -1;
+    if (e.stat_fd >= 0) {
+        n = ::pread(e.stat_fd, buf, sizeof(buf), 0);
+    } else {
+        char path[PATH_MAX];
+        std::snprintf(path, sizeof(path), "%s/%d/stat", procRoot().c_str(), pid);
+        int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        n = ::pread(fd, buf, sizeof(buf), 0);
+        if (n > 0 && ctx->cached_fds < ctx->max_cached_fds) {
+            e.stat_fd = fd;
+            ++ctx->cached_fds;
+        } else {
+            ::close(fd);
+        }
+    }
+    if (n <= 0) return false;
+    return parseStat(buf, static_cast<size_t>(n), out);
+}
+
+/* Take the PID out of its group, dropping the group with its last member. */
+static void leaveGroup(hmon::plugins::process::ProcessPluginCtx* ctx, hmon::plugins::process::PidEntry& e) {
+    if (e.group < 0) return;
+    auto it = ctx->groups.find(e.group);
+    e.group = -1;
+    if (it == ctx->groups.end() || --it->second.members > 0) return;
+    ctx->group_ids.erase(it->second.key);
+    ctx->groups.erase(it);
+}
+
+static void unindexCommand(hmon::plugins::process::ProcessPluginCtx* ctx, int pid,
+                           hmon::plugins::process::PidEntry& e) {
+    if (!e.indexed) return;
+    ctx->commands.remove(pid, e.search);
+    e.search.clear();
+    e.indexed = false;
+}
+
+static void closeEntry(hmon::plugins::process::ProcessPluginCtx* ctx, hmon::plugins::process::PidEntry& e) {
+    leaveGroup(ctx, e);
+    if (e.stat_fd < 0) return;
+    ::close(e.stat_fd);
+    e.stat_fd = -1;
+    --ctx->cached_fds;
+}
+
+/* The unified hierarchy's path ("0::/system.slice/nginx.service"), else the v1 systemd or first controller's. */
+static std::string readCgroupPath(int pid) {
+    const std::string text = readProcFile(pid, "cgroup");
+    std::string fallback;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) end = text.size();
+        const std::string line = text.substr(pos, end - pos);
+        pos = end + 1;
+        const size_t first = line.find(':');
+        const size_t second = first == std::string::npos ? std::string::npos : line.find(':', first + 1);
+        if (second == std::string::npos) continue;
+        std::string path = line.substr(second + 1);
+        if (line.compare(0, 3, "0::") == 0) return path;
+        if (line.compare(first + 1, second - first - 1, "name=systemd") == 0 || fallback.empty()) {
+            fallback = std::move(path);
+        }
+    }
+    return fallback;
+}
+
+/* The first 64-hex run in a cgroup path: docker-<id>.scope, /docker/<id>, cri-containerd-<id>.scope, libpod-<id>. */
+static std::string containerId(const std::string& path) {
+    size_t run = 0;
+    for (size_t i = 0; i < path.size(); ++i) {
+        const char c = path[i];
+        const bool hex = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+        run = hex ? run + 1 : 0;
+        if (run == 64 && (i + 1 == path.size() || !std::isxdigit(static_cast<unsigned char>(path[i + 1])))) {
+            return path.substr(i + 1 - 64, 64);
+        }
+    }
+    return "";
+}
+
+/* The innermost service or scope the cgroup path names, e.g. "nginx.service" or "session-3.scope". */
+static std::string systemdUnit(const std::string& path) {
+    size_t end = path.size();
+    while (end > 0) {
+        const size_t slash = path.rfind('/', end - 1);
+        const size_t start = slash == std::string::npos ? 0 : slash + 1;
+        const std::string part = path.substr(start, end - start);
+        auto endsWith = [&part](const char* suffix) {
+            const size_t n = std::strlen(suffix);
+            return part.size() > n && part.compare(part.size() - n, n, suffix) == 0;
+        };
+        if (endsWith(".service") || endsWith(".scope")) return part;
+        if (slash == std::string::npos) break;
+        end = slash;
+    }
+    return "";
+}
+
+static void joinGroup(hmon::plugins::process::ProcessPluginCtx* ctx, hmon::plugins::process::PidEntry& e,
+                      const std::string& key, const std::string& name) {
+    auto [it, inserted] = ctx->group_ids.emplace(key, 0);
+    if (inserted) {
+        it->second = ctx->next_group_id++;
+        auto& g = ctx->groups[it->second];
+        g.key = key;
+        g.name = name;
+    }
+    e.group = it->second;
+    ++ctx->groups[e.group].members;
+}
+
+/*
+ * Place one PID for `mode`.  In tree mode a process joins the tree of the
+ * ancestor just below PID 1 (or the nearest ancestor hmon cannot see), so
+ * its parent is placed first; the depth cap only guards against a ppid loop
+ * in a torn read.
+ */
+static void placePid(hmon::plugins::process::ProcessPluginCtx* ctx, int pid, hmon::plugins::process::PidEntry& e,
+                     hmon::plugins::process::GroupMode mode, int depth = 0) {
+    using hmon::plugins::process::GroupMode;
+    if (e.group >= 0 || e.hidden) return;
+    if (mode == GroupMode::kTree) {
+        auto parent = e.ppid > 1 && depth < 64 ? ctx->pids.find(e.ppid) : ctx->pids.end();
+        if (parent != ctx->pids.end() && !parent->second.hidden) {
+            placePid(ctx, parent->first, parent->second, mode, depth + 1);
+            if (parent->second.group >= 0) {
+                e.group = parent->second.group;
+                ++ctx->groups[e.group].members;
+                return;
+            }
+        }
+        joinGroup(ctx, e, "tree:" + std::to_string(pid) + ":" + std::to_string(e.starttime),
+                  e.command + " (" + std::to_string(pid) + ")");
+        return;
+    }
+    const std::string path = readCgroupPath(pid);
+    if (mode == GroupMode::kCgroup) {
+        joinGroup(ctx, e, "cg:" + path, path.empty() ? "?" : path);
+    } else if (mode == GroupMode::kContainer) {
+        const std::string id = containerId(path);
+        if (id.empty()) joinGroup(ctx, e, "host", "host");
+        else joinGroup(ctx, e, "ctr:" + id, "container " + id.substr(0, 12));
+    } else {
+        const std::string unit = systemdUnit(path);
+        joinGroup(ctx, e, "unit:" + unit, unit.empty() ? "no unit" : unit);
+    }
+}
+
+/* Bring the group index up to `mode`: placing only PIDs new since the last tick unless the mode changed. */
+static void updateGroups(hmon::plugins::process::ProcessPluginCtx* ctx, hmon::plugins::process::GroupMode mode) {
+    if (mode != ctx->indexed_mode) {
+        for (auto& [pid, e] : ctx->pids) e.group = -1;
+        ctx->groups.clear();
+        ctx->group_ids.clear();
+        ctx->indexed_mode = mode;
+    }
+    if (mode == hmon::plugins::process::GroupMode::kNone) return;
+    for (auto& [pid, e] : ctx->pids) placePid(ctx, pid, e, mode);
+}
+
+/*
+ * One pass over /proc: known PIDs are re-read through their cached fd, new
+ * PIDs get an entry, and entries not seen this pass are dropped so their fds
+ * and previous CPU times do not outlive the process.
+ */
+static void scanProcesses(hmon::plugins::process::ProcessPluginCtx* ctx) {
+    DIR* dir = opendir(procRoot().c_str());
+    if (!dir) return;
+    const uint32_t scan = ++ctx->scan;
 
     struct dirent* entry;
     while ((entry = readdir(dir)) != nullptr) {
         if (!isPidDir(entry->d_name)) continue;
 
         int pid = 0;
-        try { pid = std::stoi(entry->d_name); } catch (...) { continue; }
+        for (const char* c = entry->d_name; *c; ++c) pid = pid * 10 + (*c - '0');
         if (pid <= 0) continue;
 
-        char stat_path[64];
-        std::snprintf(stat_path, sizeof(stat_path), "/proc/%d/stat", pid);
-        std::ifstream sf(stat_path);
-        if (!sf) continue;
-        std::string stat_line;
-        if (!std::getline(sf, stat_line)) continue;
-        sf.close();
-
-        size_t rp = stat_line.rfind(')');
-        if (rp == std::string::npos || rp + 2 >= stat_line.size()) continue;
-
-        std::istringstream iss(stat_line.substr(rp + 2));
-        char state;
-        int ppid, pgrp, session, tty_nr, tpgid;
-        unsigned int flags;
-        unsigned long minflt, cminflt, majflt, cmajflt;
-        uint64_t utime = 0, stime = 0;
-        long cutime, cstime, priority, nice, num_threads, itrealvalue;
-        unsigned long long starttime;
-        unsigned long long vsize = 0;
-        long rss = 0;
-        iss >> state >> ppid >> pgrp >> session >> tty_nr >> tpgid
-            >> flags >> minflt >> cminflt >> majflt >> cmajflt
-            >> utime >> stime >> cutime >> cstime >> priority >> nice
-            >> num_threads >> itrealvalue >> starttime >> vsize >> rss;
-
-        if (rss <= 0) continue;
-
-        std::string cmd = readCmdline(pid);
-        if (cmd.empty() || cmd[0] == '[') continue;
-
-        ProcInfo pi;
-        pi.pid = pid;
-        pi.utime = utime;
-        pi.stime = stime;
-        pi.rss_pages = static_cast<uint64_t>(rss);
-        pi.command = std::move(cmd);
-        result.push_back(std::move(pi));
+        auto& e = ctx->pids[pid];
+        StatFields st;
+        if (!sampleStat(ctx, pid, e, st)) {
+            unindexCommand(ctx, pid, e);
+            closeEntry(ctx, e);
+            ctx->pids.erase(pid);
+            continue;
+        }
+
+        if (e.seen_scan != 0 && e.starttime == st.starttime) {
+            e.prev_utime = e.utime;
+            e.prev_stime = e.stime;
+            e.prev_blkio_ticks = e.blkio_ticks;
+            e.has_prev = true;
+        } else {
+            leaveGroup(ctx, e);
+            unindexCommand(ctx, pid, e);
+            e.starttime = st.starttime;
+            e.command = readCmdline(pid);
+            e.hidden = e.command.empty() || e.command[0] == '[';
+            if (!e.hidden) {
+                e.search = readSearchText(pid, e.command);
+                ctx->commands.add(pid, e.search);
+                e.indexed = true;
+            }
+            e.has_prev = false;
+            e.io_valid = false;
+            e.thread_io = {};
+            e.net_valid = false;
+            e.numa_node = -1;
+            e.numa_read = {};
+        }
+        e.utime = st.utime;
+        e.stime = st.stime;
+        e.blkio_ticks = st.blkio_ticks;
+        e.num_threads = st.num_threads;
+        e.ppid = st.ppid;
+        e.rss_pages = st.rss > 0 ? static_cast<uint64_t>(st.rss) : 0;
+        e.seen_scan = scan;
     }
     closedir(dir);
-    return result;
+
+    for (auto it = ctx->pids.begin(); it != ctx->pids.end();) {
+        if (it->second.seen_scan != scan) {
+            unindexCommand(ctx, it->first, it->second);
+            closeEntry(ctx, it->second);
+            it = ctx->pids.erase(it);
+        } else {
+            ++it;
+        }
+    }
 }
 
+using IoBatch = std::vector<std::pair<int, hmon::plugins::process::PidEntry*>>;
+
+static double counterRate(uint64_t now, uint64_t prev, double elapsed_s) {
+    return elapsed_s > 0 && now >= prev ? static_cast<double>(now - prev) / elapsed_s : 0.0;
 }
 
-namespace hmon::plugins::process {
+/*
+ * Bring the storage and/or TCP counters of `batch` up to the current scan,
+ * in one batched read each, and derive rates.  A rate needs the previous
+ * scan's counters as well, so a PID read for the first time (or after a gap)
+ * shows 0 until the next tick.  Entries already read this scan are skipped.
+ */
+static void sampleIo(hmon::plugins::process::ProcessPluginCtx* ctx, const IoBatch& batch, bool storage, bool net,
+                     double elapsed_s) {
+    const uint32_t scan = ctx->scan;
+    if (storage) {
+        std::vector<hmon::plugins::process::IoRequest> requests;
+        std::vector<hmon::plugins::process::PidEntry*> owners;
+        for (const auto& [pid, e] : batch) {
+            if (e->io_scan == scan) continue;
+            requests.push_back({pid, e->num_threads, &e->thread_io});
+            owners.push_back(e);
+        }
+        std::vector<hmon::plugins::process::IoSample> samples;
+        ctx->io.sampleStorage(requests, &samples);
+        for (size_t i = 0; i < owners.size(); ++i) {
+            auto* e = owners[i];
+            const auto& s = samples[i];
+            const bool baseline = e->io_valid && e->io_scan + 1 == scan;
+            e->io_read_bps = s.valid && baseline ? counterRate(s.read_bytes, e->io_read, elapsed_s) : 0.0;
+            e->io_write_bps = s.valid && baseline ? counterRate(s.write_bytes, e->io_write, elapsed_s) : 0.0;
+            e->io_read = s.read_bytes;
+            e->io_write = s.write_bytes;
+            e->io_valid = s.valid;
+            e->io_scan = scan;
+        }
+    }
+    if (net) {
+        std::vector<int> pids;
+        std::vector<hmon::plugins::process::PidEntry*> owners;
+        for (const auto& [pid, e] : batch) {
+            if (e->net_scan == scan) continue;
+            pids.push_back(pid);
+            owners.push_back(e);
+        }
+        std::vector<uint64_t> bytes;
+        const bool ok = !pids.empty() && ctx->io.sampleNet(pids, &bytes);
+        for (size_t i = 0; i < owners.size(); ++i) {
+            auto* e = owners[i];
+            const bool baseline = e->net_valid && e->net_scan + 1 == scan;
+            /* A closed socket takes its bytes with it; counterRate reads that drop as 0. */
+            e->net_bps = ok && baseline ? counterRate(bytes[i], e->net_bytes, elapsed_s) : 0.0;
+            e->net_bytes = ok ? bytes[i] : 0;
+            e->net_valid = ok;
+            e->net_scan = scan;
+        }
+    }
+}
 
-std::vector<ProcessEntry> collectTopProcesses(ProcessPluginCtx* ctx, size_t limit, SortMode sort_mode, int lock_pid) {
-    std::vector<ProcessEntry> result;
-    if (limit == 0) return result;
+/* numa_maps walks every mapping's page tables, so a PID is re-read this seldom, and only a few per scan. */
+constexpr auto kNumaMapsInterval = std::chrono::seconds(10);
+constexpr size_t kNumaMapsPerScan = 4;
+constexpr size_t kNumaMapsMaxBytes = 4 << 20;
+
+/* Add up the "N<node>=<pages>" fields of /proc/<pid>/numa_maps by node; false if it could not be read. */
+static bool readNumaPages(int pid, std::string* buf, std::vector<uint64_t>* pages) {
+    char path[PATH_MAX];
+    std::snprintf(path, sizeof(path), "%s/%d/numa_maps", procRoot().c_str(), pid);
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    buf->clear();
+    char chunk[16384];
+    ssize_t n;
+    while ((n = ::read(fd, chunk, sizeof(chunk))) > 0 && buf->size() < kNumaMapsMaxBytes) {
+        buf->append(chunk, static_cast<size_t>(n));
+    }
+    ::close(fd);
+
+    const char* begin = buf->data();
+    const char* end = begin + buf->size();
+    auto digit = [&](const char* c) { return c < end && static_cast<unsigned>(*c - '0') < 10; };
+    for (const char* p = begin; (p = static_cast<const char*>(std::memchr(p, 'N', static_cast<size_t>(end - p))));) {
+        const bool field = p > begin && p[-1] == ' ';
+        ++p;
+        if (!field || !digit(p)) continue;
+        size_t node = 0;
+        while (digit(p)) node = node * 10 + static_cast<size_t>(*p++ - '0');
+        if (p >= end || *p++ != '=') continue;
+        uint64_t count = 0;
+        while (digit(p)) count = count * 10 + static_cast<uint64_t>(*p++ - '0');
+        if (node >= pages->size()) pages->resize(node + 1, 0);
+        (*pages)[node] += count;
+    }
+    return true;
+}
 
-    long page_size = getPageSize();
-    long clock_ticks = getClockTicks();
-    if (clock_ticks <= 0) clock_ticks = 100;
-    long total_mem = ctx ? ctx->total_mem_kb : 0;
-    if (total_mem <= 0) total_mem = readTotalMemKb();
-    if (ctx) ctx->total_mem_kb = total_mem;
+/* Refresh the home node of the stalest entries in `batch`. */
+static void sampleNuma(hmon::plugins::process::ProcessPluginCtx* ctx, const IoBatch& batch) {
+    if (ctx->numa_nodes < 2) return;
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<std::pair<int, hmon::plugins::process::PidEntry*>> due;
+    for (const auto& [pid, e] : batch) {
+        if (now - e->numa_read >= kNumaMapsInterval) due.emplace_back(pid, e);
+    }
+    const size_t n = std::min(due.size(), kNumaMapsPerScan);
+    std::partial_sort(due.begin(), due.begin() + static_cast<std::ptrdiff_t>(n), due.end(),
+                      [](const auto& a, const auto& b) { return a.second->numa_read < b.second->numa_read; });
+    std::vector<uint64_t> pages;
+    for (size_t i = 0; i < n; ++i) {
+        auto* e = due[i].second;
+        e->numa_read = now;
+        pages.assign(ctx->numa_nodes, 0);
+        if (!readNumaPages(due[i].first, &ctx->numa_buf, &pages)) continue;
+        uint64_t total = 0;
+        size_t home = 0;
+        for (size_t node = 0; node < pages.size(); ++node) {
+            total += pages[node];
+            if (pages[node] > pages[home]) home = node;
+        }
+        e->numa_node = total > 0 ? static_cast<int>(home) : -1;
+        e->numa_local_pct = total > 0 ? 100.0 * static_cast<double>(pages[home]) / static_cast<double>(total) : 0.0;
+    }
+}
 
-    auto procs = readAllProcesses();
+}
 
-    if (lock_pid > 0) {
-        auto it = std::find_if(procs.begin(), procs.end(),
-                               [lock_pid](const ProcInfo& p) { return p.pid == lock_pid; });
-        if (it == procs.end()) return result;
+namespace hmon::plugins::process {
 
-        ProcessEntry e;
-        e.pid = it->pid;
-        e.command = it->command;
-        long rss_kb = static_cast<long>(it->rss_pages) * page_size / 1024;
-        e.mem_percent = total_mem > 0 ? 100.0 * static_cast<double>(rss_kb) / static_cast<double>(total_mem) : 0.0;
-        if (ctx) {
-            auto gpu_it = ctx->gpu_percent_by_pid.find(it->pid);
-            if (gpu_it != ctx->gpu_percent_by_pid.end()) {
-                e.gpu_percent = gpu_it->second;
-            }
+/*
+ * Sum the members' per-PID rates into their groups and keep the top `limit`
+ * by sort_mode.  I/O is only current for every PID when ranking by it, so
+ * otherwise the members of the winning groups are read now, in one batch,
+ * and only their totals carry I/O.
+ */
+template <typename CpuFn, typename MemFn, typename GpuFn>
+static void rankGroups(ProcessPluginCtx* ctx, size_t limit, SortMode sort_mode, double elapsed_s, CpuFn cpuPercent,
+                       MemFn memPercent, GpuFn gpuPercent, std::vector<GroupEntry>* out) {
+    for (auto& [id, g] : ctx->groups) {
+        g.totals = GroupEntry{};
+        g.totals.id = id;
+    }
+    const uint32_t scan = ctx->scan;
+    auto addIo = [scan](GroupEntry& t, const PidEntry& pi) {
+        if (pi.io_scan == scan) {
+            t.io_read_bps += pi.io_read_bps;
+            t.io_write_bps += pi.io_write_bps;
         }
+        if (pi.net_scan == scan) t.net_bps += pi.net_bps;
+    };
+    for (auto& [pid, pi] : ctx->pids) {
+        if (pi.group < 0 || pi.rss_pages == 0) continue;
+        auto it = ctx->groups.find(pi.group);
+        if (it == ctx->groups.end()) continue;
+        GroupEntry& t = it->second.totals;
+        ++t.procs;
+        t.cpu_percent += cpuPercent(pi);
+        t.mem_percent += memPercent(pi);
+        t.gpu_percent += gpuPercent(pid);
+        if (sort_mode == SortMode::kIo || sort_mode == SortMode::kNet) addIo(t, pi);
+    }
 
-        if (ctx && !ctx->prev_utime.empty()) {
-            auto ut = ctx->prev_utime.find(it->pid);
-            auto st = ctx->prev_stime.find(it->pid);
-            if (ut != ctx->prev_utime.end() && st != ctx->prev_stime.end()) {
-                uint64_t cpu_delta = (it->utime - ut->second) + (it->stime - st->second);
-                auto now = std::chrono::steady_clock::now();
-                double elapsed_s = std::chrono::duration_cast<std::chrono::milliseconds>(
-                    now - ctx->prev_time).count() / 1000.0;
-                if (elapsed_s > 0) {
-                    e.cpu_percent = 100.0 * static_cast<double>(cpu_delta) / static_cast<double>(clock_ticks) / elapsed_s;
+    std::vector<ProcessGroup*> ranked;
+    ranked.reserve(ctx->groups.size());
+    for (auto& [id, g] : ctx->groups) {
+        if (g.totals.procs > 0) ranked.push_back(&g);
+    }
+    auto rank = [sort_mode](const GroupEntry& t) {
+        switch (sort_mode) {
+            case SortMode::kGpu: return t.gpu_percent;
+            case SortMode::kMem: return t.mem_percent;
+            case SortMode::kPid: return -static_cast<double>(t.id);
+            case SortMode::kIo:  return t.io_read_bps + t.io_write_bps;
+            case SortMode::kNet: return t.net_bps;
+            default:             return t.cpu_percent;
+        }
+    };
+    auto better = [&rank](const ProcessGroup* a, const ProcessGroup* b) {
+        const double ra = rank(a->totals), rb = rank(b->totals);
+        if (ra != rb) return ra > rb;
+        return a->totals.id < b->totals.id;
+    };
+    const size_t k = std::min(limit, ranked.size());
+    if (k < ranked.size()) {
+        std::nth_element(ranked.begin(), ranked.begin() + static_cast<std::ptrdiff_t>(k), ranked.end(), better);
+    }
+    std::sort(ranked.begin(), ranked.begin() + static_cast<std::ptrdiff_t>(k), better);
+    ranked.resize(k);
+
+    if (sort_mode != SortMode::kIo && sort_mode != SortMode::kNet) {
+        IoBatch members;
+        for (auto& [pid, pi] : ctx->pids) {
+            if (pi.group < 0 || pi.rss_pages == 0) continue;
+            for (const ProcessGroup* g : ranked) {
+                if (g->totals.id == pi.group) {
+                    members.emplace_back(pid, &pi);
+                    break;
                 }
             }
         }
-        e.cpu_percent = std::max(0.0, std::min(100.0, e.cpu_percent));
-
-        result.push_back(std::move(e));
-        if (ctx) {
-            ctx->prev_utime.clear();
-            ctx->prev_stime.clear();
-            ctx->prev_utime[it->pid] = it->utime;
-            ctx->prev_stime[it->pid] = it->stime;
-            ctx->prev_time = std::chrono::steady_clock::now();
+        sampleIo(ctx, members, true, true, elapsed_s);
+        for (const auto& [pid, pi] : members) addIo(ctx->groups[pi->group].totals, *pi);
+    }
+
+    out->reserve(k);
+    for (const ProcessGroup* g : ranked) {
+        out->push_back(g->totals);
+        out->back().name = g->name;
+    }
+}
+
+/* Listed PIDs matching `filter`: a command line containing it, or, for digits, a PID starting with them. */
+static void matchFilter(ProcessPluginCtx* ctx, const std::string& filter, std::vector<int>* out) {
+    if (filter.size() >= 3) {
+        ctx->commands.find(filter, [ctx](int pid) -> std::string_view {
+            auto it = ctx->pids.find(pid);
+            return it != ctx->pids.end() ? std::string_view(it->second.search) : std::string_view();
+        }, out);
+    } else {
+        for (const auto& [pid, pi] : ctx->pids) {
+            if (CommandIndex::contains(pi.search, filter)) out->push_back(pid);
+        }
+    }
+    if (std::all_of(filter.begin(), filter.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        for (const auto& [pid, pi] : ctx->pids) {
+            if (std::to_string(pid).compare(0, filter.size(), filter) == 0) out->push_back(pid);
         }
-        return result;
+        std::sort(out->begin(), out->end());
+        out->erase(std::unique(out->begin(), out->end()), out->end());
+    }
+}
+
+ProcessPluginCtx::ProcessPluginCtx() {
+    numa_nodes = hmon::core::readNumaNodes().size();
+    /* Cached stat fds may use half of the descriptor limit, raised to the
+     * hard limit first; the rest stays available to the other plugins. */
+    struct rlimit rl {};
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) return;
+    rlim_t wanted = rl.rlim_max == RLIM_INFINITY ? 65536 : std::min<rlim_t>(rl.rlim_max, 65536);
+    if (rl.rlim_cur != RLIM_INFINITY && wanted > rl.rlim_cur) {
+        struct rlimit raised = rl;
+        raised.rlim_cur = wanted;
+        if (setrlimit(RLIMIT_NOFILE, &raised) == 0) rl = raised;
+    }
+    max_cached_fds = rl.rlim_cur == RLIM_INFINITY ? 32768 : static_cast<size_t>(rl.rlim_cur / 2);
+}
+
+ProcessPluginCtx::~ProcessPluginCtx() {
+    for (auto& [pid, e] : pids) {
+        if (e.stat_fd >= 0) ::close(e.stat_fd);
     }
+}
+
+std::vector<ProcessEntry> collectTopProcesses(ProcessPluginCtx* ctx, size_t limit, SortMode sort_mode, int lock_pid,
+                                              GroupMode group_mode, int group_filter, const std::string& filter,
+                                              bool rescan, std::vector<GroupEntry>* groups) {
+    std::vector<ProcessEntry> result;
+    if (groups) groups->clear();
+    if (limit == 0 || !ctx) return result;
+
+    long page_size = getPageSize();
+    long clock_ticks = getClockTicks();
+    if (clock_ticks <= 0) clock_ticks = 100;
+    long total_mem = ctx->total_mem_kb;
+    if (total_mem <= 0) total_mem = readTotalMemKb();
+    ctx->total_mem_kb = total_mem;
 
-    if (ctx && !ctx->prev_utime.empty()) {
+    if (rescan) {
+        scanProcesses(ctx);
         auto now = std::chrono::steady_clock::now();
-        double elapsed_s = std::chrono::duration_cast<std::chrono::milliseconds>(
-            now - ctx->prev_time).count() / 1000.0;
-        double cpu_factor = (elapsed_s > 0) ? 100.0 / static_cast<double>(clock_ticks) / elapsed_s : 0.0;
-
-        for (const auto& pi : procs) {
-            ProcessEntry e;
-            e.pid = pi.pid;
-            e.command = pi.command;
-            long rss_kb = static_cast<long>(pi.rss_pages) * page_size / 1024;
-            e.mem_percent = total_mem > 0 ? 100.0 * static_cast<double>(rss_kb) / static_cast<double>(total_mem) : 0.0;
-            auto gpu_it = ctx->gpu_percent_by_pid.find(pi.pid);
-            if (gpu_it != ctx->gpu_percent_by_pid.end()) {
-                e.gpu_percent = gpu_it->second;
-            }
+        ctx->elapsed_s = std::chrono::duration_cast<std::chrono::milliseconds>(now - ctx->prev_time).count() / 1000.0;
+        ctx->cpu_factor = (ctx->elapsed_s > 0) ? 100.0 / static_cast<double>(clock_ticks) / ctx->elapsed_s : 0.0;
+        ctx->prev_time = now;
+    }
+    updateGroups(ctx, group_mode);
+    if (group_mode == GroupMode::kNone) group_filter = -1;
+    const double elapsed_s = ctx->elapsed_s;
+    const double cpu_factor = ctx->cpu_factor;
+
+    auto cpuPercent = [&](const PidEntry& pi) {
+        if (!pi.has_prev) return 0.0;
+        uint64_t cpu_delta = (pi.utime - pi.prev_utime) + (pi.stime - pi.prev_stime);
+        return std::max(0.0, std::min(100.0, cpu_factor * static_cast<double>(cpu_delta)));
+    };
+    auto memPercent = [&](const PidEntry& pi) {
+        long rss_kb = static_cast<long>(pi.rss_pages) * page_size / 1024;
+        return total_mem > 0 ? 100.0 * static_cast<double>(rss_kb) / static_cast<double>(total_mem) : 0.0;
+    };
+    auto gpuPercent = [&](int pid) {
+        auto gpu_it = ctx->gpu_percent_by_pid.find(pid);
+        return gpu_it != ctx->gpu_percent_by_pid.end() ? gpu_it->second : 0.0;
+    };
+    auto ioDelayPercent = [&](const PidEntry& pi) {
+        if (!pi.has_prev || pi.blkio_ticks < pi.prev_blkio_ticks) return 0.0;
+        return std::min(100.0, cpu_factor * static_cast<double>(pi.blkio_ticks - pi.prev_blkio_ticks));
+    };
+
+    /* Ranking by I/O needs every process's counters; any other order only the rows returned. */
+    const bool rank_storage = sort_mode == SortMode::kIo;
+    const bool rank_net = sort_mode == SortMode::kNet;
+    if (rank_storage || rank_net) {
+        IoBatch all;
+        all.reserve(ctx->pids.size());
+        for (auto& [pid, pi] : ctx->pids) {
+            if (!pi.hidden && pi.rss_pages != 0) all.emplace_back(pid, &pi);
+        }
+        sampleIo(ctx, all, rank_storage, rank_net, elapsed_s);
+    }
 
-            auto ut = ctx->prev_utime.find(pi.pid);
-            auto st = ctx->prev_stime.find(pi.pid);
-            if (ut != ctx->prev_utime.end() && st != ctx->prev_stime.end()) {
-                uint64_t cpu_delta = (pi.utime - ut->second) + (pi.stime - st->second);
-                e.cpu_percent = cpu_factor * static_cast<double>(cpu_delta);
-            }
-            e.cpu_percent = std::max(0.0, std::min(100.0, e.cpu_percent));
-            result.push_back(std::move(e));
+    if (groups && group_mode != GroupMode::kNone) {
+        rankGroups(ctx, limit, sort_mode, elapsed_s, cpuPercent, memPercent, gpuPercent, groups);
+    }
+
+    /*
+     * Rank on a compact key first and only build ProcessEntry (and copy the
+     * command) for the winners: nth_element picks the top `limit` in O(n) and
+     * just those are sorted.  Ties break on PID so the order is deterministic.
+     */
+    struct Candidate {
+        double rank;
+        int pid;
+        PidEntry* entry;
+    };
+    std::vector<Candidate> candidates;
+    candidates.reserve(ctx->pids.size());
+    auto consider = [&](int pid, PidEntry& pi) {
+        if (pi.hidden || pi.rss_pages == 0) return;
+        if (group_filter > 0 && pi.group != group_filter) return;
+        double rank = 0.0;
+        switch (sort_mode) {
+            case SortMode::kGpu: rank = gpuPercent(pid); break;
+            case SortMode::kMem: rank = memPercent(pi); break;
+            case SortMode::kPid: rank = -static_cast<double>(pid); break;
+            case SortMode::kIo:  rank = pi.io_read_bps + pi.io_write_bps; break;
+            case SortMode::kNet: rank = pi.net_bps; break;
+            default:             rank = cpuPercent(pi); break;
         }
+        candidates.push_back(Candidate{rank, pid, &pi});
+    };
+    if (filter.empty()) {
+        for (auto& [pid, pi] : ctx->pids) consider(pid, pi);
+        ctx->filter_matches = 0;
     } else {
-        for (const auto& pi : procs) {
-            ProcessEntry e;
-            e.pid = pi.pid;
-            e.command = pi.command;
-            long rss_kb = static_cast<long>(pi.rss_pages) * page_size / 1024;
-            e.mem_percent = total_mem > 0 ? 100.0 * static_cast<double>(rss_kb) / static_cast<double>(total_mem) : 0.0;
-            if (ctx) {
-                auto gpu_it = ctx->gpu_percent_by_pid.find(pi.pid);
-                if (gpu_it != ctx->gpu_percent_by_pid.end()) {
-                    e.gpu_percent = gpu_it->second;
-                }
-            }
-            e.cpu_percent = 0.0;
-            result.push_back(std::move(e));
+        std::vector<int> matched;
+        matchFilter(ctx, filter, &matched);
+        for (int pid : matched) {
+            auto it = ctx->pids.find(pid);
+            if (it != ctx->pids.end()) consider(pid, it->second);
         }
+        ctx->filter_matches = candidates.size();
     }
 
-    switch (sort_mode) {
-        case SortMode::kGpu:
-            std::stable_sort(result.begin(), result.end(),
-                             [](const ProcessEntry& a, const ProcessEntry& b) { return a.gpu_percent > b.gpu_percent; });
-            break;
-        case SortMode::kMem:
-            std::stable_sort(result.begin(), result.end(),
-                             [](const ProcessEntry& a, const ProcessEntry& b) { return a.mem_percent > b.mem_percent; });
-            break;
-        case SortMode::kPid:
-            std::stable_sort(result.begin(), result.end(),
-                             [](const ProcessEntry& a, const ProcessEntry& b) { return a.pid < b.pid; });
-            break;
-        default:
-            std::stable_sort(result.begin(), result.end(),
-                             [](const ProcessEntry& a, const ProcessEntry& b) { return a.cpu_percent > b.cpu_percent; });
-            break;
-    }
-
-    if (result.size() > limit) result.resize(limit);
-
-    if (ctx) {
-        ctx->prev_utime.clear();
-        ctx->prev_stime.clear();
-        ctx->gpu_percent_by_pid = readGpuUsageByPid();
-        for (const auto& pi : procs) {
-            ctx->prev_utime[pi.pid] = pi.utime;
-            ctx->prev_stime[pi.pid] = pi.stime;
+    auto better = [](const Candidate& a, const Candidate& b) {
+        if (a.rank != b.rank) return a.rank > b.rank;
+        return a.pid < b.pid;
+    };
+    size_t k = std::min(limit, candidates.size());
+    if (k < candidates.size()) {
+        std::nth_element(candidates.begin(), candidates.begin() + static_cast<std::ptrdiff_t>(k), candidates.end(), better);
+    }
+    std::sort(candidates.begin(), candidates.begin() + static_cast<std::ptrdiff_t>(k), better);
+
+    auto makeEntry = [&](const Candidate& c) {
+        ProcessEntry e;
+        e.pid = c.pid;
+        e.command = c.entry->command;
+        e.cpu_percent = cpuPercent(*c.entry);
+        e.mem_percent = memPercent(*c.entry);
+        e.gpu_percent = gpuPercent(c.pid);
+        e.io_read_bps = c.entry->io_read_bps;
+        e.io_write_bps = c.entry->io_write_bps;
+        e.net_bps = c.entry->net_bps;
+        e.io_delay_pct = ioDelayPercent(*c.entry);
+        e.numa_node = c.entry->numa_node;
+        e.numa_local_pct = c.entry->numa_local_pct;
+        return e;
+    };
+
+    std::vector<const Candidate*> rows;
+    rows.reserve(k + 1);
+    bool have_lock = false;
+    for (size_t i = 0; i < k; ++i) {
+        have_lock = have_lock || candidates[i].pid == lock_pid;
+        rows.push_back(&candidates[i]);
+    }
+    Candidate locked{0.0, lock_pid, nullptr};
+    if (lock_pid > 0 && !have_lock) {
+        auto it = std::find_if(candidates.begin() + static_cast<std::ptrdiff_t>(k), candidates.end(),
+                               [lock_pid](const Candidate& c) { return c.pid == lock_pid; });
+        if (it != candidates.end()) {
+            rows.push_back(&*it);
+        } else {
+            /* Left out by the filter or the group: the locked PID is shown regardless. */
+            auto pit = ctx->pids.find(lock_pid);
+            if (pit != ctx->pids.end() && !pit->second.hidden && pit->second.rss_pages != 0) {
+                locked.entry = &pit->second;
+                rows.push_back(&locked);
+            }
         }
-        ctx->prev_time = std::chrono::steady_clock::now();
     }
+
+    IoBatch shown;
+    shown.reserve(rows.size());
+    for (const Candidate* row : rows) shown.emplace_back(row->pid, row->entry);
+    sampleIo(ctx, shown, true, true, elapsed_s);
+    if (rescan) sampleNuma(ctx, shown);
+
+    result.reserve(rows.size());
+    for (const Candidate* row : rows) result.push_back(makeEntry(*row));
+
+    if (rescan) ctx->gpu_percent_by_pid = readGpuUsageByPid(ctx);
     return result;
 }
 
@@ -1,32 +1,169 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "command_index.hpp"
+#include "io_accounting.hpp"
+#include "nvml_backend.hpp"
+
 namespace hmon::plugins::process {
 
-enum class SortMode { kCpu, kMem, kGpu, kPid };
+enum class SortMode { kCpu, kMem, kGpu, kPid, kIo, kNet };
+/* How PIDs are rolled up into groups; kNone lists them one by one. */
+enum class GroupMode { kNone, kCgroup, kContainer, kUnit, kTree };
 
 struct ProcessEntry {
     int pid = 0;
     double cpu_percent = 0.0;
     double mem_percent = 0.0;
     double gpu_percent = 0.0;
+    double io_read_bps = 0.0;
+    double io_write_bps = 0.0;
+    double net_bps = 0.0;       /* TCP, both directions */
+    double io_delay_pct = 0.0;  /* share of wall time blocked on block I/O (delay accounting) */
+    int numa_node = -1;         /* node holding most of its pages, -1 when unknown */
+    double numa_local_pct = 0.0;    /* share of its pages on that node */
     std::string command;
 };
 
+/* One group's totals over its members this tick. */
+struct GroupEntry {
+    int id = 0;
+    std::string name;
+    int procs = 0;
+    double cpu_percent = 0.0;
+    double mem_percent = 0.0;
+    double gpu_percent = 0.0;
+    double io_read_bps = 0.0;
+    double io_write_bps = 0.0;
+    double net_bps = 0.0;
+};
+
+/*
+ * A member of the group index.  Ids are never reused while hmon runs, so a
+ * group the UI drilled into cannot turn into a different one; a group goes
+ * away with its last member.
+ */
+struct ProcessGroup {
+    std::string key;
+    std::string name;
+    int members = 0;
+    GroupEntry totals;          /* rebuilt every tick from the members' per-PID rates */
+};
+
+/*
+ * Per-PID scanner state.  The stat fd stays open across ticks and is re-read
+ * with pread(); the command line is cached until starttime changes, which is
+ * how a recycled PID is told apart from the process that used to own it.
+ */
+struct PidEntry {
+    int stat_fd = -1;
+    unsigned long long starttime = 0;
+    std::string command;
+    bool hidden = false;        /* kernel thread or no command line */
+    bool indexed = false;       /* search is in ProcessPluginCtx::commands */
+    std::string search;         /* name and full command line, as indexed */
+    uint64_t utime = 0;
+    uint64_t stime = 0;
+    uint64_t prev_utime = 0;
+    uint64_t prev_stime = 0;
+    bool has_prev = false;
+    uint64_t rss_pages = 0;
+    int ppid = 0;
+    int num_threads = 1;
+    uint64_t blkio_ticks = 0;
+    uint64_t prev_blkio_ticks = 0;
+    uint32_t seen_scan = 0;
+
+    /* Cumulative I/O counters as of io_scan / net_scan, read only for PIDs that need them. */
+    uint64_t io_read = 0;
+    uint64_t io_write = 0;
+    uint64_t net_bytes = 0;
+    uint32_t io_scan = 0;
+    uint32_t net_scan = 0;
+    bool io_valid = false;
+    bool net_valid = false;
+    double io_read_bps = 0.0;
+    double io_write_bps = 0.0;
+    double net_bps = 0.0;
+    ThreadIo thread_io;         /* taskstats only: exited threads' share of io_read / io_write */
+
+    /* From numa_maps as of numa_read; only on hosts with more than one node. */
+    int numa_node = -1;
+    double numa_local_pct = 0.0;
+    std::chrono::steady_clock::time_point numa_read{};
+
+    int group = -1;             /* index id under ProcessPluginCtx::indexed_mode, -1 until assigned */
+};
+
 struct ProcessPluginCtx {
-    SortMode sort_mode = SortMode::kCpu;
-    int lock_pid = -1;
-    std::unordered_map<int, uint64_t> prev_utime;
-    std::unordered_map<int, uint64_t> prev_stime;
+    ProcessPluginCtx();
+    ~ProcessPluginCtx();
+    ProcessPluginCtx(const ProcessPluginCtx&) = delete;
+    ProcessPluginCtx& operator=(const ProcessPluginCtx&) = delete;
+
+    /* Set from the host's control thread, read by collect. */
+    std::atomic<SortMode> sort_mode{SortMode::kCpu};
+    std::atomic<int> lock_pid{-1};
+    std::atomic<size_t> limit{20};
+    std::atomic<GroupMode> group_mode{GroupMode::kNone};
+    std::atomic<int> group_filter{-1};      /* a group id: its members are the only PIDs listed */
+    std::unordered_map<int, PidEntry> pids;
+    uint32_t scan = 0;
+    size_t cached_fds = 0;
+    size_t max_cached_fds = 0;
     std::unordered_map<int, double> gpu_percent_by_pid;
     std::chrono::steady_clock::time_point prev_time;
     long total_mem_kb = 0;
+    hmon::plugins::gpu::NvmlLibrary nvml;
+    IoAccounting io;
+    size_t numa_nodes = 0;
+    std::string numa_buf;
+
+    /*
+     * PID -> group index for indexed_mode.  New and recycled PIDs are placed
+     * once, when the scan first sees them, and leave with the PID; only a
+     * change of mode re-places everything.
+     */
+    GroupMode indexed_mode = GroupMode::kNone;
+    std::unordered_map<int, ProcessGroup> groups;
+    std::unordered_map<std::string, int> group_ids;     /* key -> id */
+    int next_group_id = 1;
+
+    /* The process.filter text, lower case; set from the control thread. */
+    std::mutex filter_mutex;
+    std::string filter;
+    std::atomic<uint64_t> filter_version{0};
+    uint64_t applied_filter_version = 0;
+    CommandIndex commands;                  /* every listed PID's name and command line */
+    std::chrono::steady_clock::time_point last_scan{};
+    /* Rate scale of the last scan, reused when a new filter is applied to it. */
+    double elapsed_s = 0.0;
+    double cpu_factor = 0.0;
+    size_t filter_matches = 0;              /* processes the last filter matched */
 };
 
-std::vector<ProcessEntry> collectTopProcesses(ProcessPluginCtx* ctx, size_t limit, SortMode sort_mode, int lock_pid);
+/*
+ * Top `limit` processes by sort_mode; lock_pid, when alive, is always
+ * included, even when the filter or group_filter leaves it out.  I/O counters are read for every process only when ranking by
+ * them; otherwise just for the rows returned.
+ *
+ * With a group_mode, `groups` receives the top `limit` groups by the same
+ * order, and a group_filter > 0 restricts the processes to that group.  A
+ * non-empty `filter` (lower case) ranks only the processes it matches, found
+ * through ctx->commands, and leaves their number in ctx->filter_matches.
+ * Without `rescan` the last scan is ranked again, with no /proc reads.
+ * On a NUMA host the rows returned also carry their home node, re-read from
+ * numa_maps for a few of them each scan.
+ */
+std::vector<ProcessEntry> collectTopProcesses(ProcessPluginCtx* ctx, size_t limit, SortMode sort_mode, int lock_pid,
+                                              GroupMode group_mode, int group_filter, const std::string& filter,
+                                              bool rescan, std::vector<GroupEntry>* groups);
 
 }
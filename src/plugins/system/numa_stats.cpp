@@ -0,0 +1,94 @@
+#include "numa_stats.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+
+#include "hmon/fs_root.hpp"
+#include "hmon/numa.hpp"
+
+namespace hmon::plugins::system {
+
+namespace {
+
+/* Value after the first "<field>" in `text` ("MemFree:", "numa_miss "); false if absent. */
+bool parseField(const char* text, const char* field, uint64_t* out) {
+    const char* p = std::strstr(text, field);
+    if (!p) return false;
+    *out = std::strtoull(p + std::strlen(field), nullptr, 10);
+    return true;
+}
+
+bool preadText(int fd, char* buf, size_t size) {
+    if (fd < 0) return false;
+    const ssize_t n = ::pread(fd, buf, size - 1, 0);
+    if (n <= 0) return false;
+    buf[n] = '\0';
+    return true;
+}
+
+}
+
+NumaMonitor::~NumaMonitor() {
+    for (auto& n : nodes) {
+        if (n.meminfo_fd >= 0) ::close(n.meminfo_fd);
+        if (n.numastat_fd >= 0) ::close(n.numastat_fd);
+    }
+}
+
+bool NumaMonitor::open() {
+    if (opened_) return !nodes.empty();
+    opened_ = true;
+    for (const auto& node : hmon::core::readNumaNodes()) {
+        const std::string dir = hmon::core::sysRoot() + "/devices/system/node/node" + std::to_string(node.id);
+        NumaNodeStats stats;
+        stats.id = node.id;
+        stats.cpus = node.cpulist;
+        stats.meminfo_fd = ::open((dir + "/meminfo").c_str(), O_RDONLY | O_CLOEXEC);
+        stats.numastat_fd = ::open((dir + "/numastat").c_str(), O_RDONLY | O_CLOEXEC);
+        nodes.push_back(std::move(stats));
+    }
+    return !nodes.empty();
+}
+
+void NumaMonitor::collect() {
+    if (!open()) return;
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsed_s = has_prev_ ? std::chrono::duration<double>(now - prev_time_).count() : 0.0;
+    /* Per-node meminfo runs to about 1.5 KiB; numastat to a few hundred bytes. */
+    char buf[4096];
+    for (auto& n : nodes) {
+        n.valid = preadText(n.meminfo_fd, buf, sizeof(buf)) && parseField(buf, "MemTotal:", &n.mem_total_kb) &&
+                  parseField(buf, "MemFree:", &n.mem_free_kb);
+        uint64_t hit = 0, miss = 0, foreign = 0, other = 0;
+        const bool ok = preadText(n.numastat_fd, buf, sizeof(buf)) && parseField(buf, "numa_hit ", &hit) &&
+                             parseField(buf, "numa_miss ", &miss) && parseField(buf, "numa_foreign ", &foreign) &&
+                             parseField(buf, "other_node ", &other);
+        if (!ok) {
+            n.counted = false;
+            n.has_rates = false;
+            continue;
+        }
+        auto rate = [&](uint64_t cur, uint64_t prev) {
+            return cur >= prev ? static_cast<double>(cur - prev) / elapsed_s : 0.0;
+        };
+        if (elapsed_s > 0.0 && n.counted) {
+            n.hit_ps = rate(hit, n.hit);
+            n.miss_ps = rate(miss, n.miss);
+            n.foreign_ps = rate(foreign, n.foreign);
+            n.other_ps = rate(other, n.other);
+            n.has_rates = true;
+        }
+        n.hit = hit;
+        n.miss = miss;
+        n.foreign = foreign;
+        n.other = other;
+        n.counted = true;
+    }
+    prev_time_ = now;
+    has_prev_ = true;
+}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hmon::plugins::system {
+
+/*
+ * One NUMA node's memory and allocation counters.  numastat counts pages:
+ * a miss is a page placed here although its task preferred another node,
+ * a foreign page one that preferred this node but landed elsewhere, and an
+ * other-node page one placed here for a task running on another node.
+ */
+struct NumaNodeStats {
+    int id = 0;
+    std::string cpus;               /* cpulist */
+    int meminfo_fd = -1;
+    int numastat_fd = -1;
+    bool valid = false;
+    uint64_t mem_total_kb = 0;
+    uint64_t mem_free_kb = 0;
+    uint64_t hit = 0;
+    uint64_t miss = 0;
+    uint64_t foreign = 0;
+    uint64_t other = 0;
+    bool counted = false;           /* the counters above hold a sample */
+    bool has_rates = false;
+    double hit_ps = 0.0;
+    double miss_ps = 0.0;
+    double foreign_ps = 0.0;
+    double other_ps = 0.0;
+};
+
+/*
+ * Per-node meminfo and numastat.  The node list and cpulists are read once;
+ * afterwards a collect is two preads per node.
+ */
+class NumaMonitor {
+public:
+    NumaMonitor() = default;
+    ~NumaMonitor();
+    NumaMonitor(const NumaMonitor&) = delete;
+    NumaMonitor& operator=(const NumaMonitor&) = delete;
+
+    /* Find the nodes and open their files; false when the kernel has no NUMA. */
+    bool open();
+    /* Re-read every node; rates cover the interval since the previous call. */
+    void collect();
+
+    std::vector<NumaNodeStats> nodes;
+
+private:
+    bool opened_ = false;
+    bool has_prev_ = false;
+    std::chrono::steady_clock::time_point prev_time_{};
+};
+
+}
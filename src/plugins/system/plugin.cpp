@@ -1,5 +1,6 @@
 #include <cstdlib>
 #include <cstring>
+#include <limits>
 #include <string>
 
 #include "hmon/plugin_abi.h"
@@ -7,79 +8,188 @@
 #include "system_collector.hpp"
 
 
+static constexpr double kNull = std::numeric_limits<double>::quiet_NaN();
+
 static int system_plugin_init(hmon_plugin_ctx** out) {
     if (!out) return -1;
     auto* ctx = new (std::nothrow) hmon::plugins::system::SystemPluginCtx();
     if (!ctx) return -1;
     ctx->root_device = hmon::plugins::system::detectRootDevice();
+    ctx->pressure.open();
+    ctx->numa.open();
     *out = reinterpret_cast<hmon_plugin_ctx*>(ctx);
     return 0;
 }
 
-static void appendMetric(hmon_metric_list* list, const char* key, int type, const void* value) {
-    if (list->count >= list->capacity) {
-        size_t new_cap = list->capacity == 0 ? 32 : list->capacity * 2;
-        auto* new_items = static_cast<hmon_metric*>(std::realloc(list->items, new_cap * sizeof(hmon_metric)));
-        if (!new_items) return;
-        list->items = new_items;
-        list->capacity = new_cap;
-    }
-    auto* item = &list->items[list->count];
-    item->key = key;
-    item->value.type = type;
-    switch (type) {
-    case HMON_VAL_STRING: item->value.v.str = strdup(static_cast<const char*>(value) ? static_cast<const char*>(value) : ""); break;
-    case HMON_VAL_INT64: item->value.v.i64 = *static_cast<const int64_t*>(value); break;
-    case HMON_VAL_DOUBLE: item->value.v.f64 = *static_cast<const double*>(value); break;
-    case HMON_VAL_BOOL: item->value.v.b = *static_cast<const int32_t*>(value); break;
-    }
-    ++list->count;
-}
-
-static int system_plugin_collect(hmon_plugin_ctx* ctx, hmon_metric_list* out_list) {
-    if (!ctx || !out_list) return -1;
+static int system_plugin_collect(hmon_plugin_ctx* ctx, hmon_metric_list* out_list, hmon_arena* arena) {
+    if (!ctx || !out_list || !arena) return -1;
     auto* c = reinterpret_cast<hmon::plugins::system::SystemPluginCtx*>(ctx);
 
     auto ram_total = hmon::plugins::system::collectRamTotalKb();
     auto ram_avail = hmon::plugins::system::collectRamAvailableKb();
-    if (ram_total) { int64_t v = *ram_total; appendMetric(out_list, HMON_METRIC_RAM_TOTAL_KB, HMON_VAL_INT64, &v); }
-    if (ram_avail) { int64_t v = *ram_avail; appendMetric(out_list, HMON_METRIC_RAM_AVAILABLE_KB, HMON_VAL_INT64, &v); }
+    if (ram_total) { int64_t v = *ram_total; hmon_metric_append(out_list, arena, HMON_METRIC_RAM_TOTAL_KB, HMON_VAL_INT64, &v); }
+    if (ram_avail) { int64_t v = *ram_avail; hmon_metric_append(out_list, arena, HMON_METRIC_RAM_AVAILABLE_KB, HMON_VAL_INT64, &v); }
 
-    auto disk_total = hmon::plugins::system::collectDiskTotalBytes("/");
-    auto disk_free = hmon::plugins::system::collectDiskFreeBytes("/");
-    appendMetric(out_list, HMON_METRIC_DISK_MOUNT, HMON_VAL_STRING, "/");
-    if (disk_total) { int64_t v = static_cast<int64_t>(*disk_total); appendMetric(out_list, HMON_METRIC_DISK_TOTAL_BYTES, HMON_VAL_INT64, &v); }
-    if (disk_free) { int64_t v = static_cast<int64_t>(*disk_free); appendMetric(out_list, HMON_METRIC_DISK_FREE_BYTES, HMON_VAL_INT64, &v); }
+    hmon::plugins::system::collectMounts(c);
+    if (!c->mounts.empty()) {
+        /* The scalars describe "/" when it is in the set, else the first mount listed. */
+        const auto* primary = &c->mounts.front();
+        for (const auto& m : c->mounts) {
+            if (m.mount == "/") primary = &m;
+        }
+        int64_t total = static_cast<int64_t>(primary->total_bytes);
+        int64_t free = static_cast<int64_t>(primary->free_bytes);
+        hmon_metric_append(out_list, arena, HMON_METRIC_DISK_MOUNT, HMON_VAL_STRING, primary->mount.c_str());
+        hmon_metric_append(out_list, arena, HMON_METRIC_DISK_TOTAL_BYTES, HMON_VAL_INT64, &total);
+        hmon_metric_append(out_list, arena, HMON_METRIC_DISK_FREE_BYTES, HMON_VAL_INT64, &free);
+    }
+    static const hmon_table_column kMountColumns[] = {
+        {"mount", HMON_VAL_STRING}, {"device", HMON_VAL_STRING}, {"fstype", HMON_VAL_STRING},
+        {"total_bytes", HMON_VAL_INT64}, {"free_bytes", HMON_VAL_INT64},
+    };
+    auto* mounts = hmon_metric_append_table(out_list, arena, HMON_METRIC_DISK_MOUNTS_TABLE, kMountColumns, 5,
+                                            static_cast<uint32_t>(c->mounts.size()));
+    for (uint32_t r = 0; mounts && r < mounts->row_count; ++r) {
+        const auto& m = c->mounts[r];
+        hmon_table_set_str(arena, mounts, r, 0, m.mount.c_str());
+        hmon_table_set_str(arena, mounts, r, 1, m.device.c_str());
+        hmon_table_set_str(arena, mounts, r, 2, m.fstype.c_str());
+        hmon_table_row(mounts, r)[3].i64 = static_cast<int64_t>(m.total_bytes);
+        hmon_table_row(mounts, r)[4].i64 = static_cast<int64_t>(m.free_bytes);
+    }
 
-    auto rx = hmon::plugins::system::collectRxKbps(c);
-    auto tx = hmon::plugins::system::collectTxKbps(c);
-    if (!c->active_interface.empty()) appendMetric(out_list, HMON_METRIC_NET_INTERFACE, HMON_VAL_STRING, c->active_interface.c_str());
-    if (rx) { double v = *rx; appendMetric(out_list, HMON_METRIC_NET_RX_KBPS, HMON_VAL_DOUBLE, &v); }
-    if (tx) { double v = *tx; appendMetric(out_list, HMON_METRIC_NET_TX_KBPS, HMON_VAL_DOUBLE, &v); }
+    if (hmon::plugins::system::collectDiskIo(c)) {
+        uint32_t rows = 0;
+        for (const auto& d : c->disks) {
+            if (!d.has_rates) continue;
+            ++rows;
+            if (d.name == c->root_device) {
+                hmon_metric_append(out_list, arena, HMON_METRIC_DISK_BUSY_PCT, HMON_VAL_DOUBLE, &d.busy_pct);
+            }
+        }
+        static const hmon_table_column kIoColumns[] = {
+            {"device", HMON_VAL_STRING}, {"busy_pct", HMON_VAL_DOUBLE}, {"read_iops", HMON_VAL_DOUBLE},
+            {"write_iops", HMON_VAL_DOUBLE}, {"read_bps", HMON_VAL_DOUBLE}, {"write_bps", HMON_VAL_DOUBLE},
+            {"await_ms", HMON_VAL_DOUBLE}, {"queue_depth", HMON_VAL_DOUBLE},
+        };
+        auto* io = hmon_metric_append_table(out_list, arena, HMON_METRIC_DISK_IO_TABLE, kIoColumns, 8, rows);
+        uint32_t r = 0;
+        for (const auto& d : c->disks) {
+            if (!io || !d.has_rates) continue;
+            hmon_table_set_str(arena, io, r, 0, d.name.c_str());
+            auto* row = hmon_table_row(io, r++);
+            row[1].f64 = d.busy_pct;
+            row[2].f64 = d.read_iops;
+            row[3].f64 = d.write_iops;
+            row[4].f64 = d.read_bps;
+            row[5].f64 = d.write_bps;
+            row[6].f64 = d.await_ms;
+            row[7].f64 = d.queue_depth;
+        }
+    }
+
+    if (hmon::plugins::system::collectNetDev(c)) {
+        uint32_t rows = 0;
+        for (const auto& n : c->interfaces) {
+            if (!n.has_rates) continue;
+            ++rows;
+            if (n.name == c->active_interface) {
+                double rx = n.rx_bps / 1024.0, tx = n.tx_bps / 1024.0;
+                hmon_metric_append(out_list, arena, HMON_METRIC_NET_RX_KBPS, HMON_VAL_DOUBLE, &rx);
+                hmon_metric_append(out_list, arena, HMON_METRIC_NET_TX_KBPS, HMON_VAL_DOUBLE, &tx);
+            }
+        }
+        if (!c->active_interface.empty()) hmon_metric_append(out_list, arena, HMON_METRIC_NET_INTERFACE, HMON_VAL_STRING, c->active_interface.c_str());
+        static const hmon_table_column kNetColumns[] = {
+            {"interface", HMON_VAL_STRING}, {"rx_bps", HMON_VAL_DOUBLE}, {"tx_bps", HMON_VAL_DOUBLE},
+            {"rx_pps", HMON_VAL_DOUBLE}, {"tx_pps", HMON_VAL_DOUBLE},
+            {"rx_drops_ps", HMON_VAL_DOUBLE}, {"tx_drops_ps", HMON_VAL_DOUBLE},
+        };
+        auto* nets = hmon_metric_append_table(out_list, arena, HMON_METRIC_NET_INTERFACES_TABLE, kNetColumns, 7, rows);
+        uint32_t r = 0;
+        for (const auto& n : c->interfaces) {
+            if (!nets || !n.has_rates) continue;
+            hmon_table_set_str(arena, nets, r, 0, n.name.c_str());
+            auto* row = hmon_table_row(nets, r++);
+            row[1].f64 = n.rx_bps;
+            row[2].f64 = n.tx_bps;
+            row[3].f64 = n.rx_pps;
+            row[4].f64 = n.tx_pps;
+            row[5].f64 = n.rx_drops_ps;
+            row[6].f64 = n.tx_drops_ps;
+        }
+    }
 
     auto swap_total = hmon::plugins::system::getSwapTotalKb();
     auto swap_free = hmon::plugins::system::getSwapFreeKb();
-    if (swap_total) { int64_t v = *swap_total; appendMetric(out_list, "swap.total_kb", HMON_VAL_INT64, &v); }
-    if (swap_free) { int64_t v = *swap_free; appendMetric(out_list, "swap.free_kb", HMON_VAL_INT64, &v); }
+    if (swap_total) { int64_t v = *swap_total; hmon_metric_append(out_list, arena, "swap.total_kb", HMON_VAL_INT64, &v); }
+    if (swap_free) { int64_t v = *swap_free; hmon_metric_append(out_list, arena, "swap.free_kb", HMON_VAL_INT64, &v); }
+
+    auto& pressure = c->pressure;
+    pressure.collect();
+    uint32_t psi_rows = 0;
+    for (const auto& p : pressure.resources) psi_rows += p.valid ? 1 : 0;
+    static const hmon_table_column kPsiColumns[] = {
+        {"resource", HMON_VAL_STRING}, {"some_avg10", HMON_VAL_DOUBLE}, {"some_avg60", HMON_VAL_DOUBLE},
+        {"some_total_us", HMON_VAL_INT64}, {"full_avg10", HMON_VAL_DOUBLE}, {"full_avg60", HMON_VAL_DOUBLE},
+        {"full_total_us", HMON_VAL_INT64}, {"stalled", HMON_VAL_BOOL}, {"events", HMON_VAL_INT64},
+    };
+    auto* psi = hmon_metric_append_table(out_list, arena, HMON_METRIC_PSI_TABLE, kPsiColumns, 9, psi_rows);
+    uint32_t r = 0;
+    for (const auto& p : pressure.resources) {
+        if (!psi || !p.valid) continue;
+        hmon_table_set_str(arena, psi, r, 0, p.name);
+        auto* row = hmon_table_row(psi, r++);
+        row[1].f64 = p.some.avg10;
+        row[2].f64 = p.some.avg60;
+        row[3].i64 = static_cast<int64_t>(p.some.total_us);
+        row[4].f64 = p.has_full ? p.full.avg10 : kNull;
+        row[5].f64 = p.has_full ? p.full.avg60 : kNull;
+        row[6].i64 = p.has_full ? static_cast<int64_t>(p.full.total_us) : HMON_TABLE_NULL_I64;
+        row[7].b = p.stalled ? 1 : 0;
+        row[8].i64 = static_cast<int64_t>(p.events);
+    }
+
+    auto& numa = c->numa;
+    numa.collect();
+    uint32_t numa_rows = 0;
+    for (const auto& n : numa.nodes) numa_rows += n.valid ? 1 : 0;
+    static const hmon_table_column kNumaColumns[] = {
+        {"node", HMON_VAL_INT64}, {"cpus", HMON_VAL_STRING}, {"mem_total_kb", HMON_VAL_INT64},
+        {"mem_free_kb", HMON_VAL_INT64}, {"numa_hit_ps", HMON_VAL_DOUBLE}, {"numa_miss_ps", HMON_VAL_DOUBLE},
+        {"numa_foreign_ps", HMON_VAL_DOUBLE}, {"other_node_ps", HMON_VAL_DOUBLE},
+    };
+    if (numa_rows > 0) {
+        auto* nodes = hmon_metric_append_table(out_list, arena, HMON_METRIC_NUMA_NODES_TABLE, kNumaColumns, 8,
+                                               numa_rows);
+        r = 0;
+        for (const auto& n : numa.nodes) {
+            if (!nodes || !n.valid) continue;
+            hmon_table_set_str(arena, nodes, r, 1, n.cpus.c_str());
+            auto* row = hmon_table_row(nodes, r++);
+            row[0].i64 = n.id;
+            row[2].i64 = static_cast<int64_t>(n.mem_total_kb);
+            row[3].i64 = static_cast<int64_t>(n.mem_free_kb);
+            row[4].f64 = n.has_rates ? n.hit_ps : kNull;
+            row[5].f64 = n.has_rates ? n.miss_ps : kNull;
+            row[6].f64 = n.has_rates ? n.foreign_ps : kNull;
+            row[7].f64 = n.has_rates ? n.other_ps : kNull;
+        }
+    }
 
     return 0;
 }
 
+static int system_plugin_event_fd(hmon_plugin_ctx* ctx) {
+    if (!ctx) return -1;
+    return reinterpret_cast<hmon::plugins::system::SystemPluginCtx*>(ctx)->pressure.eventFd();
+}
+
 static void system_plugin_destroy(hmon_plugin_ctx* ctx) {
     if (!ctx) return;
     delete reinterpret_cast<hmon::plugins::system::SystemPluginCtx*>(ctx);
 }
 
-static void system_plugin_free_list(hmon_metric_list* list) {
-    if (!list) return;
-    for (size_t i = 0; i < list->count; ++i) {
-        if (list->items[i].value.type == HMON_VAL_STRING && list->items[i].value.v.str)
-            free(const_cast<char*>(list->items[i].value.v.str));
-    }
-    free(list->items);
-    list->items = nullptr;
-    list->count = 0;
-    list->capacity = 0;
-}
-
-HMON_STATIC_PLUGIN("system", system_plugin_init, system_plugin_collect, system_plugin_destroy, system_plugin_free_list, nullptr)
+/* PSI triggers wake the plugin on a stall, and keep it sampling fast until the stall passes. */
+HMON_STATIC_PLUGIN_EVENTS("system", system_plugin_init, system_plugin_collect, system_plugin_destroy, nullptr, 1000,
+                          system_plugin_event_fd)
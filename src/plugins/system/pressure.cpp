@@ -0,0 +1,177 @@
+#include "pressure.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "hmon/fs_root.hpp"
+
+namespace hmon::plugins::system {
+
+namespace {
+
+using hmon::core::procRoot;
+
+/* Stall per 1 s window that counts as an incident; CPU "some" is routine on a busy box, so it gets more room. */
+struct TriggerSpec {
+    const char* name;
+    int stall_ms;
+};
+constexpr TriggerSpec kTriggers[3] = {
+    {"cpu", 500},
+    {"memory", 100},
+    {"io", 150},
+};
+
+/* Epoll tag for the burst timer; trigger fds are tagged with their resource index. */
+constexpr uint64_t kTimerTag = 100;
+
+/* "some avg10=0.12 avg60=0.05 avg300=0.01 total=12345" */
+bool parseLine(const char* line, PressureLine* out) {
+    double avg300 = 0.0;
+    unsigned long long total = 0;
+    if (std::sscanf(line, "%*s avg10=%lf avg60=%lf avg300=%lf total=%llu", &out->avg10, &out->avg60, &avg300,
+                    &total) != 4) {
+        return false;
+    }
+    out->total_us = total;
+    return true;
+}
+
+/*
+ * Privileged triggers may use a 1 s window; since 6.4 unprivileged ones are
+ * allowed too, but only with windows in multiples of 2 s.
+ */
+int openTrigger(const std::string& path, int stall_ms) {
+    for (int window_ms : {1000, 2000}) {
+        const int fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) return -1;
+        char spec[64];
+        const int len = std::snprintf(spec, sizeof(spec), "some %d %d", stall_ms * window_ms, window_ms * 1000);
+        /* The kernel wants the terminating NUL written too. */
+        if (::write(fd, spec, static_cast<size_t>(len) + 1) >= 0) return fd;
+        ::close(fd);
+    }
+    return -1;
+}
+
+}
+
+PressureMonitor::~PressureMonitor() {
+    for (auto& r : resources) {
+        if (r.fd >= 0) ::close(r.fd);
+        if (r.trigger_fd >= 0) ::close(r.trigger_fd);
+    }
+    if (timer_fd_ >= 0) ::close(timer_fd_);
+    if (epoll_fd_ >= 0) ::close(epoll_fd_);
+}
+
+bool PressureMonitor::open() {
+    if (opened_) return resources[0].fd >= 0 || resources[1].fd >= 0 || resources[2].fd >= 0;
+    opened_ = true;
+    /* Triggers are written into the file itself; a relocated /proc is somebody's fixture. */
+    const bool live = procRoot() == "/proc";
+    bool any = false;
+    for (int i = 0; i < 3; ++i) {
+        auto& r = resources[i];
+        r.name = kTriggers[i].name;
+        const std::string path = procRoot() + "/pressure/" + r.name;
+        r.fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (r.fd < 0) continue;
+        any = true;
+        if (!live) continue;
+        r.trigger_fd = openTrigger(path, kTriggers[i].stall_ms);
+        if (r.trigger_fd < 0) continue;
+        if (epoll_fd_ < 0) epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLPRI;
+        ev.data.u64 = static_cast<uint64_t>(i);
+        if (epoll_fd_ < 0 || ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, r.trigger_fd, &ev) != 0) {
+            ::close(r.trigger_fd);
+            r.trigger_fd = -1;
+        }
+    }
+    if (epoll_fd_ >= 0) {
+        timer_fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = kTimerTag;
+        if (timer_fd_ >= 0 && ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &ev) != 0) {
+            ::close(timer_fd_);
+            timer_fd_ = -1;
+        }
+    }
+    return any;
+}
+
+void PressureMonitor::setBurst(bool on) {
+    if (burst_ == on || timer_fd_ < 0) return;
+    burst_ = on;
+    itimerspec spec{};
+    if (on) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(kBurstPeriod).count();
+        spec.it_interval.tv_sec = static_cast<time_t>(ns / 1000000000);
+        spec.it_interval.tv_nsec = static_cast<long>(ns % 1000000000);
+        spec.it_value = spec.it_interval;
+    }
+    ::timerfd_settime(timer_fd_, 0, &spec, nullptr);
+}
+
+void PressureMonitor::collect() {
+    if (!open()) return;
+
+    if (epoll_fd_ >= 0) {
+        epoll_event events[4];
+        const int n = ::epoll_wait(epoll_fd_, events, 4, 0);
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.u64 != kTimerTag) continue;
+            uint64_t expirations;
+            (void)!::read(timer_fd_, &expirations, sizeof(expirations));
+        }
+    }
+
+    /*
+     * Polling the epoll set from the scheduler already consumes a trigger's
+     * event, so whether one fired is judged from the stall time instead: the
+     * threshold is per one-second window, so the interval must show it pro
+     * rata, and a long interval does not count thin stalls spread over it.
+     */
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsed_us = has_prev_ ? std::chrono::duration<double, std::micro>(now - prev_time_).count() : 0.0;
+    bool stalled_any = false;
+    for (int i = 0; i < 3; ++i) {
+        auto& r = resources[i];
+        r.valid = false;
+        if (r.fd < 0) continue;
+        char buf[256];
+        const ssize_t n = ::pread(r.fd, buf, sizeof(buf) - 1, 0);
+        if (n <= 0) continue;
+        buf[n] = '\0';
+        const uint64_t prev_total = r.some.total_us;
+        r.valid = parseLine(buf, &r.some);
+        const char* full = std::strstr(buf, "\nfull ");
+        r.has_full = full && parseLine(full + 1, &r.full);
+        if (!r.valid || elapsed_us <= 0.0 || r.some.total_us < prev_total) continue;
+        const bool stalled = static_cast<double>(r.some.total_us - prev_total) >= elapsed_us * kTriggers[i].stall_ms / 1000.0;
+        if (stalled && !r.stalled) ++r.events;
+        r.stalled = stalled;
+        stalled_any = stalled_any || stalled;
+    }
+    prev_time_ = now;
+    has_prev_ = true;
+
+    if (stalled_any) {
+        burst_until_ = now + kBurstLength;
+        setBurst(true);
+    } else if (burst_ && now >= burst_until_) {
+        setBurst(false);
+    }
+}
+
+}
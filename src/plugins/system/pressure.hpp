@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace hmon::plugins::system {
+
+/* One line of a /proc/pressure file: share of the last 10 s / 60 s and cumulative stall time. */
+struct PressureLine {
+    double avg10 = 0.0;
+    double avg60 = 0.0;
+    uint64_t total_us = 0;
+};
+
+struct PressureResource {
+    const char* name = "";
+    int fd = -1;                    /* read side, pread at offset 0 */
+    int trigger_fd = -1;            /* same file with a trigger written to it */
+    bool valid = false;
+    bool has_full = false;          /* cpu has no "full" line before 5.13 */
+    PressureLine some;
+    PressureLine full;
+    bool stalled = false;           /* over the trigger threshold during the last interval */
+    uint64_t events = 0;            /* times it went over, since start */
+};
+
+/*
+ * Pressure Stall Information for cpu, memory and io.  Each resource also
+ * gets a PSI trigger ("some <stall> <window>"); the trigger fds sit in one
+ * epoll set that is the plugin's event fd, so a stall wakes the scheduler at
+ * once.  A stall starts a burst: a periodic timer in the same set keeps the
+ * plugin collecting every kBurstPeriod until kBurstLength passes without
+ * one.
+ */
+class PressureMonitor {
+public:
+    static constexpr auto kBurstPeriod = std::chrono::milliseconds(250);
+    static constexpr auto kBurstLength = std::chrono::seconds(5);
+
+    PressureMonitor() = default;
+    ~PressureMonitor();
+    PressureMonitor(const PressureMonitor&) = delete;
+    PressureMonitor& operator=(const PressureMonitor&) = delete;
+
+    /* Open the files and register the triggers; false when the kernel has no PSI. */
+    bool open();
+    /* Drain pending wakeups, then re-read every resource. */
+    void collect();
+    int eventFd() const { return epoll_fd_; }
+    bool bursting() const { return burst_; }
+
+    PressureResource resources[3];
+
+private:
+    void setBurst(bool on);
+
+    int epoll_fd_ = -1;
+    int timer_fd_ = -1;
+    bool opened_ = false;
+    bool burst_ = false;
+    std::chrono::steady_clock::time_point burst_until_{};
+    bool has_prev_ = false;
+    std::chrono::steady_clock::time_point prev_time_{};
+};
+
+}
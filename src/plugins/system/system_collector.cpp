@@ -1,26 +1,42 @@
 #include "system_collector.hpp"
 
 #include <algorithm>
+#include <cctype>
+#include <cerrno>
 #include <chrono>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
 #include <filesystem>
 #include <fstream>
 #include <ifaddrs.h>
-#include <linux/rtnetlink.h>
 #include <net/if.h>
 #include <netinet/in.h>
 #include <optional>
 #include <sstream>
 #include <string>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/statvfs.h>
+#include <sys/sysmacros.h>
 #include <sys/utsname.h>
+#include <unistd.h>
 #include <vector>
 
+#include "hmon/fs_root.hpp"
+
 namespace fs = std::filesystem;
 
 namespace {
 
+using hmon::core::procRoot;
+using hmon::core::sysRoot;
+
+using hmon::plugins::system::MountUsage;
+
+constexpr auto kMountRefreshInterval = std::chrono::seconds(10);
+
 std::string trim(const std::string& s) {
     auto b = s.find_first_not_of(" \t\r\n");
     if (b == std::string::npos) return "";
@@ -44,6 +60,73 @@ std::optional<std::string> readFirstLine(const fs::path& p) {
     return std::nullopt;
 }
 
+/* Read the whole file at offset 0, growing the buffer until it fits. */
+bool readWhole(int fd, std::string* buf) {
+    if (buf->empty()) buf->resize(8192);
+    while (true) {
+        const ssize_t n = pread(fd, buf->data(), buf->size(), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (static_cast<size_t>(n) < buf->size()) {
+            buf->resize(static_cast<size_t>(n));
+            return true;
+        }
+        buf->resize(buf->size() * 2);
+    }
+}
+
+void skipSpaces(const char** p, const char* end) {
+    while (*p < end && (**p == ' ' || **p == '\t')) ++*p;
+}
+
+uint64_t parseCounter(const char** p, const char* end) {
+    skipSpaces(p, end);
+    uint64_t v = 0;
+    while (*p < end && static_cast<unsigned>(**p - '0') < 10) v = v * 10 + static_cast<uint64_t>(*(*p)++ - '0');
+    return v;
+}
+
+/* The whole disk holding `dev` (e.g. 259:2 -> "nvme0n1"), from its /sys/dev/block link. */
+std::optional<std::string> blockDeviceName(dev_t dev) {
+    const fs::path link = fs::path(sysRoot()) / "dev" / "block" /
+                          (std::to_string(major(dev)) + ":" + std::to_string(minor(dev)));
+    std::error_code ec;
+    fs::path target = fs::canonical(link, ec);
+    if (ec) return std::nullopt;
+    if (fs::exists(target / "partition", ec)) target = target.parent_path();
+    std::string name = target.filename().string();
+    std::replace(name.begin(), name.end(), '!', '/');
+    return name;
+}
+
+/* /proc/self/mounts writes space, tab, newline and backslash as \\ooo. */
+std::string unescapeMountField(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '\\' && i + 3 < s.size() &&
+            std::isdigit(static_cast<unsigned char>(s[i + 1])) != 0) {
+            out.push_back(static_cast<char>(std::stoi(s.substr(i + 1, 3), nullptr, 8)));
+            i += 3;
+        } else {
+            out.push_back(s[i]);
+        }
+    }
+    return out;
+}
+
+/*
+ * Filesystems on a local block device, plus ZFS datasets.  Network mounts
+ * ("server:/path") are left out: statvfs() on a hung server blocks the
+ * plugin thread.  Read-only images (snaps, ISOs) are always full.
+ */
+bool isLocalFilesystem(const MountUsage& m) {
+    if (m.fstype == "zfs") return true;
+    return m.device.rfind("/dev/", 0) == 0 && m.fstype != "squashfs" && m.fstype != "iso9660";
+}
+
 bool isCpuDir(const std::string& name) {
     if (name.size() <= 3 || name.rfind("cpu", 0) != 0) return false;
     return std::all_of(name.begin() + 3, name.end(),
@@ -55,7 +138,7 @@ bool isCpuDir(const std::string& name) {
 namespace hmon::plugins::system {
 
 std::optional<long long> collectRamTotalKb() {
-    std::ifstream f("/proc/meminfo");
+    std::ifstream f(procRoot() + "/meminfo");
     if (!f) return std::nullopt;
     std::string line;
     while (std::getline(f, line)) {
@@ -69,7 +152,7 @@ std::optional<long long> collectRamTotalKb() {
 }
 
 std::optional<long long> collectRamAvailableKb() {
-    std::ifstream f("/proc/meminfo");
+    std::ifstream f(procRoot() + "/meminfo");
     if (!f) return std::nullopt;
     std::string line;
     while (std::getline(f, line)) {
@@ -83,7 +166,7 @@ std::optional<long long> collectRamAvailableKb() {
 }
 
 std::optional<double> getSwapUsagePercent() {
-    std::ifstream f("/proc/meminfo");
+    std::ifstream f(procRoot() + "/meminfo");
     if (!f) return std::nullopt;
     std::string line;
     long long total = 0, free = 0;
@@ -103,7 +186,7 @@ std::optional<double> getSwapUsagePercent() {
 }
 
 std::optional<long long> getSwapTotalKb() {
-    std::ifstream f("/proc/meminfo");
+    std::ifstream f(procRoot() + "/meminfo");
     if (!f) return std::nullopt;
     std::string line;
     while (std::getline(f, line)) {
@@ -117,7 +200,7 @@ std::optional<long long> getSwapTotalKb() {
 }
 
 std::optional<long long> getSwapFreeKb() {
-    std::ifstream f("/proc/meminfo");
+    std::ifstream f(procRoot() + "/meminfo");
     if (!f) return std::nullopt;
     std::string line;
     while (std::getline(f, line)) {
@@ -131,7 +214,12 @@ std::optional<long long> getSwapFreeKb() {
 }
 
 std::string detectRootDevice() {
-    std::ifstream mounts("/proc/self/mounts");
+    struct stat st;
+    if (stat("/", &st) == 0 && major(st.st_dev) != 0) {
+        if (auto name = blockDeviceName(st.st_dev)) return *name;
+    }
+
+    std::ifstream mounts(procRoot() + "/self/mounts");
     if (!mounts) return "sda";
     std::string line;
     while (std::getline(mounts, line)) {
@@ -154,16 +242,174 @@ std::string detectRootDevice() {
     return "sda";
 }
 
-std::optional<unsigned long long> collectDiskTotalBytes(const std::string& mount) {
-    struct statvfs st;
-    if (statvfs(mount.c_str(), &st) != 0) return std::nullopt;
-    return static_cast<unsigned long long>(st.f_frsize) * st.f_blocks;
+void collectMounts(SystemPluginCtx* ctx) {
+    const auto now = std::chrono::steady_clock::now();
+    if (ctx->mounts_loaded && now - ctx->mounts_checked < kMountRefreshInterval) return;
+    if (!ctx->mounts_loaded) {
+        if (const char* env = std::getenv("HMON_MOUNTS")) {
+            std::istringstream iss(env);
+            std::string mount;
+            while (std::getline(iss, mount, ',')) {
+                mount = trim(mount);
+                if (!mount.empty()) ctx->mount_list.push_back(mount);
+            }
+        }
+    }
+    ctx->mounts_checked = now;
+    ctx->mounts_loaded = true;
+
+    std::vector<MountUsage> candidates;
+    std::ifstream table(procRoot() + "/self/mounts");
+    std::string line;
+    while (std::getline(table, line)) {
+        std::istringstream iss(line);
+        MountUsage m;
+        if (!(iss >> m.device >> m.mount >> m.fstype)) continue;
+        m.device = unescapeMountField(m.device);
+        m.mount = unescapeMountField(m.mount);
+        candidates.push_back(std::move(m));
+    }
+
+    std::vector<MountUsage> selected;
+    if (!ctx->mount_list.empty()) {
+        for (const auto& wanted : ctx->mount_list) {
+            MountUsage m;
+            m.mount = wanted;
+            for (const auto& c : candidates) {
+                if (c.mount == wanted) m = c;   /* the last mount on a path is the visible one */
+            }
+            selected.push_back(std::move(m));
+        }
+    } else {
+        /* Every local filesystem once: bind mounts and btrfs subvolumes share a device. */
+        std::vector<std::string> devices;
+        for (const auto& c : candidates) {
+            if (c.mount != "/" && !isLocalFilesystem(c)) continue;
+            if (c.mount != "/" && std::find(devices.begin(), devices.end(), c.device) != devices.end()) continue;
+            auto same = std::find_if(selected.begin(), selected.end(),
+                                     [&](const MountUsage& m) { return m.mount == c.mount; });
+            if (same != selected.end()) {
+                *same = c;
+                continue;
+            }
+            devices.push_back(c.device);
+            selected.push_back(c);
+        }
+        if (std::none_of(selected.begin(), selected.end(), [](const MountUsage& m) { return m.mount == "/"; })) {
+            MountUsage root;
+            root.mount = "/";
+            selected.insert(selected.begin(), std::move(root));
+        }
+    }
+
+    ctx->mounts.clear();
+    for (auto& m : selected) {
+        struct statvfs st;
+        if (statvfs(m.mount.c_str(), &st) != 0) continue;
+        if (st.f_blocks == 0 && m.mount != "/") continue;
+        m.total_bytes = static_cast<uint64_t>(st.f_frsize) * st.f_blocks;
+        m.free_bytes = static_cast<uint64_t>(st.f_frsize) * st.f_bfree;
+        ctx->mounts.push_back(std::move(m));
+    }
+}
+
+SystemPluginCtx::~SystemPluginCtx() {
+    if (diskstats_fd >= 0) ::close(diskstats_fd);
+    if (net_dev_fd >= 0) ::close(net_dev_fd);
 }
 
-std::optional<unsigned long long> collectDiskFreeBytes(const std::string& mount) {
-    struct statvfs st;
-    if (statvfs(mount.c_str(), &st) != 0) return std::nullopt;
-    return static_cast<unsigned long long>(st.f_frsize) * st.f_bfree;
+bool collectDiskIo(SystemPluginCtx* ctx) {
+    if (ctx->diskstats_fd < 0) {
+        ctx->diskstats_fd = ::open((procRoot() + "/diskstats").c_str(), O_RDONLY | O_CLOEXEC);
+        if (ctx->diskstats_fd < 0) return false;
+    }
+    if (!readWhole(ctx->diskstats_fd, &ctx->diskstats_buf)) return false;
+
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsed_ms = std::chrono::duration<double, std::milli>(now - ctx->prev_disk_time).count();
+    ctx->prev_disk_time = now;
+
+    std::vector<DiskIoDevice> previous;
+    previous.swap(ctx->disks);
+    size_t hint = 0;
+
+    const char* p = ctx->diskstats_buf.data();
+    const char* end = p + ctx->diskstats_buf.size();
+    while (p < end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!eol) eol = end;
+        parseCounter(&p, eol);  /* major */
+        parseCounter(&p, eol);  /* minor */
+        skipSpaces(&p, eol);
+        const char* name_begin = p;
+        while (p < eol && *p != ' ') ++p;
+        std::string name(name_begin, p);
+
+        DiskIoCounters c;
+        c.reads = parseCounter(&p, eol);
+        parseCounter(&p, eol);  /* reads merged */
+        c.read_sectors = parseCounter(&p, eol);
+        c.read_ms = parseCounter(&p, eol);
+        c.writes = parseCounter(&p, eol);
+        parseCounter(&p, eol);  /* writes merged */
+        c.write_sectors = parseCounter(&p, eol);
+        c.write_ms = parseCounter(&p, eol);
+        parseCounter(&p, eol);  /* in flight */
+        c.io_ms = parseCounter(&p, eol);
+        c.weighted_ms = parseCounter(&p, eol);
+        p = eol < end ? eol + 1 : end;
+
+        /* Partitions would count their disk's I/O twice; loop and ram devices are noise. */
+        if (name.empty() || name.rfind("loop", 0) == 0 || name.rfind("ram", 0) == 0) continue;
+        auto known = ctx->whole_disk.find(name);
+        if (known == ctx->whole_disk.end()) {
+            std::string sys_name = name;
+            std::replace(sys_name.begin(), sys_name.end(), '/', '!');
+            std::error_code ec;
+            known = ctx->whole_disk.emplace(name, fs::exists(fs::path(sysRoot()) / "block" / sys_name, ec)).first;
+        }
+        if (!known->second || c.reads + c.writes == 0) continue;
+
+        DiskIoDevice dev;
+        dev.name = std::move(name);
+        dev.counters = c;
+
+        /* Devices keep their diskstats order, so the previous entry is almost always next in line. */
+        const DiskIoDevice* prev = nullptr;
+        if (hint < previous.size() && previous[hint].name == dev.name) {
+            prev = &previous[hint++];
+        } else {
+            for (size_t i = 0; i < previous.size(); ++i) {
+                if (previous[i].name == dev.name) {
+                    prev = &previous[i];
+                    hint = i + 1;
+                    break;
+                }
+            }
+        }
+
+        const DiskIoCounters& a = prev ? prev->counters : c;
+        if (prev && elapsed_ms > 0.0 && c.reads >= a.reads && c.writes >= a.writes && c.io_ms >= a.io_ms) {
+            const double seconds = elapsed_ms / 1000.0;
+            const uint64_t reads = c.reads - a.reads;
+            const uint64_t writes = c.writes - a.writes;
+            dev.has_rates = true;
+            dev.busy_pct = std::min(100.0, 100.0 * static_cast<double>(c.io_ms - a.io_ms) / elapsed_ms);
+            dev.read_iops = static_cast<double>(reads) / seconds;
+            dev.write_iops = static_cast<double>(writes) / seconds;
+            dev.read_bps = static_cast<double>(c.read_sectors - a.read_sectors) * 512.0 / seconds;
+            dev.write_bps = static_cast<double>(c.write_sectors - a.write_sectors) * 512.0 / seconds;
+            if (reads + writes > 0) {
+                dev.await_ms = static_cast<double>((c.read_ms - a.read_ms) + (c.write_ms - a.write_ms)) /
+                               static_cast<double>(reads + writes);
+            }
+            if (c.weighted_ms >= a.weighted_ms) {
+                dev.queue_depth = static_cast<double>(c.weighted_ms - a.weighted_ms) / elapsed_ms;
+            }
+        }
+        ctx->disks.push_back(std::move(dev));
+    }
+    return true;
 }
 
 std::string detectActiveInterface() {
@@ -185,114 +431,84 @@ std::string detectActiveInterface() {
     return best;
 }
 
-std::optional<double> collectRxKbps(SystemPluginCtx* ctx) {
-    struct ifaddrs* addrs = nullptr;
-    if (getifaddrs(&addrs) != 0) return std::nullopt;
-
-    unsigned long long rx_bytes = 0;
-    bool found = false;
-
-    if (ctx->active_interface.empty()) {
-        ctx->active_interface = detectActiveInterface();
-    }
-
-    for (struct ifaddrs* ifa = addrs; ifa; ifa = ifa->ifa_next) {
-        if (!ifa->ifa_name || std::string(ifa->ifa_name) != ctx->active_interface) continue;
-        if (ifa->ifa_flags & IFF_LOOPBACK) continue;
-        if (ifa->ifa_flags & IFF_RUNNING) {
-            rx_bytes = ifa->ifa_data ? reinterpret_cast<struct rtnl_link_stats*>(ifa->ifa_data)->rx_bytes : 0;
-            found = true;
-        }
-        break;
-    }
-    freeifaddrs(addrs);
-
-    if (!found) {
-        /* Fallback: parse /proc/net/dev */
-        std::ifstream f("/proc/net/dev");
-        if (!f) return std::nullopt;
-        std::string line;
-        while (std::getline(f, line)) {
-            if (line.find(ctx->active_interface + ":") == std::string::npos) continue;
-            std::istringstream iss(line.substr(line.find(':') + 1));
-            if (iss >> rx_bytes) found = true;
-            break;
-        }
-    }
-
-    if (!found) return std::nullopt;
-
-    auto now = std::chrono::steady_clock::now();
-    if (!ctx->net_initialized) {
-        ctx->prev_rx_bytes = rx_bytes;
-        ctx->prev_net_time = now;
-        ctx->net_initialized = true;
-        return 0.0;
+bool collectNetDev(SystemPluginCtx* ctx) {
+    if (ctx->net_dev_fd < 0) {
+        ctx->net_dev_fd = ::open((procRoot() + "/net/dev").c_str(), O_RDONLY | O_CLOEXEC);
+        if (ctx->net_dev_fd < 0) return false;
     }
+    if (!readWhole(ctx->net_dev_fd, &ctx->net_dev_buf)) return false;
 
-    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - ctx->prev_net_time).count();
-    if (elapsed <= 0) return 0.0;
-
-    double delta = static_cast<double>(rx_bytes - ctx->prev_rx_bytes);
-    ctx->prev_rx_bytes = rx_bytes;
+    const auto now = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(now - ctx->prev_net_time).count();
     ctx->prev_net_time = now;
 
-    return (delta / 1024.0) / (static_cast<double>(elapsed) / 1000.0);
-}
-
-std::optional<double> collectTxKbps(SystemPluginCtx* ctx) {
-    struct ifaddrs* addrs = nullptr;
-    if (getifaddrs(&addrs) != 0) return std::nullopt;
-
-    unsigned long long tx_bytes = 0;
-    bool found = false;
-
-    if (ctx->active_interface.empty()) {
-        ctx->active_interface = detectActiveInterface();
-    }
-
-    for (struct ifaddrs* ifa = addrs; ifa; ifa = ifa->ifa_next) {
-        if (!ifa->ifa_name || std::string(ifa->ifa_name) != ctx->active_interface) continue;
-        if (ifa->ifa_flags & IFF_LOOPBACK) continue;
-        if (ifa->ifa_flags & IFF_RUNNING) {
-            tx_bytes = ifa->ifa_data ? reinterpret_cast<struct rtnl_link_stats*>(ifa->ifa_data)->tx_bytes : 0;
-            found = true;
+    std::vector<NetInterface> previous;
+    previous.swap(ctx->interfaces);
+    size_t hint = 0;
+    bool active_seen = false;
+
+    const char* p = ctx->net_dev_buf.data();
+    const char* end = p + ctx->net_dev_buf.size();
+    while (p < end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!eol) eol = end;
+        const char* colon = static_cast<const char*>(std::memchr(p, ':', static_cast<size_t>(eol - p)));
+        if (!colon) {   /* the two header lines */
+            p = eol < end ? eol + 1 : end;
+            continue;
         }
-        break;
-    }
-    freeifaddrs(addrs);
-
-    if (!found) {
-        std::ifstream f("/proc/net/dev");
-        if (!f) return std::nullopt;
-        std::string line;
-        while (std::getline(f, line)) {
-            if (line.find(ctx->active_interface + ":") == std::string::npos) continue;
-            std::istringstream iss(line.substr(line.find(':') + 1));
-            unsigned long long rx;
-            if (iss >> rx >> rx >> rx >> rx >> rx >> rx >> rx >> rx >> tx_bytes) found = true;
-            break;
+        skipSpaces(&p, colon);
+        NetInterface iface;
+        iface.name.assign(p, colon);
+        p = colon + 1;
+
+        uint64_t fields[16] = {};
+        for (auto& f : fields) f = parseCounter(&p, eol);
+        p = eol < end ? eol + 1 : end;
+        if (iface.name == "lo") continue;
+
+        NetCounters& c = iface.counters;
+        c.rx_bytes = fields[0];
+        c.rx_packets = fields[1];
+        c.rx_drops = fields[3];
+        c.tx_bytes = fields[8];
+        c.tx_packets = fields[9];
+        c.tx_drops = fields[11];
+        if (iface.name == ctx->active_interface) active_seen = true;
+
+        /* /proc/net/dev keeps its order between reads, so the previous entry is almost always next. */
+        const NetInterface* prev = nullptr;
+        if (hint < previous.size() && previous[hint].name == iface.name) {
+            prev = &previous[hint++];
+        } else {
+            for (size_t i = 0; i < previous.size(); ++i) {
+                if (previous[i].name == iface.name) {
+                    prev = &previous[i];
+                    hint = i + 1;
+                    break;
+                }
+            }
         }
-    }
 
-    if (!found) return std::nullopt;
-
-    auto now = std::chrono::steady_clock::now();
-    if (!ctx->net_initialized) {
-        ctx->prev_tx_bytes = tx_bytes;
-        ctx->prev_net_time = now;
-        ctx->net_initialized = true;
-        return 0.0;
+        /* Counters reset when a driver reloads; skip that interval rather than report a wrap. */
+        if (prev && seconds > 0.0 && c.rx_bytes >= prev->counters.rx_bytes && c.tx_bytes >= prev->counters.tx_bytes) {
+            const NetCounters& a = prev->counters;
+            auto rate = [&](uint64_t now_v, uint64_t then_v) {
+                return now_v >= then_v ? static_cast<double>(now_v - then_v) / seconds : 0.0;
+            };
+            iface.has_rates = true;
+            iface.rx_bps = rate(c.rx_bytes, a.rx_bytes);
+            iface.tx_bps = rate(c.tx_bytes, a.tx_bytes);
+            iface.rx_pps = rate(c.rx_packets, a.rx_packets);
+            iface.tx_pps = rate(c.tx_packets, a.tx_packets);
+            iface.rx_drops_ps = rate(c.rx_drops, a.rx_drops);
+            iface.tx_drops_ps = rate(c.tx_drops, a.tx_drops);
+        }
+        ctx->interfaces.push_back(std::move(iface));
     }
 
-    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - ctx->prev_net_time).count();
-    if (elapsed <= 0) return 0.0;
-
-    double delta = static_cast<double>(tx_bytes - ctx->prev_tx_bytes);
-    ctx->prev_tx_bytes = tx_bytes;
-    ctx->prev_net_time = now;
-
-    return (delta / 1024.0) / (static_cast<double>(elapsed) / 1000.0);
+    if (!active_seen) ctx->active_interface = detectActiveInterface();
+    return true;
 }
 
 std::string currentTimestamp() {
@@ -1,29 +1,103 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "numa_stats.hpp"
+#include "pressure.hpp"
+
 namespace hmon::plugins::system {
 
-struct SystemPluginCtx {
+/* Cumulative /proc/diskstats counters of one block device. */
+struct DiskIoCounters {
+    uint64_t reads = 0;
+    uint64_t read_sectors = 0;
+    uint64_t read_ms = 0;
+    uint64_t writes = 0;
+    uint64_t write_sectors = 0;
+    uint64_t write_ms = 0;
+    uint64_t io_ms = 0;
+    uint64_t weighted_ms = 0;
+};
+
+/* A whole disk (sdX, nvmeXnY, md, dm) and its rates over the last interval. */
+struct DiskIoDevice {
+    std::string name;
+    DiskIoCounters counters;
+    bool has_rates = false;
+    double busy_pct = 0.0;
+    double read_iops = 0.0;
+    double write_iops = 0.0;
+    double read_bps = 0.0;
+    double write_bps = 0.0;
+    double await_ms = 0.0;          /* mean time per completed I/O, queueing included */
+    double queue_depth = 0.0;       /* mean requests in flight */
+};
+
+/* Cumulative /proc/net/dev counters of one interface. */
+struct NetCounters {
+    uint64_t rx_bytes = 0;
+    uint64_t rx_packets = 0;
+    uint64_t rx_drops = 0;
+    uint64_t tx_bytes = 0;
+    uint64_t tx_packets = 0;
+    uint64_t tx_drops = 0;
+};
 
-    unsigned long long prev_rx_bytes = 0;
-    unsigned long long prev_tx_bytes = 0;
-    bool net_initialized = false;
+/* An interface and its per-second rates over the last interval. */
+struct NetInterface {
+    std::string name;
+    NetCounters counters;
+    bool has_rates = false;
+    double rx_bps = 0.0;
+    double tx_bps = 0.0;
+    double rx_pps = 0.0;
+    double tx_pps = 0.0;
+    double rx_drops_ps = 0.0;
+    double tx_drops_ps = 0.0;
+};
+
+/* statvfs() of one mounted filesystem. */
+struct MountUsage {
+    std::string mount;
+    std::string device;
+    std::string fstype;
+    uint64_t total_bytes = 0;
+    uint64_t free_bytes = 0;
+};
+
+struct SystemPluginCtx {
+    int net_dev_fd = -1;
+    std::string net_dev_buf;
+    std::vector<NetInterface> interfaces;
     std::chrono::steady_clock::time_point prev_net_time;
     std::string active_interface;
 
+    std::vector<std::string> mount_list;    /* from HMON_MOUNTS; empty means every local filesystem */
+    std::vector<MountUsage> mounts;
+    std::chrono::steady_clock::time_point mounts_checked{};
+    bool mounts_loaded = false;
 
-    unsigned long long prev_read_sectors = 0;
-    unsigned long long prev_write_sectors = 0;
-    unsigned long long prev_io_time = 0;
-    bool disk_initialized = false;
+    int diskstats_fd = -1;
+    std::string diskstats_buf;
+    std::vector<DiskIoDevice> disks;
+    std::unordered_map<std::string, bool> whole_disk;    /* diskstats name -> listed in /sys/block */
     std::chrono::steady_clock::time_point prev_disk_time;
     std::string root_device;
+
+    PressureMonitor pressure;
+    NumaMonitor numa;
+
+    SystemPluginCtx() = default;
+    SystemPluginCtx(const SystemPluginCtx&) = delete;
+    SystemPluginCtx& operator=(const SystemPluginCtx&) = delete;
+    ~SystemPluginCtx();
 };
 
 std::optional<long long> collectRamTotalKb();
@@ -33,12 +107,14 @@ std::optional<long long> getSwapTotalKb();
 std::optional<long long> getSwapFreeKb();
 
 std::string detectRootDevice();
-std::optional<unsigned long long> collectDiskTotalBytes(const std::string& mount);
-std::optional<unsigned long long> collectDiskFreeBytes(const std::string& mount);
+/* Re-stat the mount set if the slow refresh interval has passed; ctx->mounts keeps the last result. */
+void collectMounts(SystemPluginCtx* ctx);
+/* One read of /proc/diskstats; refreshes ctx->disks.  Returns false if the file could not be read. */
+bool collectDiskIo(SystemPluginCtx* ctx);
 
 std::string detectActiveInterface();
-std::optional<double> collectRxKbps(SystemPluginCtx* ctx);
-std::optional<double> collectTxKbps(SystemPluginCtx* ctx);
+/* One read of /proc/net/dev; refreshes ctx->interfaces.  Returns false if the file could not be read. */
+bool collectNetDev(SystemPluginCtx* ctx);
 
 std::string currentTimestamp();
 std::string hostName();
@@ -0,0 +1,432 @@
+#include "bus_client.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace hmon::plugins::systemd {
+
+namespace {
+
+constexpr const char* kSystemBusSocket = "/run/dbus/system_bus_socket";
+constexpr size_t kMaxMessageBytes = 128u * 1024 * 1024;     /* the spec's limit */
+constexpr int kMaxNesting = 32;
+
+enum : uint8_t {
+    kFieldPath = 1,
+    kFieldInterface = 2,
+    kFieldMember = 3,
+    kFieldErrorName = 4,
+    kFieldReplySerial = 5,
+    kFieldDestination = 6,
+    kFieldSender = 7,
+    kFieldSignature = 8,
+};
+
+size_t alignOf(char type) {
+    switch (type) {
+    case 'n': case 'q': return 2;
+    case 'b': case 'i': case 'u': case 'h': case 's': case 'o': case 'a': return 4;
+    case 'x': case 't': case 'd': case '(': case '{': return 8;
+    default: return 1;
+    }
+}
+
+/* Step over one complete type in a signature without touching any data. */
+bool skipSignatureType(std::string_view sig, size_t* i, int depth = 0) {
+    if (depth > kMaxNesting || *i >= sig.size()) return false;
+    const char c = sig[(*i)++];
+    if (c == 'a') return skipSignatureType(sig, i, depth + 1);
+    if (c == '(' || c == '{') {
+        const char close = c == '(' ? ')' : '}';
+        while (*i < sig.size() && sig[*i] != close) {
+            if (!skipSignatureType(sig, i, depth + 1)) return false;
+        }
+        if (*i >= sig.size()) return false;
+        ++*i;
+    }
+    return true;
+}
+
+uint32_t rd32(const char* p, bool big_endian) {
+    const auto* u = reinterpret_cast<const uint8_t*>(p);
+    if (big_endian) return (uint32_t{u[0]} << 24) | (uint32_t{u[1]} << 16) | (uint32_t{u[2]} << 8) | u[3];
+    return u[0] | (uint32_t{u[1]} << 8) | (uint32_t{u[2]} << 16) | (uint32_t{u[3]} << 24);
+}
+
+/* Little-endian marshalling of the few types a method call needs. */
+struct BusWriter {
+    std::string buf;
+
+    void pad(size_t n) { while (buf.size() % n) buf.push_back('\0'); }
+    void byte(uint8_t v) { buf.push_back(static_cast<char>(v)); }
+    void u32(uint32_t v) {
+        pad(4);
+        for (int i = 0; i < 4; ++i) buf.push_back(static_cast<char>(v >> (i * 8)));
+    }
+    void string(std::string_view s) {
+        u32(static_cast<uint32_t>(s.size()));
+        buf.append(s);
+        buf.push_back('\0');
+    }
+    void signature(std::string_view s) {
+        byte(static_cast<uint8_t>(s.size()));
+        buf.append(s);
+        buf.push_back('\0');
+    }
+    void field(uint8_t code, char type, std::string_view value) {
+        pad(8);
+        byte(code);
+        signature(std::string_view(&type, 1));
+        if (type == 'g') signature(value);
+        else string(value);
+    }
+};
+
+std::string busSocketPath() {
+    const char* addr = std::getenv("DBUS_SYSTEM_BUS_ADDRESS");
+    if (!addr || !*addr) return kSystemBusSocket;
+    /* "unix:path=/run/dbus/system_bus_socket[,guid=...]"; only the first address is tried. */
+    std::string_view a(addr);
+    a = a.substr(0, a.find(';'));
+    if (a.rfind("unix:", 0) != 0) return "";
+    a.remove_prefix(5);
+    while (!a.empty()) {
+        std::string_view kv = a.substr(0, a.find(','));
+        a.remove_prefix(std::min(a.size(), kv.size() + 1));
+        if (kv.rfind("path=", 0) == 0) return std::string(kv.substr(5));
+        if (kv.rfind("abstract=", 0) == 0) {
+            std::string path;
+            path.push_back('\0');
+            path.append(kv.substr(9));
+            return path;
+        }
+    }
+    return "";
+}
+
+int remainingMs(std::chrono::steady_clock::time_point deadline) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    return left.count() > 0 ? static_cast<int>(left.count()) : 0;
+}
+
+}
+
+void BusReader::align(size_t n) {
+    size_t aligned = (pos_ + n - 1) & ~(n - 1);
+    if (aligned > data_.size()) { ok_ = false; return; }
+    /* Padding must be zero; anything else means we lost the framing. */
+    for (size_t i = pos_; i < aligned; ++i) {
+        if (data_[i] != '\0') ok_ = false;
+    }
+    pos_ = aligned;
+}
+
+bool BusReader::take(size_t n) {
+    if (!ok_ || n > data_.size() - pos_) {
+        ok_ = false;
+        return false;
+    }
+    pos_ += n;
+    return true;
+}
+
+uint8_t BusReader::byte() {
+    if (!take(1)) return 0;
+    return static_cast<uint8_t>(data_[pos_ - 1]);
+}
+
+uint32_t BusReader::u32() {
+    align(4);
+    if (!take(4)) return 0;
+    return rd32(data_.data() + pos_ - 4, big_endian_);
+}
+
+std::string_view BusReader::string() {
+    const uint32_t len = u32();
+    if (!ok_ || len >= data_.size() - pos_) {
+        ok_ = false;
+        return {};
+    }
+    std::string_view s = data_.substr(pos_, len);
+    pos_ += len + 1;
+    return s;
+}
+
+std::string_view BusReader::signature() {
+    const uint8_t len = byte();
+    if (!ok_ || len >= data_.size() - pos_) {
+        ok_ = false;
+        return {};
+    }
+    std::string_view s = data_.substr(pos_, len);
+    pos_ += len + 1u;
+    return s;
+}
+
+void BusReader::skip(std::string_view types) {
+    size_t i = 0;
+    while (ok_ && i < types.size()) skipOne(types, &i, 0);
+}
+
+void BusReader::skipOne(std::string_view sig, size_t* i, int depth) {
+    if (!ok_) return;
+    if (depth > kMaxNesting || *i >= sig.size()) { ok_ = false; return; }
+    const char c = sig[(*i)++];
+    switch (c) {
+    case 'y': take(1); return;
+    case 'n': case 'q': align(2); take(2); return;
+    case 'b': case 'i': case 'u': case 'h': align(4); take(4); return;
+    case 'x': case 't': case 'd': align(8); take(8); return;
+    case 's': case 'o': string(); return;
+    case 'g': signature(); return;
+    case 'v': {
+        const std::string_view inner = signature();
+        size_t j = 0;
+        skipOne(inner, &j, depth + 1);
+        if (j != inner.size()) ok_ = false;
+        return;
+    }
+    case 'a': {
+        const uint32_t len = u32();
+        if (*i >= sig.size()) { ok_ = false; return; }
+        align(alignOf(sig[*i]));
+        take(len);
+        if (!skipSignatureType(sig, i, depth + 1)) ok_ = false;
+        return;
+    }
+    case '(':
+        align(8);
+        while (ok_ && *i < sig.size() && sig[*i] != ')') skipOne(sig, i, depth + 1);
+        if (*i >= sig.size()) { ok_ = false; return; }
+        ++*i;
+        return;
+    case '{':
+        align(8);
+        skipOne(sig, i, depth + 1);
+        skipOne(sig, i, depth + 1);
+        if (*i >= sig.size() || sig[*i] != '}') { ok_ = false; return; }
+        ++*i;
+        return;
+    default:
+        ok_ = false;
+    }
+}
+
+BusConnection::~BusConnection() {
+    close();
+}
+
+void BusConnection::close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    serial_ = 0;
+    in_.clear();
+    in_pos_ = 0;
+}
+
+bool BusConnection::open(int timeout_ms) {
+    close();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    const std::string path = busSocketPath();
+    sockaddr_un addr{};
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.data(), path.size());
+    const auto len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + (path[0] ? 1 : 0));
+
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) return false;
+    /* Unix stream connects complete or fail at once unless the listen backlog is full. */
+    if (::connect(fd_, reinterpret_cast<sockaddr*>(&addr), len) != 0 && errno != EAGAIN) {
+        close();
+        return false;
+    }
+    if (!authenticate(remainingMs(deadline))) {
+        close();
+        return false;
+    }
+
+    const uint32_t hello = call("org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus", "Hello");
+    while (hello != 0) {
+        BusMessage msg;
+        while (next(&msg)) {
+            if (msg.reply_serial != hello) continue;
+            if (msg.type == kBusMethodReturn) return true;
+            close();
+            return false;
+        }
+        if (remainingMs(deadline) == 0 || !receive(remainingMs(deadline))) break;
+    }
+    close();
+    return false;
+}
+
+bool BusConnection::authenticate(int timeout_ms) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    static const char kHex[] = "0123456789abcdef";
+    std::string uid = std::to_string(geteuid());
+    std::string request(1, '\0');
+    request += "AUTH EXTERNAL ";
+    for (unsigned char c : uid) {
+        request.push_back(kHex[c >> 4]);
+        request.push_back(kHex[c & 0xf]);
+    }
+    request += "\r\n";
+    if (!sendAll(request, remainingMs(deadline))) return false;
+
+    std::string line;
+    while (line.find("\r\n") == std::string::npos) {
+        pollfd pfd{fd_, POLLIN, 0};
+        if (poll(&pfd, 1, remainingMs(deadline)) != 1) return false;
+        char buf[256];
+        const ssize_t n = recv(fd_, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+            return false;
+        }
+        line.append(buf, static_cast<size_t>(n));
+        if (line.size() > 4096) return false;
+    }
+    if (line.rfind("OK ", 0) != 0) return false;
+    /* The daemon sends nothing else before BEGIN, so whatever follows the line is ours to keep. */
+    in_ = line.substr(line.find("\r\n") + 2);
+    return sendAll("BEGIN\r\n", remainingMs(deadline));
+}
+
+bool BusConnection::sendAll(const std::string& data, int timeout_ms) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    size_t off = 0;
+    while (off < data.size()) {
+        const ssize_t n = send(fd_, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+        if (n > 0) {
+            off += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) {
+            pollfd pfd{fd_, POLLOUT, 0};
+            if (poll(&pfd, 1, remainingMs(deadline)) == 1) continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+uint32_t BusConnection::call(std::string_view destination, std::string_view path, std::string_view interface,
+                             std::string_view member, std::optional<std::string_view> arg) {
+    if (fd_ < 0) return 0;
+    BusWriter body;
+    if (arg) body.string(*arg);
+
+    const uint32_t serial = ++serial_;
+    BusWriter msg;
+    msg.byte('l');
+    msg.byte(kBusMethodCall);
+    msg.byte(0);
+    msg.byte(1);
+    msg.u32(static_cast<uint32_t>(body.buf.size()));
+    msg.u32(serial);
+    msg.u32(0);                         /* header field array length, patched below */
+    msg.field(kFieldPath, 'o', path);
+    msg.field(kFieldDestination, 's', destination);
+    msg.field(kFieldInterface, 's', interface);
+    msg.field(kFieldMember, 's', member);
+    if (arg) msg.field(kFieldSignature, 'g', "s");
+    const auto fields_len = static_cast<uint32_t>(msg.buf.size() - 16);
+    for (int i = 0; i < 4; ++i) msg.buf[12 + i] = static_cast<char>(fields_len >> (i * 8));
+    msg.pad(8);
+    msg.buf += body.buf;
+
+    if (!sendAll(msg.buf, 1000)) {
+        close();
+        return 0;
+    }
+    return serial;
+}
+
+bool BusConnection::receive(int timeout_ms) {
+    if (fd_ < 0) return false;
+    in_.erase(0, in_pos_);
+    in_pos_ = 0;
+
+    pollfd pfd{fd_, POLLIN, 0};
+    int rc = poll(&pfd, 1, timeout_ms);
+    if (rc < 0 && errno != EINTR) {
+        close();
+        return false;
+    }
+    if (rc <= 0) return true;
+
+    char buf[16384];
+    while (true) {
+        const ssize_t n = recv(fd_, buf, sizeof(buf), 0);
+        if (n > 0) {
+            in_.append(buf, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) return true;
+        close();
+        return false;
+    }
+}
+
+bool BusConnection::next(BusMessage* msg) {
+    if (fd_ < 0 || in_.size() - in_pos_ < 16) return false;
+    const char* p = in_.data() + in_pos_;
+    if (p[0] != 'l' && p[0] != 'B') {
+        close();
+        return false;
+    }
+    const bool big_endian = p[0] == 'B';
+    const uint32_t body_len = rd32(p + 4, big_endian);
+    const uint32_t fields_len = rd32(p + 12, big_endian);
+    const size_t header_len = (16 + size_t{fields_len} + 7) & ~size_t{7};
+    const size_t total = header_len + body_len;
+    if (total > kMaxMessageBytes) {
+        close();
+        return false;
+    }
+    if (in_.size() - in_pos_ < total) return false;
+
+    *msg = BusMessage{};
+    msg->type = static_cast<uint8_t>(p[1]);
+    msg->big_endian = big_endian;
+    msg->serial = rd32(p + 8, big_endian);
+    msg->body = std::string_view(p + header_len, body_len);
+
+    BusReader fields(std::string_view(p, 16 + size_t{fields_len}), big_endian);
+    fields.skip("yyyyuuu");
+    while (fields.ok() && !fields.atEnd()) {
+        fields.align(8);
+        const uint8_t code = fields.byte();
+        const std::string_view type = fields.signature();
+        if (code == kFieldPath && type == "o") msg->path = fields.string();
+        else if (code == kFieldInterface && type == "s") msg->interface = fields.string();
+        else if (code == kFieldMember && type == "s") msg->member = fields.string();
+        else if (code == kFieldReplySerial && type == "u") msg->reply_serial = fields.u32();
+        else if (code == kFieldSignature && type == "g") msg->signature = fields.signature();
+        else fields.skip(type);
+    }
+    if (!fields.ok()) {
+        close();
+        return false;
+    }
+    in_pos_ += total;
+    return true;
+}
+
+}
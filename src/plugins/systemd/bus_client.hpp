@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace hmon::plugins::systemd {
+
+/*
+ * Just enough of the D-Bus wire protocol to be one client of the system bus:
+ * EXTERNAL authentication, method calls with at most one string argument,
+ * and parsing of whatever comes back.  Values are read by the caller, who
+ * knows the signature, through BusReader.
+ */
+class BusReader {
+public:
+    BusReader(std::string_view data, bool big_endian) : data_(data), big_endian_(big_endian) {}
+
+    bool ok() const { return ok_; }
+    size_t pos() const { return pos_; }
+    bool atEnd() const { return pos_ >= data_.size(); }
+
+    void align(size_t n);
+    uint8_t byte();
+    uint32_t u32();
+    std::string_view string();          /* 's' and 'o' */
+    std::string_view signature();       /* 'g' */
+    /* Skip one value per complete type in `types`, e.g. "a{sv}" or "uso". */
+    void skip(std::string_view types);
+
+private:
+    bool take(size_t n);
+    void skipOne(std::string_view sig, size_t* i, int depth);
+
+    std::string_view data_;
+    size_t pos_ = 0;
+    bool big_endian_ = false;
+    bool ok_ = true;
+};
+
+enum BusMessageType : uint8_t {
+    kBusMethodCall = 1,
+    kBusMethodReturn = 2,
+    kBusError = 3,
+    kBusSignal = 4,
+};
+
+/* One parsed message; the views point into the connection's input buffer. */
+struct BusMessage {
+    uint8_t type = 0;
+    bool big_endian = false;
+    uint32_t serial = 0;
+    uint32_t reply_serial = 0;
+    std::string_view path;
+    std::string_view interface;
+    std::string_view member;
+    std::string_view signature;
+    std::string_view body;
+
+    BusReader reader() const { return BusReader(body, big_endian); }
+};
+
+/*
+ * Non-blocking connection to the system bus ($DBUS_SYSTEM_BUS_ADDRESS, else
+ * /run/dbus/system_bus_socket).  Any I/O or framing error closes it.
+ */
+class BusConnection {
+public:
+    BusConnection() = default;
+    ~BusConnection();
+    BusConnection(const BusConnection&) = delete;
+    BusConnection& operator=(const BusConnection&) = delete;
+
+    /* Connect, authenticate and say Hello within `timeout_ms`; false on any failure. */
+    bool open(int timeout_ms);
+    void close();
+    bool connected() const { return fd_ >= 0; }
+    int fd() const { return fd_; }
+
+    /* Send a method call; returns its serial, or 0 if the connection dropped. */
+    uint32_t call(std::string_view destination, std::string_view path, std::string_view interface,
+                  std::string_view member, std::optional<std::string_view> arg = std::nullopt);
+    /* Read everything queued, first waiting up to `timeout_ms` for it; false once closed. */
+    bool receive(int timeout_ms);
+    /* Pop the next complete message; its views stay valid until the next receive(). */
+    bool next(BusMessage* msg);
+
+private:
+    bool sendAll(const std::string& data, int timeout_ms);
+    bool authenticate(int timeout_ms);
+
+    int fd_ = -1;
+    uint32_t serial_ = 0;
+    std::string in_;
+    size_t in_pos_ = 0;
+};
+
+}
@@ -10,12 +10,14 @@
 
 extern "C" {
     int systemd_plugin_init(hmon_plugin_ctx**);
-    int systemd_plugin_collect(hmon_plugin_ctx*, hmon_metric_list*);
+    int systemd_plugin_collect(hmon_plugin_ctx*, hmon_metric_list*, hmon_arena*);
     void systemd_plugin_destroy(hmon_plugin_ctx*);
-    void systemd_plugin_free_list(hmon_metric_list*);
+    int systemd_plugin_event_fd(hmon_plugin_ctx*);
 }
 
-HMON_STATIC_PLUGIN("systemd", systemd_plugin_init, systemd_plugin_collect, systemd_plugin_destroy, systemd_plugin_free_list, nullptr)
+/* Signals wake the plugin through its bus socket; the interval only paces reconnects and re-lists. */
+HMON_STATIC_PLUGIN_EVENTS("systemd", systemd_plugin_init, systemd_plugin_collect, systemd_plugin_destroy, nullptr, 10000,
+                          systemd_plugin_event_fd)
 
 extern "C" {
 
@@ -27,61 +29,44 @@ HMON_PLUGIN_EXPORT int systemd_plugin_init(hmon_plugin_ctx** out) {
     return 0;
 }
 
-static void appendMetric(hmon_metric_list* list, const char* key, int type, const void* value) {
-    if (list->count >= list->capacity) {
-        size_t new_cap = list->capacity == 0 ? 64 : list->capacity * 2;
-        auto* new_items = static_cast<hmon_metric*>(std::realloc(list->items, new_cap * sizeof(hmon_metric)));
-        if (!new_items) return;
-        list->items = new_items;
-        list->capacity = new_cap;
-    }
-    auto* item = &list->items[list->count];
-    item->key = key;
-    item->value.type = type;
-    switch (type) {
-    case HMON_VAL_STRING: item->value.v.str = strdup(static_cast<const char*>(value) ? static_cast<const char*>(value) : ""); break;
-    case HMON_VAL_INT64: item->value.v.i64 = *static_cast<const int64_t*>(value); break;
-    case HMON_VAL_DOUBLE: item->value.v.f64 = *static_cast<const double*>(value); break;
-    case HMON_VAL_BOOL: item->value.v.b = *static_cast<const int32_t*>(value); break;
-    }
-    ++list->count;
-}
+static const hmon_table_column kColumns[] = {
+    {"name", HMON_VAL_STRING},
+    {"state", HMON_VAL_STRING},
+    {"sub", HMON_VAL_STRING},
+    {"desc", HMON_VAL_STRING},
+};
+enum : uint32_t {
+    kColName,
+    kColState,
+    kColSub,
+    kColDesc,
+    kColumnCount
+};
 
-HMON_PLUGIN_EXPORT int systemd_plugin_collect(hmon_plugin_ctx* ctx, hmon_metric_list* out_list) {
-    if (!ctx || !out_list) return -1;
+HMON_PLUGIN_EXPORT int systemd_plugin_collect(hmon_plugin_ctx* ctx, hmon_metric_list* out_list, hmon_arena* arena) {
+    if (!ctx || !out_list || !arena) return -1;
     auto* c = reinterpret_cast<hmon::plugins::systemd::SystemdPluginCtx*>(ctx);
     auto services = hmon::plugins::systemd::collectServices(c);
-    for (size_t i = 0; i < services.size(); ++i) {
+    auto* table = hmon_metric_append_table(out_list, arena, HMON_METRIC_SYSTEMD_TABLE, kColumns, kColumnCount, static_cast<uint32_t>(services.size()));
+    if (!table) return 0;
+    for (uint32_t i = 0; i < table->row_count; ++i) {
         const auto& s = services[i];
-        char key[256];
-        std::snprintf(key, sizeof(key), "systemd.%zu.name", i);
-        appendMetric(out_list, strdup(key), HMON_VAL_STRING, s.name.c_str());
-        std::snprintf(key, sizeof(key), "systemd.%zu.state", i);
-        appendMetric(out_list, strdup(key), HMON_VAL_STRING, s.active_state.c_str());
-        std::snprintf(key, sizeof(key), "systemd.%zu.sub", i);
-        appendMetric(out_list, strdup(key), HMON_VAL_STRING, s.sub_state.c_str());
-        std::snprintf(key, sizeof(key), "systemd.%zu.desc", i);
-        appendMetric(out_list, strdup(key), HMON_VAL_STRING, s.description.c_str());
+        hmon_table_set_str(arena, table, i, kColName, s.name.c_str());
+        hmon_table_set_str(arena, table, i, kColState, s.active_state.c_str());
+        hmon_table_set_str(arena, table, i, kColSub, s.sub_state.c_str());
+        hmon_table_set_str(arena, table, i, kColDesc, s.description.c_str());
     }
     return 0;
 }
 
+HMON_PLUGIN_EXPORT int systemd_plugin_event_fd(hmon_plugin_ctx* ctx) {
+    if (!ctx) return -1;
+    return reinterpret_cast<hmon::plugins::systemd::SystemdPluginCtx*>(ctx)->bus.fd();
+}
+
 HMON_PLUGIN_EXPORT void systemd_plugin_destroy(hmon_plugin_ctx* ctx) {
     if (!ctx) return;
     delete reinterpret_cast<hmon::plugins::systemd::SystemdPluginCtx*>(ctx);
 }
 
-HMON_PLUGIN_EXPORT void systemd_plugin_free_list(hmon_metric_list* list) {
-    if (!list) return;
-    for (size_t i = 0; i < list->count; ++i) {
-        if (list->items[i].value.type == HMON_VAL_STRING && list->items[i].value.v.str)
-            free(const_cast<char*>(list->items[i].value.v.str));
-        free(const_cast<char*>(list->items[i].key));
-    }
-    free(list->items);
-    list->items = nullptr;
-    list->count = 0;
-    list->capacity = 0;
-}
-
 }
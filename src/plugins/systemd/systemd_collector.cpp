@@ -2,106 +2,184 @@
 
 #include <algorithm>
 #include <chrono>
-#include <cstring>
-#include <dirent.h>
-#include <filesystem>
-#include <fstream>
-#include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
-namespace fs = std::filesystem;
-
 namespace {
 
-static std::string trim(const std::string& s) {
-    auto b = s.find_first_not_of(" \t\r\n");
-    if (b == std::string::npos) return "";
-    auto e = s.find_last_not_of(" \t\r\n");
-    return s.substr(b, e - b + 1);
+using hmon::plugins::systemd::BusMessage;
+using hmon::plugins::systemd::BusReader;
+using hmon::plugins::systemd::ServiceInfo;
+using hmon::plugins::systemd::SystemdPluginCtx;
+
+constexpr const char* kSystemd = "org.freedesktop.systemd1";
+constexpr const char* kManagerPath = "/org/freedesktop/systemd1";
+constexpr const char* kManager = "org.freedesktop.systemd1.Manager";
+constexpr const char* kUnit = "org.freedesktop.systemd1.Unit";
+constexpr const char* kProperties = "org.freedesktop.DBus.Properties";
+constexpr std::string_view kServiceSuffix = ".service";
+constexpr std::string_view kServicePathSuffix = "_2eservice";   /* ".service" as escaped in object paths */
+
+constexpr int kConnectTimeoutMs = 1000;
+constexpr int kCallTimeoutMs = 2000;
+constexpr auto kRetryInterval = std::chrono::seconds(30);
+
+bool endsWith(std::string_view s, std::string_view suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
 }
 
-static std::string parseDescriptionFromFile(const fs::path& unit_file) {
-    std::ifstream f(unit_file);
-    if (!f) return "";
-    std::string line;
-    while (std::getline(f, line)) {
-        if (line.rfind("Description=", 0) == 0) {
-            return trim(line.substr(12));
-        }
+/* ListUnits: a(ssssssouso) = name, description, load, active, sub, following, path, job id/type/path. */
+bool parseListUnits(SystemdPluginCtx* ctx, const BusMessage& msg) {
+    if (msg.signature != "a(ssssssouso)") return false;
+    BusReader r = msg.reader();
+    const uint32_t len = r.u32();
+    r.align(8);
+    const size_t end = r.pos() + len;
+    ctx->units.clear();
+    while (r.ok() && r.pos() < end) {
+        r.align(8);
+        std::string_view name = r.string();
+        std::string_view description = r.string();
+        std::string_view load = r.string();
+        std::string_view active = r.string();
+        std::string_view sub = r.string();
+        r.string();
+        std::string_view path = r.string();
+        r.skip("uso");
+        if (!r.ok() || !endsWith(name, kServiceSuffix)) continue;
+
+        ServiceInfo& si = ctx->units[std::string(path)];
+        si.name = std::string(name.substr(0, name.size() - kServiceSuffix.size()));
+        si.description = description.empty() ? si.name : std::string(description);
+        si.load_state = std::string(load);
+        si.active_state = std::string(active);
+        si.sub_state = std::string(sub);
     }
-    return "";
+    return r.ok();
 }
 
-static std::string resolveServiceDescription(const std::string& unit_name) {
-    static std::vector<fs::path> search_dirs = {
-        "/run/systemd/system",
-        "/etc/systemd/system",
-        "/usr/lib/systemd/system",
-        "/lib/systemd/system"
-    };
-    for (const auto& dir : search_dirs) {
-        fs::path p = dir / (unit_name + ".service");
-        if (fs::exists(p)) {
-            std::string desc = parseDescriptionFromFile(p);
-            if (!desc.empty()) return desc;
+/* PropertiesChanged: s interface, a{sv} changed, as invalidated. */
+void applyPropertiesChanged(SystemdPluginCtx* ctx, const BusMessage& msg) {
+    if (msg.signature != "sa{sv}as") return;
+    BusReader r = msg.reader();
+    if (r.string() != kUnit) return;
+
+    auto it = ctx->units.find(std::string(msg.path));
+    if (it == ctx->units.end()) {
+        if (endsWith(msg.path, kServicePathSuffix)) ctx->resync = true;
+        return;
+    }
+    ServiceInfo& si = it->second;
+
+    const uint32_t len = r.u32();
+    r.align(8);
+    const size_t end = r.pos() + len;
+    while (r.ok() && r.pos() < end) {
+        r.align(8);
+        std::string_view key = r.string();
+        std::string_view type = r.signature();
+        if (type != "s") {
+            r.skip(type);
+            continue;
         }
+        std::string_view value = r.string();
+        if (key == "ActiveState") si.active_state = std::string(value);
+        else if (key == "SubState") si.sub_state = std::string(value);
+        else if (key == "LoadState") si.load_state = std::string(value);
+        else if (key == "Description") si.description = std::string(value);
+    }
+
+    const uint32_t invalidated_len = r.u32();
+    const size_t invalidated_end = r.pos() + invalidated_len;
+    while (r.ok() && r.pos() < invalidated_end) {
+        std::string_view key = r.string();
+        if (key == "ActiveState" || key == "SubState" || key == "LoadState" || key == "Description") ctx->resync = true;
     }
-    return unit_name;
+    if (!r.ok()) ctx->resync = true;
 }
 
-static void scanUnitFiles(std::vector<std::string>& out_unit_names) {
-    static std::vector<fs::path> search_dirs = {
-        "/run/systemd/system",
-        "/etc/systemd/system",
-        "/usr/lib/systemd/system",
-        "/lib/systemd/system"
-    };
-    for (const auto& dir : search_dirs) {
-        std::error_code ec;
-        if (!fs::exists(dir, ec)) continue;
-        fs::directory_iterator it(dir, ec);
-        if (ec) continue;
-        for (const auto& entry : it) {
-            std::string fname = entry.path().filename().string();
-            if (fname.size() < 9) continue;
-            if (fname.rfind(".service") != fname.size() - 8) continue;
-            std::string unit = fname.substr(0, fname.size() - 8);
-            if (std::find(out_unit_names.begin(), out_unit_names.end(), unit) == out_unit_names.end()) {
-                out_unit_names.push_back(unit);
-            }
+void dispatch(SystemdPluginCtx* ctx, const BusMessage& msg) {
+    if (msg.type == hmon::plugins::systemd::kBusMethodReturn || msg.type == hmon::plugins::systemd::kBusError) {
+        const bool ok = msg.type == hmon::plugins::systemd::kBusMethodReturn;
+        if (msg.reply_serial != 0 && msg.reply_serial == ctx->list_serial) {
+            ctx->list_serial = 0;
+            ctx->resync = !(ok && parseListUnits(ctx, msg));
+        } else if (msg.reply_serial != 0 && msg.reply_serial == ctx->subscribe_serial) {
+            ctx->subscribe_serial = 0;
+            ctx->subscribed = ok;
+        }
+        return;
+    }
+    if (msg.type != hmon::plugins::systemd::kBusSignal) return;
+
+    if (msg.interface == kProperties && msg.member == "PropertiesChanged") {
+        applyPropertiesChanged(ctx, msg);
+    } else if (msg.interface == kManager && (msg.member == "UnitNew" || msg.member == "UnitRemoved")) {
+        BusReader r = msg.reader();
+        std::string_view id = r.string();
+        std::string_view path = r.string();
+        if (!r.ok() || !endsWith(id, kServiceSuffix)) return;
+        if (msg.member == "UnitRemoved") ctx->units.erase(std::string(path));
+        else if (!ctx->units.count(std::string(path))) ctx->resync = true;
+    } else if (msg.interface == kManager && msg.member == "Reloading") {
+        /* b active: false once a daemon-reload has finished. */
+        BusReader r = msg.reader();
+        if (r.u32() == 0 && r.ok()) ctx->resync = true;
+    } else if (msg.interface == "org.freedesktop.DBus" && msg.member == "NameOwnerChanged") {
+        /* systemd re-executed and took its name back: subscriptions are per owner. */
+        BusReader r = msg.reader();
+        r.string();
+        r.string();
+        if (!r.string().empty() && r.ok()) {
+            ctx->resync = true;
+            ctx->subscribe_serial = ctx->bus.call(kSystemd, kManagerPath, kManager, "Subscribe");
         }
     }
 }
 
-static bool serviceHasProcs(const std::string& unit_name) {
-    std::vector<fs::path> cgroup_paths = {
-        fs::path("/sys/fs/cgroup/system.slice") / (unit_name + ".service") / "cgroup.procs",
-        fs::path("/sys/fs/cgroup/systemd/system.slice") / (unit_name + ".service") / "cgroup.procs",
-        fs::path("/sys/fs/cgroup") / (unit_name + ".service") / "cgroup.procs",
-    };
-    for (const auto& p : cgroup_paths) {
-        std::ifstream f(p);
-        if (!f) continue;
-        std::string line;
-        if (std::getline(f, line) && !trim(line).empty()) return true;
+/* Handle everything that arrives within `timeout_ms`; false once the connection is gone. */
+bool pump(SystemdPluginCtx* ctx, int timeout_ms) {
+    if (!ctx->bus.receive(timeout_ms)) return false;
+    BusMessage msg;
+    while (ctx->bus.next(&msg)) dispatch(ctx, msg);
+    return ctx->bus.connected();
+}
+
+bool listUnits(SystemdPluginCtx* ctx) {
+    ctx->list_serial = ctx->bus.call(kSystemd, kManagerPath, kManager, "ListUnits");
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kCallTimeoutMs);
+    while (ctx->list_serial != 0) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0 || !pump(ctx, static_cast<int>(left.count()))) return false;
     }
-    return false;
+    return !ctx->resync;
 }
 
-static bool serviceIsFailed(const std::string& unit_name) {
-    std::string path = "/run/systemd/units/invocation:" + unit_name + ".service";
-    if (!fs::exists(path)) return false;
-    std::ifstream f(path);
-    if (!f) return false;
-    std::string content;
-    std::getline(f, content);
-    content = trim(content);
-    return content == "failed" || content.find("failed") != std::string::npos;
+bool connectBus(SystemdPluginCtx* ctx) {
+    ctx->units.clear();
+    ctx->list_serial = 0;
+    ctx->subscribed = true;
+    ctx->resync = false;
+    if (!ctx->bus.open(kConnectTimeoutMs)) return false;
+
+    const std::string owner_match = std::string("type='signal',sender='org.freedesktop.DBus',member='NameOwnerChanged',"
+                                                "arg0='") + kSystemd + "'";
+    const std::string manager_match = std::string("type='signal',sender='") + kSystemd + "',interface='" + kManager + "'";
+    const std::string unit_match = std::string("type='signal',sender='") + kSystemd + "',interface='" + kProperties +
+                                   "',member='PropertiesChanged',path_namespace='/org/freedesktop/systemd1/unit'";
+    for (const auto& rule : {owner_match, manager_match, unit_match}) {
+        ctx->bus.call("org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus", "AddMatch", rule);
+    }
+    /* systemd only emits unit signals while at least one client is subscribed. */
+    ctx->subscribe_serial = ctx->bus.call(kSystemd, kManagerPath, kManager, "Subscribe");
+    return listUnits(ctx);
 }
 
-static bool isSystemdRunning() {
-    return fs::exists("/run/systemd/system");
+bool isShown(const ServiceInfo& si) {
+    if (si.active_state == "failed") return true;
+    /* Oneshot services sit in active/exited with nothing running; the old cgroup scan skipped them too. */
+    return si.active_state != "inactive" && si.sub_state != "exited" && si.sub_state != "dead";
 }
 
 }
@@ -109,46 +187,26 @@ static bool isSystemdRunning() {
 namespace hmon::plugins::systemd {
 
 std::vector<ServiceInfo> collectServices(SystemdPluginCtx* ctx) {
-    if (ctx) {
-        auto elapsed = std::chrono::steady_clock::now() - ctx->last_cache_time;
-        if (!ctx->cached_result.empty() &&
-            std::chrono::duration_cast<std::chrono::seconds>(elapsed).count() < SystemdPluginCtx::TTL_SECONDS) {
-            return ctx->cached_result;
-        }
-    }
-
     std::vector<ServiceInfo> result;
-
-    if (!isSystemdRunning()) {
-        if (ctx) {
-            ctx->cached_result = result;
-            ctx->last_cache_time = std::chrono::steady_clock::now();
+    if (!ctx) return result;
+
+    if (!ctx->bus.connected()) {
+        auto now = std::chrono::steady_clock::now();
+        if (now < ctx->retry_at) return result;
+        if (!connectBus(ctx)) {
+            ctx->bus.close();
+            ctx->retry_at = now + kRetryInterval;
+            return result;
         }
+    } else if (!pump(ctx, 0) || ((ctx->resync || !ctx->subscribed) && !listUnits(ctx))) {
+        ctx->bus.close();
+        ctx->units.clear();
         return result;
     }
 
-    std::vector<std::string> unit_names;
-    scanUnitFiles(unit_names);
-
-    for (const auto& unit : unit_names) {
-        ServiceInfo si;
-        si.name = unit;
-        si.description = resolveServiceDescription(unit);
-        si.load_state = "loaded";
-
-        if (serviceIsFailed(unit)) {
-            si.active_state = "failed";
-            si.sub_state = "failed";
-        } else if (serviceHasProcs(unit)) {
-            si.active_state = "active";
-            si.sub_state = "running";
-        }
-
-        if (si.active_state == "active" || si.active_state == "failed") {
-            result.push_back(std::move(si));
-        }
+    for (const auto& [path, si] : ctx->units) {
+        if (isShown(si)) result.push_back(si);
     }
-
     std::sort(result.begin(), result.end(),
               [](const ServiceInfo& a, const ServiceInfo& b) {
                   bool a_failed = (a.active_state == "failed");
@@ -157,10 +215,6 @@ std::vector<ServiceInfo> collectServices(SystemdPluginCtx* ctx) {
                   return a.name < b.name;
               });
 
-    if (ctx) {
-        ctx->cached_result = result;
-        ctx->last_cache_time = std::chrono::steady_clock::now();
-    }
     return result;
 }
 
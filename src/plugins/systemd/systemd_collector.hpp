@@ -1,9 +1,13 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "bus_client.hpp"
+
 namespace hmon::plugins::systemd {
 
 struct ServiceInfo {
@@ -14,11 +18,20 @@ struct ServiceInfo {
     std::string description;
 };
 
+/*
+ * Service state mirrored from org.freedesktop.systemd1: one ListUnits call
+ * when the connection comes up, then PropertiesChanged/UnitNew/UnitRemoved
+ * signals after Subscribe.  The bus socket is the plugin's event fd, so a
+ * state change is collected as soon as it arrives.
+ */
 struct SystemdPluginCtx {
-    std::vector<ServiceInfo> services;
-    std::vector<ServiceInfo> cached_result;
-    std::chrono::steady_clock::time_point last_cache_time;
-    static constexpr int TTL_SECONDS = 10;
+    BusConnection bus;
+    std::unordered_map<std::string, ServiceInfo> units;     /* .service units by object path */
+    uint32_t list_serial = 0;           /* outstanding ListUnits call */
+    uint32_t subscribe_serial = 0;
+    bool subscribed = false;            /* false: systemd refused, so re-list every collect */
+    bool resync = false;                /* a signal we cannot apply in place; re-list */
+    std::chrono::steady_clock::time_point retry_at{};
 };
 
 std::vector<ServiceInfo> collectServices(SystemdPluginCtx* ctx);
@@ -1,19 +1,36 @@
 #include "webserver_collector.hpp"
 
+#include <arpa/inet.h>
+#include <cerrno>
 #include <chrono>
-#include <cstdio>
 #include <filesystem>
 #include <fstream>
+#include <netinet/in.h>
+#include <poll.h>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <strings.h>
+#include <sys/socket.h>
 #include <unistd.h>
 #include <unordered_map>
 #include <vector>
 
+#include "hmon/fs_root.hpp"
+
 namespace fs = std::filesystem;
 
 namespace {
 
+using hmon::core::sysRoot;
+
+using hmon::plugins::webserver::StatusEndpoint;
+using hmon::plugins::webserver::StatusSource;
+using hmon::plugins::webserver::WebServerInfo;
+
+constexpr int kProbeTimeoutMs = 500;
+constexpr size_t kMaxResponseBytes = 64 * 1024;
+
 static std::string trim(const std::string& s) {
     auto b = s.find_first_not_of(" \t\r\n");
     if (b == std::string::npos) return "";
@@ -21,16 +38,6 @@ static std::string trim(const std::string& s) {
     return s.substr(b, e - b + 1);
 }
 
-static std::string runCmd(const std::string& cmd) {
-    std::string result;
-    FILE* pipe = popen((cmd + " 2>/dev/null").c_str(), "r");
-    if (!pipe) return "";
-    char buf[256];
-    while (fgets(buf, sizeof(buf), pipe)) result += buf;
-    pclose(pipe);
-    return trim(result);
-}
-
 static bool cmdExists(const std::string& cmd) {
     static std::unordered_map<std::string, bool> cache;
     auto it = cache.find(cmd);
@@ -53,8 +60,8 @@ static bool cmdExists(const std::string& cmd) {
 
 static bool systemdServiceActive(const std::string& name) {
     std::vector<fs::path> cgroup_paths = {
-        fs::path("/sys/fs/cgroup/system.slice") / (name + ".service"),
-        fs::path("/sys/fs/cgroup/systemd/system.slice") / (name + ".service"),
+        fs::path(sysRoot()) / "fs/cgroup/system.slice" / (name + ".service"),
+        fs::path(sysRoot()) / "fs/cgroup/systemd/system.slice" / (name + ".service"),
     };
     for (const auto& p : cgroup_paths) {
         if (fs::exists(p)) {
@@ -69,95 +76,353 @@ static bool systemdServiceActive(const std::string& name) {
     return false;
 }
 
-static std::string httpGet(const std::string& url, int timeout_ms = 1000) {
-    char cmd[512];
-    std::snprintf(cmd, sizeof(cmd), "curl -s --max-time %d %s 2>/dev/null", timeout_ms / 1000, url.c_str());
-    return runCmd(cmd);
+static void closeEndpoint(StatusEndpoint* ep) {
+    if (ep->fd >= 0) ::close(ep->fd);
+    ep->fd = -1;
+    ep->connecting = false;
 }
 
+static void failEndpoint(StatusEndpoint* ep) {
+    closeEndpoint(ep);
+    ep->done = true;
+    ep->status_code = 0;
+    ep->body.clear();
 }
 
-namespace hmon::plugins::webserver {
+/* Queue a GET on the endpoint's kept connection, or start a non-blocking connect. */
+static bool startRequest(StatusEndpoint* ep) {
+    ep->done = false;
+    ep->status_code = 0;
+    ep->body.clear();
+    ep->response.clear();
+    ep->sent = 0;
+    ep->request = std::string("GET ") + ep->path + " HTTP/1.1\r\n"
+                  "Host: 127.0.0.1\r\n"
+                  "User-Agent: hmon\r\n"
+                  "Accept: */*\r\n\r\n";
+    ep->reused = ep->fd >= 0;
+    if (ep->fd >= 0) return true;
 
-std::vector<WebServerInfo> collectWebServers(WebServerPluginCtx* ctx) {
-    if (ctx) {
-        auto elapsed = std::chrono::steady_clock::now() - ctx->last_cache_time;
-        if (!ctx->cached_result.empty() &&
-            std::chrono::duration_cast<std::chrono::seconds>(elapsed).count() < WebServerPluginCtx::TTL_SECONDS) {
-            return ctx->cached_result;
+    ep->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (ep->fd < 0) return false;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(ep->port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(ep->fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+        if (errno != EINPROGRESS) {
+            closeEndpoint(ep);
+            return false;
         }
+        ep->connecting = true;
+    }
+    return true;
+}
+
+/* A kept connection the server has since closed fails without a byte of reply; dial once more. */
+static void retryOrFail(StatusEndpoint* ep) {
+    if (ep->reused && ep->response.empty()) {
+        closeEndpoint(ep);
+        if (startRequest(ep)) return;
     }
+    failEndpoint(ep);
+}
 
+static std::string_view headerValue(std::string_view head, std::string_view name) {
+    size_t pos = head.find("\r\n");
+    while (pos != std::string_view::npos) {
+        pos += 2;
+        size_t end = head.find("\r\n", pos);
+        std::string_view line = head.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos);
+        if (line.size() > name.size() && line[name.size()] == ':' &&
+            strncasecmp(line.data(), name.data(), name.size()) == 0) {
+            std::string_view value = line.substr(name.size() + 1);
+            while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+            return value;
+        }
+        pos = end;
+    }
+    return {};
+}
+
+/* Decode a chunked body; false until the terminating chunk has arrived. */
+static bool decodeChunked(std::string_view data, std::string* body) {
+    body->clear();
+    size_t pos = 0;
+    while (true) {
+        size_t eol = data.find("\r\n", pos);
+        if (eol == std::string_view::npos) return false;
+        size_t len = 0;
+        try { len = std::stoul(std::string(data.substr(pos, eol - pos)), nullptr, 16); } catch (...) { return false; }
+        pos = eol + 2;
+        if (len == 0) return true;
+        if (data.size() < pos + len + 2) return false;
+        body->append(data.substr(pos, len));
+        pos += len + 2;
+    }
+}
+
+/* Parse what has arrived; true once the response is complete.  Sets `keep` if the connection may be reused. */
+static bool responseComplete(StatusEndpoint* ep, bool eof, bool* keep) {
+    const size_t head_end = ep->response.find("\r\n\r\n");
+    if (head_end == std::string::npos) return false;
+    std::string_view head(ep->response.data(), head_end);
+    std::string_view rest(ep->response.data() + head_end + 4, ep->response.size() - head_end - 4);
+
+    if (head.size() < 12 || head.substr(0, 5) != "HTTP/") {
+        *keep = false;
+        ep->status_code = 0;
+        return true;
+    }
+    ep->status_code = std::atoi(head.data() + 9);
+    const std::string_view connection = headerValue(head, "Connection");
+    *keep = !eof && head.substr(0, 8) == "HTTP/1.1" &&
+            !(connection.size() >= 5 && strncasecmp(connection.data(), "close", 5) == 0);
+
+    const std::string_view encoding = headerValue(head, "Transfer-Encoding");
+    if (encoding.size() >= 7 && strncasecmp(encoding.data(), "chunked", 7) == 0) {
+        return decodeChunked(rest, &ep->body);
+    }
+    const std::string_view length = headerValue(head, "Content-Length");
+    if (!length.empty()) {
+        const size_t len = std::strtoul(std::string(length).c_str(), nullptr, 10);
+        if (rest.size() < len) return false;
+        ep->body.assign(rest.substr(0, len));
+        return true;
+    }
+    /* No framing: the body runs to the end of the connection. */
+    *keep = false;
+    if (!eof) return false;
+    ep->body.assign(rest);
+    return true;
+}
+
+static void readResponse(StatusEndpoint* ep) {
+    char buf[4096];
+    bool eof = false;
+    while (true) {
+        const ssize_t n = recv(ep->fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            ep->response.append(buf, static_cast<size_t>(n));
+            if (ep->response.size() > kMaxResponseBytes) {
+                failEndpoint(ep);
+                return;
+            }
+            continue;
+        }
+        if (n == 0) {
+            eof = true;
+            break;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        retryOrFail(ep);
+        return;
+    }
+    if (eof && ep->response.empty()) {
+        retryOrFail(ep);
+        return;
+    }
+    bool keep = false;
+    if (responseComplete(ep, eof, &keep)) {
+        ep->done = true;
+        if (!keep) closeEndpoint(ep);
+    } else if (eof) {
+        failEndpoint(ep);
+    }
+}
+
+/*
+ * Fetch every endpoint's page at once: one poll() loop drives all connects,
+ * writes and reads against a single deadline, so a silent port costs the
+ * timeout once per tick rather than once per page.
+ */
+static void fetchStatusPages(const std::vector<StatusEndpoint*>& endpoints, int timeout_ms) {
+    for (StatusEndpoint* ep : endpoints) {
+        if (!startRequest(ep)) failEndpoint(ep);
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    std::vector<pollfd> fds;
+    std::vector<StatusEndpoint*> polled;
+    while (true) {
+        fds.clear();
+        polled.clear();
+        for (StatusEndpoint* ep : endpoints) {
+            if (ep->done || ep->fd < 0) continue;
+            const bool writing = ep->connecting || ep->sent < ep->request.size();
+            fds.push_back(pollfd{ep->fd, static_cast<short>(writing ? POLLOUT : POLLIN), 0});
+            polled.push_back(ep);
+        }
+        if (fds.empty()) break;
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) break;
+        const int ready = poll(fds.data(), fds.size(), static_cast<int>(left));
+        if (ready < 0 && errno != EINTR) break;
+        if (ready <= 0) continue;
+
+        for (size_t i = 0; i < fds.size(); ++i) {
+            StatusEndpoint* ep = polled[i];
+            const short revents = fds[i].revents;
+            if (revents == 0) continue;
+            if (ep->connecting) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                if (getsockopt(ep->fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+                    failEndpoint(ep);
+                    continue;
+                }
+                ep->connecting = false;
+            }
+            if (ep->sent < ep->request.size()) {
+                if (revents & (POLLERR | POLLHUP)) {
+                    retryOrFail(ep);
+                    continue;
+                }
+                const ssize_t n = send(ep->fd, ep->request.data() + ep->sent,
+                                       ep->request.size() - ep->sent, MSG_NOSIGNAL);
+                if (n > 0) {
+                    ep->sent += static_cast<size_t>(n);
+                } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    retryOrFail(ep);
+                }
+                continue;
+            }
+            readResponse(ep);
+        }
+    }
+
+    /* Out of time: a half-read reply would desynchronise the connection, so drop it. */
+    for (StatusEndpoint* ep : endpoints) {
+        if (!ep->done) failEndpoint(ep);
+    }
+}
+
+/* Poll the endpoint that served the page last time and still has its connection; otherwise try them all. */
+static void addEndpoints(StatusSource* source, std::vector<StatusEndpoint*>* out) {
+    StatusEndpoint* known = nullptr;
+    for (auto& ep : source->endpoints) {
+        if (!known && ep.fd >= 0 && ep.status_code == 200) known = &ep;
+    }
+    for (auto& ep : source->endpoints) {
+        ep.done = false;
+        if (!known || &ep == known) {
+            out->push_back(&ep);
+        } else {
+            closeEndpoint(&ep);
+        }
+    }
+}
+
+static const std::string* statusPage(const StatusSource& source, const char* marker) {
+    for (const auto& ep : source.endpoints) {
+        if (ep.done && ep.status_code == 200 && ep.body.find(marker) != std::string::npos) return &ep.body;
+    }
+    return nullptr;
+}
+
+/* Requests per second from the change in the server's request counter since the last probe. */
+static void updateRate(StatusSource* source, WebServerInfo* ws) {
+    const auto now = std::chrono::steady_clock::now();
+    if (source->prev_total_requests >= 0 && ws->total_requests >= source->prev_total_requests) {
+        const double seconds = std::chrono::duration<double>(now - source->prev_time).count();
+        if (seconds > 0.0) {
+            ws->requests_per_sec = static_cast<double>(ws->total_requests - source->prev_total_requests) / seconds;
+        }
+    }
+    source->prev_total_requests = ws->total_requests;
+    source->prev_time = now;
+}
+
+static void resetSource(StatusSource* source) {
+    for (auto& ep : source->endpoints) closeEndpoint(&ep);
+    source->prev_total_requests = -1;
+}
+
+static void parseNginx(const std::string& status, WebServerInfo* ws) {
+    std::istringstream iss(status);
+    std::string line;
+    while (std::getline(iss, line)) {
+        line = trim(line);
+        if (line.rfind("Active connections:", 0) == 0) {
+            try { ws->active_connections = std::stoi(line.substr(19)); } catch (...) {}
+        }
+        if (line.find(" ") != std::string::npos && line.find(":") == std::string::npos) {
+            std::istringstream iss2(line);
+            int64_t accepts, handled, requests;
+            if (iss2 >> accepts >> handled >> requests) ws->total_requests = requests;
+        }
+    }
+}
+
+static void parseApache(const std::string& status, WebServerInfo* ws) {
+    std::istringstream iss(status);
+    std::string line;
+    while (std::getline(iss, line)) {
+        line = trim(line);
+        if (line.rfind("Total Accesses:", 0) == 0) {
+            try { ws->total_requests = std::stoll(line.substr(15)); } catch (...) {}
+        }
+        if (line.rfind("BusyWorkers:", 0) == 0) {
+            try { ws->active_connections = std::stoi(line.substr(12)); } catch (...) {}
+        }
+        if (line.rfind("ReqPerSec:", 0) == 0) {
+            try { ws->requests_per_sec = std::stod(line.substr(10)); } catch (...) {}
+        }
+    }
+}
+
+}
+
+namespace hmon::plugins::webserver {
+
+StatusEndpoint::~StatusEndpoint() {
+    if (fd >= 0) ::close(fd);
+}
+
+std::vector<WebServerInfo> collectWebServers(WebServerPluginCtx* ctx) {
     std::vector<WebServerInfo> result;
 
-    if (cmdExists("nginx") || systemdServiceActive("nginx")) {
+    const bool nginx_running = systemdServiceActive("nginx");
+    const bool apache_running = systemdServiceActive("apache2") || systemdServiceActive("httpd");
+
+    std::vector<StatusEndpoint*> endpoints;
+    if (nginx_running) addEndpoints(&ctx->nginx, &endpoints);
+    if (apache_running) addEndpoints(&ctx->apache, &endpoints);
+    fetchStatusPages(endpoints, kProbeTimeoutMs);
+
+    if (nginx_running || cmdExists("nginx")) {
         WebServerInfo ws;
         ws.type = "nginx";
-        ws.status = systemdServiceActive("nginx") ? "running" : "stopped";
-        if (ws.status == "running") {
-            std::string status = httpGet("http://127.0.0.1/nginx_status");
-            if (status.empty()) status = httpGet("http://127.0.0.1:8080/nginx_status");
-            if (!status.empty() && status.find("Active connections") != std::string::npos) {
-                std::istringstream iss(status);
-                std::string line;
-                while (std::getline(iss, line)) {
-                    line = trim(line);
-                    if (line.rfind("Active connections:", 0) == 0) {
-                        try { ws.active_connections = std::stoi(line.substr(19)); } catch (...) {}
-                    }
-                    if (line.find(" ") != std::string::npos && line.find(":") == std::string::npos) {
-                        std::istringstream iss2(line);
-                        int64_t accepts, handled, requests;
-                        if (iss2 >> accepts >> handled >> requests) {
-                            ws.total_requests = requests;
-                            if (ctx && ctx->prev_total_requests > 0) {
-                                ws.requests_per_sec = static_cast<double>(requests - ctx->prev_total_requests);
-                            }
-                            ctx->prev_total_requests = requests;
-                        }
-                    }
-                }
+        ws.status = nginx_running ? "running" : "stopped";
+        if (nginx_running) {
+            if (const std::string* status = statusPage(ctx->nginx, "Active connections")) {
+                parseNginx(*status, &ws);
+                updateRate(&ctx->nginx, &ws);
             }
+        } else {
+            resetSource(&ctx->nginx);
         }
         result.push_back(std::move(ws));
     }
 
-    if (cmdExists("apache2") || cmdExists("httpd") ||
-        systemdServiceActive("apache2") || systemdServiceActive("httpd")) {
+    if (apache_running || cmdExists("apache2") || cmdExists("httpd")) {
         WebServerInfo ws;
         ws.type = "apache";
-        ws.status = (systemdServiceActive("apache2") || systemdServiceActive("httpd")) ? "running" : "stopped";
-        if (ws.status == "running") {
-            std::string status = httpGet("http://127.0.0.1/server-status?auto");
-            if (status.empty()) status = httpGet("http://127.0.0.1:8080/server-status?auto");
-            if (!status.empty()) {
-                std::istringstream iss(status);
-                std::string line;
-                while (std::getline(iss, line)) {
-                    line = trim(line);
-                    if (line.rfind("Total Accesses:", 0) == 0) {
-                        try { ws.total_requests = std::stoll(line.substr(15)); } catch (...) {}
-                    }
-                    if (line.rfind("BusyWorkers:", 0) == 0) {
-                        try { ws.active_connections = std::stoi(line.substr(12)); } catch (...) {}
-                    }
-                    if (line.rfind("ReqPerSec:", 0) == 0) {
-                        try { ws.requests_per_sec = std::stod(line.substr(10)); } catch (...) {}
-                    }
-                }
-                if (ctx && ctx->prev_total_requests > 0 && ws.total_requests > ctx->prev_total_requests) {
-                    ws.requests_per_sec = static_cast<double>(ws.total_requests - ctx->prev_total_requests);
-                }
-                ctx->prev_total_requests = ws.total_requests;
+        ws.status = apache_running ? "running" : "stopped";
+        if (apache_running) {
+            if (const std::string* status = statusPage(ctx->apache, "BusyWorkers")) {
+                /* ReqPerSec is the average since startup; kept only until there is a delta. */
+                parseApache(*status, &ws);
+                updateRate(&ctx->apache, &ws);
             }
+        } else {
+            resetSource(&ctx->apache);
         }
         result.push_back(std::move(ws));
     }
 
-    if (ctx) {
-        ctx->cached_result = result;
-        ctx->last_cache_time = std::chrono::steady_clock::now();
-    }
     return result;
 }
 
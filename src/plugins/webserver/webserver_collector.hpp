@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -15,12 +17,43 @@ struct WebServerInfo {
     int64_t uptime_seconds = 0;
 };
 
+/* A keep-alive HTTP connection to one local status page, e.g. 127.0.0.1:80/nginx_status. */
+struct StatusEndpoint {
+    uint16_t port = 0;
+    const char* path = "";
+    int fd = -1;
+    bool connecting = false;
+    bool reused = false;        /* the request went out on a connection kept from an earlier probe */
+    std::string request;
+    size_t sent = 0;
+    std::string response;
+    bool done = false;
+    int status_code = 0;
+    std::string body;
+
+    StatusEndpoint() = default;
+    StatusEndpoint(const StatusEndpoint&) = delete;
+    StatusEndpoint& operator=(const StatusEndpoint&) = delete;
+    ~StatusEndpoint();
+};
+
+/* Status pages tried for one server kind, and the counter the request rate is derived from. */
+struct StatusSource {
+    explicit StatusSource(const char* path) {
+        endpoints[0].port = 80;
+        endpoints[1].port = 8080;
+        for (auto& ep : endpoints) ep.path = path;
+    }
+
+    std::array<StatusEndpoint, 2> endpoints;
+    int64_t prev_total_requests = -1;
+    std::chrono::steady_clock::time_point prev_time{};
+};
+
 struct WebServerPluginCtx {
     std::vector<WebServerInfo> servers;
-    std::vector<WebServerInfo> cached_result;
-    std::chrono::steady_clock::time_point last_cache_time;
-    static constexpr int TTL_SECONDS = 10;
-    int64_t prev_total_requests = 0;
+    StatusSource nginx{"/nginx_status"};
+    StatusSource apache{"/server-status?auto"};
 };
 
 std::vector<WebServerInfo> collectWebServers(WebServerPluginCtx* ctx);